@@ -2,10 +2,29 @@
 #include "filedialog.h"
 #include "trianglemesh.h"
 #include "imagetexture.h"
+#include "textureresidency.h"
+#include "virtualtexture.h"
 #include "camera.h"
 #include "light.h"
+#include "clusteredlights.h"
 #include "shaderprog.h"
 #include "skybox.h"
+#include "environmentlighting.h"
+#include "rendertarget.h"
+#include "gbuffer.h"
+#include "ssao.h"
+#include "hdrpipeline.h"
+#include "oit.h"
+#include "debugdraw.h"
+#include "shadowmaps.h"
+#include "pointshadowmap.h"
+#include "framecapture.h"
+#include "batchrender.h"
+#include "threadpool.h"
+#include "softrasterizer.h"
+#include "bvh.h"
+#include "aobaker.h"
+#include "timer.h"
 using namespace std;
 
 #define MAX_PATH_SIZE 1024
@@ -42,12 +61,47 @@ float spotLightTotalWidthInDegree = 45.0f;
 
 glm::vec3 dirLightDirection = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 dirLightRadiance = glm::vec3(0.6f, 0.6f, 0.6f);
+// Point and spot lights for clustered shading; --lights <N> adds random ones up to N lights
+// in total (with the three above). 'k' switches between clustered and all lights per pixel.
+ClusteredLights* clusteredLights = nullptr;
+vector<LocalLight> extraLights;
+int numSceneLights = 3;
+bool useClusteredLights = true;
+// Shadow maps of the directional and spot lights, and the cubemap of the point light at half
+// the resolution ('h' toggles them, --shadow-size sets the resolution). Their GPU time is
+// printed every shadowTimingFrames frames.
+ShadowMaps* shadowMaps = nullptr;
+PointShadowMap* pointShadowMap = nullptr;
+bool useShadows = true;
+int shadowMapSize = 2048;
+const int shadowTimingFrames = 600;
 // Skybox.
 Skybox* skybox = nullptr;
+// Image-based lighting from the skybox panorama (--ibl).
+EnvironmentLighting* envLighting = nullptr;
+bool useIbl = false;
+// Ambient occlusion per vertex baked on load with --ao <rays per vertex> ('i' toggles it).
+int aoRaysPerVertex = 0;
+bool useOcclusion = true;
 // Shader.
 PhongShadingShaderProg* phongShadingShader = nullptr;
-FillColorShaderProg* fillColorShader = nullptr;
+ShaderProg* debugDrawShader = nullptr;
 SkyboxShaderProg* skyboxShader = nullptr;
+SkyboxCubeShaderProg* skyboxCubeShader = nullptr;
+VirtualTextureFeedbackShaderProg* vtFeedbackShader = nullptr;
+// The geometry pass of deferred shading is phong_shading.fs compiled with GBUFFER_PASS.
+PhongShadingShaderProg* gBufferShader = nullptr;
+DeferredLightingShaderProg* deferredLightingShader = nullptr;
+ShaderProg* shadowDepthShader = nullptr;
+PointShadowShaderProg* pointShadowShader = nullptr;
+SsaoShaderProg* ssaoShader = nullptr;
+SsaoShaderProg* ssaoBlurShader = nullptr;
+HdrShaderProg* bloomDownsampleShader = nullptr;
+HdrShaderProg* bloomUpsampleShader = nullptr;
+HdrShaderProg* toneMapShader = nullptr;
+// The accumulation pass of the transparency is phong_shading.fs compiled with OIT_PASS.
+PhongShadingShaderProg* oitShader = nullptr;
+OitCompositeShaderProg* oitCompositeShader = nullptr;
 
 bool firstSkyboxTex = true;
 // UI.
@@ -56,6 +110,90 @@ static float curRotationY = 0.0f;
 static float rotDirectionY = 1.0f;
 const float rotStep = 0.005f;
 const float lightMoveSpeed = 0.2f;
+// Batch and software rendering (command line).
+string batchManifestPath = "";
+string softRasterObjPath = "";
+string softRasterOutputPath = "";
+int softRasterFrames = 1;
+string bvhBenchObjPath = "";
+string mipBenchImagePath = "";
+string decodeBenchImagePath = "";
+string lightBenchObjPath = "";
+string overdrawBenchObjPath = "";
+string aoBenchObjPath = "";
+string oitBenchObjPath = "";
+string oitBenchOutputPath = "";
+int outputWidth = 800;
+int outputHeight = 800;
+unsigned int batchLoaderThreads = 0;
+const int batchNumReadbackSlots = 3;
+// Frame capture ('g': save one frame, 'v': start/stop recording).
+FrameCapture* frameCapture = nullptr;
+string capturePrefix = "capture_";
+string captureFormat = "png";
+int captureNumFrames = 0;
+// Index of the next frame file, and of the next frame of the turntable being recorded.
+int captureFrameIndex = 0;
+int turntableFrameIndex = 0;
+bool isRecording = false;
+bool captureOneFrame = false;
+// Streaming texture uploads (--stream-uploads) and the longest frame while a load is uploading.
+TextureStreamer* textureStreamer = nullptr;
+int streamMBPerFrame = 0;
+CpuTimer frameTimer;
+CpuTimer loadHitchTimer;
+string loadHitchLabel = "";
+double loadHitchMaxMs = 0.0;
+int loadHitchFrames = 0;
+// Texture residency (--texture-budget): a VRAM budget with mip levels streamed by texel density.
+TextureResidency* textureResidency = nullptr;
+int textureBudgetMB = 0;
+// Virtual texturing of large diffuse maps (--virtual-textures): a page cache of N x N tiles.
+VirtualTextureSystem* virtualTextures = nullptr;
+int virtualTexturePages = 0;
+// Pack the material textures of a model into texture arrays (--texture-arrays).
+bool packTextureArrays = false;
+// GPU time of the skybox draw, averaged and printed every skyboxTimingFrames frames.
+GpuTimer* skyboxGpuTimer = nullptr;
+const int skyboxTimingFrames = 600;
+// Deferred shading (--deferred; 'f' switches between forward and deferred at runtime). The
+// GPU time of the scene is averaged and printed every sceneTimingFrames frames.
+GBuffer* gBuffer = nullptr;
+bool useDeferred = false;
+GpuTimer* sceneGpuTimer = nullptr;
+const int sceneTimingFrames = 300;
+// Depth pre-pass of the opaque submeshes ('z' toggles it, --depth-prepass turns it on): the
+// shading pass then tests GL_EQUAL without depth writes and shades each pixel once. The
+// samples it shades are printed with the GPU time of the scene.
+bool useDepthPrepass = false;
+GpuSampleCounter* sceneSampleCounter = nullptr;
+// Gizmos of the lights and the bounds ('b'), with a budget of vertices per frame.
+DebugDraw* debugDraw = nullptr;
+const int debugDrawMaxVertices = 65536;
+bool showBounds = false;
+// Screen-space ambient occlusion after the opaque pass ('x' cycles off and the qualities,
+// --ssao low|medium|high turns it on).
+Ssao* ssao = nullptr;
+bool useSsao = false;
+SsaoQuality ssaoQuality = SSAO_QUALITY_MEDIUM;
+// HDR rendering ('y' cycles off and the tone mapping operators, --hdr reinhard|aces turns it
+// on): the frame goes to an RGBA16F target, tone mapped with the exposure ('[' and ']') and
+// the bloom ('n' toggles it).
+HdrPipeline* hdrPipeline = nullptr;
+bool useHdr = false;
+ToneMapOperator toneMapOperator = TONE_MAP_ACES;
+float exposure = 1.0f;
+bool useBloom = true;
+const float bloomStrength = 0.05f;
+// Transparent submeshes (MTL d < 1 or map_d) after the opaque pass, in one unsorted pass:
+// weighted blended OIT, or alpha blending in submesh order ('j' switches). Their GPU time is
+// printed every sceneTimingFrames frames.
+Oit* oit = nullptr;
+bool useOit = true;
+GpuTimer* transparentGpuTimer = nullptr;
+// Picking (left click without dragging).
+glm::ivec2 mouseDownPos = glm::ivec2(0, 0);
+const int pickMaxDragPixels = 3;
 
 // SceneObject.
 struct SceneObject
@@ -63,13 +201,26 @@ struct SceneObject
     SceneObject() 
     {
         mesh = nullptr;
+        bvh = nullptr;
         worldMatrix = glm::mat4x4(1.0f);
     }
     TriangleMesh* mesh;
+    Bvh* bvh;
     glm::mat4x4 worldMatrix;
 };
 SceneObject sceneObj;
 
+// Submeshes drawn by DrawSceneObject(). The opaque ones include the alpha tested cutouts,
+// the solid ones do not.
+enum SubMeshFilter
+{
+    DRAW_ALL_SUBMESHES,
+    DRAW_OPAQUE_SUBMESHES,
+    DRAW_SOLID_SUBMESHES,
+    DRAW_ALPHA_TESTED_SUBMESHES,
+    DRAW_TRANSPARENT_SUBMESHES
+};
+
 // ScenePointLight (for visualization of a point light).
 struct ScenePointLight
 {
@@ -112,9 +263,43 @@ void SetupRenderState();
 void LoadObjects();
 void CreateCamera();
 void CreateLights();
+void CreateExtraLights(const int);
 void CreateSkybox();
 void CreateShaderLib();
+void CreateVirtualTextures();
 void Start();
+void UpdateClusteredLights(Camera*);
+void RenderShadowMaps(SceneObject&, Camera*);
+void RenderSceneObject(SceneObject&, Camera*);
+void DrawSceneObject(SceneObject&, Camera*, PhongShadingShaderProg*, const SubMeshFilter = DRAW_ALL_SUBMESHES, const bool = false);
+void DrawSceneDepth(SceneObject&, Camera*);
+void SetDepthEqualTest(const bool);
+void SetLightUniforms(PhongShadingShaderProg*, Camera*);
+void SetSsaoUniforms(PhongShadingShaderProg*, Camera*, const bool);
+void BeginDeferredGeometry();
+void ShadeDeferred(Camera*, const bool = false);
+bool RenderSsao(SceneObject&, Camera*);
+void RenderTransparentObject(SceneObject&, Camera*);
+void BeginHdrFrame();
+void ResolveHdrFrame();
+void RequestTextureLevels(SceneObject&, Camera*);
+void RenderVirtualTextureFeedback(SceneObject&, Camera*);
+void RenderLightObjects(Camera*);
+void RenderSkybox(Camera*, const float);
+void UpdateCapture();
+void BeginLoadHitch(const string&);
+void UpdateLoadHitch();
+void PickSceneObject(int, int);
+bool ParseCommandLine(int, char**);
+int RunBatch();
+int RunSoftRaster();
+int RunBvhBench();
+int RunMipBench();
+int RunDecodeBench();
+int RunLightBench();
+int RunOverdrawBench();
+int RunAoBench();
+int RunOitBench();
 string GetSubFilePath();
 
 
@@ -132,6 +317,11 @@ void ReleaseResources()
         delete mesh;
         mesh = nullptr;
     }
+    if (sceneObj.bvh != nullptr)
+    {
+        delete sceneObj.bvh;
+        sceneObj.bvh = nullptr;
+    }
     // Delete camera.
     if (camera != nullptr)
     {
@@ -154,161 +344,952 @@ void ReleaseResources()
         delete dirLight;
         dirLight = nullptr;
     }
+    if (clusteredLights != nullptr)
+    {
+        delete clusteredLights;
+        clusteredLights = nullptr;
+    }
+    if (shadowMaps != nullptr)
+    {
+        delete shadowMaps;
+        shadowMaps = nullptr;
+    }
+    if (pointShadowMap != nullptr)
+    {
+        delete pointShadowMap;
+        pointShadowMap = nullptr;
+    }
     // Delete skybox.
     if (skybox != nullptr)
     {
         delete skybox;
         skybox = nullptr;
     }
+    if (envLighting != nullptr)
+    {
+        delete envLighting;
+        envLighting = nullptr;
+    }
+    // Delete frame capture (writes the pending frames).
+    if (frameCapture != nullptr)
+    {
+        delete frameCapture;
+        frameCapture = nullptr;
+    }
     // Delete shaders.
     if (phongShadingShader != nullptr)
     {
         delete phongShadingShader;
         phongShadingShader = nullptr;
     }
-    if (fillColorShader != nullptr)
+    if (debugDrawShader != nullptr)
     {
-        delete fillColorShader;
-        fillColorShader = nullptr;
+        delete debugDrawShader;
+        debugDrawShader = nullptr;
     }
     if (skyboxShader != nullptr)
     {
         delete skyboxShader;
         skyboxShader = nullptr;
     }
+    if (skyboxCubeShader != nullptr)
+    {
+        delete skyboxCubeShader;
+        skyboxCubeShader = nullptr;
+    }
+    if (vtFeedbackShader != nullptr)
+    {
+        delete vtFeedbackShader;
+        vtFeedbackShader = nullptr;
+    }
+    if (gBufferShader != nullptr)
+    {
+        delete gBufferShader;
+        gBufferShader = nullptr;
+    }
+    if (deferredLightingShader != nullptr)
+    {
+        delete deferredLightingShader;
+        deferredLightingShader = nullptr;
+    }
+    if (shadowDepthShader != nullptr)
+    {
+        delete shadowDepthShader;
+        shadowDepthShader = nullptr;
+    }
+    if (pointShadowShader != nullptr)
+    {
+        delete pointShadowShader;
+        pointShadowShader = nullptr;
+    }
+    if (ssaoShader != nullptr)
+    {
+        delete ssaoShader;
+        ssaoShader = nullptr;
+    }
+    if (ssaoBlurShader != nullptr)
+    {
+        delete ssaoBlurShader;
+        ssaoBlurShader = nullptr;
+    }
+    if (bloomDownsampleShader != nullptr)
+    {
+        delete bloomDownsampleShader;
+        bloomDownsampleShader = nullptr;
+    }
+    if (bloomUpsampleShader != nullptr)
+    {
+        delete bloomUpsampleShader;
+        bloomUpsampleShader = nullptr;
+    }
+    if (toneMapShader != nullptr)
+    {
+        delete toneMapShader;
+        toneMapShader = nullptr;
+    }
+    if (oitShader != nullptr)
+    {
+        delete oitShader;
+        oitShader = nullptr;
+    }
+    if (oitCompositeShader != nullptr)
+    {
+        delete oitCompositeShader;
+        oitCompositeShader = nullptr;
+    }
+    if (skyboxGpuTimer != nullptr)
+    {
+        delete skyboxGpuTimer;
+        skyboxGpuTimer = nullptr;
+    }
+    if (sceneGpuTimer != nullptr)
+    {
+        delete sceneGpuTimer;
+        sceneGpuTimer = nullptr;
+    }
+    if (sceneSampleCounter != nullptr)
+    {
+        delete sceneSampleCounter;
+        sceneSampleCounter = nullptr;
+    }
+    if (transparentGpuTimer != nullptr)
+    {
+        delete transparentGpuTimer;
+        transparentGpuTimer = nullptr;
+    }
+    // Delete the G-buffer, the SSAO, transparency and HDR targets and the gizmos.
+    if (gBuffer != nullptr)
+    {
+        delete gBuffer;
+        gBuffer = nullptr;
+    }
+    if (ssao != nullptr)
+    {
+        delete ssao;
+        ssao = nullptr;
+    }
+    if (oit != nullptr)
+    {
+        delete oit;
+        oit = nullptr;
+    }
+    if (hdrPipeline != nullptr)
+    {
+        delete hdrPipeline;
+        hdrPipeline = nullptr;
+    }
+    if (debugDraw != nullptr)
+    {
+        delete debugDraw;
+        debugDraw = nullptr;
+    }
+    // Delete the residency manager and the texture streamer (after the textures that use them).
+    if (textureResidency != nullptr)
+    {
+        ImageTexture::SetResidency(nullptr);
+        delete textureResidency;
+        textureResidency = nullptr;
+    }
+    if (textureStreamer != nullptr)
+    {
+        ImageTexture::SetStreamer(nullptr);
+        delete textureStreamer;
+        textureStreamer = nullptr;
+    }
+    if (virtualTextures != nullptr)
+    {
+        ImageTexture::SetVirtualTextures(nullptr);
+        delete virtualTextures;
+        virtualTextures = nullptr;
+    }
 }
 
-void RenderSceneCB()
+void UpdateClusteredLights(Camera* cam)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    // Render a triangle mesh with Gouraud shading.
-    TriangleMesh* mesh = sceneObj.mesh;
-    PointLight* pointLight = pointLightObj.light;
-    SpotLight* spotLight = spotLightObj.light;
-    if (camera != nullptr && mesh != nullptr && pointLight != nullptr && spotLight != nullptr)
+    // The point and spot lights moved with the keys come first, then the extra lights.
+    if (cam == nullptr || clusteredLights == nullptr || pointLight == nullptr || spotLight == nullptr)
+        return;
+    vector<LocalLight>& lights = clusteredLights->GetLights();
+    lights.clear();
+    lights.push_back(LocalLight(pointLight->GetPosition(), pointLight->GetIntensity()));
+    lights.push_back(LocalLight(spotLight->GetPosition(), spotLight->GetIntensity(), spotLight->GetDirection(),
+        spotLight->GetCutoffStartInDegree(), spotLight->GetTotalWidthInDegree()));
+    lights.insert(lights.end(), extraLights.begin(), extraLights.end());
+    clusteredLights->Update(cam->GetViewMatrix(), cam->GetProjMatrix());
+}
+
+void RenderShadowMaps(SceneObject& obj, Camera* cam)
+{
+    // Depth of the object seen from the lights, positions only.
+    TriangleMesh* mesh = obj.mesh;
+    if (!useShadows || cam == nullptr || mesh == nullptr)
+        return;
+    if (shadowMaps == nullptr)
     {
-        // Update transform.
-        if (isRotated)
-            curRotationY += rotDirectionY * rotStep;
-        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
-        glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(curRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
-        sceneObj.worldMatrix = S * R;
+        shadowMaps = new ShadowMaps(shadowMapSize);
+        cout << "Shadow maps: " << NUM_SHADOW_CASCADES << " cascades and a spot light map of " << shadowMapSize << " x "
+            << shadowMapSize << " (" << shadowMaps->GetGpuBytes() / (1 << 20) << " MB)" << endl;
+    }
+    float scale = max(max(glm::length(glm::vec3(obj.worldMatrix[0])), glm::length(glm::vec3(obj.worldMatrix[1]))),
+        glm::length(glm::vec3(obj.worldMatrix[2])));
+    glm::vec3 center = glm::vec3(obj.worldMatrix * glm::vec4(mesh->GetObjCenter(), 1.0f));
+    float radius = 0.5f * scale * glm::length(mesh->GetObjExtent());
+    shadowMaps->Render(cam, dirLight, spotLight, center, radius, [&obj, mesh](const glm::mat4x4& viewProj) {
+        glm::mat4x4 MVP = viewProj * obj.worldMatrix;
+        shadowDepthShader->Bind();
+        glUniformMatrix4fv(shadowDepthShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+        mesh->DrawDepth();
+        shadowDepthShader->UnBind();
+    });
+    if (shadowMaps->GetNumTimingSamples() >= shadowTimingFrames)
+        shadowMaps->ShowInfo();
+
+    // The cubemap keeps the faces that neither the light nor the object moved in.
+    if (pointLight == nullptr)
+        return;
+    if (pointShadowMap == nullptr)
+    {
+        pointShadowMap = new PointShadowMap(max(128, shadowMapSize / 2));
+        cout << "Point shadow cubemap: 6 x " << pointShadowMap->GetSize() << " x " << pointShadowMap->GetSize()
+            << " (" << pointShadowMap->GetGpuBytes() / (1 << 20) << " MB)" << endl;
+    }
+    pointShadowMap->Update(pointLight->GetPosition(), ClusteredLights::ComputeRange(pointLight->GetIntensity()), mesh,
+        obj.worldMatrix, center, radius, [&obj, mesh](int faceMask) {
+        pointShadowShader->Bind();
+        glUniformMatrix4fv(pointShadowShader->GetLocWorldMatrix(), 1, GL_FALSE, glm::value_ptr(obj.worldMatrix));
+        glUniformMatrix4fv(pointShadowShader->GetLocFaceMatrices(), 6, GL_FALSE, glm::value_ptr(pointShadowMap->GetFaceMatrices()[0]));
+        glUniform1i(pointShadowShader->GetLocFaceMask(), faceMask);
+        glUniform3fv(pointShadowShader->GetLocLightPos(), 1, glm::value_ptr(pointShadowMap->GetLightPos()));
+        glUniform1f(pointShadowShader->GetLocFarPlane(), pointShadowMap->GetFarPlane());
+        mesh->DrawDepth();
+        pointShadowShader->UnBind();
+    });
+    if (pointShadowMap->GetNumFrames() >= shadowTimingFrames)
+        pointShadowMap->ShowInfo();
+}
 
-        glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(sceneObj.worldMatrix));
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * sceneObj.worldMatrix;
+void RenderSceneObject(SceneObject& obj, Camera* cam)
+{
+    // Render the opaque submeshes of a triangle mesh with Phong shading, forward or deferred.
+    if (cam == nullptr || obj.mesh == nullptr || clusteredLights == nullptr)
+        return;
+    if (sceneSampleCounter == nullptr)
+        sceneSampleCounter = new GpuSampleCounter();
+    // A forward frame needs its occlusion before it is shaded.
+    const bool applySsao = !useDeferred && RenderSsao(obj, cam);
+    if (useDeferred)
+        BeginDeferredGeometry();
+    if (useDepthPrepass)
+    {
+        DrawSceneDepth(obj, cam);
+        SetDepthEqualTest(true);
+    }
+    PhongShadingShaderProg* shader = useDeferred ? gBufferShader : phongShadingShader;
+    sceneSampleCounter->Begin();
+    if (useDepthPrepass)
+    {
+        // The holes of the cutouts have no depth in the pre-pass, so they are depth tested as usual.
+        DrawSceneObject(obj, cam, shader, DRAW_SOLID_SUBMESHES, applySsao);
+        SetDepthEqualTest(false);
+        if (obj.mesh->GetNumAlphaTestedSubMeshes() > 0)
+            DrawSceneObject(obj, cam, shader, DRAW_ALPHA_TESTED_SUBMESHES, applySsao);
+    }
+    else
+        DrawSceneObject(obj, cam, shader, DRAW_OPAQUE_SUBMESHES, applySsao);
+    sceneSampleCounter->End();
+    if (useDeferred)
+        ShadeDeferred(cam, RenderSsao(obj, cam));
+}
 
-        phongShadingShader->Bind();
-        glUniformMatrix4fv(phongShadingShader->GetLocM(), 1, GL_FALSE, glm::value_ptr(sceneObj.worldMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(phongShadingShader->GetLocCameraPos(), 1, glm::value_ptr(camera->GetCameraPos()));
+void DrawSceneDepth(SceneObject& obj, Camera* cam)
+{
+    // Draw the depth of the solid submeshes only, from the packed positions of the mesh (the
+    // cutouts would need their opacity maps).
+    glm::mat4x4 MVP = cam->GetProjMatrix() * cam->GetViewMatrix() * obj.worldMatrix;
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    shadowDepthShader->Bind();
+    glUniformMatrix4fv(shadowDepthShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+    obj.mesh->DrawDepth(true, true);
+    shadowDepthShader->UnBind();
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
 
-        glUniform3fv(phongShadingShader->GetLocAmbientLight(), 1, glm::value_ptr(ambientLight));
-        glUniform3fv(phongShadingShader->GetLocPointLightPos(), 1, glm::value_ptr(pointLight->GetPosition()));
-        glUniform3fv(phongShadingShader->GetLocPointLightIntensity(), 1, glm::value_ptr(pointLight->GetIntensity()));
+void SetDepthEqualTest(const bool enable)
+{
+    // After DrawSceneDepth() only the nearest fragments pass, and the depth is already final.
+    glDepthFunc(enable ? GL_EQUAL : GL_LESS);
+    glDepthMask(enable ? GL_FALSE : GL_TRUE);
+}
 
-        glUniform3fv(phongShadingShader->GetLocSpotLightPos(), 1, glm::value_ptr(spotLight->GetPosition()));
-        glUniform3fv(phongShadingShader->GetLocSpotLightIntensity(), 1, glm::value_ptr(spotLight->GetIntensity()));
-        glUniform3fv(phongShadingShader->GetLocSpotLightDir(), 1, glm::value_ptr(spotLight->GetDirection()));
-        glUniform1f(phongShadingShader->GetLocCutoffStart(), spotLight->GetCutoffStartInDegree());
-        glUniform1f(phongShadingShader->GetLocTotalWidth(), spotLight->GetTotalWidthInDegree());
+void DrawSceneObject(SceneObject& obj, Camera* cam, PhongShadingShaderProg* shader, const SubMeshFilter filter, const bool applySsao)
+{
+    // Draw a triangle mesh with Phong shading, into the G-buffer with gBufferShader, or into
+    // the transparency targets with oitShader. With applySsao the ambient term is scaled by
+    // the occlusion of RenderSsao().
+    TriangleMesh* mesh = obj.mesh;
 
-        glUniform3fv(phongShadingShader->GetLocDirLightDir(), 1, glm::value_ptr(dirLight->GetDirection()));
-        glUniform3fv(phongShadingShader->GetLocDirLightRadiance(), 1, glm::value_ptr(dirLight->GetRadiance()));
+    glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(obj.worldMatrix));
+    glm::mat4x4 MVP = cam->GetProjMatrix() * cam->GetViewMatrix() * obj.worldMatrix;
 
-        unsigned int i = 0;
-        for (SubMesh& subMesh : mesh->GetSubMeshes())
+    shader->Bind();
+    glUniformMatrix4fv(shader->GetLocM(), 1, GL_FALSE, glm::value_ptr(obj.worldMatrix));
+    glUniformMatrix4fv(shader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    glUniformMatrix4fv(shader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+    SetLightUniforms(shader, cam);
+    SetSsaoUniforms(shader, cam, applySsao);
+    glUniform1i(shader->GetLocUseOcclusion(), useOcclusion && mesh->GetHadOcclusion());
+
+    if (textureResidency != nullptr)
+        RequestTextureLevels(obj, cam);
+    // Texture arrays stay bound on units 5-9 for all submeshes. The array samplers always
+    // point there, since they must not share a unit with the 2D maps even when unused.
+    GLint locMapArrays[NUM_TEXTURE_MAPS] = {
+        shader->GetLocMapNormArray(), shader->GetLocMapKaArray(), shader->GetLocMapKdArray(),
+        shader->GetLocMapKsArray(), shader->GetLocMapNsArray()
+    };
+    for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+    {
+        glUniform1i(locMapArrays[map], 5 + map);
+        TextureArray* textureArray = mesh->GetTextureArray(static_cast<TextureMap>(map));
+        if (textureArray != nullptr)
+            textureArray->Bind(GL_TEXTURE5 + map);
+    }
+    // Virtual diffuse maps: the indirection texture of the submesh on unit 11, the page cache on 12.
+    glUniform1i(shader->GetLocVtIndirection(), 11);
+    glUniform1i(shader->GetLocVtPhysical(), 12);
+    if (virtualTextures != nullptr)
+        virtualTextures->BindPhysical(GL_TEXTURE12);
+    unsigned int i = 0;
+    for (SubMesh& subMesh : mesh->GetSubMeshes())
+    {
+        bool transparent = (subMesh.material)->GetTransparent();
+        bool alphaTested = (subMesh.material)->GetAlphaTested();
+        if ((filter == DRAW_OPAQUE_SUBMESHES && transparent) || (filter == DRAW_TRANSPARENT_SUBMESHES && !transparent)
+            || (filter == DRAW_SOLID_SUBMESHES && (transparent || alphaTested)) || (filter == DRAW_ALPHA_TESTED_SUBMESHES && !alphaTested))
         {
-            glUniform3fv(phongShadingShader->GetLocKa(), 1, glm::value_ptr((subMesh.material)->GetKa()));
-            glUniform3fv(phongShadingShader->GetLocKd(), 1, glm::value_ptr((subMesh.material)->GetKd()));
-            glUniform3fv(phongShadingShader->GetLocKs(), 1, glm::value_ptr((subMesh.material)->GetKs()));
-            glUniform1f(phongShadingShader->GetLocNs(), (subMesh.material)->GetNs());
+            i++;
+            continue;
+        }
+        glUniform3fv(shader->GetLocKa(), 1, glm::value_ptr((subMesh.material)->GetKa()));
+        glUniform3fv(shader->GetLocKd(), 1, glm::value_ptr((subMesh.material)->GetKd()));
+        glUniform3fv(shader->GetLocKs(), 1, glm::value_ptr((subMesh.material)->GetKs()));
+        glUniform1f(shader->GetLocNs(), (subMesh.material)->GetNs());
 
-            ImageTexture* imageTexNorm = (subMesh.material)->GetMapNorm();
-            bool hadMapNorm = (subMesh.material)->GetHadMapNorm();
-            glUniform1i(phongShadingShader->GetLocHadMapNorm(), hadMapNorm);
-            if (hadMapNorm)
-            {
-                glUniform1i(phongShadingShader->GetLocMapNorm(), 0);
+        ImageTexture* imageTexNorm = (subMesh.material)->GetMapNorm();
+        bool hadMapNorm = (subMesh.material)->GetHadMapNorm();
+        int layerNorm = mesh->GetTextureLayer(TEXTURE_MAP_NORM, imageTexNorm);
+        glUniform1i(shader->GetLocHadMapNorm(), hadMapNorm);
+        glUniform1i(shader->GetLocMapNormLayer(), layerNorm);
+        if (hadMapNorm)
+        {
+            glUniform1i(shader->GetLocMapNorm(), 0);
+            glUniform1i(shader->GetLocMapNormTwoChannel(), imageTexNorm->GetTwoChannel());
+            if (layerNorm < 0)
                 imageTexNorm->Bind(GL_TEXTURE0);
-            }
-            ImageTexture* imageTexKa = (subMesh.material)->GetMapKa();
-            bool hadMapKa = (subMesh.material)->GetHadMapKa();
-            glUniform1i(phongShadingShader->GetLocHadMapKa(), hadMapKa);
-            if (hadMapKa)
-            {
-                glUniform1i(phongShadingShader->GetLocMapKa(), 1);
+        }
+        ImageTexture* imageTexKa = (subMesh.material)->GetMapKa();
+        bool hadMapKa = (subMesh.material)->GetHadMapKa();
+        int layerKa = mesh->GetTextureLayer(TEXTURE_MAP_KA, imageTexKa);
+        glUniform1i(shader->GetLocHadMapKa(), hadMapKa);
+        glUniform1i(shader->GetLocMapKaLayer(), layerKa);
+        if (hadMapKa)
+        {
+            glUniform1i(shader->GetLocMapKa(), 1);
+            if (layerKa < 0)
                 imageTexKa->Bind(GL_TEXTURE1);
-            }
-            ImageTexture* imageTexKd = (subMesh.material)->GetMapKd();
-            bool hadMapKd = (subMesh.material)->GetHadMapKd();
-            glUniform1i(phongShadingShader->GetLocHadMapKd(), hadMapKd);
-            if (hadMapKd)
-            {
+        }
+        ImageTexture* imageTexKd = (subMesh.material)->GetMapKd();
+        bool hadMapKd = (subMesh.material)->GetHadMapKd();
+        int layerKd = mesh->GetTextureLayer(TEXTURE_MAP_KD, imageTexKd);
+        VirtualTexture* virtualKd = hadMapKd ? imageTexKd->GetVirtual() : nullptr;
+        // A virtual texture that could not be registered is left out.
+        if (virtualKd != nullptr && (virtualTextures == nullptr || virtualTextures->GetId(virtualKd) == 0))
+            hadMapKd = false;
+        glUniform1i(shader->GetLocHadMapKd(), hadMapKd);
+        glUniform1i(shader->GetLocMapKdLayer(), layerKd);
+        glUniform1i(shader->GetLocMapKdVirtual(), hadMapKd && virtualKd != nullptr);
+        if (hadMapKd && virtualKd != nullptr)
+        {
+            glUniform2i(shader->GetLocVtSize(), virtualKd->GetWidth(), virtualKd->GetHeight());
+            glUniform1i(shader->GetLocVtMaxLevel(), virtualKd->GetNumLevels() - 1);
+            virtualTextures->BindIndirection(virtualKd, GL_TEXTURE11);
+        }
+        else if (hadMapKd)
+        {
+            if (layerKd < 0)
                 imageTexKd->Bind(GL_TEXTURE2);
-                glUniform1i(phongShadingShader->GetLocMapKd(), 2);
-            }
-            ImageTexture* imageTexKs = (subMesh.material)->GetMapKs();
-            bool hadMapKs = (subMesh.material)->GetHadMapKs();
-            glUniform1i(phongShadingShader->GetLocHadMapKs(), hadMapKs);
-            if (hadMapKs)
-            {
-                glUniform1i(phongShadingShader->GetLocMapKs(), 3);
+            glUniform1i(shader->GetLocMapKd(), 2);
+        }
+        ImageTexture* imageTexKs = (subMesh.material)->GetMapKs();
+        bool hadMapKs = (subMesh.material)->GetHadMapKs();
+        int layerKs = mesh->GetTextureLayer(TEXTURE_MAP_KS, imageTexKs);
+        glUniform1i(shader->GetLocHadMapKs(), hadMapKs);
+        glUniform1i(shader->GetLocMapKsLayer(), layerKs);
+        if (hadMapKs)
+        {
+            glUniform1i(shader->GetLocMapKs(), 3);
+            if (layerKs < 0)
                 imageTexKs->Bind(GL_TEXTURE3);
-            }
-            ImageTexture* imageTexNs = (subMesh.material)->GetMapNs();
-            bool hadMapNs = (subMesh.material)->GetHadMapNs();
-            glUniform1i(phongShadingShader->GetLocHadMapNs(), hadMapNs);
-            if (hadMapNs)
-            {
-                glUniform1i(phongShadingShader->GetLocMapNs(), 4);
+        }
+        ImageTexture* imageTexNs = (subMesh.material)->GetMapNs();
+        bool hadMapNs = (subMesh.material)->GetHadMapNs();
+        int layerNs = mesh->GetTextureLayer(TEXTURE_MAP_NS, imageTexNs);
+        glUniform1i(shader->GetLocHadMapNs(), hadMapNs);
+        glUniform1i(shader->GetLocMapNsLayer(), layerNs);
+        if (hadMapNs)
+        {
+            glUniform1i(shader->GetLocMapNs(), 4);
+            if (layerNs < 0)
                 imageTexNs->Bind(GL_TEXTURE4);
-            }
-            // Render model.
-            mesh->Draw(i);
-            i++;
         }
-        phongShadingShader->UnBind();
+        // Opacity maps are never packed; they go on unit 18.
+        bool hadMapD = (subMesh.material)->GetHadMapD();
+        glUniform1f(shader->GetLocOpacity(), (subMesh.material)->GetOpacity());
+        glUniform1i(shader->GetLocHadMapD(), hadMapD);
+        glUniform1i(shader->GetLocMapD(), 18);
+        if (hadMapD)
+            (subMesh.material)->GetMapD()->Bind(GL_TEXTURE18);
+        // Render model.
+        mesh->Draw(i);
+        i++;
+    }
+    shader->UnBind();
+}
+
+void SetLightUniforms(PhongShadingShaderProg* shader, Camera* cam)
+{
+    // Uniforms of phong_lighting.glsl, for the forward and the deferred lighting pass.
+    glUniform3fv(shader->GetLocCameraPos(), 1, glm::value_ptr(cam->GetCameraPos()));
+
+    glUniform3fv(shader->GetLocAmbientLight(), 1, glm::value_ptr(ambientLight));
+    // Point and spot lights, binned for this camera by UpdateClusteredLights(), on units 13 and 14.
+    // The tiles of the cluster grid span the current viewport.
+    GLint viewport[4] = { 0, 0, screenWidth, screenHeight };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glUniform1i(shader->GetLocLightData(), 13);
+    glUniform1i(shader->GetLocClusterData(), 14);
+    glUniform1i(shader->GetLocNumLights(), clusteredLights->GetNumLights());
+    glUniform1i(shader->GetLocUseClusters(), useClusteredLights);
+    glUniform3i(shader->GetLocClusterGrid(), CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+    glUniform2f(shader->GetLocClusterTileScale(), CLUSTER_GRID_X / static_cast<float>(max(1, viewport[2])),
+        CLUSTER_GRID_Y / static_cast<float>(max(1, viewport[3])));
+    glUniform1f(shader->GetLocClusterDepthScale(), clusteredLights->GetDepthScale());
+    glUniform1f(shader->GetLocClusterDepthBias(), clusteredLights->GetDepthBias());
+    glUniform3fv(shader->GetLocCameraDir(), 1, glm::value_ptr(clusteredLights->GetViewDir()));
+    clusteredLights->Bind(GL_TEXTURE13, GL_TEXTURE14);
+
+    glUniform3fv(shader->GetLocDirLightDir(), 1, glm::value_ptr(dirLight->GetDirection()));
+    glUniform3fv(shader->GetLocDirLightRadiance(), 1, glm::value_ptr(dirLight->GetRadiance()));
+
+    // Shadow maps from RenderShadowMaps() on units 15 to 17 (the samplers keep them even when
+    // unused). UpdateClusteredLights() puts the point light at index 0, the spot light at 1.
+    glUniform1i(shader->GetLocDirShadowMap(), 15);
+    glUniform1i(shader->GetLocSpotShadowMap(), 16);
+    glUniform1i(shader->GetLocPointShadowMap(), 17);
+    glUniform1i(shader->GetLocUsePointShadow(), useShadows && pointShadowMap != nullptr);
+    if (useShadows && pointShadowMap != nullptr)
+    {
+        glUniform1i(shader->GetLocPointShadowLight(), 0);
+        glUniform1f(shader->GetLocPointShadowFar(), pointShadowMap->GetFarPlane());
+        glUniform1f(shader->GetLocPointShadowTexelSize(), pointShadowMap->GetTexelSize());
+        pointShadowMap->Bind(GL_TEXTURE17);
+    }
+    glUniform1i(shader->GetLocUseShadows(), useShadows && shadowMaps != nullptr);
+    if (useShadows && shadowMaps != nullptr)
+    {
+        glUniformMatrix4fv(shader->GetLocDirShadowMatrices(), NUM_SHADOW_CASCADES, GL_FALSE, glm::value_ptr(shadowMaps->GetCascadeMatrices()[0]));
+        glUniform4fv(shader->GetLocCascadeSplits(), 1, glm::value_ptr(shadowMaps->GetCascadeSplits()));
+        glUniform4fv(shader->GetLocCascadeTexelSizes(), 1, glm::value_ptr(shadowMaps->GetCascadeTexelSizes()));
+        glUniformMatrix4fv(shader->GetLocSpotShadowMatrix(), 1, GL_FALSE, glm::value_ptr(shadowMaps->GetSpotMatrix()));
+        glUniform1f(shader->GetLocSpotShadowTexelSize(), shadowMaps->GetSpotTexelSize());
+        glUniform1i(shader->GetLocSpotShadowLight(), 1);
+        shadowMaps->Bind(GL_TEXTURE15, GL_TEXTURE16);
+    }
+
+    // Image-based lighting follows the skybox rotation. The cubemap sampler keeps unit 10
+    // even when unused, since it must not share a unit with the 2D maps.
+    glUniform1i(shader->GetLocEnvSpecular(), 10);
+    glUniform1i(shader->GetLocUseIbl(), envLighting != nullptr);
+    if (envLighting != nullptr)
+    {
+        glm::mat3x3 envRotation = glm::mat3x3(glm::rotate(glm::mat4x4(1.0f), glm::radians(-curRotationY), glm::vec3(0.0f, 1.0f, 0.0f)));
+        glUniformMatrix3fv(shader->GetLocEnvRotation(), 1, GL_FALSE, glm::value_ptr(envRotation));
+        glUniform3fv(shader->GetLocShIrradiance(), 9, glm::value_ptr(envLighting->GetIrradianceSH()[0]));
+        glUniform1f(shader->GetLocEnvSpecularMaxLevel(), envLighting->GetSpecularMaxLevel());
+        envLighting->BindSpecular(GL_TEXTURE10);
+    }
+}
+
+void SetSsaoUniforms(PhongShadingShaderProg* shader, Camera* cam, const bool applySsao)
+{
+    // Uniforms of ssao_upsample.glsl. The occlusion map goes on unit 19, which no other map uses
+    // in the forward or the deferred lighting pass.
+    glUniform1i(shader->GetLocAoMap(), 19);
+    glUniform1i(shader->GetLocUseSsao(), applySsao);
+    if (applySsao)
+    {
+        glm::mat4x4 invProjMatrix = glm::inverse(cam->GetProjMatrix());
+        glUniformMatrix4fv(shader->GetLocInvProjMatrix(), 1, GL_FALSE, glm::value_ptr(invProjMatrix));
+        glActiveTexture(GL_TEXTURE19);
+        glBindTexture(GL_TEXTURE_2D, ssao->GetAoTex());
+    }
+}
+
+void BeginDeferredGeometry()
+{
+    // The G-buffer follows the size of the viewport it is lit into.
+    GLint viewport[4] = { 0, 0, screenWidth, screenHeight };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (gBuffer == nullptr)
+        gBuffer = new GBuffer(viewport[2], viewport[3]);
+    else
+        gBuffer->Resize(viewport[2], viewport[3]);
+    gBuffer->Bind();
+    // Pixels left at the far plane are not lit, so the color maps need no clear.
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadeDeferred(Camera* cam, const bool applySsao)
+{
+    // Light the G-buffer with one fullscreen triangle. Every pixel loops over the lights of its
+    // cluster (as the forward pass does), so there are no light volumes to rasterize. The pass
+    // writes the depth of the G-buffer for the lights and the skybox drawn afterwards. With
+    // applySsao the ambient term is scaled by the occlusion of RenderSsao().
+    gBuffer->UnBind();
+    deferredLightingShader->Bind();
+    SetLightUniforms(deferredLightingShader, cam);
+    gBuffer->BindMaps(GL_TEXTURE0);
+    glUniform1i(deferredLightingShader->GetLocGPosition(), GBUFFER_MAP_POSITION);
+    glUniform1i(deferredLightingShader->GetLocGNormal(), GBUFFER_MAP_NORMAL);
+    glUniform1i(deferredLightingShader->GetLocGAlbedo(), GBUFFER_MAP_ALBEDO);
+    glUniform1i(deferredLightingShader->GetLocGSpecular(), GBUFFER_MAP_SPECULAR);
+    glUniform1i(deferredLightingShader->GetLocGAmbient(), GBUFFER_MAP_AMBIENT);
+    glUniform1i(deferredLightingShader->GetLocGDepth(), GBUFFER_MAP_DEPTH);
+    SetSsaoUniforms(deferredLightingShader, cam, applySsao);
+    glDepthFunc(GL_ALWAYS);
+    gBuffer->DrawFullscreen();
+    glDepthFunc(GL_LESS);
+    deferredLightingShader->UnBind();
+}
+
+bool RenderSsao(SceneObject& obj, Camera* cam)
+{
+    // Occlusion of the opaque scene in screen space, which scales only the ambient term (as the
+    // baked occlusion does). A deferred frame computes it from the depth of the G-buffer between
+    // its geometry and lighting passes. A forward frame computes it before it is shaded, from a
+    // depth pass of its own (the depth of the frame itself can't be sampled).
+    TriangleMesh* mesh = obj.mesh;
+    if (!useSsao || cam == nullptr || mesh == nullptr)
+        return false;
+    GLint viewport[4] = { 0, 0, screenWidth, screenHeight };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (ssao == nullptr)
+    {
+        ssao = new Ssao(viewport[2], viewport[3], ssaoQuality);
+        cout << "SSAO: " << Ssao::GetQualityName(ssaoQuality) << " quality (" << ssao->GetGpuBytes() / (1 << 20) << " MB)" << endl;
+    }
+    else
+        ssao->Resize(viewport[2], viewport[3]);
+    // The hemisphere spans a tenth of the object.
+    float scale = glm::length(glm::vec3(obj.worldMatrix[0]));
+    float radius = 0.1f * scale * glm::length(mesh->GetObjExtent());
+    if (useDeferred)
+    {
+        if (gBuffer == nullptr || gBuffer->GetWidth() != viewport[2] || gBuffer->GetHeight() != viewport[3])
+            return false;
+        ssao->Render(cam->GetProjMatrix(), gBuffer->GetMapTex(GBUFFER_MAP_DEPTH), radius, ssaoShader, ssaoBlurShader);
+    }
+    else
+    {
+        glm::mat4x4 MVP = cam->GetProjMatrix() * cam->GetViewMatrix() * obj.worldMatrix;
+        ssao->DrawDepth([mesh, &MVP]() {
+            shadowDepthShader->Bind();
+            glUniformMatrix4fv(shadowDepthShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+            mesh->DrawDepth(true);
+            shadowDepthShader->UnBind();
+        });
+        ssao->Render(cam->GetProjMatrix(), ssao->GetDepthTex(), radius, ssaoShader, ssaoBlurShader);
+    }
+    // The passes run inside the scene timer of the window (which counts them), so only a batch
+    // times them.
+    if (ssao->GetNumTimingSamples() >= sceneTimingFrames)
+        ssao->ShowInfo();
+    return true;
+}
+
+void RenderTransparentObject(SceneObject& obj, Camera* cam)
+{
+    // Draw the transparent submeshes over the opaque frame in one pass, in no particular order.
+    // They are tested against the opaque depth (of the G-buffer when deferred, drawn again
+    // when forward) but do not write it.
+    TriangleMesh* mesh = obj.mesh;
+    if (cam == nullptr || mesh == nullptr || clusteredLights == nullptr || mesh->GetNumTransparentSubMeshes() == 0)
+        return;
+    if (transparentGpuTimer == nullptr)
+        transparentGpuTimer = new GpuTimer();
+    transparentGpuTimer->Begin();
+    if (useOit)
+    {
+        GLint viewport[4] = { 0, 0, screenWidth, screenHeight };
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if (oit == nullptr)
+        {
+            oit = new Oit(viewport[2], viewport[3]);
+            cout << "Transparency targets: " << viewport[2] << " x " << viewport[3] << " (" << oit->GetGpuBytes() / (1 << 20) << " MB)" << endl;
+        }
+        else
+            oit->Resize(viewport[2], viewport[3]);
+        GLuint depthTexId = 0;
+        if (useDeferred && gBuffer != nullptr && gBuffer->GetWidth() == viewport[2] && gBuffer->GetHeight() == viewport[3])
+            depthTexId = gBuffer->GetMapTex(GBUFFER_MAP_DEPTH);
+        else
+        {
+            glm::mat4x4 MVP = cam->GetProjMatrix() * cam->GetViewMatrix() * obj.worldMatrix;
+            oit->DrawDepth([mesh, &MVP]() {
+                shadowDepthShader->Bind();
+                glUniformMatrix4fv(shadowDepthShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+                mesh->DrawDepth(true);
+                shadowDepthShader->UnBind();
+            });
+            depthTexId = oit->GetDepthTex();
+        }
+        oit->BeginAccumulate(depthTexId);
+        DrawSceneObject(obj, cam, oitShader, DRAW_TRANSPARENT_SUBMESHES);
+        oit->EndAccumulate();
+        oit->Composite(oitCompositeShader);
+    }
+    else
+    {
+        // Alpha blending in submesh order, correct only where the order happens to be back to front.
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        DrawSceneObject(obj, cam, phongShadingShader, DRAW_TRANSPARENT_SUBMESHES);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+    transparentGpuTimer->End();
+    if (transparentGpuTimer->GetNumSamples() >= sceneTimingFrames)
+    {
+        cout << "Transparency (" << (useOit ? "weighted blended OIT" : "unsorted blending") << ", " << mesh->GetNumTransparentSubMeshes()
+            << " submeshes): " << transparentGpuTimer->GetAverageMs() << " ms GPU per frame" << endl;
+        transparentGpuTimer->Reset();
+    }
+}
+
+void BeginHdrFrame()
+{
+    // Render the frame into the HDR target, of the size of the viewport.
+    if (!useHdr)
+        return;
+    GLint viewport[4] = { 0, 0, screenWidth, screenHeight };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (hdrPipeline == nullptr)
+    {
+        hdrPipeline = new HdrPipeline(viewport[2], viewport[3]);
+        cout << "HDR target: " << viewport[2] << " x " << viewport[3] << ", " << hdrPipeline->GetNumBloomLevels()
+            << " bloom levels (" << hdrPipeline->GetGpuBytes() / (1 << 20) << " MB)" << endl;
+    }
+    else
+        hdrPipeline->Resize(viewport[2], viewport[3]);
+    hdrPipeline->BeginScene();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void ResolveHdrFrame()
+{
+    // Bloom and tone map the HDR target into the framebuffer bound before BeginHdrFrame().
+    if (!useHdr || hdrPipeline == nullptr)
+        return;
+    hdrPipeline->EndScene();
+    hdrPipeline->Resolve(toneMapOperator, exposure, useBloom ? bloomStrength : 0.0f,
+        bloomDownsampleShader, bloomUpsampleShader, toneMapShader);
+    if (hdrPipeline->GetNumTimingSamples() >= sceneTimingFrames)
+        hdrPipeline->ShowInfo();
+}
+
+void RequestTextureLevels(SceneObject& obj, Camera* cam)
+{
+    // A world unit at distance d covers screenHeight / (2 d tan(fovy / 2)) pixels; the texels
+    // it covers follow from the UV density of the submesh (at the nearest point of its bounds).
+    const float scale = glm::length(glm::vec3(obj.worldMatrix[0]));
+    const float pixelsAtUnitDistance = screenHeight / (2.0f * tan(glm::radians(fovy) * 0.5f));
+    for (SubMesh& subMesh : obj.mesh->GetSubMeshes())
+    {
+        glm::vec3 center = glm::vec3(obj.worldMatrix * glm::vec4(subMesh.boundsCenter, 1.0f));
+        float distance = max(zNear, glm::length(cam->GetCameraPos() - center) - scale * subMesh.boundsRadius);
+        float pixelsPerUnit = pixelsAtUnitDistance / distance;
+        ImageTexture* textures[] = {
+            (subMesh.material)->GetMapNorm(), (subMesh.material)->GetMapKa(), (subMesh.material)->GetMapKd(),
+            (subMesh.material)->GetMapKs(), (subMesh.material)->GetMapNs(), (subMesh.material)->GetMapD()
+        };
+        for (ImageTexture* texture : textures)
+        {
+            if (texture == nullptr || texture->GetVirtual() != nullptr)
+                continue;
+            float texelsPerUnit = subMesh.uvDensity / scale * sqrt(static_cast<float>(texture->GetWidth()) * texture->GetHeight());
+            textureResidency->Request(texture, TextureResidency::ComputeMipLevel(texelsPerUnit, pixelsPerUnit));
+        }
     }
+}
 
-    // Visualize the lights with fill color.
-    if (camera != nullptr && pointLight != nullptr)
+void RenderVirtualTextureFeedback(SceneObject& obj, Camera* cam)
+{
+    // Write the tiles the virtual diffuse maps are sampled from (and the depth of the other
+    // submeshes) into the feedback target; the system reads it back a few frames later.
+    TriangleMesh* mesh = obj.mesh;
+    if (cam == nullptr || mesh == nullptr)
+        return;
+    glm::mat4x4 MVP = cam->GetProjMatrix() * cam->GetViewMatrix() * obj.worldMatrix;
+    virtualTextures->BeginFeedback(screenWidth, screenHeight);
+    vtFeedbackShader->Bind();
+    glUniformMatrix4fv(vtFeedbackShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+    glUniform1f(vtFeedbackShader->GetLocVtLodBias(), virtualTextures->GetFeedbackLodBias());
+    unsigned int i = 0;
+    for (SubMesh& subMesh : mesh->GetSubMeshes())
     {
-        glm::mat4x4 T = glm::translate(glm::mat4x4(1.0f), pointLight->GetPosition());
-        pointLightObj.worldMatrix = T;
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * pointLightObj.worldMatrix;
+        ImageTexture* imageTexKd = (subMesh.material)->GetMapKd();
+        VirtualTexture* virtualKd = (imageTexKd != nullptr) ? imageTexKd->GetVirtual() : nullptr;
+        int id = (virtualKd != nullptr) ? virtualTextures->GetId(virtualKd) : 0;
+        glUniform1i(vtFeedbackShader->GetLocVtId(), id);
+        if (id > 0)
+        {
+            glUniform2i(vtFeedbackShader->GetLocVtSize(), virtualKd->GetWidth(), virtualKd->GetHeight());
+            glUniform1i(vtFeedbackShader->GetLocVtMaxLevel(), virtualKd->GetNumLevels() - 1);
+        }
+        mesh->Draw(i);
+        i++;
+    }
+    vtFeedbackShader->UnBind();
+    virtualTextures->EndFeedback();
+}
 
-        fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(pointLightObj.visColor));
-        // Render the point light.
-        pointLight->Draw();
-        fillColorShader->UnBind();
+void RenderLightObjects(Camera* cam)
+{
+    // Visualize the lights (and the bounds with 'b') as gizmos drawn in one batch.
+    if (cam == nullptr)
+        return;
+    if (debugDraw == nullptr)
+        debugDraw = new DebugDraw(debugDrawMaxVertices);
+    PointLight* pointLight = pointLightObj.light;
+    SpotLight* spotLight = spotLightObj.light;
+    if (pointLight != nullptr)
+        debugDraw->AddPoint(pointLight->GetPosition(), pointLightObj.visColor);
+    if (spotLight != nullptr)
+    {
+        debugDraw->AddPoint(spotLight->GetPosition(), spotLightObj.visColor);
+        debugDraw->AddLine(spotLight->GetPosition(), spotLight->GetPosition() + 0.3f * spotLight->GetDirection(), spotLightObj.visColor);
+    }
+    // Colored by the hue of the intensity (a light switched off to zero is drawn black).
+    for (const LocalLight& light : extraLights)
+    {
+        float maxIntensity = max(max(light.intensity.x, light.intensity.y), light.intensity.z);
+        debugDraw->AddPoint(light.position, light.intensity / max(maxIntensity, 1e-6f));
+    }
+    if (showBounds && sceneObj.mesh != nullptr)
+    {
+        TriangleMesh* mesh = sceneObj.mesh;
+        glm::vec3 halfExtent = 0.5f * mesh->GetObjExtent();
+        debugDraw->AddBox(mesh->GetObjCenter() - halfExtent, mesh->GetObjCenter() + halfExtent, sceneObj.worldMatrix, glm::vec3(1.0f, 1.0f, 0.0f));
+        float scale = glm::length(glm::vec3(sceneObj.worldMatrix[0]));
+        for (const SubMesh& subMesh : mesh->GetSubMeshes())
+            debugDraw->AddSphere(glm::vec3(sceneObj.worldMatrix * glm::vec4(subMesh.boundsCenter, 1.0f)), scale * subMesh.boundsRadius,
+                glm::vec3(0.0f, 1.0f, 1.0f));
     }
-    if (camera != nullptr && spotLight != nullptr)
+    debugDraw->Flush(cam->GetProjMatrix() * cam->GetViewMatrix(), debugDrawShader, 16.0f);
+}
+
+void RenderSkybox(Camera* cam, const float rotationY)
+{
+    if (skyboxGpuTimer == nullptr)
+        skyboxGpuTimer = new GpuTimer();
+    skyboxGpuTimer->Begin();
+    if (skybox->GetCubemap() != nullptr)
+        skybox->Render(cam, skyboxCubeShader, rotationY);
+    else
+        skybox->Render(cam, skyboxShader, rotationY);
+    skyboxGpuTimer->End();
+    if (skyboxGpuTimer->GetNumSamples() >= skyboxTimingFrames)
     {
-        glm::mat4x4 T = glm::translate(glm::mat4x4(1.0f), spotLight->GetPosition());
-        spotLightObj.worldMatrix = T;
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * spotLightObj.worldMatrix;
+        cout << "Skybox (" << (skybox->GetCubemap() != nullptr ? "cubemap" : "sphere") << "): "
+            << skyboxGpuTimer->GetAverageMs() << " ms GPU per frame" << endl;
+        skyboxGpuTimer->Reset();
+    }
+}
 
-        fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(spotLightObj.visColor));
-        // Render the spot light.
-        spotLight->Draw();
-        fillColorShader->UnBind();
+void RenderSceneCB()
+{
+    // Hand the next strips of the loading textures to GL.
+    if (textureStreamer != nullptr)
+        textureStreamer->Update();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    BeginHdrFrame();
+    
+    // Render a triangle mesh with Phong shading.
+    if (camera != nullptr && sceneObj.mesh != nullptr)
+    {
+        // Update transform.
+        if (isRecording && captureNumFrames > 0)
+            curRotationY = 360.0f * turntableFrameIndex / captureNumFrames;
+        else if (isRotated)
+            curRotationY += rotDirectionY * rotStep;
+        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+        glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(curRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+        sceneObj.worldMatrix = S * R;
+        if (virtualTextures != nullptr)
+            RenderVirtualTextureFeedback(sceneObj, camera);
+        UpdateClusteredLights(camera);
+        RenderShadowMaps(sceneObj, camera);
+        if (sceneGpuTimer == nullptr)
+            sceneGpuTimer = new GpuTimer();
+        sceneGpuTimer->Begin();
+        RenderSceneObject(sceneObj, camera);
+        sceneGpuTimer->End();
+        RenderTransparentObject(sceneObj, camera);
+        if (sceneGpuTimer->GetNumSamples() >= sceneTimingFrames)
+        {
+            cout << "Scene (" << (useDeferred ? "deferred" : "forward") << (useDepthPrepass ? " with depth pre-pass" : "")
+                << (useSsao ? " and SSAO" : "") << ", "
+                << clusteredLights->GetNumLights() << " lights): " << sceneGpuTimer->GetAverageMs() << " ms GPU per frame, "
+                << static_cast<long long>(sceneSampleCounter->GetAverageSamples()) << " samples shaded" << endl;
+            sceneGpuTimer->Reset();
+            sceneSampleCounter->Reset();
+        }
     }
 
+    // Visualize the lights and the other gizmos.
+    RenderLightObjects(camera);
+
     // Render skybox.
     if (camera != nullptr && skybox != nullptr)
     {
-        if (isRotated)
+        if (isRotated && !(isRecording && captureNumFrames > 0))
             curRotationY += rotDirectionY * rotStep;
-        skybox->Render(camera, skyboxShader, curRotationY);
+        RenderSkybox(camera, curRotationY);
+        // The panorama spans 2 pi horizontally, the screen spans fovy vertically.
+        if (textureResidency != nullptr && skybox->GetTexture() != nullptr)
+        {
+            ImageTexture* panorama = skybox->GetTexture();
+            float texelsPerRadian = panorama->GetWidth() / (2.0f * glm::pi<float>());
+            textureResidency->Request(panorama, TextureResidency::ComputeMipLevel(texelsPerRadian, screenHeight / glm::radians(fovy)));
+        }
     }
+    ResolveHdrFrame();
+    if (textureResidency != nullptr)
+        textureResidency->Update();
+    if (virtualTextures != nullptr)
+        virtualTextures->Update();
 
+    // Read back the frame before swapping.
+    UpdateCapture();
     glutSwapBuffers();
+    UpdateLoadHitch();
+}
+
+void BeginLoadHitch(const string& label)
+{
+    // The first frame after the load includes everything the load did on this thread.
+    loadHitchLabel = label;
+    loadHitchMaxMs = 0.0;
+    loadHitchFrames = 0;
+    loadHitchTimer.Start();
+    frameTimer.Start();
+}
+
+void UpdateLoadHitch()
+{
+    double frameMs = frameTimer.GetElapsedMs();
+    frameTimer.Start();
+    if (loadHitchLabel.empty())
+        return;
+    loadHitchMaxMs = max(loadHitchMaxMs, frameMs);
+    loadHitchFrames++;
+    if (textureStreamer != nullptr && textureStreamer->GetBusy())
+        return;
+    cout << "Loading " << loadHitchLabel << ": " << loadHitchTimer.GetElapsedMs() << " ms until the textures were on the GPU, "
+        << loadHitchFrames << " frames, max frame time " << loadHitchMaxMs << " ms";
+    if (textureStreamer != nullptr)
+        cout << " (streamed " << textureStreamer->GetNumStreamedBytes() / (1 << 20) << " MB, max "
+            << textureStreamer->GetMaxUpdateMs() << " ms per update)";
+    cout << endl;
+    loadHitchLabel = "";
+}
+
+void UpdateCapture()
+{
+    if (!isRecording && !captureOneFrame && frameCapture == nullptr)
+        return;
+    if (frameCapture == nullptr)
+        frameCapture = new FrameCapture();
+    if (isRecording || captureOneFrame)
+    {
+        // Turntable frames are numbered from 0 by their step of the rotation.
+        bool isTurntable = isRecording && captureNumFrames > 0;
+        stringstream ss;
+        ss << capturePrefix << setw(5) << setfill('0') << (isTurntable ? turntableFrameIndex++ : captureFrameIndex++) << "." << captureFormat;
+        frameCapture->CaptureFrame(0, screenWidth, screenHeight, ss.str());
+        captureOneFrame = false;
+    }
+    frameCapture->Update();
+    // A turntable sequence (--capture-frames) stops after one full rotation.
+    if (isRecording && captureNumFrames > 0 && turntableFrameIndex >= captureNumFrames)
+    {
+        isRecording = false;
+        frameCapture->Flush();
+        cout << "Turntable capture finished: " << frameCapture->GetNumWritten() << " frames written" << endl;
+    }
+}
+
+void PickSceneObject(int x, int y)
+{
+    // Cast a ray through the pixel against the BVH of the model (in object space,
+    // so the BVH does not need to be rebuilt when the model rotates).
+    if (camera == nullptr || sceneObj.mesh == nullptr || sceneObj.bvh == nullptr)
+        return;
+    CpuTimer timer;
+    glm::vec3 origin, direction;
+    camera->GetPickRay(x + 0.5f, y + 0.5f, screenWidth, screenHeight, origin, direction);
+    glm::mat4x4 invWorldMatrix = glm::inverse(sceneObj.worldMatrix);
+    // The direction is left unnormalized so that t is the same in both spaces.
+    Ray ray(glm::vec3(invWorldMatrix * glm::vec4(origin, 1.0f)), glm::vec3(invWorldMatrix * glm::vec4(direction, 0.0f)));
+    RayHit hit;
+    bool found = (sceneObj.bvh)->Intersect(ray, hit);
+    double pickMs = timer.GetElapsedMs();
+    if (!found)
+    {
+        cout << "Picked nothing (" << pickMs << " ms)" << endl;
+        return;
+    }
+    unsigned int subMeshIndex = 0, triIndex = 0;
+    (sceneObj.bvh)->GetSubMeshTriangle(hit.triIndex, subMeshIndex, triIndex);
+    const SubMesh& subMesh = (sceneObj.mesh)->GetSubMeshes()[subMeshIndex];
+    glm::vec3 position = origin + direction * hit.t;
+    cout << "Picked submesh " << subMeshIndex << " (material: "
+        << (subMesh.material != nullptr ? subMesh.material->GetName() : "none") << "), triangle " << triIndex
+        << " (vertices " << subMesh.vertexIndices[3 * triIndex + 0] << ", " << subMesh.vertexIndices[3 * triIndex + 1]
+        << ", " << subMesh.vertexIndices[3 * triIndex + 2] << ")" << endl;
+    cout << "  position: (" << position.x << ", " << position.y << ", " << position.z << "), distance: " << hit.t
+        << ", barycentric: (" << 1.0f - hit.u - hit.v << ", " << hit.u << ", " << hit.v << "), time: " << pickMs << " ms" << endl;
 }
 
 void ReshapeCB(int w, int h)
@@ -363,16 +1344,118 @@ void ProcessKeysCB(unsigned char key, int x, int y)
         rotDirectionY = -1.0f;
     else if (key == 'r' || key == 'R')
         rotDirectionY = 1.0f;
-    // Dynamically load and delete model.
-    if (mesh == nullptr && (key == 'o' || key == 'O'))
-        Start();
-    else if (mesh != nullptr && (key == 'e' || key == 'E'))
+    // Light culling control.
+    else if (key == 'k' || key == 'K')
     {
-        ReleaseResources();
-        cout << "The model was deleted!" << endl << endl;
+        useClusteredLights = !useClusteredLights;
+        cout << "Shading " << (useClusteredLights ? "the lights of each cluster" : "all lights at every pixel") << endl;
+        if (clusteredLights != nullptr)
+            clusteredLights->ShowInfo();
     }
-    // Spot light control.
-    if (spotLight != nullptr)
+    // Gizmo control.
+    else if (key == 'b' || key == 'B')
+        showBounds = !showBounds;
+    // Ambient occlusion control.
+    else if (key == 'i' || key == 'I')
+    {
+        useOcclusion = !useOcclusion;
+        cout << "Ambient occlusion " << (useOcclusion ? "on" : "off") << endl;
+    }
+    else if (key == 'x' || key == 'X')
+    {
+        // Off, then each quality from the lowest.
+        if (!useSsao)
+        {
+            useSsao = true;
+            ssaoQuality = SSAO_QUALITY_LOW;
+        }
+        else if (ssaoQuality + 1 < NUM_SSAO_QUALITIES)
+            ssaoQuality = static_cast<SsaoQuality>(ssaoQuality + 1);
+        else
+            useSsao = false;
+        if (ssao != nullptr)
+            ssao->SetQuality(ssaoQuality);
+        cout << "SSAO " << (useSsao ? Ssao::GetQualityName(ssaoQuality) : "off") << endl;
+    }
+    // HDR control.
+    else if (key == 'y' || key == 'Y')
+    {
+        // Off, then each tone mapping operator.
+        if (!useHdr)
+        {
+            useHdr = true;
+            toneMapOperator = TONE_MAP_REINHARD;
+        }
+        else if (toneMapOperator + 1 < NUM_TONE_MAP_OPERATORS)
+            toneMapOperator = static_cast<ToneMapOperator>(toneMapOperator + 1);
+        else
+            useHdr = false;
+        cout << "HDR " << (useHdr ? HdrPipeline::GetOperatorName(toneMapOperator) : "off") << endl;
+    }
+    else if (key == 'n' || key == 'N')
+    {
+        useBloom = !useBloom;
+        cout << "Bloom " << (useBloom ? "on" : "off") << endl;
+    }
+    // Depth pre-pass control.
+    else if (key == 'z' || key == 'Z')
+    {
+        useDepthPrepass = !useDepthPrepass;
+        cout << "Depth pre-pass " << (useDepthPrepass ? "on" : "off") << endl;
+    }
+    // Transparency control.
+    else if (key == 'j' || key == 'J')
+    {
+        useOit = !useOit;
+        cout << "Transparency: " << (useOit ? "weighted blended OIT" : "unsorted blending") << endl;
+    }
+    else if (key == '[' || key == ']')
+    {
+        // Half a stop per key.
+        exposure *= (key == ']') ? sqrt(2.0f) : 1.0f / sqrt(2.0f);
+        cout << "Exposure: " << exposure << endl;
+    }
+    // Shadow control.
+    else if (key == 'h' || key == 'H')
+    {
+        useShadows = !useShadows;
+        cout << "Shadows " << (useShadows ? "on" : "off") << endl;
+    }
+    else if (key == 'f' || key == 'F')
+    {
+        useDeferred = !useDeferred;
+        cout << (useDeferred ? "Deferred" : "Forward") << " shading" << endl;
+        if (sceneGpuTimer != nullptr)
+            sceneGpuTimer->Reset();
+    }
+    // Texture memory info (residency and virtual texture pages).
+    else if (key == 'm' || key == 'M')
+    {
+        if (textureResidency != nullptr)
+            textureResidency->ShowInfo();
+        if (virtualTextures != nullptr)
+            virtualTextures->ShowInfo();
+    }
+    // Frame capture control.
+    else if (key == 'g' || key == 'G')
+        captureOneFrame = true;
+    else if (key == 'v' || key == 'V')
+    {
+        isRecording = !isRecording;
+        if (isRecording)
+            turntableFrameIndex = 0;
+        cout << (isRecording ? "Start" : "Stop") << " recording frames: " << capturePrefix << endl;
+    }
+    // Dynamically load and delete model.
+    if (mesh == nullptr && (key == 'o' || key == 'O'))
+        Start();
+    else if (mesh != nullptr && (key == 'e' || key == 'E'))
+    {
+        ReleaseResources();
+        cout << "The model was deleted!" << endl << endl;
+    }
+    // Spot light control.
+    if (spotLight != nullptr)
     {
         if (key == 'w' || key == 'W')
             spotLight->MoveUp(lightMoveSpeed);
@@ -391,7 +1474,10 @@ void ProcessKeysCB(unsigned char key, int x, int y)
             // Create skybox texture files dialog.
             fileDialog->OpenSkyboxTexFiles();
             if(!(fileDialog->GetSkyboxTexFilePath()).empty())
+            {
+                BeginLoadHitch("skybox");
                 CreateSkybox();
+            }
             else
             {
                 delete skybox;
@@ -402,6 +1488,8 @@ void ProcessKeysCB(unsigned char key, int x, int y)
         {
             delete skybox;
             skybox = nullptr;
+            delete envLighting;
+            envLighting = nullptr;
             cout << "The skybox texture was deleted!" << endl << endl;
         }
     }
@@ -413,6 +1501,12 @@ void ProcessMouseInputCB(int button, int state, int x, int y)
     // Handle mouse input.
     if (camera != nullptr)
         camera->ProcessMouseInput(button, state, x, y);
+    // A left click that does not drag the camera picks the model.
+    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
+        mouseDownPos = glm::ivec2(x, y);
+    else if (button == GLUT_LEFT_BUTTON && state == GLUT_UP
+        && abs(x - mouseDownPos.x) <= pickMaxDragPixels && abs(y - mouseDownPos.y) <= pickMaxDragPixels)
+        PickSceneObject(x, y);
 }
 
 void ProcessMouseMotionCB(int x, int y)
@@ -430,6 +1524,9 @@ void SetupRenderState()
     rotDirectionY = 1.0f;
 
     glEnable(GL_DEPTH_TEST);
+    // Filter across cubemap face edges (skybox cubemap).
+    if (GLEW_ARB_seamless_cube_map)
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     glm::vec4 clearColor = glm::vec4(0.44f, 0.57f, 0.75f, 1.00f);
     glClearColor(
@@ -455,6 +1552,22 @@ void LoadObjects()
             mesh->ShowInfo();
             sceneObj.mesh = mesh;
             (sceneObj.mesh)->CreateBuffers();
+            // Managed textures change their GL objects, so they are not packed.
+            if (packTextureArrays && textureResidency == nullptr)
+                (sceneObj.mesh)->PackTextureArrays();
+            (sceneObj.mesh)->ShowTexturesInfo();
+            // Build the BVH for picking.
+            sceneObj.bvh = new Bvh();
+            (sceneObj.bvh)->Build(mesh);
+            (sceneObj.bvh)->ShowInfo();
+            if (aoRaysPerVertex > 0)
+            {
+                AoBaker aoBaker(aoRaysPerVertex);
+                vector<float> occlusion;
+                aoBaker.Bake(mesh, sceneObj.bvh, occlusion);
+                aoBaker.ShowInfo(occlusion);
+                mesh->SetVertexOcclusion(occlusion);
+            }
         }
         else
         {
@@ -493,6 +1606,30 @@ void CreateLights()
     spotLightObj.visColor = glm::normalize((spotLightObj.light)->GetIntensity());
     // Create a directional light.
     dirLight = new DirectionalLight(dirLightDirection, dirLightRadiance);
+    // Create the clustered lights (point, spot and extra lights).
+    clusteredLights = new ClusteredLights();
+    CreateExtraLights(numSceneLights - 3);
+}
+
+void CreateExtraLights(const int numLights)
+{
+    // Scatter short-range point lights (and a spot light every fourth one) around the model,
+    // dimmer the more there are. The seed is fixed so that runs are comparable.
+    extraLights.clear();
+    mt19937 rng(1234);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float scale = min(1.0f, 32.0f / max(1, numLights));
+    for (int i = 0; i < numLights; ++i)
+    {
+        glm::vec3 position = glm::vec3(4.0f * uniform(rng) - 2.0f, 3.0f * uniform(rng) - 1.5f, 4.0f * uniform(rng) - 2.0f);
+        glm::vec3 color = glm::vec3(uniform(rng), uniform(rng), uniform(rng)) + glm::vec3(0.05f);
+        glm::vec3 intensity = 0.05f * scale * color / max(max(color.r, color.g), color.b);
+        float range = 0.5f + uniform(rng);
+        if (i % 4 == 3)
+            extraLights.push_back(LocalLight(position, intensity, glm::vec3(-position.x, -2.0f, -position.z), 20.0f, 35.0f, 1.5f * range));
+        else
+            extraLights.push_back(LocalLight(position, intensity, range));
+    }
 }
 
 void CreateSkybox()
@@ -508,11 +1645,34 @@ void CreateSkybox()
     const int numSlices = 36;
     const int numStacks = 18;
     const float radius = 50.0f;
+    CpuTimer loadTimer;
     skybox = new Skybox(filePath, numSlices, numStacks, radius);
-    if (skybox->GetTexture() == nullptr)
+    if (!skybox->GetLoaded())
     {
         delete skybox;
         skybox = nullptr;
+        return;
+    }
+    if (skybox->GetCubemap() != nullptr)
+        skybox->GetCubemap()->ShowInfo();
+    else
+        skybox->GetTexture()->ShowInfo();
+    cout << "Skybox (" << (skybox->GetCubemap() != nullptr ? "cubemap" : "sphere") << ") loaded in "
+        << loadTimer.GetElapsedMs() << " ms" << endl;
+    // Restart the averages for the new skybox.
+    if (skyboxGpuTimer != nullptr)
+        skyboxGpuTimer->Reset();
+
+    if (useIbl)
+    {
+        envLighting = new EnvironmentLighting();
+        if (envLighting->Create(filePath))
+            envLighting->ShowInfo();
+        else
+        {
+            delete envLighting;
+            envLighting = nullptr;
+        }
     }
 }
 
@@ -521,8 +1681,8 @@ void CreateShaderLib()
     // Get sub file path.
     string subFilePath = GetSubFilePath();
     // Create Shaders.
-    fillColorShader = new FillColorShaderProg();
-    if (!fillColorShader->LoadFromFiles(subFilePath + "shaders/fixed_color.vs", subFilePath + "shaders/fixed_color.fs"))
+    debugDrawShader = new ShaderProg();
+    if (!debugDrawShader->LoadFromFiles(subFilePath + "shaders/debug_draw.vs", subFilePath + "shaders/debug_draw.fs"))
         exit(1);
 
     phongShadingShader = new PhongShadingShaderProg();
@@ -532,12 +1692,88 @@ void CreateShaderLib()
     skyboxShader = new SkyboxShaderProg();
     if (!skyboxShader->LoadFromFiles(subFilePath + "shaders/skybox.vs", subFilePath + "shaders/skybox.fs"))
         exit(1);
+
+    skyboxCubeShader = new SkyboxCubeShaderProg();
+    if (!skyboxCubeShader->LoadFromFiles(subFilePath + "shaders/skybox_cube.vs", subFilePath + "shaders/skybox_cube.fs"))
+        exit(1);
+
+    vtFeedbackShader = new VirtualTextureFeedbackShaderProg();
+    if (!vtFeedbackShader->LoadFromFiles(subFilePath + "shaders/vt_feedback.vs", subFilePath + "shaders/vt_feedback.fs"))
+        exit(1);
+
+    gBufferShader = new PhongShadingShaderProg();
+    if (!gBufferShader->LoadFromFiles(subFilePath + "shaders/phong_shading.vs", subFilePath + "shaders/phong_shading.fs",
+        "#define GBUFFER_PASS\n"))
+        exit(1);
+
+    shadowDepthShader = new ShaderProg();
+    if (!shadowDepthShader->LoadFromFiles(subFilePath + "shaders/shadow_depth.vs", subFilePath + "shaders/shadow_depth.fs"))
+        exit(1);
+
+    pointShadowShader = new PointShadowShaderProg();
+    if (!pointShadowShader->AddGeometryShaderFromFile(subFilePath + "shaders/point_shadow.gs")
+        || !pointShadowShader->LoadFromFiles(subFilePath + "shaders/point_shadow.vs", subFilePath + "shaders/point_shadow.fs"))
+        exit(1);
+
+    deferredLightingShader = new DeferredLightingShaderProg();
+    if (!deferredLightingShader->LoadFromFiles(subFilePath + "shaders/deferred_lighting.vs", subFilePath + "shaders/deferred_lighting.fs"))
+        exit(1);
+
+    ssaoShader = new SsaoShaderProg();
+    if (!ssaoShader->LoadFromFiles(subFilePath + "shaders/ssao.vs", subFilePath + "shaders/ssao.fs"))
+        exit(1);
+    ssaoBlurShader = new SsaoShaderProg();
+    if (!ssaoBlurShader->LoadFromFiles(subFilePath + "shaders/ssao.vs", subFilePath + "shaders/ssao_blur.fs"))
+        exit(1);
+
+    bloomDownsampleShader = new HdrShaderProg();
+    if (!bloomDownsampleShader->LoadFromFiles(subFilePath + "shaders/hdr.vs", subFilePath + "shaders/bloom_downsample.fs"))
+        exit(1);
+    bloomUpsampleShader = new HdrShaderProg();
+    if (!bloomUpsampleShader->LoadFromFiles(subFilePath + "shaders/hdr.vs", subFilePath + "shaders/bloom_upsample.fs"))
+        exit(1);
+    toneMapShader = new HdrShaderProg();
+    if (!toneMapShader->LoadFromFiles(subFilePath + "shaders/hdr.vs", subFilePath + "shaders/tone_map.fs"))
+        exit(1);
+
+    oitShader = new PhongShadingShaderProg();
+    if (!oitShader->LoadFromFiles(subFilePath + "shaders/phong_shading.vs", subFilePath + "shaders/phong_shading.fs",
+        "#define OIT_PASS\n"))
+        exit(1);
+    oitCompositeShader = new OitCompositeShaderProg();
+    if (!oitCompositeShader->LoadFromFiles(subFilePath + "shaders/oit_composite.vs", subFilePath + "shaders/oit_composite.fs"))
+        exit(1);
+}
+
+void CreateVirtualTextures()
+{
+    // Create the page cache before the textures are loaded.
+    virtualTextures = new VirtualTextureSystem(virtualTexturePages);
+    ImageTexture::SetVirtualTextures(virtualTextures);
+    cout << "Virtual textures: diffuse maps from " << VIRTUAL_TEXTURE_MIN_SIZE << " texels, " << virtualTextures->GetNumPages()
+        << " pages of " << VIRTUAL_TEXTURE_TILE_SIZE << " x " << VIRTUAL_TEXTURE_TILE_SIZE << " texels ("
+        << virtualTextures->GetGpuBytes() / (1 << 20) << " MB)" << endl;
 }
 
 void Start()
 {
     // Initialization.
     SetupRenderState();
+    if (streamMBPerFrame > 0 && textureStreamer == nullptr)
+    {
+        textureStreamer = new TextureStreamer(static_cast<size_t>(streamMBPerFrame) << 20);
+        ImageTexture::SetStreamer(textureStreamer);
+        cout << "Streaming texture uploads: " << streamMBPerFrame << " MB per frame, "
+            << (textureStreamer->GetPersistent() ? "persistently mapped" : "staged") << " unpack buffer" << endl;
+    }
+    if (textureBudgetMB > 0 && textureResidency == nullptr)
+    {
+        textureResidency = new TextureResidency(static_cast<size_t>(textureBudgetMB) << 20);
+        ImageTexture::SetResidency(textureResidency);
+    }
+    if (virtualTexturePages > 0 && virtualTextures == nullptr)
+        CreateVirtualTextures();
+    BeginLoadHitch("model");
     LoadObjects();
     if (mesh != nullptr)
     {
@@ -559,6 +1795,928 @@ void Start()
     glutMainLoop();
 }
 
+bool ParseCommandLine(int argc, char** argv)
+{
+    // Options: --batch <manifest> [--size <width>x<height>] [--threads <num loader threads>]
+    //          --softraster <obj file> <output image> [--size <width>x<height>] [--frames <num frames>]
+    //          --bvhbench <obj file> [--size <width>x<height>]
+    //          --compress none|fast|high [--texture-cache <directory>]
+    //          --cpu-mipmaps box|kaiser
+    //          --mipbench <image file>
+    //          --decodebench <image file>
+    //          --lightbench <obj file> [--size <width>x<height>]
+    //          --lights <num lights>
+    //          --deferred
+    //          --depth-prepass
+    //          --shadow-size <texels>|off
+    //          --overdrawbench <obj file> [--size <width>x<height>] [--lights <num lights>]
+    //          --stream-uploads <MB per frame>
+    //          --texture-budget <MB>
+    //          --release-cpu-textures
+    //          --texture-arrays
+    //          --virtual-textures <cache pages per side>
+    //          --skybox-cubemap <face size>|auto
+    //          --ibl
+    //          --ao <rays per vertex>
+    //          --aobench <obj file> [--ao <rays per vertex>]
+    //          --ssao low|medium|high
+    //          --hdr reinhard|aces [--exposure <value>] [--no-bloom]
+    //          --oitbench <obj file> <output image> [--size <width>x<height>]
+    //          --capture <output prefix> [--capture-frames <num turntable frames>] [--capture-format png|jpg]
+    // Other arguments are left to glutInit.
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+            continue;
+        if (arg == "--batch" && i + 1 < argc)
+            batchManifestPath = argv[++i];
+        else if (arg == "--softraster" && i + 2 < argc)
+        {
+            softRasterObjPath = argv[++i];
+            softRasterOutputPath = argv[++i];
+        }
+        else if (arg == "--bvhbench" && i + 1 < argc)
+            bvhBenchObjPath = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc)
+            softRasterFrames = max(1, atoi(argv[++i]));
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            char separator = 0;
+            stringstream ss(argv[++i]);
+            ss >> outputWidth >> separator >> outputHeight;
+            if (ss.fail() || outputWidth <= 0 || outputHeight <= 0)
+            {
+                cerr << "[ERROR] Invalid size: " << argv[i] << endl;
+                return false;
+            }
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+            batchLoaderThreads = static_cast<unsigned int>(atoi(argv[++i]));
+        else if (arg == "--compress" && i + 1 < argc)
+        {
+            string mode = argv[++i];
+            if (mode == "none")
+                ImageTexture::SetCompression(TEXTURE_COMPRESSION_NONE);
+            else if (mode == "fast")
+                ImageTexture::SetCompression(TEXTURE_COMPRESSION_FAST);
+            else if (mode == "high")
+                ImageTexture::SetCompression(TEXTURE_COMPRESSION_HIGH);
+            else
+            {
+                cerr << "[ERROR] Unknown compression mode: " << mode << endl;
+                return false;
+            }
+        }
+        else if (arg == "--texture-cache" && i + 1 < argc)
+            TextureCache::SetDirectory(argv[++i]);
+        else if (arg == "--cpu-mipmaps" && i + 1 < argc)
+        {
+            string filter = argv[++i];
+            if (filter != "box" && filter != "kaiser")
+            {
+                cerr << "[ERROR] Unknown mipmap filter: " << filter << endl;
+                return false;
+            }
+            ImageTexture::SetCpuMipmaps(true);
+            ImageTexture::SetMipFilter(filter == "kaiser" ? MIP_FILTER_KAISER : MIP_FILTER_BOX);
+        }
+        else if (arg == "--mipbench" && i + 1 < argc)
+            mipBenchImagePath = argv[++i];
+        else if (arg == "--decodebench" && i + 1 < argc)
+            decodeBenchImagePath = argv[++i];
+        else if (arg == "--lightbench" && i + 1 < argc)
+            lightBenchObjPath = argv[++i];
+        else if (arg == "--deferred")
+            useDeferred = true;
+        else if (arg == "--depth-prepass")
+            useDepthPrepass = true;
+        else if (arg == "--shadow-size" && i + 1 < argc)
+        {
+            string size = argv[++i];
+            if (size == "off")
+                useShadows = false;
+            else
+                shadowMapSize = max(256, atoi(size.c_str()));
+        }
+        else if (arg == "--overdrawbench" && i + 1 < argc)
+            overdrawBenchObjPath = argv[++i];
+        else if (arg == "--lights" && i + 1 < argc)
+            numSceneLights = max(3, atoi(argv[++i]));
+        else if (arg == "--stream-uploads" && i + 1 < argc)
+            streamMBPerFrame = max(1, atoi(argv[++i]));
+        else if (arg == "--texture-budget" && i + 1 < argc)
+            textureBudgetMB = max(1, atoi(argv[++i]));
+        else if (arg == "--release-cpu-textures")
+            ImageTexture::SetReleaseCpuCopies(true);
+        else if (arg == "--texture-arrays")
+            packTextureArrays = true;
+        else if (arg == "--virtual-textures" && i + 1 < argc)
+            virtualTexturePages = max(2, atoi(argv[++i]));
+        else if (arg == "--ibl")
+            useIbl = true;
+        else if (arg == "--ao" && i + 1 < argc)
+            aoRaysPerVertex = max(1, atoi(argv[++i]));
+        else if (arg == "--aobench" && i + 1 < argc)
+            aoBenchObjPath = argv[++i];
+        else if (arg == "--ssao" && i + 1 < argc)
+        {
+            string quality = argv[++i];
+            useSsao = true;
+            if (quality == "low")
+                ssaoQuality = SSAO_QUALITY_LOW;
+            else if (quality == "high")
+                ssaoQuality = SSAO_QUALITY_HIGH;
+            else
+                ssaoQuality = SSAO_QUALITY_MEDIUM;
+        }
+        else if (arg == "--hdr" && i + 1 < argc)
+        {
+            string op = argv[++i];
+            useHdr = true;
+            toneMapOperator = (op == "reinhard") ? TONE_MAP_REINHARD : TONE_MAP_ACES;
+        }
+        else if (arg == "--exposure" && i + 1 < argc)
+            exposure = max(0.01f, static_cast<float>(atof(argv[++i])));
+        else if (arg == "--no-bloom")
+            useBloom = false;
+        else if (arg == "--oitbench" && i + 2 < argc)
+        {
+            oitBenchObjPath = argv[++i];
+            oitBenchOutputPath = argv[++i];
+        }
+        else if (arg == "--skybox-cubemap" && i + 1 < argc)
+        {
+            string size = argv[++i];
+            Skybox::SetCubemap(true, size == "auto" ? 0 : max(1, atoi(size.c_str())));
+        }
+        else if (arg == "--capture" && i + 1 < argc)
+        {
+            capturePrefix = argv[++i];
+            isRecording = true;
+        }
+        else if (arg == "--capture-frames" && i + 1 < argc)
+            captureNumFrames = max(0, atoi(argv[++i]));
+        else if (arg == "--capture-format" && i + 1 < argc)
+            captureFormat = argv[++i];
+        else
+        {
+            cerr << "[ERROR] Unknown option: " << arg << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int RunBatch()
+{
+    // Render every view of every model in the manifest with one GL context.
+    // Shaders, lights and the skybox stay resident, model N+1 is parsed and decoded
+    // on loader threads while model N renders, and frames are saved by FrameCapture.
+    BatchManifest manifest;
+    if (!manifest.LoadFromFile(batchManifestPath))
+        return 1;
+    vector<BatchModel>& models = manifest.GetModels();
+    cout << "Batch: " << models.size() << " models, " << manifest.GetNumViews() << " views, "
+        << outputWidth << " x " << outputHeight << endl;
+
+    CpuTimer totalTimer;
+    StageStats stats;
+    SetupRenderState();
+    fileDialog = new FileDialog();
+    if (virtualTexturePages > 0)
+        CreateVirtualTextures();
+    CreateCamera();
+    CreateLights();
+    CreateSkybox();
+    CreateShaderLib();
+    float aspectRatio = (outputWidth * 1.0f) / (outputHeight * 1.0f);
+    RenderTarget renderTarget(outputWidth, outputHeight);
+    if (!renderTarget.GetComplete())
+        return 1;
+    FrameCapture batchCapture(batchNumReadbackSlots);
+    batchCapture.SetStats(&stats);
+    ThreadPool loaderPool(batchLoaderThreads);
+    stats.Add("setup", totalTimer.GetElapsedMs());
+
+    // Parse the OBJ file and decode its textures (no GL calls).
+    // False for a model that can't be parsed or has nothing to draw.
+    auto loadModel = [&stats](const string& objFilePath) -> pair<TriangleMesh*, bool>
+    {
+        CpuTimer timer;
+        TriangleMesh* loadedMesh = new TriangleMesh();
+        bool loaded = loadedMesh->LoadObjFile(objFilePath, true)
+            && !loadedMesh->GetVertices().empty() && !loadedMesh->GetSubMeshes().empty();
+        stats.Add("load (worker)", timer.GetElapsedMs());
+        return make_pair(loadedMesh, loaded);
+    };
+    // Keep one pending load per loader thread.
+    deque<future<pair<TriangleMesh*, bool>>> pendingLoads;
+    size_t nextLoad = 0;
+    const size_t loadAhead = max(1u, loaderPool.GetNumThreads());
+    unsigned int numRendered = 0, numModelsRendered = 0, numFailed = 0;
+    for (size_t m = 0; m < models.size(); ++m)
+    {
+        while (nextLoad < models.size() && pendingLoads.size() < loadAhead)
+        {
+            string objFilePath = models[nextLoad++].objFilePath;
+            pendingLoads.push_back(loaderPool.Submit([loadModel, objFilePath]() { return loadModel(objFilePath); }));
+        }
+        CpuTimer waitTimer;
+        pair<TriangleMesh*, bool> loadedModel = pendingLoads.front().get();
+        TriangleMesh* batchMesh = loadedModel.first;
+        pendingLoads.pop_front();
+        stats.Add("load wait", waitTimer.GetElapsedMs());
+        if (!loadedModel.second)
+        {
+            // Deleted here, its textures may already be registered with the texture systems.
+            cerr << "[ERROR] Skipped the model. Obj file path: " << models[m].objFilePath << endl;
+            delete batchMesh;
+            numFailed++;
+            continue;
+        }
+
+        CpuTimer uploadTimer;
+        batchMesh->CreateBuffers();
+        stats.Add("upload", uploadTimer.GetElapsedMs());
+
+        SceneObject batchObj;
+        batchObj.mesh = batchMesh;
+        numModelsRendered++;
+        for (BatchView& view : models[m].views)
+        {
+            CpuTimer renderTimer;
+            camera->UpdateView(view.cameraPos, view.cameraTarget, cameraUp);
+            // The skybox and its lighting turn with the model.
+            curRotationY = view.rotationY;
+            camera->UpdateProjection(view.fovy, aspectRatio, zNear, zFar);
+            glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+            glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(view.rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+            batchObj.worldMatrix = S * R;
+            // Page in the tiles of this view before rendering it.
+            if (virtualTextures != nullptr)
+            {
+                RenderVirtualTextureFeedback(batchObj, camera);
+                virtualTextures->Update(true);
+            }
+
+            renderTarget.Bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            BeginHdrFrame();
+            UpdateClusteredLights(camera);
+            RenderShadowMaps(batchObj, camera);
+            RenderSceneObject(batchObj, camera);
+            RenderTransparentObject(batchObj, camera);
+            // The light gizmos are an interactive aid and stay out of the output images.
+            if (skybox != nullptr)
+                RenderSkybox(camera, view.rotationY);
+            ResolveHdrFrame();
+            renderTarget.UnBind();
+            stats.Add("render", renderTimer.GetElapsedMs());
+
+            batchCapture.CaptureFrame(renderTarget.GetFboId(), outputWidth, outputHeight, view.outputPath);
+            numRendered++;
+        }
+        delete batchMesh;
+        // The next mesh may get the same address.
+        if (pointShadowMap != nullptr)
+            pointShadowMap->Invalidate();
+    }
+    batchCapture.Flush();
+    numFailed += batchCapture.GetNumFailed();
+
+    double totalMs = totalTimer.GetElapsedMs();
+    cout << endl << "Batch finished: " << numModelsRendered << " of " << models.size() << " models, " << numRendered
+        << " views rendered, " << numFailed << " failures" << endl;
+    cout << "Total time: " << totalMs << " ms" << endl;
+    cout << "Models/s: " << numModelsRendered * 1000.0 / totalMs << ", views/s: " << numRendered * 1000.0 / totalMs << endl;
+    stats.ShowInfo();
+    return numFailed == 0 ? 0 : 1;
+}
+
+int RunSoftRaster()
+{
+    // Render an OBJ file with the CPU rasterizer (no GL context at all) and report
+    // its throughput. The model turns a full circle over the frames.
+    ifstream objFile(softRasterObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << softRasterObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    CpuTimer loadTimer;
+    TriangleMesh* softMesh = new TriangleMesh();
+    if (!softMesh->LoadObjFile(softRasterObjPath, true))
+    {
+        delete softMesh;
+        return 1;
+    }
+    softMesh->ShowInfo();
+    cout << "Load time: " << loadTimer.GetElapsedMs() << " ms" << endl;
+
+    float aspectRatio = (outputWidth * 1.0f) / (outputHeight * 1.0f);
+    Camera softCamera(aspectRatio);
+    softCamera.UpdateView(cameraPos, cameraTarget, cameraUp);
+    softCamera.UpdateProjection(fovy, aspectRatio, zNear, zFar);
+    SoftLights softLights;
+    softLights.ambientLight = ambientLight;
+    softLights.pointLightPos = pointLightPosition;
+    softLights.pointLightIntensity = pointLightIntensity;
+    softLights.spotLightPos = spotLightPosition;
+    softLights.spotLightIntensity = spotLightIntensity;
+    softLights.spotLightDir = spotLightDirection;
+    softLights.cutoffStart = spotLightCutoffStartInDegree;
+    softLights.totalWidth = spotLightTotalWidthInDegree;
+    softLights.dirLightDir = glm::normalize(dirLightDirection);
+    softLights.dirLightRadiance = dirLightRadiance;
+
+    SoftRasterizer rasterizer(outputWidth, outputHeight);
+    rasterizer.SetCamera(softCamera.GetViewMatrix(), softCamera.GetProjMatrix(), softCamera.GetCameraPos());
+    rasterizer.SetLights(softLights);
+    double totalMs = 0.0, minMs = 1e30;
+    unsigned long long totalTriangles = 0, totalPixels = 0;
+    for (int f = 0; f < softRasterFrames; ++f)
+    {
+        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+        glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(360.0f * f / softRasterFrames), glm::vec3(0.0f, 1.0f, 0.0f));
+        CpuTimer frameTimer;
+        rasterizer.Clear(glm::vec3(0.44f, 0.57f, 0.75f));
+        rasterizer.DrawMesh(softMesh, S * R);
+        double frameMs = frameTimer.GetElapsedMs();
+        totalMs += frameMs;
+        minMs = min(minMs, frameMs);
+        totalTriangles += rasterizer.GetNumTriangles();
+        totalPixels += rasterizer.GetNumPixelsShaded();
+    }
+    cout << "Software rasterizer (" << SIMD_WIDTH << "-wide SIMD, " << ThreadPool::GetGlobal()->GetNumThreads()
+        << " threads): " << softRasterFrames << " frames, " << outputWidth << " x " << outputHeight << endl;
+    cout << "Frame time: avg " << totalMs / softRasterFrames << " ms, min " << minMs << " ms" << endl;
+    cout << "Triangles/s: " << totalTriangles * 1000.0 / totalMs << endl;
+    cout << "Shaded pixels/s: " << totalPixels * 1000.0 / totalMs << endl;
+
+    bool success = rasterizer.SaveImage(softRasterOutputPath);
+    delete softMesh;
+    return success ? 0 : 1;
+}
+
+int RunBvhBench()
+{
+    // Build a BVH over an OBJ file and measure ray throughput (no GL context):
+    // coherent primary rays through the default camera, one per pixel of --size,
+    // and the same number of incoherent rays between random points of the bounds.
+    ifstream objFile(bvhBenchObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << bvhBenchObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    TriangleMesh* benchMesh = new TriangleMesh();
+    if (!benchMesh->LoadObjFile(bvhBenchObjPath, true))
+    {
+        delete benchMesh;
+        return 1;
+    }
+    benchMesh->ShowInfo();
+
+    const int numBuilds = 3;
+    Bvh bvh;
+    double minBuildMs = 1e30;
+    for (int i = 0; i < numBuilds; ++i)
+    {
+        bvh.Build(benchMesh);
+        minBuildMs = min(minBuildMs, bvh.GetBuildTimeMs());
+    }
+    bvh.ShowInfo();
+    cout << "BVH build time: min " << minBuildMs << " ms over " << numBuilds << " builds, "
+        << bvh.GetNumTriangles() * 0.001 / minBuildMs << " Mtris/s" << endl;
+
+    // Coherent rays: primary rays in scanline order, so packets hold neighbouring pixels.
+    const int numRays = (outputWidth * outputHeight / SIMD_WIDTH) * SIMD_WIDTH;
+    vector<Ray> primaryRays(numRays);
+    float aspectRatio = (outputWidth * 1.0f) / (outputHeight * 1.0f);
+    Camera benchCamera(aspectRatio);
+    benchCamera.UpdateView(cameraPos, cameraTarget, cameraUp);
+    benchCamera.UpdateProjection(fovy, aspectRatio, zNear, zFar);
+    for (int i = 0; i < numRays; ++i)
+    {
+        glm::vec3 origin, direction;
+        benchCamera.GetPickRay((i % outputWidth) + 0.5f, (i / outputWidth) + 0.5f, outputWidth, outputHeight, origin, direction);
+        primaryRays[i] = Ray(origin, direction);
+    }
+    // Incoherent rays: between random points of the (slightly enlarged) bounds.
+    vector<Ray> randomRays(numRays);
+    glm::vec3 bmin = bvh.GetBoundsMin();
+    glm::vec3 bmax = bvh.GetBoundsMax();
+    glm::vec3 center = (bmin + bmax) * 0.5f;
+    glm::vec3 extent = (bmax - bmin) * 0.6f;
+    mt19937 rng(1234);
+    uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (int i = 0; i < numRays; ++i)
+    {
+        glm::vec3 a = center + extent * glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        glm::vec3 b = center + extent * glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        randomRays[i] = Ray(a, glm::normalize(b - a + glm::vec3(0.0f, 0.0f, 1e-6f)));
+    }
+
+    ThreadPool* pool = ThreadPool::GetGlobal();
+    vector<RayHit> singleHits(numRays);
+    vector<RayHit> packetHits(numRays);
+    const char* names[2] = { "primary", "random" };
+    vector<Ray>* rayLists[2] = { &primaryRays, &randomRays };
+    for (int r = 0; r < 2; ++r)
+    {
+        const vector<Ray>& rays = *rayLists[r];
+        CpuTimer singleTimer;
+        pool->ParallelFor(0, numRays, 1024, [&](int first, int last) {
+            for (int i = first; i < last; ++i)
+                bvh.Intersect(rays[i], singleHits[i]);
+        });
+        double singleMs = singleTimer.GetElapsedMs();
+        CpuTimer packetTimer;
+        pool->ParallelFor(0, numRays / SIMD_WIDTH, 128, [&](int first, int last) {
+            for (int i = first; i < last; ++i)
+                bvh.IntersectPacket(&rays[i * SIMD_WIDTH], &packetHits[i * SIMD_WIDTH]);
+        });
+        double packetMs = packetTimer.GetElapsedMs();
+        CpuTimer occludedTimer;
+        atomic<int> numOccluded(0);
+        pool->ParallelFor(0, numRays, 1024, [&](int first, int last) {
+            int count = 0;
+            for (int i = first; i < last; ++i)
+                count += bvh.Occluded(rays[i]) ? 1 : 0;
+            numOccluded += count;
+        });
+        double occludedMs = occludedTimer.GetElapsedMs();
+
+        int numHits = 0, numMismatches = 0;
+        for (int i = 0; i < numRays; ++i)
+        {
+            numHits += singleHits[i].GetHit() ? 1 : 0;
+            if (singleHits[i].GetHit() != packetHits[i].GetHit() || fabs(singleHits[i].t - packetHits[i].t) > 1e-4f)
+                numMismatches++;
+        }
+        cout << names[r] << " rays: " << numRays << " (" << numHits << " hits, "
+            << numMismatches << " packet mismatches, " << numOccluded << " occluded)" << endl;
+        cout << "  single: " << numRays * 0.001 / singleMs << " Mrays/s, "
+            << SIMD_WIDTH << "-wide packets: " << numRays * 0.001 / packetMs << " Mrays/s, "
+            << "occlusion: " << numRays * 0.001 / occludedMs << " Mrays/s" << endl;
+    }
+    delete benchMesh;
+    return 0;
+}
+
+int RunAoBench()
+{
+    // Bake the ambient occlusion of an OBJ file without the cache (no GL context), at the
+    // rays per vertex of --ao or at a range of them.
+    ifstream objFile(aoBenchObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << aoBenchObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    TriangleMesh* benchMesh = new TriangleMesh();
+    if (!benchMesh->LoadObjFile(aoBenchObjPath, true))
+    {
+        delete benchMesh;
+        return 1;
+    }
+    benchMesh->ShowInfo();
+    Bvh bvh;
+    bvh.Build(benchMesh);
+    bvh.ShowInfo();
+
+    vector<int> rayCounts = { 16, 64, 256 };
+    if (aoRaysPerVertex > 0)
+        rayCounts = { aoRaysPerVertex };
+    for (int rays : rayCounts)
+    {
+        AoBaker aoBaker(rays);
+        vector<float> occlusion;
+        aoBaker.Bake(benchMesh, &bvh, occlusion, false);
+        aoBaker.ShowInfo(occlusion);
+    }
+    delete benchMesh;
+    return 0;
+}
+
+int RunDecodeBench()
+{
+    // Compare cv::imread followed by the vertical flip the textures used to need with
+    // ImageDecoder, then reduced decodes and many decodes in a row vs. on the thread pool.
+    const int numRuns = 5;
+    cv::Mat image;
+    double imreadMs = 1e30;
+    for (int run = 0; run < numRuns; ++run)
+    {
+        CpuTimer timer;
+        image = cv::imread(decodeBenchImagePath);
+        if (image.empty())
+        {
+            cerr << "[ERROR] Failed to load image: " << decodeBenchImagePath << endl;
+            return 1;
+        }
+        cv::flip(image, image, 0);
+        imreadMs = min(imreadMs, timer.GetElapsedMs());
+    }
+    double decodeMs = 1e30;
+    for (int run = 0; run < numRuns; ++run)
+    {
+        CpuTimer timer;
+        ImageDecoder::DecodeFile(decodeBenchImagePath, image);
+        decodeMs = min(decodeMs, timer.GetElapsedMs());
+    }
+    const unsigned int numThreads = ThreadPool::GetGlobal()->GetNumThreads();
+    cout << fixed << setprecision(2);
+    cout << "Image: " << image.cols << " x " << image.rows << ", " << numThreads << " threads" << endl;
+    cout << "  cv::imread + cv::flip: " << imreadMs << " ms" << endl;
+    cout << "  ImageDecoder:          " << decodeMs << " ms (" << imreadMs / decodeMs << "x)" << endl;
+    for (int reduction = 2; reduction <= 8; reduction *= 2)
+    {
+        cv::Mat reduced;
+        double minMs = 1e30;
+        for (int run = 0; run < numRuns; ++run)
+        {
+            CpuTimer timer;
+            ImageDecoder::DecodeFile(decodeBenchImagePath, reduced, reduction);
+            minMs = min(minMs, timer.GetElapsedMs());
+        }
+        cout << "  1/" << reduction << " (" << reduced.cols << " x " << reduced.rows << "): " << minMs << " ms" << endl;
+    }
+
+    // The same file stands in for the textures of a material library.
+    const int numFiles = max(8, static_cast<int>(2 * numThreads));
+    vector<string> paths(numFiles, decodeBenchImagePath);
+    vector<cv::Mat> images(numFiles);
+    CpuTimer serialTimer;
+    for (int i = 0; i < numFiles; ++i)
+        ImageDecoder::DecodeFile(paths[i], images[i]);
+    const double serialMs = serialTimer.GetElapsedMs();
+    CpuTimer parallelTimer;
+    ImageDecoder::DecodeAll(paths, images);
+    const double parallelMs = parallelTimer.GetElapsedMs();
+    cout << "  " << numFiles << " decodes: " << serialMs << " ms serial, " << parallelMs << " ms concurrent ("
+        << serialMs / parallelMs << "x)" << endl;
+    return 0;
+}
+
+int RunLightBench()
+{
+    // Render an OBJ file offscreen with 3 to 1024 lights (the directional, point and spot
+    // lights and random ones), shading the lights of each cluster and then every light at
+    // every pixel, and report the binning time and the GPU time per frame.
+    ifstream objFile(lightBenchObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << lightBenchObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    mesh = new TriangleMesh();
+    if (!mesh->LoadObjFile(lightBenchObjPath, true))
+    {
+        delete mesh;
+        mesh = nullptr;
+        return 1;
+    }
+    mesh->ShowInfo();
+    mesh->CreateBuffers();
+    sceneObj.mesh = mesh;
+    sceneObj.worldMatrix = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+
+    SetupRenderState();
+    CreateCamera();
+    CreateLights();
+    CreateShaderLib();
+    camera->UpdateProjection(fovy, (outputWidth * 1.0f) / (outputHeight * 1.0f), zNear, zFar);
+    RenderTarget renderTarget(outputWidth, outputHeight);
+    if (!renderTarget.GetComplete())
+        return 1;
+
+    const int numFrames = 20;
+    const int lightCounts[] = { 3, 16, 64, 256, 1024 };
+    cout << "GL renderer: " << glGetString(GL_RENDERER) << endl;
+    cout << outputWidth << " x " << outputHeight << ", " << CLUSTER_GRID_X << " x " << CLUSTER_GRID_Y << " x " << CLUSTER_GRID_Z
+        << " clusters, " << ThreadPool::GetGlobal()->GetNumThreads() << " threads, " << numFrames << " frames per run" << endl;
+    for (int numLights : lightCounts)
+    {
+        CreateExtraLights(numLights - 3);
+        double gpuMs[2] = { 0.0, 0.0 };
+        double binMs = 0.0;
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            useClusteredLights = (mode == 0);
+            GpuTimer gpuTimer;
+            renderTarget.Bind();
+            for (int f = 0; f < numFrames; ++f)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                UpdateClusteredLights(camera);
+                binMs += clusteredLights->GetBinTimeMs();
+                gpuTimer.Begin();
+                RenderSceneObject(sceneObj, camera);
+                gpuTimer.End();
+                // Each query is read back at the next Begin().
+                glFinish();
+            }
+            renderTarget.UnBind();
+            gpuMs[mode] = gpuTimer.GetAverageMs();
+        }
+        cout << setw(5) << numLights << " lights: binning " << binMs / (2 * numFrames) << " ms, "
+            << static_cast<double>(clusteredLights->GetNumIndices()) / clusteredLights->GetNumClusters() << " avg / "
+            << clusteredLights->GetMaxClusterLights() << " max lights per cluster, GPU " << gpuMs[0] << " ms clustered, "
+            << gpuMs[1] << " ms all lights (" << gpuMs[1] / max(gpuMs[0], 1e-6) << "x)" << endl;
+    }
+    useClusteredLights = true;
+    return 0;
+}
+
+int RunOverdrawBench()
+{
+    // Render 1 to 16 instances of an OBJ file offscreen, back to front so that every layer
+    // passes the depth test, forward and then deferred, each without and with the depth
+    // pre-pass, and report the GPU time per frame and the samples shaded. The forward pass
+    // shades every layer; the deferred one and the pre-pass shade each pixel once.
+    ifstream objFile(overdrawBenchObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << overdrawBenchObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    mesh = new TriangleMesh();
+    if (!mesh->LoadObjFile(overdrawBenchObjPath, true))
+    {
+        delete mesh;
+        mesh = nullptr;
+        return 1;
+    }
+    mesh->ShowInfo();
+    mesh->CreateBuffers();
+    sceneObj.mesh = mesh;
+
+    SetupRenderState();
+    CreateCamera();
+    CreateLights();
+    CreateShaderLib();
+    camera->UpdateProjection(fovy, (outputWidth * 1.0f) / (outputHeight * 1.0f), zNear, zFar);
+    RenderTarget renderTarget(outputWidth, outputHeight);
+    if (!renderTarget.GetComplete())
+        return 1;
+
+    const int numFrames = 20;
+    const int layerCounts[] = { 1, 4, 16 };
+    cout << "GL renderer: " << glGetString(GL_RENDERER) << endl;
+    cout << outputWidth << " x " << outputHeight << ", " << clusteredLights->GetNumLights() << " lights, "
+        << numFrames << " frames per run" << endl;
+    for (int numLayers : layerCounts)
+    {
+        // Instances spaced along the view direction, farthest first.
+        vector<SceneObject> layers(numLayers, sceneObj);
+        const glm::vec3 viewDir = glm::normalize(cameraTarget - cameraPos);
+        for (int l = 0; l < numLayers; ++l)
+        {
+            glm::mat4x4 T = glm::translate(glm::mat4x4(1.0f), viewDir * (0.25f * (numLayers - 1 - l)));
+            layers[l].worldMatrix = T * glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+        }
+        // Forward, forward with the pre-pass, deferred, deferred with the pre-pass.
+        double gpuMs[4] = { 0.0, 0.0, 0.0, 0.0 };
+        double samples[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for (int mode = 0; mode < 4; ++mode)
+        {
+            useDeferred = (mode >= 2);
+            useDepthPrepass = (mode % 2 == 1);
+            GpuTimer gpuTimer;
+            GpuSampleCounter sampleCounter;
+            renderTarget.Bind();
+            for (int f = 0; f < numFrames; ++f)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                UpdateClusteredLights(camera);
+                gpuTimer.Begin();
+                if (useDeferred)
+                    BeginDeferredGeometry();
+                if (useDepthPrepass)
+                {
+                    for (SceneObject& layer : layers)
+                        DrawSceneDepth(layer, camera);
+                    SetDepthEqualTest(true);
+                }
+                PhongShadingShaderProg* shader = useDeferred ? gBufferShader : phongShadingShader;
+                sampleCounter.Begin();
+                for (SceneObject& layer : layers)
+                    DrawSceneObject(layer, camera, shader, useDepthPrepass ? DRAW_SOLID_SUBMESHES : DRAW_OPAQUE_SUBMESHES);
+                if (useDepthPrepass)
+                {
+                    SetDepthEqualTest(false);
+                    if (mesh->GetNumAlphaTestedSubMeshes() > 0)
+                        for (SceneObject& layer : layers)
+                            DrawSceneObject(layer, camera, shader, DRAW_ALPHA_TESTED_SUBMESHES);
+                }
+                sampleCounter.End();
+                if (useDeferred)
+                    ShadeDeferred(camera);
+                gpuTimer.End();
+                // Each query is read back at the next Begin().
+                glFinish();
+            }
+            renderTarget.UnBind();
+            gpuMs[mode] = gpuTimer.GetAverageMs();
+            samples[mode] = sampleCounter.GetAverageSamples();
+        }
+        cout << setw(3) << numLayers << " layers: GPU " << gpuMs[0] << " ms forward, " << gpuMs[1] << " ms with pre-pass ("
+            << gpuMs[0] / max(gpuMs[1], 1e-6) << "x), " << gpuMs[2] << " ms deferred (" << gpuMs[0] / max(gpuMs[2], 1e-6) << "x), "
+            << gpuMs[3] << " ms deferred with pre-pass (" << gpuMs[0] / max(gpuMs[3], 1e-6) << "x)" << endl;
+        cout << "           samples shaded: " << static_cast<long long>(samples[0]) << " forward, " << static_cast<long long>(samples[1])
+            << " with pre-pass (" << samples[0] / max(samples[1], 1.0) << "x fewer)" << endl;
+    }
+    if (gBuffer != nullptr)
+        cout << "G-buffer: " << gBuffer->GetGpuBytes() / (1 << 20) << " MB" << endl;
+    useDeferred = false;
+    useDepthPrepass = false;
+    return 0;
+}
+
+int RunOitBench()
+{
+    // Render an OBJ file offscreen with its submeshes in file order and reversed, with weighted
+    // blended OIT and with unsorted blending, and report the GPU time of the transparent pass
+    // and how much each image changes with the order. The OIT image, which must not change
+    // beyond rounding, is saved. Models without transparent materials are drawn at d = 0.5, and
+    // with fewer than two transparent submeshes both orders are the same, so nothing is checked.
+    ifstream objFile(oitBenchObjPath);
+    if (!objFile)
+    {
+        cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << oitBenchObjPath << endl;
+        return 1;
+    }
+    objFile.close();
+    mesh = new TriangleMesh();
+    if (!mesh->LoadObjFile(oitBenchObjPath, true))
+    {
+        delete mesh;
+        mesh = nullptr;
+        return 1;
+    }
+    mesh->ShowInfo();
+    mesh->CreateBuffers();
+    if (mesh->GetNumTransparentSubMeshes() == 0)
+    {
+        for (SubMesh& subMesh : mesh->GetSubMeshes())
+            (subMesh.material)->SetOpacity(0.5f);
+    }
+    sceneObj.mesh = mesh;
+    sceneObj.worldMatrix = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+
+    SetupRenderState();
+    CreateCamera();
+    CreateLights();
+    CreateShaderLib();
+    camera->UpdateProjection(fovy, (outputWidth * 1.0f) / (outputHeight * 1.0f), zNear, zFar);
+    RenderTarget renderTarget(outputWidth, outputHeight);
+    if (!renderTarget.GetComplete())
+        return 1;
+
+    const int numFrames = 20;
+    // Largest difference (of 255) allowed between the OIT images of the two orders.
+    const int maxOitDifference = 2;
+    cout << "GL renderer: " << glGetString(GL_RENDERER) << endl;
+    cout << outputWidth << " x " << outputHeight << ", " << mesh->GetNumTransparentSubMeshes() << " of "
+        << mesh->GetNumSubMeshes() << " submeshes transparent, " << numFrames << " frames per run" << endl;
+    const bool checkOrder = mesh->GetNumTransparentSubMeshes() >= 2;
+    if (!checkOrder)
+        cout << "Fewer than two transparent submeshes, the order check is skipped" << endl;
+    vector<unsigned char> images[2][2];
+    int maxDifference[2] = { 0, 0 };
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        useOit = (mode == 0);
+        double gpuMs = 0.0;
+        for (int order = 0; order < 2; ++order)
+        {
+            renderTarget.Bind();
+            for (int f = 0; f < numFrames; ++f)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                UpdateClusteredLights(camera);
+                RenderSceneObject(sceneObj, camera);
+                RenderTransparentObject(sceneObj, camera);
+                // Each query is read back at the next Begin().
+                glFinish();
+            }
+            images[mode][order].resize(static_cast<size_t>(outputWidth) * outputHeight * 4);
+            glReadPixels(0, 0, outputWidth, outputHeight, GL_BGRA, GL_UNSIGNED_BYTE, images[mode][order].data());
+            renderTarget.UnBind();
+            gpuMs += transparentGpuTimer->GetAverageMs();
+            transparentGpuTimer->Reset();
+            reverse(mesh->GetSubMeshes().begin(), mesh->GetSubMeshes().end());
+        }
+        double sumDifference = 0.0;
+        for (size_t p = 0; p < images[mode][0].size(); ++p)
+        {
+            int difference = abs(static_cast<int>(images[mode][0][p]) - static_cast<int>(images[mode][1][p]));
+            maxDifference[mode] = max(maxDifference[mode], difference);
+            sumDifference += difference;
+        }
+        cout << (useOit ? "Weighted blended OIT" : "Unsorted blending") << ": GPU " << gpuMs * 0.5 << " ms per frame";
+        if (checkOrder)
+            cout << ", reversed order changes the image by up to " << maxDifference[mode] << " (mean "
+                << sumDifference / max(images[mode][0].size(), static_cast<size_t>(1)) << ")";
+        cout << endl;
+    }
+    useOit = true;
+
+    cv::Mat image(outputHeight, outputWidth, CV_8UC4, images[0][0].data());
+    cv::flip(image, image, 0);
+    bool saved = false;
+    try
+    {
+        saved = cv::imwrite(oitBenchOutputPath, image);
+    }
+    catch (const cv::Exception& e)
+    {
+        cerr << "[ERROR] " << e.what() << endl;
+    }
+    if (!saved)
+    {
+        cerr << "[ERROR] Couldn't write the image. Image file path: " << oitBenchOutputPath << endl;
+        return 1;
+    }
+    cout << "Saved " << oitBenchOutputPath << endl;
+    if (checkOrder && maxDifference[0] > maxOitDifference)
+    {
+        cerr << "[ERROR] The OIT image depends on the submesh order" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int RunMipBench()
+{
+    // Compare the CPU mip builder with glGenerateMipmap on one image. Run with
+    // LIBGL_ALWAYS_SOFTWARE=1 to measure Mesa's llvmpipe.
+    cv::Mat image;
+    if (!ImageDecoder::DecodeFile(mipBenchImagePath, image))
+    {
+        cerr << "[ERROR] Failed to load image: " << mipBenchImagePath << endl;
+        return 1;
+    }
+    cout << "GL renderer: " << glGetString(GL_RENDERER) << endl;
+    cout << "Image: " << image.cols << " x " << image.rows << ", " << ThreadPool::GetGlobal()->GetNumThreads()
+        << " threads, " << SIMD_WIDTH << "-wide SIMD" << endl;
+    const int numRuns = 5;
+    vector<cv::Mat> mipLevels;
+    MipFilter filters[2] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+    for (int f = 0; f < 2; ++f)
+    {
+        MipmapBuilder builder(filters[f], true);
+        double minMs = 1e30;
+        for (int run = 0; run < numRuns; ++run)
+        {
+            builder.Build(image, mipLevels);
+            minMs = min(minMs, builder.GetBuildTimeMs());
+        }
+        cout << "CPU " << MipmapBuilder::GetFilterName(filters[f]) << " (linear, sRGB-aware): " << mipLevels.size()
+            << " levels in " << minMs << " ms, " << image.cols * image.rows * 0.001 / minMs << " Mpixels/s" << endl;
+    }
+
+    // Driver path: level 0 upload, then glGenerateMipmap (glFinish waits for the work).
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    double minUploadMs = 1e30, minGenerateMs = 1e30, minLevelsMs = 1e30;
+    for (int run = 0; run < numRuns; ++run)
+    {
+        CpuTimer uploadTimer;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.cols, image.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, image.ptr());
+        glFinish();
+        minUploadMs = min(minUploadMs, uploadTimer.GetElapsedMs());
+        CpuTimer generateTimer;
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        minGenerateMs = min(minGenerateMs, generateTimer.GetElapsedMs());
+    }
+    // CPU path: upload the prebuilt chain level by level.
+    for (int run = 0; run < numRuns; ++run)
+    {
+        CpuTimer levelsTimer;
+        for (unsigned int level = 0; level < mipLevels.size(); ++level)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, mipLevels[level].cols, mipLevels[level].rows,
+                0, GL_BGR, GL_UNSIGNED_BYTE, mipLevels[level].ptr());
+        glFinish();
+        minLevelsMs = min(minLevelsMs, levelsTimer.GetElapsedMs());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glDeleteTextures(1, &texture);
+    cout << "glGenerateMipmap: " << minGenerateMs << " ms on the render thread (+ " << minUploadMs << " ms level 0 upload)" << endl;
+    cout << "Upload of the CPU-built chain: " << minLevelsMs << " ms on the render thread" << endl;
+    return 0;
+}
+
 string GetSubFilePath()
 {
     char path[MAX_PATH_SIZE] = { 0 };
@@ -581,6 +2739,23 @@ string GetSubFilePath()
 
 int main(int argc, char** argv)
 {
+    if (!GetCpuSupportsSimd())
+    {
+        cerr << "[ERROR] This build needs a CPU with AVX2." << endl;
+        return 1;
+    }
+    if (!ParseCommandLine(argc, argv))
+        return 1;
+    // The software rasterizer needs neither a window nor a GL context.
+    if (!softRasterObjPath.empty())
+        return RunSoftRaster();
+    if (!bvhBenchObjPath.empty())
+        return RunBvhBench();
+    if (!aoBenchObjPath.empty())
+        return RunAoBench();
+    if (!decodeBenchImagePath.empty())
+        return RunDecodeBench();
+
     // Setting window properties.
     glutInit(&argc, argv);
     glutSetOption(GLUT_MULTISAMPLE, 4);
@@ -588,6 +2763,9 @@ int main(int argc, char** argv)
     glutInitWindowSize(screenWidth, screenHeight);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("Texture Mapping");
+    if (!batchManifestPath.empty() || !mipBenchImagePath.empty() || !lightBenchObjPath.empty() || !overdrawBenchObjPath.empty()
+        || !oitBenchObjPath.empty())
+        glutHideWindow();
 
     // Initialize GLEW.
     // Must be done after glut is initialized!
@@ -598,6 +2776,32 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    if (!batchManifestPath.empty())
+    {
+        int result = RunBatch();
+        ReleaseResources();
+        return result;
+    }
+    if (!mipBenchImagePath.empty())
+        return RunMipBench();
+    if (!lightBenchObjPath.empty())
+    {
+        int result = RunLightBench();
+        ReleaseResources();
+        return result;
+    }
+    if (!overdrawBenchObjPath.empty())
+    {
+        int result = RunOverdrawBench();
+        ReleaseResources();
+        return result;
+    }
+    if (!oitBenchObjPath.empty())
+    {
+        int result = RunOitBench();
+        ReleaseResources();
+        return result;
+    }
     Start();
 
     return 0;
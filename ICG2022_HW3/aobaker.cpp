@@ -0,0 +1,157 @@
+#include "aobaker.h"
+#include "texturecache.h"
+using namespace std;
+
+// Tag of the cache entries ("ICGA").
+#define AO_CACHE_MAGIC 0x41474349
+
+// Van der Corput radical inverse in base 2.
+static float RadicalInverse(unsigned int bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+// A well mixed 32-bit hash (for the per-vertex rotation of the sample set).
+static unsigned int HashIndex(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+AoBaker::AoBaker(const int raysPerVertex)
+{
+	numRaysPerVertex = max(1, raysPerVertex);
+	bakeTimeMs = 0.0;
+	numRaysTraced = 0.0;
+	fromCache = false;
+}
+
+AoBaker::~AoBaker()
+{}
+
+void AoBaker::Bake(TriangleMesh* mesh, const Bvh* bvh, vector<float>& occlusion, const bool useCache)
+{
+	CpuTimer timer;
+	const vector<VertexPTN>& vertices = mesh->GetVertices();
+	const string cachePath = useCache ? GetCachePath(mesh) : "";
+	fromCache = useCache && LoadCache(cachePath, vertices.size(), occlusion);
+	numRaysTraced = 0.0;
+	if (fromCache)
+	{
+		bakeTimeMs = timer.GetElapsedMs();
+		return;
+	}
+
+	// Offsets and lengths relative to the size of the mesh.
+	const float diagonal = glm::length(bvh->GetBoundsMax() - bvh->GetBoundsMin());
+	const float maxDistance = AO_MAX_DISTANCE_RATIO * diagonal;
+	const float bias = 1e-4f * diagonal;
+	const int numRays = numRaysPerVertex;
+	occlusion.assign(vertices.size(), 1.0f);
+	ThreadPool::GetGlobal()->ParallelFor(0, static_cast<int>(vertices.size()), 64, [&](int first, int last) {
+		for (int i = first; i < last; ++i)
+		{
+			const VertexPTN& vertex = vertices[i];
+			const float normalLength = glm::length(vertex.normal);
+			if (normalLength < 1e-6f)
+				continue;
+			const glm::vec3 n = vertex.normal / normalLength;
+			const glm::vec3 a = (abs(n.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			const glm::vec3 t = glm::normalize(glm::cross(a, n));
+			const glm::vec3 b = glm::cross(n, t);
+			const unsigned int hash = HashIndex(static_cast<unsigned int>(i));
+			const float rotU = (hash & 0xffffu) / 65536.0f;
+			const float rotV = (hash >> 16) / 65536.0f;
+			int numOpen = 0;
+			for (int r = 0; r < numRays; ++r)
+			{
+				// Cosine-weighted direction from the rotated Hammersley point (u, v).
+				const float u = glm::fract((r + 0.5f) / numRays + rotU);
+				const float v = glm::fract(RadicalInverse(static_cast<unsigned int>(r)) + rotV);
+				const float radius = sqrt(u);
+				const float phi = 2.0f * glm::pi<float>() * v;
+				const glm::vec3 dir = t * (radius * cos(phi)) + b * (radius * sin(phi)) + n * sqrt(max(0.0f, 1.0f - u));
+				if (!bvh->Occluded(Ray(vertex.position + n * bias, dir, 0.0f, maxDistance)))
+					numOpen++;
+			}
+			occlusion[i] = static_cast<float>(numOpen) / numRays;
+		}
+	});
+	bakeTimeMs = timer.GetElapsedMs();
+	numRaysTraced = static_cast<double>(vertices.size()) * numRays;
+	if (useCache)
+		SaveCache(cachePath, occlusion);
+}
+
+// Named after the positions and normals of the vertices and the number of rays.
+string AoBaker::GetCachePath(TriangleMesh* mesh) const
+{
+	const vector<VertexPTN>& vertices = mesh->GetVertices();
+	vector<unsigned char> bytes(vertices.size() * 2 * sizeof(glm::vec3));
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		memcpy(&bytes[(2 * i + 0) * sizeof(glm::vec3)], &vertices[i].position, sizeof(glm::vec3));
+		memcpy(&bytes[(2 * i + 1) * sizeof(glm::vec3)], &vertices[i].normal, sizeof(glm::vec3));
+	}
+	stringstream settings;
+	settings << "ao" << numRaysPerVertex << "r" << AO_CACHE_VERSION;
+	return TextureCache::GetCachePath(TextureCache::HashBytes(bytes), settings.str(), "ao");
+}
+
+bool AoBaker::LoadCache(const string& filePath, const size_t numVertices, vector<float>& occlusion) const
+{
+	ifstream file(filePath, ios::binary);
+	if (!file)
+		return false;
+	unsigned int header[4] = { 0, 0, 0, 0 };
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!file || header[0] != AO_CACHE_MAGIC || header[1] != AO_CACHE_VERSION || header[2] != numVertices
+		|| header[3] != static_cast<unsigned int>(numRaysPerVertex))
+		return false;
+	occlusion.resize(numVertices);
+	file.read(reinterpret_cast<char*>(occlusion.data()), numVertices * sizeof(float));
+	return !file.fail();
+}
+
+// Written through a temporary file, so a concurrent reader never sees a partial entry.
+void AoBaker::SaveCache(const string& filePath, const vector<float>& occlusion) const
+{
+	TextureCache::MakeDirectory();
+	const string tmpPath = filePath + ".tmp";
+	ofstream file(tmpPath, ios::binary);
+	if (!file)
+	{
+		cerr << "[ERROR] Couldn't write the occlusion cache file: " << tmpPath << endl;
+		return;
+	}
+	unsigned int header[4] = { AO_CACHE_MAGIC, AO_CACHE_VERSION, static_cast<unsigned int>(occlusion.size()),
+		static_cast<unsigned int>(numRaysPerVertex) };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(occlusion.data()), occlusion.size() * sizeof(float));
+	file.close();
+	if (file.fail() || rename(tmpPath.c_str(), filePath.c_str()) != 0)
+		remove(tmpPath.c_str());
+}
+
+void AoBaker::ShowInfo(const vector<float>& occlusion) const
+{
+	double sum = 0.0;
+	for (float ao : occlusion)
+		sum += ao;
+	cout << "Ambient occlusion: " << occlusion.size() << " vertices, " << numRaysPerVertex << " rays per vertex, ";
+	if (fromCache)
+		cout << "loaded from the cache in " << bakeTimeMs << " ms";
+	else
+		cout << "baked in " << bakeTimeMs << " ms (" << GetRaysPerSecond() * 1e-6 << " Mrays/s, "
+			<< ThreadPool::GetGlobal()->GetNumThreads() << " threads)";
+	cout << ", mean " << (occlusion.empty() ? 1.0 : sum / occlusion.size()) << endl;
+}
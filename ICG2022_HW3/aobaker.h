@@ -0,0 +1,51 @@
+#ifndef AO_BAKER_H
+#define AO_BAKER_H
+
+#include "headers.h"
+#include "trianglemesh.h"
+#include "bvh.h"
+#include "threadpool.h"
+#include "timer.h"
+using namespace std;
+
+// Occlusion rays end at this fraction of the diagonal of the mesh bounds.
+#define AO_MAX_DISTANCE_RATIO 0.25f
+// Version of the cache entries (change it when the baker changes).
+#define AO_CACHE_VERSION 1
+
+
+// AoBaker Declarations.
+// Ambient occlusion per vertex: the fraction of cosine-weighted hemisphere rays around the
+// vertex normal that leave the mesh without hitting it (within AO_MAX_DISTANCE_RATIO of its
+// size), traced against the Bvh of the mesh on the thread pool. The rays of a vertex follow
+// a Hammersley set rotated per vertex, so a bake is deterministic. Results are kept in the
+// texture cache directory, keyed by a hash of the vertices and the number of rays.
+class AoBaker
+{
+public:
+	// AoBaker Public Methods.
+	AoBaker(const int raysPerVertex);
+	~AoBaker();
+
+	int GetRaysPerVertex() const { return numRaysPerVertex; }
+	double GetBakeTimeMs() const { return bakeTimeMs; }
+	double GetRaysPerSecond() const { return bakeTimeMs > 0.0 ? numRaysTraced / (bakeTimeMs * 0.001) : 0.0; }
+	bool GetFromCache() const { return fromCache; }
+
+	// Occlusion of each vertex of the mesh (1 for open, 0 for fully occluded).
+	void Bake(TriangleMesh* mesh, const Bvh* bvh, vector<float>& occlusion, const bool useCache = true);
+	void ShowInfo(const vector<float>& occlusion) const;
+
+private:
+	// AoBaker Private Methods.
+	string GetCachePath(TriangleMesh* mesh) const;
+	bool LoadCache(const string& filePath, const size_t numVertices, vector<float>& occlusion) const;
+	void SaveCache(const string& filePath, const vector<float>& occlusion) const;
+	// AoBaker Private Data.
+	int numRaysPerVertex;
+	double bakeTimeMs;
+	double numRaysTraced;
+	bool fromCache;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "batchrender.h"
+using namespace std;
+
+// Get the total number of views of all models.
+unsigned int BatchManifest::GetNumViews() const
+{
+	unsigned int numViews = 0;
+	for (const BatchModel& model : models)
+		numViews += static_cast<unsigned int>(model.views.size());
+	return numViews;
+}
+
+// Load the models and views from a manifest file.
+bool BatchManifest::LoadFromFile(const string& filePath)
+{
+	ifstream fileStream(filePath);
+	if (!fileStream)
+	{
+		cerr << "[ERROR] Couldn't open the batch manifest. Manifest file path: " << filePath << endl;
+		return false;
+	}
+	models.clear();
+	string line = "";
+	int lineNumber = 0;
+	while (getline(fileStream, line))
+	{
+		lineNumber++;
+		stringstream ss;
+		string prefix;
+		ss << line;
+		ss >> prefix;
+		if (prefix.empty() || prefix[0] == '#')
+			continue;
+		if (prefix == "model")
+		{
+			BatchModel model;
+			getline(ss >> ws, model.objFilePath);
+			if (model.objFilePath.empty())
+			{
+				cerr << "[ERROR] Couldn't parse the batch manifest. Lack of the obj file path at line " << lineNumber << endl;
+				return false;
+			}
+			models.push_back(model);
+		}
+		else if (prefix == "view")
+		{
+			if (models.empty())
+			{
+				cerr << "[ERROR] Couldn't parse the batch manifest. View without a model at line " << lineNumber << endl;
+				return false;
+			}
+			BatchView view;
+			ss >> view.outputPath;
+			if (view.outputPath.empty())
+			{
+				cerr << "[ERROR] Couldn't parse the batch manifest. Lack of the output path at line " << lineNumber << endl;
+				return false;
+			}
+			// Optional fields keep their defaults when absent.
+			glm::vec3 pos, target;
+			float fovy, rotationY;
+			if (ss >> pos.x >> pos.y >> pos.z)
+			{
+				view.cameraPos = pos;
+				if (ss >> target.x >> target.y >> target.z)
+				{
+					view.cameraTarget = target;
+					if (ss >> fovy)
+					{
+						view.fovy = fovy;
+						if (ss >> rotationY)
+							view.rotationY = rotationY;
+					}
+				}
+			}
+			models.back().views.push_back(view);
+		}
+		else
+			cout << "Unknown batch manifest directive at line " << lineNumber << ": " << prefix << endl;
+	}
+	fileStream.close();
+	return true;
+}
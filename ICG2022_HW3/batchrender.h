@@ -0,0 +1,56 @@
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include "headers.h"
+using namespace std;
+
+
+// BatchView Declarations (one output image of a model).
+struct BatchView
+{
+	BatchView()
+	{
+		outputPath = "";
+		cameraPos = glm::vec3(0.0f, 1.0f, 5.0f);
+		cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
+		fovy = 30.0f;
+		rotationY = 0.0f;
+	}
+	string outputPath;
+	glm::vec3 cameraPos;
+	glm::vec3 cameraTarget;
+	float fovy;      // in degree.
+	float rotationY; // model rotation around the Y axis, in degree.
+};
+
+
+// BatchModel Declarations (an OBJ file and the views rendered from it).
+struct BatchModel
+{
+	string objFilePath;
+	vector<BatchView> views;
+};
+
+
+// BatchManifest Declarations.
+// Manifest format (one directive per line, '#' starts a comment):
+//   model <obj file path>
+//   view <output image path> [camX camY camZ [targetX targetY targetZ [fovy [rotationY]]]]
+// Every view belongs to the closest preceding model.
+class BatchManifest
+{
+public:
+	// BatchManifest Public Methods.
+	BatchManifest() {}
+	~BatchManifest() { models.clear(); }
+
+	vector<BatchModel>& GetModels() { return models; }
+	unsigned int GetNumViews() const;
+	bool LoadFromFile(const string& filePath);
+
+private:
+	// BatchManifest Private Data.
+	vector<BatchModel> models;
+};
+
+#endif
@@ -0,0 +1,605 @@
+#include "bvh.h"
+using namespace std;
+
+#define BVH_MAX_DEPTH 60
+#define BVH_PARALLEL_BINNING 16384
+#define BVH_PARALLEL_SUBTREE 4096
+
+// Binned SAH declarations.
+struct BvhBin
+{
+	BvhBin()
+	{
+		boundsMin = glm::vec3(FLT_MAX);
+		boundsMax = glm::vec3(-FLT_MAX);
+		count = 0;
+	}
+	void Grow(const glm::vec3& bmin, const glm::vec3& bmax)
+	{
+		boundsMin = glm::min(boundsMin, bmin);
+		boundsMax = glm::max(boundsMax, bmax);
+	}
+	void Merge(const BvhBin& other)
+	{
+		Grow(other.boundsMin, other.boundsMax);
+		count += other.count;
+	}
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	unsigned int count;
+};
+
+static float SurfaceArea(const glm::vec3& bmin, const glm::vec3& bmax)
+{
+	glm::vec3 e = glm::max(bmax - bmin, glm::vec3(0.0f));
+	return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+// Slab test, returning the entry distance or FLT_MAX on a miss.
+static inline float IntersectBox(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir,
+	const float tMin, const float tMax)
+{
+	glm::vec3 t0 = (node.boundsMin - origin) * invDir;
+	glm::vec3 t1 = (node.boundsMax - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, tMin));
+	float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+	return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+// Slab test for SIMD_WIDTH rays, returning the lanes that hit.
+static inline SimdFloat IntersectBoxPacket(const BvhNode& node, const SimdVec3& origin, const SimdVec3& invDir,
+	const SimdFloat tMin, const SimdFloat tMax, SimdFloat& tEnter)
+{
+	SimdFloat tx0 = (SimdFloat(node.boundsMin.x) - origin.x) * invDir.x;
+	SimdFloat tx1 = (SimdFloat(node.boundsMax.x) - origin.x) * invDir.x;
+	SimdFloat ty0 = (SimdFloat(node.boundsMin.y) - origin.y) * invDir.y;
+	SimdFloat ty1 = (SimdFloat(node.boundsMax.y) - origin.y) * invDir.y;
+	SimdFloat tz0 = (SimdFloat(node.boundsMin.z) - origin.z) * invDir.z;
+	SimdFloat tz1 = (SimdFloat(node.boundsMax.z) - origin.z) * invDir.z;
+	tEnter = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), tMin));
+	SimdFloat tExit = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), tMax));
+	return CmpLe(tEnter, tExit);
+}
+
+static inline int LowestLane(const int mask)
+{
+	int lane = 0;
+	while (!(mask & (1 << lane)))
+		++lane;
+	return lane;
+}
+
+Bvh::Bvh()
+{
+	numBuildNodes = 0;
+	maxDepth = 0;
+	buildTimeMs = 0.0;
+}
+
+Bvh::~Bvh()
+{
+	nodes.clear();
+	triangles.clear();
+	triIds.clear();
+	subMeshTriOffsets.clear();
+}
+
+// Build the hierarchy over all submesh triangles of the mesh (object space).
+void Bvh::Build(TriangleMesh* mesh)
+{
+	CpuTimer timer;
+	nodes.clear();
+	triangles.clear();
+	triIds.clear();
+	subMeshTriOffsets.clear();
+	maxDepth = 0;
+	buildTimeMs = 0.0;
+
+	const vector<VertexPTN>& vertices = mesh->GetVertices();
+	const vector<SubMesh>& subMeshes = mesh->GetSubMeshes();
+	unsigned int numTris = 0;
+	for (unsigned int i = 0; i < subMeshes.size(); ++i)
+	{
+		subMeshTriOffsets.push_back(numTris);
+		numTris += static_cast<unsigned int>(subMeshes[i].vertexIndices.size() / 3);
+	}
+	if (numTris == 0)
+		return;
+
+	// Per-triangle bounds and the Moller-Trumbore form of each triangle.
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	vector<Triangle> sourceTris(numTris);
+	primMin.resize(numTris);
+	primMax.resize(numTris);
+	primCentroid.resize(numTris);
+	triIds.resize(numTris);
+	for (unsigned int s = 0; s < subMeshes.size(); ++s)
+	{
+		const vector<unsigned int>& indices = subMeshes[s].vertexIndices;
+		const unsigned int offset = subMeshTriOffsets[s];
+		pool->ParallelFor(0, static_cast<int>(indices.size() / 3), 4096, [&](int first, int last) {
+			for (int t = first; t < last; ++t)
+			{
+				const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+				const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+				const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+				const unsigned int id = offset + t;
+				sourceTris[id].v0 = p0;
+				sourceTris[id].e1 = p1 - p0;
+				sourceTris[id].e2 = p2 - p0;
+				primMin[id] = glm::min(p0, glm::min(p1, p2));
+				primMax[id] = glm::max(p0, glm::max(p1, p2));
+				primCentroid[id] = (primMin[id] + primMax[id]) * 0.5f;
+				triIds[id] = id;
+			}
+		});
+	}
+
+	buildNodes.resize(2 * static_cast<size_t>(numTris));
+	numBuildNodes = 1;
+	BuildRecursive(0, 0, numTris, 0);
+	Flatten();
+
+	// Store triangles in leaf order so a leaf reads one contiguous block.
+	triangles.resize(numTris);
+	pool->ParallelFor(0, static_cast<int>(numTris), 16384, [&](int first, int last) {
+		for (int i = first; i < last; ++i)
+			triangles[i] = sourceTris[triIds[i]];
+	});
+
+	buildNodes.clear();
+	buildNodes.shrink_to_fit();
+	primMin.clear();
+	primMin.shrink_to_fit();
+	primMax.clear();
+	primMax.shrink_to_fit();
+	primCentroid.clear();
+	primCentroid.shrink_to_fit();
+	buildTimeMs = timer.GetElapsedMs();
+}
+
+// Split the triIds range [begin, end) of a node with the binned SAH.
+void Bvh::BuildRecursive(const unsigned int nodeIndex, const unsigned int begin, const unsigned int end, const int depth)
+{
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	const unsigned int numPrims = end - begin;
+	BuildNode& node = buildNodes[nodeIndex];
+	node.begin = begin;
+	node.end = end;
+	node.left = BVH_INVALID_INDEX;
+	node.right = BVH_INVALID_INDEX;
+
+	// Node bounds and centroid bounds.
+	glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+	mutex boundsMutex;
+	pool->ParallelFor(begin, end, BVH_PARALLEL_BINNING, [&](int first, int last) {
+		glm::vec3 lbmin(FLT_MAX), lbmax(-FLT_MAX), lcmin(FLT_MAX), lcmax(-FLT_MAX);
+		for (int i = first; i < last; ++i)
+		{
+			unsigned int id = triIds[i];
+			lbmin = glm::min(lbmin, primMin[id]);
+			lbmax = glm::max(lbmax, primMax[id]);
+			lcmin = glm::min(lcmin, primCentroid[id]);
+			lcmax = glm::max(lcmax, primCentroid[id]);
+		}
+		lock_guard<mutex> lock(boundsMutex);
+		bmin = glm::min(bmin, lbmin);
+		bmax = glm::max(bmax, lbmax);
+		cmin = glm::min(cmin, lcmin);
+		cmax = glm::max(cmax, lcmax);
+	});
+	node.boundsMin = bmin;
+	node.boundsMax = bmax;
+
+	if (numPrims == 1 || depth >= BVH_MAX_DEPTH)
+	{
+		lock_guard<mutex> lock(depthMutex);
+		maxDepth = max(maxDepth, depth);
+		return;
+	}
+
+	// Bin the centroids on all three axes.
+	glm::vec3 extent = cmax - cmin;
+	glm::vec3 scale;
+	for (int a = 0; a < 3; ++a)
+		scale[a] = extent[a] > 1e-12f ? BVH_NUM_BINS / extent[a] : 0.0f;
+	BvhBin bins[3][BVH_NUM_BINS];
+	mutex binsMutex;
+	pool->ParallelFor(begin, end, BVH_PARALLEL_BINNING, [&](int first, int last) {
+		BvhBin localBins[3][BVH_NUM_BINS];
+		for (int i = first; i < last; ++i)
+		{
+			unsigned int id = triIds[i];
+			for (int a = 0; a < 3; ++a)
+			{
+				int b = min(BVH_NUM_BINS - 1, static_cast<int>((primCentroid[id][a] - cmin[a]) * scale[a]));
+				localBins[a][b].Grow(primMin[id], primMax[id]);
+				localBins[a][b].count++;
+			}
+		}
+		lock_guard<mutex> lock(binsMutex);
+		for (int a = 0; a < 3; ++a)
+			for (int b = 0; b < BVH_NUM_BINS; ++b)
+				bins[a][b].Merge(localBins[a][b]);
+	});
+
+	// Evaluate the SAH cost (traversal cost 1, intersection cost 1) of each bin boundary.
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int a = 0; a < 3; ++a)
+	{
+		if (scale[a] == 0.0f)
+			continue;
+		float rightArea[BVH_NUM_BINS];
+		unsigned int rightCount[BVH_NUM_BINS];
+		BvhBin acc;
+		for (int b = BVH_NUM_BINS - 1; b > 0; --b)
+		{
+			acc.Merge(bins[a][b]);
+			rightArea[b] = SurfaceArea(acc.boundsMin, acc.boundsMax);
+			rightCount[b] = acc.count;
+		}
+		acc = BvhBin();
+		for (int b = 0; b < BVH_NUM_BINS - 1; ++b)
+		{
+			acc.Merge(bins[a][b]);
+			if (acc.count == 0 || rightCount[b + 1] == 0)
+				continue;
+			float cost = acc.count * SurfaceArea(acc.boundsMin, acc.boundsMax) + rightCount[b + 1] * rightArea[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestSplit = b;
+			}
+		}
+	}
+	float parentArea = SurfaceArea(bmin, bmax);
+	float leafCost = static_cast<float>(numPrims);
+	float splitCost = 1.0f + (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+	if (numPrims <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || leafCost <= splitCost))
+	{
+		lock_guard<mutex> lock(depthMutex);
+		maxDepth = max(maxDepth, depth);
+		return;
+	}
+
+	// Partition; fall back to an even split when all centroids coincide.
+	unsigned int mid = begin + numPrims / 2;
+	if (bestAxis >= 0)
+	{
+		const float axisMin = cmin[bestAxis];
+		const float axisScale = scale[bestAxis];
+		vector<unsigned int>::iterator it = partition(triIds.begin() + begin, triIds.begin() + end, [&](unsigned int id) {
+			int b = min(BVH_NUM_BINS - 1, static_cast<int>((primCentroid[id][bestAxis] - axisMin) * axisScale));
+			return b <= bestSplit;
+		});
+		unsigned int split = static_cast<unsigned int>(it - triIds.begin());
+		if (split > begin && split < end)
+			mid = split;
+	}
+
+	unsigned int left = numBuildNodes.fetch_add(2);
+	node.left = left;
+	node.right = left + 1;
+	if (numPrims >= BVH_PARALLEL_SUBTREE)
+	{
+		pool->ParallelFor(0, 2, 1, [&](int first, int last) {
+			for (int c = first; c < last; ++c)
+			{
+				if (c == 0)
+					BuildRecursive(left, begin, mid, depth + 1);
+				else
+					BuildRecursive(left + 1, mid, end, depth + 1);
+			}
+		});
+	}
+	else
+	{
+		BuildRecursive(left, begin, mid, depth + 1);
+		BuildRecursive(left + 1, mid, end, depth + 1);
+	}
+}
+
+// Lay the build nodes out depth-first: the left child directly follows its parent.
+void Bvh::Flatten()
+{
+	nodes.clear();
+	nodes.reserve(numBuildNodes);
+	vector<pair<unsigned int, unsigned int>> stack;
+	stack.push_back(make_pair(0u, BVH_INVALID_INDEX));
+	while (!stack.empty())
+	{
+		unsigned int buildIndex = stack.back().first;
+		unsigned int parent = stack.back().second;
+		stack.pop_back();
+		const BuildNode& src = buildNodes[buildIndex];
+		unsigned int flatIndex = static_cast<unsigned int>(nodes.size());
+		if (parent != BVH_INVALID_INDEX)
+			nodes[parent].rightOrFirst = flatIndex;
+		BvhNode dst;
+		dst.boundsMin = src.boundsMin;
+		dst.boundsMax = src.boundsMax;
+		if (src.left == BVH_INVALID_INDEX)
+		{
+			dst.rightOrFirst = src.begin;
+			dst.numTriangles = src.end - src.begin;
+		}
+		else
+		{
+			dst.rightOrFirst = BVH_INVALID_INDEX;
+			dst.numTriangles = 0;
+			stack.push_back(make_pair(src.right, flatIndex));
+			stack.push_back(make_pair(src.left, BVH_INVALID_INDEX));
+		}
+		nodes.push_back(dst);
+	}
+}
+
+// Map a triangle index back to its submesh and the triangle within that submesh.
+void Bvh::GetSubMeshTriangle(const unsigned int triIndex, unsigned int& subMesh, unsigned int& subMeshTri) const
+{
+	vector<unsigned int>::const_iterator it = upper_bound(subMeshTriOffsets.begin(), subMeshTriOffsets.end(), triIndex);
+	subMesh = static_cast<unsigned int>(it - subMeshTriOffsets.begin()) - 1;
+	subMeshTri = triIndex - subMeshTriOffsets[subMesh];
+}
+
+// Moller-Trumbore ray/triangle test against (tMin, tMax).
+bool Bvh::IntersectTriangle(const unsigned int index, const Ray& ray, float& t, float& u, float& v) const
+{
+	const Triangle& tri = triangles[index];
+	glm::vec3 p = glm::cross(ray.direction, tri.e2);
+	float det = glm::dot(tri.e1, p);
+	if (fabs(det) < 1e-12f)
+		return false;
+	float invDet = 1.0f / det;
+	glm::vec3 s = ray.origin - tri.v0;
+	u = glm::dot(s, p) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+	glm::vec3 q = glm::cross(s, tri.e1);
+	v = glm::dot(ray.direction, q) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+	t = glm::dot(tri.e2, q) * invDet;
+	return t > ray.tMin && t < ray.tMax;
+}
+
+// Find the closest hit along the ray.
+bool Bvh::Intersect(const Ray& ray, RayHit& hit) const
+{
+	hit = RayHit();
+	if (nodes.empty())
+		return false;
+	Ray r = ray;
+	glm::vec3 invDir = 1.0f / r.direction;
+	if (IntersectBox(nodes[0], r.origin, invDir, r.tMin, r.tMax) == FLT_MAX)
+		return false;
+
+	unsigned int stack[BVH_STACK_SIZE];
+	float stackDist[BVH_STACK_SIZE];
+	int stackSize = 0;
+	unsigned int nodeIndex = 0;
+	while (true)
+	{
+		const BvhNode& node = nodes[nodeIndex];
+		if (node.numTriangles > 0)
+		{
+			float t, u, v;
+			for (unsigned int i = node.rightOrFirst; i < node.rightOrFirst + node.numTriangles; ++i)
+			{
+				if (IntersectTriangle(i, r, t, u, v))
+				{
+					r.tMax = t;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triIndex = triIds[i];
+				}
+			}
+		}
+		else
+		{
+			unsigned int nearChild = nodeIndex + 1;
+			unsigned int farChild = node.rightOrFirst;
+			float tNear = IntersectBox(nodes[nearChild], r.origin, invDir, r.tMin, r.tMax);
+			float tFar = IntersectBox(nodes[farChild], r.origin, invDir, r.tMin, r.tMax);
+			if (tFar < tNear)
+			{
+				swap(nearChild, farChild);
+				swap(tNear, tFar);
+			}
+			if (tNear != FLT_MAX)
+			{
+				if (tFar != FLT_MAX)
+				{
+					stack[stackSize] = farChild;
+					stackDist[stackSize++] = tFar;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+		// Pop the next node that is still closer than the current hit.
+		bool found = false;
+		while (stackSize > 0 && !found)
+		{
+			--stackSize;
+			if (stackDist[stackSize] < r.tMax)
+			{
+				nodeIndex = stack[stackSize];
+				found = true;
+			}
+		}
+		if (!found)
+			break;
+	}
+	return hit.GetHit();
+}
+
+// Return true as soon as any hit is found (shadow and occlusion rays).
+bool Bvh::Occluded(const Ray& ray) const
+{
+	if (nodes.empty())
+		return false;
+	glm::vec3 invDir = 1.0f / ray.direction;
+	unsigned int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BvhNode& node = nodes[stack[--stackSize]];
+		if (IntersectBox(node, ray.origin, invDir, ray.tMin, ray.tMax) == FLT_MAX)
+			continue;
+		if (node.numTriangles > 0)
+		{
+			float t, u, v;
+			for (unsigned int i = node.rightOrFirst; i < node.rightOrFirst + node.numTriangles; ++i)
+				if (IntersectTriangle(i, ray, t, u, v))
+					return true;
+		}
+		else
+		{
+			stack[stackSize++] = node.rightOrFirst;
+			stack[stackSize++] = static_cast<unsigned int>(&node - &nodes[0]) + 1;
+		}
+	}
+	return false;
+}
+
+// Find the closest hits of SIMD_WIDTH rays at once. The packet descends into a node
+// while any of its rays hits the node, which pays off for coherent (e.g. primary) rays.
+void Bvh::IntersectPacket(const Ray* rays, RayHit* hits) const
+{
+	float ox[SIMD_WIDTH], oy[SIMD_WIDTH], oz[SIMD_WIDTH];
+	float dx[SIMD_WIDTH], dy[SIMD_WIDTH], dz[SIMD_WIDTH];
+	float tmin[SIMD_WIDTH], tmax[SIMD_WIDTH];
+	unsigned int hitTri[SIMD_WIDTH];
+	for (int k = 0; k < SIMD_WIDTH; ++k)
+	{
+		ox[k] = rays[k].origin.x;
+		oy[k] = rays[k].origin.y;
+		oz[k] = rays[k].origin.z;
+		dx[k] = rays[k].direction.x;
+		dy[k] = rays[k].direction.y;
+		dz[k] = rays[k].direction.z;
+		tmin[k] = rays[k].tMin;
+		tmax[k] = rays[k].tMax;
+		hitTri[k] = BVH_INVALID_INDEX;
+		hits[k] = RayHit();
+	}
+	if (nodes.empty())
+		return;
+	SimdVec3 origin(SimdFloat::Load(ox), SimdFloat::Load(oy), SimdFloat::Load(oz));
+	SimdVec3 dir(SimdFloat::Load(dx), SimdFloat::Load(dy), SimdFloat::Load(dz));
+	SimdVec3 invDir(SimdFloat(1.0f) / dir.x, SimdFloat(1.0f) / dir.y, SimdFloat(1.0f) / dir.z);
+	SimdFloat tMin = SimdFloat::Load(tmin);
+	SimdFloat tMax = SimdFloat::Load(tmax);
+	SimdFloat hitU(0.0f), hitV(0.0f);
+
+	SimdFloat tEnter;
+	if (MoveMask(IntersectBoxPacket(nodes[0], origin, invDir, tMin, tMax, tEnter)) == 0)
+		return;
+	unsigned int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	unsigned int nodeIndex = 0;
+	while (true)
+	{
+		const BvhNode& node = nodes[nodeIndex];
+		if (node.numTriangles > 0)
+		{
+			for (unsigned int i = node.rightOrFirst; i < node.rightOrFirst + node.numTriangles; ++i)
+			{
+				const Triangle& tri = triangles[i];
+				SimdVec3 e1(tri.e1.x, tri.e1.y, tri.e1.z);
+				SimdVec3 e2(tri.e2.x, tri.e2.y, tri.e2.z);
+				SimdVec3 p = Cross(dir, e2);
+				SimdFloat det = Dot(e1, p);
+				SimdFloat invDet = SimdFloat(1.0f) / det;
+				SimdVec3 s = origin - SimdVec3(tri.v0.x, tri.v0.y, tri.v0.z);
+				SimdFloat u = Dot(s, p) * invDet;
+				SimdVec3 q = Cross(s, e1);
+				SimdFloat v = Dot(dir, q) * invDet;
+				SimdFloat t = Dot(e2, q) * invDet;
+				SimdFloat mask = CmpGe(Max(det, -det), SimdFloat(1e-12f)) & CmpGe(u, SimdFloat(0.0f))
+					& CmpGe(v, SimdFloat(0.0f)) & CmpLe(u + v, SimdFloat(1.0f))
+					& CmpGt(t, tMin) & CmpLt(t, tMax);
+				int laneMask = MoveMask(mask);
+				if (laneMask == 0)
+					continue;
+				tMax = Select(mask, t, tMax);
+				hitU = Select(mask, u, hitU);
+				hitV = Select(mask, v, hitV);
+				for (int k = 0; k < SIMD_WIDTH; ++k)
+					if (laneMask & (1 << k))
+						hitTri[k] = triIds[i];
+			}
+		}
+		else
+		{
+			unsigned int nearChild = nodeIndex + 1;
+			unsigned int farChild = node.rightOrFirst;
+			SimdFloat tNear, tFar;
+			int nearMask = MoveMask(IntersectBoxPacket(nodes[nearChild], origin, invDir, tMin, tMax, tNear));
+			int farMask = MoveMask(IntersectBoxPacket(nodes[farChild], origin, invDir, tMin, tMax, tFar));
+			if (nearMask != 0 && farMask != 0)
+			{
+				// Order the children by the first ray that hits both.
+				float nearDist[SIMD_WIDTH], farDist[SIMD_WIDTH];
+				tNear.Store(nearDist);
+				tFar.Store(farDist);
+				int lane = LowestLane((nearMask & farMask) ? (nearMask & farMask) : nearMask);
+				if (farDist[lane] < nearDist[lane])
+					swap(nearChild, farChild);
+				stack[stackSize++] = farChild;
+				nodeIndex = nearChild;
+				continue;
+			}
+			if (nearMask != 0 || farMask != 0)
+			{
+				nodeIndex = nearMask != 0 ? nearChild : farChild;
+				continue;
+			}
+		}
+		// Pop the next node that some ray can still hit before its current hit.
+		bool found = false;
+		while (stackSize > 0 && !found)
+		{
+			nodeIndex = stack[--stackSize];
+			found = MoveMask(IntersectBoxPacket(nodes[nodeIndex], origin, invDir, tMin, tMax, tEnter)) != 0;
+		}
+		if (!found)
+			break;
+	}
+
+	float t[SIMD_WIDTH], u[SIMD_WIDTH], v[SIMD_WIDTH];
+	tMax.Store(t);
+	hitU.Store(u);
+	hitV.Store(v);
+	for (int k = 0; k < SIMD_WIDTH; ++k)
+	{
+		if (hitTri[k] == BVH_INVALID_INDEX)
+			continue;
+		hits[k].t = t[k];
+		hits[k].u = u[k];
+		hits[k].v = v[k];
+		hits[k].triIndex = hitTri[k];
+	}
+}
+
+// Show BVH info.
+void Bvh::ShowInfo() const
+{
+	unsigned int numLeaves = 0;
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+		if (nodes[i].numTriangles > 0)
+			numLeaves++;
+	cout << "# Triangles: " << GetNumTriangles() << endl;
+	cout << "# BVH nodes: " << GetNumNodes() << " (" << numLeaves << " leaves, max depth " << maxDepth << ")" << endl;
+	cout << "BVH memory: " << (nodes.size() * sizeof(BvhNode) + triangles.size() * sizeof(Triangle)
+		+ triIds.size() * sizeof(unsigned int)) / 1024 << " KB" << endl;
+	cout << "BVH build time: " << buildTimeMs << " ms (" << ThreadPool::GetGlobal()->GetNumThreads() << " threads)" << endl;
+}
@@ -0,0 +1,131 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "headers.h"
+#include "trianglemesh.h"
+#include "threadpool.h"
+#include "simd.h"
+#include "timer.h"
+using namespace std;
+
+#define BVH_NUM_BINS 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_STACK_SIZE 64
+#define BVH_INVALID_INDEX 0xffffffffu
+
+
+// Ray Declarations.
+struct Ray
+{
+	Ray()
+	{
+		origin = glm::vec3(0.0f, 0.0f, 0.0f);
+		direction = glm::vec3(0.0f, 0.0f, -1.0f);
+		tMin = 0.0f;
+		tMax = FLT_MAX;
+	}
+	Ray(const glm::vec3 o, const glm::vec3 d, const float tmin = 0.0f, const float tmax = FLT_MAX)
+	{
+		origin = o;
+		direction = d;
+		tMin = tmin;
+		tMax = tmax;
+	}
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMin;
+	float tMax;
+};
+
+
+// RayHit Declarations (triIndex counts the triangles of all submeshes in order).
+struct RayHit
+{
+	RayHit()
+	{
+		t = FLT_MAX;
+		u = 0.0f;
+		v = 0.0f;
+		triIndex = BVH_INVALID_INDEX;
+	}
+	bool GetHit() const { return triIndex != BVH_INVALID_INDEX; }
+	float t;
+	float u;
+	float v;
+	unsigned int triIndex;
+};
+
+
+// BvhNode Declarations (32 bytes, depth-first order: the left child follows its parent).
+struct BvhNode
+{
+	glm::vec3 boundsMin;
+	unsigned int rightOrFirst; // Interior: index of the right child. Leaf: first triangle.
+	glm::vec3 boundsMax;
+	unsigned int numTriangles; // 0 for interior nodes.
+};
+
+
+// Bvh Declarations.
+// A bounding volume hierarchy over the triangles of all submeshes of a TriangleMesh,
+// in the mesh's object space. Built with a binned SAH builder that splits large nodes
+// and their binning across the thread pool, then flattened to a depth-first array.
+class Bvh
+{
+public:
+	// Bvh Public Methods.
+	Bvh();
+	~Bvh();
+
+	unsigned int GetNumNodes()     const { return static_cast<unsigned int>(nodes.size()); }
+	unsigned int GetNumTriangles() const { return static_cast<unsigned int>(triIds.size()); }
+	double GetBuildTimeMs() const { return buildTimeMs; }
+	glm::vec3 GetBoundsMin() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].boundsMin; }
+	glm::vec3 GetBoundsMax() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].boundsMax; }
+
+	void Build(TriangleMesh* mesh);
+	void GetSubMeshTriangle(const unsigned int triIndex, unsigned int& subMesh, unsigned int& subMeshTri) const;
+
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+	bool Occluded(const Ray& ray) const;
+	void IntersectPacket(const Ray* rays, RayHit* hits) const;
+	void ShowInfo() const;
+
+private:
+	// Bvh Private Declarations.
+	struct BuildNode
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		unsigned int left;
+		unsigned int right;
+		unsigned int begin;
+		unsigned int end;
+	};
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 e1;
+		glm::vec3 e2;
+	};
+	// Bvh Private Methods.
+	void BuildRecursive(const unsigned int nodeIndex, const unsigned int begin, const unsigned int end, const int depth);
+	void Flatten();
+	bool IntersectTriangle(const unsigned int index, const Ray& ray, float& t, float& u, float& v) const;
+	// Bvh Private Data.
+	vector<BvhNode> nodes;
+	vector<Triangle> triangles;
+	vector<unsigned int> triIds;
+	vector<unsigned int> subMeshTriOffsets;
+	// Build state.
+	vector<BuildNode> buildNodes;
+	atomic<unsigned int> numBuildNodes;
+	vector<glm::vec3> primMin;
+	vector<glm::vec3> primMax;
+	vector<glm::vec3> primCentroid;
+	int maxDepth;
+	mutex depthMutex;
+	double buildTimeMs;
+};
+
+#endif
@@ -47,6 +47,19 @@ void Camera::UpdateProjection(const float fovyInDegree, const float aspectRatio,
 	projMatrix = glm::perspective(glm::radians(fovyInDegree), aspectRatio, nearPlane, farPlane);
 }
 
+// Unproject a window position (pixels, origin at the top-left) to a world-space ray
+// from the near plane (direction normalized).
+void Camera::GetPickRay(const float x, const float y, const int width, const int height, glm::vec3& origin, glm::vec3& direction) const
+{
+	float ndcX = x / width * 2.0f - 1.0f;
+	float ndcY = 1.0f - y / height * 2.0f;
+	glm::mat4x4 invViewProj = glm::inverse(projMatrix * viewMatrix);
+	glm::vec4 pNear = invViewProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 pFar = invViewProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	origin = glm::vec3(pNear) / pNear.w;
+	direction = glm::normalize(glm::vec3(pFar) / pFar.w - origin);
+}
+
 void Camera::ProcessMouseInput(int button, int state, int x, int y)
 {
 	buttonStates = vector<bool>(5, false);
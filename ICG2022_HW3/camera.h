@@ -25,6 +25,7 @@ public:
 	void UpdateView();
 	void UpdateView(const glm::vec3 newPos, const glm::vec3 newTarget, const glm::vec3 up);
 	void UpdateProjection(const float fovyInDegree, const float aspectRatio, const float zNear, const float zFar);
+	void GetPickRay(const float x, const float y, const int width, const int height, glm::vec3& origin, glm::vec3& direction) const;
 
 	void ProcessMouseInput(int button, int state, int x, int y);
 	void ProcessMouseMotion(int x, int y);
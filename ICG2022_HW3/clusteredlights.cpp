@@ -0,0 +1,228 @@
+#include "clusteredlights.h"
+using namespace std;
+
+// Tiles [first, last] whose edges (at slopes -tanHalf ... tanHalf over numTiles) may touch
+// the interval center +- radius somewhere between the view depths za and zb.
+static bool GetTileRange(const float center, const float radius, const float za, const float zb,
+	const float tanHalf, const int numTiles, int& first, int& last)
+{
+	const float lo = center - radius;
+	const float hi = center + radius;
+	const float slopeMin = lo / ((lo >= 0.0f) ? zb : za);
+	const float slopeMax = hi / ((hi >= 0.0f) ? za : zb);
+	const float ndcMin = slopeMin / tanHalf;
+	const float ndcMax = slopeMax / tanHalf;
+	if (ndcMax < -1.0f || ndcMin > 1.0f)
+		return false;
+	first = glm::clamp(static_cast<int>(floor((ndcMin + 1.0f) * 0.5f * numTiles)), 0, numTiles - 1);
+	last = glm::clamp(static_cast<int>(floor((ndcMax + 1.0f) * 0.5f * numTiles)), 0, numTiles - 1);
+	return true;
+}
+
+ClusteredLights::ClusteredLights()
+{
+	tanHalfX = tanHalfY = 1.0f;
+	sliceNear = 0.1f;
+	sliceFar = 1.0f;
+	depthScale = 0.0f;
+	depthBias = 0.0f;
+	viewDir = glm::vec3(0.0f, 0.0f, -1.0f);
+	numIndices = 0;
+	numDropped = 0;
+	maxClusterLights = 0;
+	binTimeMs = 0.0;
+	maxBufferTexels = 65536;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxBufferTexels);
+	clusterLights.resize(GetNumClusters());
+
+	GLuint bufferObjs[2] = { 0, 0 };
+	GLuint textureObjs[2] = { 0, 0 };
+	glGenBuffers(2, bufferObjs);
+	glGenTextures(2, textureObjs);
+	lightBufferObj = bufferObjs[0];
+	clusterBufferObj = bufferObjs[1];
+	lightTextureObj = textureObjs[0];
+	clusterTextureObj = textureObjs[1];
+	// Every cluster starts empty.
+	clusterData.assign(2 * GetNumClusters(), 0);
+	UploadBuffer(lightBufferObj, lightTextureObj, GL_RGBA32F, nullptr, 0);
+	UploadBuffer(clusterBufferObj, clusterTextureObj, GL_R32UI, clusterData.data(), clusterData.size() * sizeof(unsigned int));
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	GLuint bufferObjs[2] = { lightBufferObj, clusterBufferObj };
+	GLuint textureObjs[2] = { lightTextureObj, clusterTextureObj };
+	glDeleteTextures(2, textureObjs);
+	glDeleteBuffers(2, bufferObjs);
+}
+
+void ClusteredLights::Update(const glm::mat4x4& viewMatrix, const glm::mat4x4& projMatrix)
+{
+	CpuTimer timer;
+	// Frustum of the projection (as built by glm::perspective).
+	tanHalfX = 1.0f / projMatrix[0][0];
+	tanHalfY = 1.0f / projMatrix[1][1];
+	const float zNear = projMatrix[3][2] / (projMatrix[2][2] - 1.0f);
+	const float zFar = projMatrix[3][2] / (projMatrix[2][2] + 1.0f);
+	viewDir = -glm::vec3(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2]);
+
+	// Pack the lights (a cos outer below -1 marks a point light) and bound them in view space.
+	const int numLights = GetNumLights();
+	lightData.resize(numLights * CLUSTER_LIGHT_TEXELS);
+	viewBounds.resize(numLights);
+	float maxDepth = zNear;
+	for (int i = 0; i < numLights; ++i)
+	{
+		const LocalLight& light = lights[i];
+		const float range = (light.range > 0.0f) ? light.range : ComputeRange(light.intensity);
+		const float cosOuter = light.isSpot ? light.cosOuter : -2.0f;
+		const float cosInner = light.isSpot ? max(light.cosInner, light.cosOuter + 1e-4f) : -1.0f;
+		lightData[CLUSTER_LIGHT_TEXELS * i + 0] = glm::vec4(light.position, range);
+		lightData[CLUSTER_LIGHT_TEXELS * i + 1] = glm::vec4(light.intensity, cosInner);
+		lightData[CLUSTER_LIGHT_TEXELS * i + 2] = glm::vec4(light.direction, cosOuter);
+
+		// A cone narrower than 90 degrees fits into a smaller sphere than its range.
+		glm::vec3 center = light.position;
+		float radius = range;
+		if (light.isSpot && light.cosOuter > 0.0f)
+		{
+			const float cosAngle = min(light.cosOuter, 1.0f);
+			if (cosAngle < 0.70710678f)
+			{
+				center += light.direction * (range * cosAngle);
+				radius = range * sqrt(1.0f - cosAngle * cosAngle);
+			}
+			else
+			{
+				radius = range / (2.0f * cosAngle);
+				center += light.direction * radius;
+			}
+		}
+		glm::vec3 viewCenter = glm::vec3(viewMatrix * glm::vec4(center, 1.0f));
+		viewBounds[i] = glm::vec4(viewCenter, radius);
+		maxDepth = max(maxDepth, -viewCenter.z + radius);
+	}
+
+	// The slices span the depth range the lights reach; fragments beyond it fall into
+	// the last slice, where the range test in the shader leaves them unlit.
+	sliceNear = zNear;
+	sliceFar = max(min(maxDepth, zFar), 2.0f * zNear);
+	depthScale = CLUSTER_GRID_Z / log(sliceFar / sliceNear);
+	depthBias = -log(sliceNear) * depthScale;
+	for (vector<unsigned int>& indices : clusterLights)
+		indices.clear();
+	ThreadPool::GetGlobal()->ParallelFor(0, CLUSTER_GRID_Z, 1, [this](int first, int last) {
+		for (int slice = first; slice < last; ++slice)
+			BinSlice(slice);
+	});
+
+	// Flatten the lists; past the texture buffer size limit, clusters keep their first lights.
+	const int numClusters = GetNumClusters();
+	size_t numTotal = 0;
+	for (const vector<unsigned int>& indices : clusterLights)
+		numTotal += indices.size();
+	const size_t capacity = static_cast<size_t>(max(0, maxBufferTexels - 2 * numClusters));
+	const size_t maxPerCluster = (numTotal > capacity) ? capacity / numClusters : numTotal;
+	clusterData.resize(2 * numClusters);
+	numIndices = 0;
+	numDropped = 0;
+	maxClusterLights = 0;
+	for (int c = 0; c < numClusters; ++c)
+	{
+		const size_t count = min(clusterLights[c].size(), maxPerCluster);
+		clusterData[2 * c + 0] = static_cast<unsigned int>(numIndices);
+		clusterData[2 * c + 1] = static_cast<unsigned int>(count);
+		numIndices += count;
+		numDropped += clusterLights[c].size() - count;
+		maxClusterLights = max(maxClusterLights, static_cast<unsigned int>(clusterLights[c].size()));
+	}
+	clusterData.resize(2 * numClusters + numIndices);
+	ThreadPool::GetGlobal()->ParallelFor(0, numClusters, 256, [this, numClusters](int first, int last) {
+		for (int c = first; c < last; ++c)
+			copy(clusterLights[c].begin(), clusterLights[c].begin() + clusterData[2 * c + 1],
+				clusterData.begin() + 2 * numClusters + clusterData[2 * c]);
+	});
+
+	UploadBuffer(lightBufferObj, lightTextureObj, GL_RGBA32F, lightData.data(), lightData.size() * sizeof(glm::vec4));
+	UploadBuffer(clusterBufferObj, clusterTextureObj, GL_R32UI, clusterData.data(), clusterData.size() * sizeof(unsigned int));
+	binTimeMs = timer.GetElapsedMs();
+}
+
+// Append the lights touching each cluster of a depth slice to its list.
+void ClusteredLights::BinSlice(const int slice)
+{
+	const float d0 = sliceNear * pow(sliceFar / sliceNear, static_cast<float>(slice) / CLUSTER_GRID_Z);
+	const float d1 = sliceNear * pow(sliceFar / sliceNear, static_cast<float>(slice + 1) / CLUSTER_GRID_Z);
+	const int numLights = GetNumLights();
+	for (int i = 0; i < numLights; ++i)
+	{
+		const glm::vec4& bounds = viewBounds[i];
+		const float depth = -bounds.z;
+		const float radius = bounds.w;
+		if (depth + radius < d0 || depth - radius > d1)
+			continue;
+		// Tiles of the bounding box of the sphere within the depth overlap.
+		const float za = max(d0, depth - radius);
+		const float zb = min(d1, depth + radius);
+		int x0, x1, y0, y1;
+		if (!GetTileRange(bounds.x, radius, za, zb, tanHalfX, CLUSTER_GRID_X, x0, x1)
+			|| !GetTileRange(bounds.y, radius, za, zb, tanHalfY, CLUSTER_GRID_Y, y0, y1))
+			continue;
+		// Sphere against the view-space bounding box of each cluster.
+		for (int ty = y0; ty <= y1; ++ty)
+		{
+			const float slopeY0 = (-1.0f + 2.0f * ty / CLUSTER_GRID_Y) * tanHalfY;
+			const float slopeY1 = (-1.0f + 2.0f * (ty + 1) / CLUSTER_GRID_Y) * tanHalfY;
+			const float minY = min(slopeY0 * d0, slopeY0 * d1);
+			const float maxY = max(slopeY1 * d0, slopeY1 * d1);
+			const float dy = max(max(minY - bounds.y, bounds.y - maxY), 0.0f);
+			const float dz = max(max(d0 - depth, depth - d1), 0.0f);
+			for (int tx = x0; tx <= x1; ++tx)
+			{
+				const float slopeX0 = (-1.0f + 2.0f * tx / CLUSTER_GRID_X) * tanHalfX;
+				const float slopeX1 = (-1.0f + 2.0f * (tx + 1) / CLUSTER_GRID_X) * tanHalfX;
+				const float minX = min(slopeX0 * d0, slopeX0 * d1);
+				const float maxX = max(slopeX1 * d0, slopeX1 * d1);
+				const float dx = max(max(minX - bounds.x, bounds.x - maxX), 0.0f);
+				if (dx * dx + dy * dy + dz * dz <= radius * radius)
+					clusterLights[(slice * CLUSTER_GRID_Y + ty) * CLUSTER_GRID_X + tx].push_back(static_cast<unsigned int>(i));
+			}
+		}
+	}
+}
+
+// Replace the data of a buffer (orphaning the old one) and attach it to its buffer texture.
+void ClusteredLights::UploadBuffer(GLuint bufferObj, GLuint textureObj, GLenum format, const void* data, const size_t numBytes)
+{
+	// An empty buffer texture is not complete, so keep at least one texel.
+	const size_t size = max(numBytes, sizeof(glm::vec4));
+	glBindBuffer(GL_TEXTURE_BUFFER, bufferObj);
+	glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	if (numBytes > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, numBytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, textureObj);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, bufferObj);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::Bind(GLenum lightUnit, GLenum clusterUnit)
+{
+	glActiveTexture(lightUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, lightTextureObj);
+	glActiveTexture(clusterUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterTextureObj);
+}
+
+void ClusteredLights::ShowInfo() const
+{
+	const int numClusters = GetNumClusters();
+	cout << "Clustered lights: " << GetNumLights() << " lights, " << CLUSTER_GRID_X << " x " << CLUSTER_GRID_Y << " x "
+		<< CLUSTER_GRID_Z << " clusters (depth " << sliceNear << " - " << sliceFar << "), avg "
+		<< static_cast<double>(numIndices) / numClusters << " / max " << maxClusterLights << " lights per cluster, binned in "
+		<< binTimeMs << " ms";
+	if (numDropped > 0)
+		cout << " (" << numDropped << " light indices over the texture buffer limit dropped)";
+	cout << endl;
+}
@@ -0,0 +1,127 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "timer.h"
+using namespace std;
+
+// View-space cluster grid: tiles across the viewport and exponential depth slices.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 16
+#define CLUSTER_GRID_Z 24
+// Texels per light in the light buffer (see phong_shading.fs).
+#define CLUSTER_LIGHT_TEXELS 3
+// A light without a range ends where its 1 / d^2 falloff drops below this.
+#define CLUSTER_LIGHT_CUTOFF (1.0f / 256.0f)
+
+
+// LocalLight Declarations (a point light, or a spot light if isSpot).
+struct LocalLight
+{
+	LocalLight()
+	{
+		position = glm::vec3(0.0f, 0.0f, 0.0f);
+		intensity = glm::vec3(1.0f, 1.0f, 1.0f);
+		direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		cosInner = cosOuter = -1.0f;
+		range = 0.0f;
+		isSpot = false;
+	}
+	// A range of 0 is computed from the intensity (see ClusteredLights::ComputeRange).
+	LocalLight(const glm::vec3 p, const glm::vec3 I, const float r = 0.0f)
+	{
+		position = p;
+		intensity = I;
+		direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		cosInner = cosOuter = -1.0f;
+		range = r;
+		isSpot = false;
+	}
+	LocalLight(const glm::vec3 p, const glm::vec3 I, const glm::vec3 D, const float cutoffDeg, const float totalWidthDeg,
+		const float r = 0.0f)
+	{
+		position = p;
+		intensity = I;
+		direction = glm::normalize(D);
+		cosInner = cos(glm::radians(cutoffDeg));
+		cosOuter = cos(glm::radians(totalWidthDeg));
+		range = r;
+		isSpot = true;
+	}
+	glm::vec3 position;
+	glm::vec3 intensity;
+	glm::vec3 direction;
+	float cosInner;
+	float cosOuter;
+	float range;
+	bool isSpot;
+};
+
+
+// ClusteredLights Declarations.
+// Point and spot lights for clustered forward shading. Update() uploads the lights into a
+// texture buffer and bins them into a grid of view-space clusters on the thread pool, one
+// depth slice per task: each light is bounded by a sphere (the cone of a spot light by a
+// tighter one), and tested against the clusters of the slices and tiles its bounds cover.
+// A second texture buffer holds the (offset, count) of every cluster followed by the light
+// indices, so a fragment only loops over the lights of its cluster. Texture buffers are
+// core in GL 3.1, so this needs nothing beyond the GL 3.3 the shaders are written for.
+class ClusteredLights
+{
+public:
+	// ClusteredLights Public Methods.
+	ClusteredLights();
+	~ClusteredLights();
+
+	vector<LocalLight>& GetLights() { return lights; }
+	int GetNumLights() const { return static_cast<int>(lights.size()); }
+	int GetNumClusters() const { return CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z; }
+	size_t GetNumIndices() const { return numIndices; }
+	unsigned int GetMaxClusterLights() const { return maxClusterLights; }
+	double GetBinTimeMs() const { return binTimeMs; }
+	// The slice of a fragment at view depth z is log(z) * depthScale + depthBias.
+	float GetDepthScale() const { return depthScale; }
+	float GetDepthBias() const { return depthBias; }
+	glm::vec3 GetViewDir() const { return viewDir; }
+
+	// Bin the lights for a camera with a symmetric perspective projection.
+	void Update(const glm::mat4x4& viewMatrix, const glm::mat4x4& projMatrix);
+	void Bind(GLenum lightUnit, GLenum clusterUnit);
+	void ShowInfo() const;
+
+	static float ComputeRange(const glm::vec3& intensity)
+	{
+		return sqrt(max(max(intensity.r, intensity.g), intensity.b) / CLUSTER_LIGHT_CUTOFF);
+	}
+
+private:
+	// ClusteredLights Private Methods.
+	void BinSlice(const int slice);
+	void UploadBuffer(GLuint bufferObj, GLuint textureObj, GLenum format, const void* data, const size_t numBytes);
+	// ClusteredLights Private Data.
+	vector<LocalLight> lights;
+	vector<glm::vec4> lightData;
+	vector<glm::vec4> viewBounds;            // View-space bounding sphere (center, radius) per light.
+	vector<vector<unsigned int>> clusterLights;
+	vector<unsigned int> clusterData;        // (offset, count) per cluster, then the light indices.
+	float tanHalfX;
+	float tanHalfY;
+	float sliceNear;
+	float sliceFar;
+	float depthScale;
+	float depthBias;
+	glm::vec3 viewDir;
+	GLuint lightBufferObj;
+	GLuint lightTextureObj;
+	GLuint clusterBufferObj;
+	GLuint clusterTextureObj;
+	GLint maxBufferTexels;
+	// Statistics.
+	size_t numIndices;
+	size_t numDropped;
+	unsigned int maxClusterLights;
+	double binTimeMs;
+};
+
+#endif
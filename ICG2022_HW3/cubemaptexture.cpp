@@ -0,0 +1,227 @@
+#include "cubemaptexture.h"
+using namespace std;
+
+CubemapTexture::CubemapTexture()
+{
+	textureObj = 0;
+	faceSize = 0;
+	numLevels = 0;
+	fromCache = false;
+	loadTimeMs = 0.0;
+	convertTimeMs = 0.0;
+}
+
+CubemapTexture::~CubemapTexture()
+{
+	if (textureObj != 0)
+		glDeleteTextures(1, &textureObj);
+}
+
+// Read the faces from the texture cache, or decode, convert and cache the panorama.
+bool CubemapTexture::Create(const string& panoramaPath, const int size, const MipFilter mipFilter)
+{
+	if (textureObj != 0)
+		return false;
+	CpuTimer loadTimer;
+	filePath = panoramaPath;
+	ifstream file(filePath, ios::binary);
+	if (!file)
+	{
+		cerr << "[ERROR] Failed to load skybox panorama: " << filePath << endl;
+		return false;
+	}
+	vector<unsigned char> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	file.close();
+	stringstream settings;
+	settings << "cube" << (size > 0 ? to_string(size) : "auto") << "_" << MipmapBuilder::GetFilterName(mipFilter)
+		<< "_c" << CUBEMAP_CONVERTER_VERSION;
+	string cachePath = TextureCache::GetCachePath(TextureCache::HashBytes(bytes), settings.str());
+
+	vector<vector<cv::Mat>> faces;
+	fromCache = TextureCache::LoadCubemap(cachePath, faces);
+	if (!fromCache)
+	{
+		cv::Mat panorama = cv::imdecode(bytes, cv::IMREAD_COLOR);
+		if (panorama.empty())
+		{
+			cerr << "[ERROR] Failed to load skybox panorama: " << filePath << endl;
+			return false;
+		}
+		cv::cvtColor(panorama, panorama, cv::COLOR_BGR2BGRA);
+		int targetSize = size;
+		if (targetSize <= 0)
+		{
+			targetSize = 1;
+			while (targetSize * 2 <= panorama.cols / 4)
+				targetSize *= 2;
+		}
+		// Bilinear taps only cover the panorama if it is not much finer than the faces.
+		if (panorama.cols > 8 * targetSize)
+			cv::resize(panorama, panorama, cv::Size(4 * targetSize, max(1, panorama.rows * 4 * targetSize / panorama.cols)),
+				0.0, 0.0, cv::INTER_AREA);
+
+		CpuTimer convertTimer;
+		vector<cv::Mat> baseFaces;
+		ConvertPanorama(panorama, targetSize, baseFaces);
+		convertTimeMs = convertTimer.GetElapsedMs();
+		MipmapBuilder builder(mipFilter, true);
+		faces.assign(6, vector<cv::Mat>());
+		for (int face = 0; face < 6; ++face)
+			builder.Build(baseFaces[face], faces[face]);
+		TextureCache::SaveCubemap(cachePath, faces);
+	}
+	Upload(faces);
+	loadTimeMs = loadTimer.GetElapsedMs();
+	return true;
+}
+
+bool CubemapTexture::Create(const vector<vector<cv::Mat>>& faces)
+{
+	if (textureObj != 0 || faces.size() != 6 || faces[0].empty())
+		return false;
+	Upload(faces);
+	return true;
+}
+
+// Upload all faces and levels into an immutable RGBA8 cubemap.
+void CubemapTexture::Upload(const vector<vector<cv::Mat>>& faces)
+{
+	faceSize = faces[0][0].cols;
+	numLevels = static_cast<int>(faces[0].size());
+	glGenTextures(1, &textureObj);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureObj);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, numLevels, GL_RGBA8, faceSize, faceSize);
+	else
+	{
+		for (int face = 0; face < 6; ++face)
+			for (int level = 0; level < numLevels; ++level)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA8, max(1, faceSize >> level),
+					max(1, faceSize >> level), 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	for (int face = 0; face < 6; ++face)
+	{
+		for (int level = 0; level < numLevels; ++level)
+		{
+			const cv::Mat& image = faces[face][level];
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, image.cols, image.rows,
+				GL_BGRA, GL_UNSIGNED_BYTE, image.ptr());
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void CubemapTexture::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureObj);
+}
+
+// GPU memory of the six faces including their mip chains.
+size_t CubemapTexture::GetGpuBytes() const
+{
+	size_t numBytes = 0;
+	for (int level = 0; level < numLevels; ++level)
+		numBytes += static_cast<size_t>(max(1, faceSize >> level)) * max(1, faceSize >> level) * 4;
+	return numBytes * 6;
+}
+
+void CubemapTexture::ShowInfo()
+{
+	stringstream ss;
+	ss << fixed << setprecision(1);
+	ss << "Cubemap " << filePath << ": 6 x " << faceSize << "x" << faceSize << ", " << numLevels << " levels, "
+		<< GetGpuBytes() / 1024.0 / 1024.0 << " MB GPU" << endl;
+	if (fromCache)
+		ss << "  Loaded from the texture cache in " << loadTimeMs << " ms" << endl;
+	else
+		ss << "  Converted in " << convertTimeMs << " ms, loaded in " << loadTimeMs << " ms (cached for the next load)" << endl;
+	cout << ss.str();
+}
+
+// Resample the panorama into the six faces. For the face texel (i, j) with a = 2s - 1 and
+// b = 2t - 1 the direction follows the GL cubemap face table; its longitude and latitude
+// give the panorama position, like the texture coordinates of the sphere skybox.
+void CubemapTexture::ConvertPanorama(const cv::Mat& panorama, const int size, vector<cv::Mat>& faces)
+{
+	faces.assign(6, cv::Mat());
+	for (int face = 0; face < 6; ++face)
+		faces[face].create(size, size, CV_8UC4);
+	const int width = panorama.cols;
+	const int height = panorama.rows;
+	const float pi = glm::pi<float>();
+
+	ThreadPool::GetGlobal()->ParallelFor(0, 6 * size, 16, [&](int first, int last) {
+		const int paddedSize = (size + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+		vector<float> px(paddedSize), py(paddedSize);
+		float taps[4][4][SIMD_WIDTH]; // [channel][tap][lane]
+		float weightX[SIMD_WIDTH], weightY[SIMD_WIDTH], result[4][SIMD_WIDTH];
+		for (int row = first; row < last; ++row)
+		{
+			const int face = row / size;
+			const int j = row % size;
+			// Panorama coordinates of the row's texel centers.
+			const SimdFloat b = SimdFloat(2.0f * (j + 0.5f) / size - 1.0f);
+			for (int i = 0; i < size; i += SIMD_WIDTH)
+			{
+				const SimdFloat a = (SimdFloat(static_cast<float>(i) + 0.5f) + SimdFloat::LaneOffsets()) * SimdFloat(2.0f / size) - SimdFloat(1.0f);
+				const SimdFloat one(1.0f);
+				SimdVec3 dir;
+				switch (face)
+				{
+				case 0: dir = SimdVec3(one, -b, -a); break;
+				case 1: dir = SimdVec3(-one, -b, a); break;
+				case 2: dir = SimdVec3(a, one, b); break;
+				case 3: dir = SimdVec3(a, -one, -b); break;
+				case 4: dir = SimdVec3(a, -b, one); break;
+				default: dir = SimdVec3(-a, -b, -one); break;
+				}
+				SimdFloat phi = Atan2(dir.z, dir.x);
+				phi = Select(CmpLt(phi, SimdFloat(0.0f)), phi + SimdFloat(2.0f * pi), phi);
+				const SimdFloat theta = Atan2(dir.y, Sqrt(dir.x * dir.x + dir.z * dir.z));
+				(phi * SimdFloat(width / (2.0f * pi)) - SimdFloat(0.5f)).Store(&px[i]);
+				((SimdFloat(0.5f) - theta * SimdFloat(1.0f / pi)) * SimdFloat(static_cast<float>(height)) - SimdFloat(0.5f)).Store(&py[i]);
+			}
+
+			// Gather the four taps per lane, then blend all channels SIMD_WIDTH texels at a time.
+			unsigned char* dst = faces[face].ptr<unsigned char>(j);
+			for (int i = 0; i < size; i += SIMD_WIDTH)
+			{
+				for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+				{
+					const float x = px[i + lane], y = py[i + lane];
+					const int x0 = static_cast<int>(floor(x)), y0 = static_cast<int>(floor(y));
+					weightX[lane] = x - x0;
+					weightY[lane] = y - y0;
+					const int xa = ((x0 % width) + width) % width, xb = (xa + 1) % width;
+					const int ya = min(max(y0, 0), height - 1), yb = min(max(y0 + 1, 0), height - 1);
+					const unsigned char* texels[4] = {
+						panorama.ptr<unsigned char>(ya) + xa * 4, panorama.ptr<unsigned char>(ya) + xb * 4,
+						panorama.ptr<unsigned char>(yb) + xa * 4, panorama.ptr<unsigned char>(yb) + xb * 4 };
+					for (int tap = 0; tap < 4; ++tap)
+						for (int c = 0; c < 4; ++c)
+							taps[c][tap][lane] = texels[tap][c];
+				}
+				const SimdFloat wx = SimdFloat::Load(weightX), wy = SimdFloat::Load(weightY);
+				for (int c = 0; c < 4; ++c)
+				{
+					const SimdFloat t00 = SimdFloat::Load(taps[c][0]), t10 = SimdFloat::Load(taps[c][1]);
+					const SimdFloat t01 = SimdFloat::Load(taps[c][2]), t11 = SimdFloat::Load(taps[c][3]);
+					const SimdFloat top = t00 + (t10 - t00) * wx;
+					const SimdFloat bottom = t01 + (t11 - t01) * wx;
+					Clamp(top + (bottom - top) * wy + SimdFloat(0.5f), SimdFloat(0.0f), SimdFloat(255.0f)).Store(result[c]);
+				}
+				const int numLanes = min(SIMD_WIDTH, size - i);
+				for (int lane = 0; lane < numLanes; ++lane)
+					for (int c = 0; c < 4; ++c)
+						dst[(i + lane) * 4 + c] = static_cast<unsigned char>(result[c][lane]);
+			}
+		}
+	});
+}
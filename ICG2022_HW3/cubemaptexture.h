@@ -0,0 +1,60 @@
+#ifndef CUBEMAP_TEXTURE_H
+#define CUBEMAP_TEXTURE_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "simd.h"
+#include "timer.h"
+#include "mipmapbuilder.h"
+#include "texturecache.h"
+using namespace std;
+
+// Bump when the conversion changes so stale cache entries are rebuilt.
+#define CUBEMAP_CONVERTER_VERSION 1
+
+
+// CubemapTexture Declarations.
+// A GL cubemap converted from an equirectangular panorama at load time. Face texels are
+// mapped to directions and then to panorama coordinates SIMD_WIDTH at a time, sampled
+// bilinearly (wrapping horizontally), and the rows of all six faces are spread over the
+// thread pool. The faces get CPU-built mip chains and the result is kept in the texture
+// cache, so later loads only read the faces back. The panorama is laid out like the
+// sphere skybox: u = 0 along +X turning towards +Z, the top row looks up (+Y).
+class CubemapTexture
+{
+public:
+	// CubemapTexture Public Methods.
+	CubemapTexture();
+	~CubemapTexture();
+
+	int GetFaceSize() const { return faceSize; }
+	int GetNumLevels() const { return numLevels; }
+	bool GetFromCache() const { return fromCache; }
+	double GetLoadTimeMs() const { return loadTimeMs; }
+	size_t GetGpuBytes() const;
+
+	// faceSize 0 picks a quarter of the panorama width (rounded down to a power of two).
+	bool Create(const string& panoramaPath, const int size = 0, const MipFilter mipFilter = MIP_FILTER_BOX);
+	// Upload prebuilt BGRA faces, faces[face][level] with a full mip chain.
+	bool Create(const vector<vector<cv::Mat>>& faces);
+	void Bind(GLenum textureUnit);
+	void ShowInfo();
+
+	// The panorama is an 8-bit BGRA image, top row first. Faces are BGRA in GL face order
+	// (+X, -X, +Y, -Y, +Z, -Z) with row 0 at t = 0, as uploaded.
+	static void ConvertPanorama(const cv::Mat& panorama, const int size, vector<cv::Mat>& faces);
+
+private:
+	// CubemapTexture Private Methods.
+	void Upload(const vector<vector<cv::Mat>>& faces);
+	// CubemapTexture Private Data.
+	string filePath;
+	GLuint textureObj;
+	int faceSize;
+	int numLevels;
+	bool fromCache;
+	double loadTimeMs;
+	double convertTimeMs;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "debugdraw.h"
+using namespace std;
+
+DebugDraw::DebugDraw(const int maxVertices)
+{
+	maxFrameVertices = maxVertices;
+	numDropped = 0;
+	numDroppedLastFrame = 0;
+	glGenBuffers(1, &vboId);
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPC) * maxFrameVertices, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+DebugDraw::~DebugDraw()
+{
+	glDeleteBuffers(1, &vboId);
+}
+
+// Whether a primitive of numVertices fits into the budget of the frame.
+bool DebugDraw::Reserve(const int numVertices)
+{
+	if (static_cast<int>(points.size() + lines.size()) + numVertices <= maxFrameVertices)
+		return true;
+	numDropped++;
+	return false;
+}
+
+void DebugDraw::AddPoint(const glm::vec3& p, const glm::vec3& color)
+{
+	if (Reserve(1))
+		points.push_back(VertexPC(p, color));
+}
+
+void DebugDraw::AddLine(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color)
+{
+	if (!Reserve(2))
+		return;
+	lines.push_back(VertexPC(a, color));
+	lines.push_back(VertexPC(b, color));
+}
+
+void DebugDraw::AddBox(const glm::vec3& minCorner, const glm::vec3& maxCorner, const glm::mat4x4& worldMatrix, const glm::vec3& color)
+{
+	if (!Reserve(24))
+		return;
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner = glm::vec3((i & 1) ? maxCorner.x : minCorner.x, (i & 2) ? maxCorner.y : minCorner.y,
+			(i & 4) ? maxCorner.z : minCorner.z);
+		corners[i] = glm::vec3(worldMatrix * glm::vec4(corner, 1.0f));
+	}
+	// Corners that differ in one bit share an edge.
+	for (int i = 0; i < 8; ++i)
+	{
+		for (int bit = 1; bit < 8; bit <<= 1)
+		{
+			if ((i & bit) != 0)
+				continue;
+			lines.push_back(VertexPC(corners[i], color));
+			lines.push_back(VertexPC(corners[i | bit], color));
+		}
+	}
+}
+
+void DebugDraw::AddSphere(const glm::vec3& center, const float radius, const glm::vec3& color)
+{
+	if (!Reserve(3 * 2 * DEBUG_DRAW_CIRCLE_SEGMENTS))
+		return;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		glm::vec3 u = glm::vec3(0.0f, 0.0f, 0.0f);
+		glm::vec3 v = glm::vec3(0.0f, 0.0f, 0.0f);
+		u[(axis + 1) % 3] = radius;
+		v[(axis + 2) % 3] = radius;
+		glm::vec3 prev = center + u;
+		for (int s = 1; s <= DEBUG_DRAW_CIRCLE_SEGMENTS; ++s)
+		{
+			const float angle = 2.0f * glm::pi<float>() * s / DEBUG_DRAW_CIRCLE_SEGMENTS;
+			glm::vec3 next = center + u * cos(angle) + v * sin(angle);
+			lines.push_back(VertexPC(prev, color));
+			lines.push_back(VertexPC(next, color));
+			prev = next;
+		}
+	}
+}
+
+void DebugDraw::Flush(const glm::mat4x4& viewProjMatrix, ShaderProg* shader, const float pointSize)
+{
+	const GLsizei numPoints = static_cast<GLsizei>(points.size());
+	const GLsizei numLineVertices = static_cast<GLsizei>(lines.size());
+	if (numPoints + numLineVertices > 0)
+	{
+		// Orphan the buffer of the last frame, then points followed by lines.
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPC) * maxFrameVertices, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(VertexPC) * numPoints, points.data());
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(VertexPC) * numPoints, sizeof(VertexPC) * numLineVertices, lines.data());
+
+		shader->Bind();
+		glUniformMatrix4fv(shader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(viewProjMatrix));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPC), (const GLvoid*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPC), (const GLvoid*)offsetof(VertexPC, color));
+		if (numPoints > 0)
+		{
+			glPointSize(pointSize);
+			glDrawArrays(GL_POINTS, 0, numPoints);
+			glPointSize(1.0f);
+		}
+		if (numLineVertices > 0)
+			glDrawArrays(GL_LINES, numPoints, numLineVertices);
+		glDisableVertexAttribArray(0);
+		glDisableVertexAttribArray(1);
+		shader->UnBind();
+	}
+	points.clear();
+	lines.clear();
+	if (numDropped > 0 && numDroppedLastFrame == 0)
+		cerr << "[ERROR] Debug draw budget of " << maxFrameVertices << " vertices exceeded: " << numDropped << " primitives dropped" << endl;
+	numDroppedLastFrame = numDropped;
+	numDropped = 0;
+}
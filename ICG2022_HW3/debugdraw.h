@@ -0,0 +1,67 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include "headers.h"
+#include "shaderprog.h"
+using namespace std;
+
+// Segments of a circle of AddSphere().
+#define DEBUG_DRAW_CIRCLE_SEGMENTS 24
+
+
+// VertexPC Declarations.
+struct VertexPC
+{
+	VertexPC()
+	{
+		position = glm::vec3(0.0f, 0.0f, 0.0f);
+		color = glm::vec3(1.0f, 1.0f, 1.0f);
+	}
+	VertexPC(const glm::vec3 p, const glm::vec3 c)
+	{
+		position = p;
+		color = c;
+	}
+	glm::vec3 position;
+	glm::vec3 color;
+};
+
+
+// DebugDraw Declarations.
+// Immediate-mode gizmos: points and lines in world space are collected during the frame and
+// Flush() draws them with one dynamic vertex buffer, one draw call per primitive type. Each
+// frame holds at most maxVertices vertices; primitives past the budget are dropped and
+// counted rather than growing the buffer.
+class DebugDraw
+{
+public:
+	// DebugDraw Public Methods.
+	DebugDraw(const int maxVertices);
+	~DebugDraw();
+
+	int GetMaxVertices() const { return maxFrameVertices; }
+	// Primitives dropped from the last flushed frame.
+	int GetNumDropped() const { return numDroppedLastFrame; }
+
+	void AddPoint(const glm::vec3& p, const glm::vec3& color);
+	void AddLine(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color);
+	// The edges of a box, transformed by a world matrix.
+	void AddBox(const glm::vec3& minCorner, const glm::vec3& maxCorner, const glm::mat4x4& worldMatrix, const glm::vec3& color);
+	// Three great circles.
+	void AddSphere(const glm::vec3& center, const float radius, const glm::vec3& color);
+	// Draw and clear everything added since the last flush.
+	void Flush(const glm::mat4x4& viewProjMatrix, ShaderProg* shader, const float pointSize);
+
+private:
+	// DebugDraw Private Methods.
+	bool Reserve(const int numVertices);
+	// DebugDraw Private Data.
+	int maxFrameVertices;
+	vector<VertexPC> points;
+	vector<VertexPC> lines;
+	GLuint vboId;
+	int numDropped;
+	int numDroppedLastFrame;
+};
+
+#endif
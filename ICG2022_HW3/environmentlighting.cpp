@@ -0,0 +1,319 @@
+#include "environmentlighting.h"
+using namespace std;
+
+EnvironmentLighting::EnvironmentLighting()
+{
+	for (int i = 0; i < 9; ++i)
+		irradianceSH[i] = glm::vec3(0.0f);
+	fromCache = false;
+	loadTimeMs = 0.0;
+	projectTimeMs = 0.0;
+	prefilterTimeMs = 0.0;
+}
+
+EnvironmentLighting::~EnvironmentLighting()
+{}
+
+// Read the precomputed lighting from the texture cache, or compute and cache it.
+bool EnvironmentLighting::Create(const string& panoramaPath)
+{
+	CpuTimer loadTimer;
+	filePath = panoramaPath;
+	ifstream file(filePath, ios::binary);
+	if (!file)
+	{
+		cerr << "[ERROR] Failed to load environment panorama: " << filePath << endl;
+		return false;
+	}
+	vector<unsigned char> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	file.close();
+	stringstream settings;
+	settings << "ibl" << ENVIRONMENT_SPECULAR_SIZE << "_e" << ENVIRONMENT_LIGHTING_VERSION;
+	string cachePath = TextureCache::GetCachePath(TextureCache::HashBytes(bytes), settings.str());
+
+	vector<vector<cv::Mat>> faces;
+	vector<float> coeffs;
+	fromCache = TextureCache::LoadCubemap(cachePath, faces, &coeffs) && coeffs.size() == 27;
+	if (fromCache)
+	{
+		for (int i = 0; i < 9; ++i)
+			irradianceSH[i] = glm::vec3(coeffs[i * 3], coeffs[i * 3 + 1], coeffs[i * 3 + 2]);
+	}
+	else
+	{
+		cv::Mat panorama = cv::imdecode(bytes, cv::IMREAD_COLOR);
+		if (panorama.empty())
+		{
+			cerr << "[ERROR] Failed to load environment panorama: " << filePath << endl;
+			return false;
+		}
+		cv::cvtColor(panorama, panorama, cv::COLOR_BGR2BGRA);
+
+		CpuTimer projectTimer;
+		ProjectSH9(panorama, irradianceSH);
+		projectTimeMs = projectTimer.GetElapsedMs();
+
+		CpuTimer prefilterTimer;
+		if (panorama.cols > 8 * ENVIRONMENT_SOURCE_SIZE)
+			cv::resize(panorama, panorama, cv::Size(4 * ENVIRONMENT_SOURCE_SIZE, max(1, panorama.rows * 4 * ENVIRONMENT_SOURCE_SIZE / panorama.cols)),
+				0.0, 0.0, cv::INTER_AREA);
+		vector<cv::Mat> baseFaces;
+		CubemapTexture::ConvertPanorama(panorama, ENVIRONMENT_SOURCE_SIZE, baseFaces);
+		vector<vector<cv::Mat>> source(6);
+		MipmapBuilder builder(MIP_FILTER_BOX, false);
+		for (int face = 0; face < 6; ++face)
+			builder.Build(baseFaces[face], source[face]);
+		PrefilterSpecular(source, ENVIRONMENT_SPECULAR_SIZE, faces);
+		prefilterTimeMs = prefilterTimer.GetElapsedMs();
+
+		for (int i = 0; i < 9; ++i)
+			for (int c = 0; c < 3; ++c)
+				coeffs.push_back(irradianceSH[i][c]);
+		TextureCache::SaveCubemap(cachePath, faces, &coeffs);
+	}
+	specular.Create(faces);
+	loadTimeMs = loadTimer.GetElapsedMs();
+	return true;
+}
+
+void EnvironmentLighting::ShowInfo()
+{
+	stringstream ss;
+	ss << fixed << setprecision(1);
+	ss << "Environment lighting " << filePath << ": SH9 irradiance, " << specular.GetFaceSize() << "x"
+		<< specular.GetFaceSize() << " prefiltered specular cubemap (" << specular.GetNumLevels() << " levels)" << endl;
+	if (fromCache)
+		ss << "  Loaded from the texture cache in " << loadTimeMs << " ms" << endl;
+	else
+		ss << "  SH projection " << projectTimeMs << " ms, specular prefilter " << prefilterTimeMs << " ms, total "
+			<< loadTimeMs << " ms (cached for the next load)" << endl;
+	cout << ss.str();
+}
+
+// Integrate radiance * Y_lm over the sphere, texel by texel with the solid angle of the
+// texel, then apply the clamped cosine (A0 = pi, A1 = 2 pi / 3, A2 = pi / 4) and divide
+// by pi, so that Kd * irradiance is the diffuse reflection. The basis constants are folded
+// into the coefficients: E / pi = c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1)
+// + c7 xz + c8 (x^2 - y^2).
+void EnvironmentLighting::ProjectSH9(const cv::Mat& panorama, glm::vec3 coeffs[9])
+{
+	const int width = panorama.cols;
+	const int height = panorama.rows;
+	const int paddedWidth = (width + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	const float pi = glm::pi<float>();
+	// Longitude of the columns, as in CubemapTexture::ConvertPanorama().
+	vector<float> cosPhi(paddedWidth, 0.0f), sinPhi(paddedWidth, 0.0f);
+	for (int x = 0; x < width; ++x)
+	{
+		cosPhi[x] = cos((x + 0.5f) * 2.0f * pi / width);
+		sinPhi[x] = sin((x + 0.5f) * 2.0f * pi / width);
+	}
+	vector<float> rowSums(static_cast<size_t>(height) * 27, 0.0f);
+
+	ThreadPool::GetGlobal()->ParallelFor(0, height, 8, [&](int first, int last) {
+		// Padding lanes have zero radiance.
+		vector<float> channels[3] = { vector<float>(paddedWidth, 0.0f), vector<float>(paddedWidth, 0.0f), vector<float>(paddedWidth, 0.0f) };
+		float lanes[SIMD_WIDTH];
+		for (int y = first; y < last; ++y)
+		{
+			const unsigned char* src = panorama.ptr<unsigned char>(y);
+			for (int x = 0; x < width; ++x)
+				for (int c = 0; c < 3; ++c)
+					channels[c][x] = src[x * 4 + 2 - c];
+			const float latitude = 0.5f * pi - (y + 0.5f) * pi / height;
+			const SimdFloat cosLat(cos(latitude));
+			const SimdFloat dy(sin(latitude));
+			SimdFloat sums[9][3];
+			for (int x = 0; x < paddedWidth; x += SIMD_WIDTH)
+			{
+				const SimdFloat dx = cosLat * SimdFloat::Load(&cosPhi[x]);
+				const SimdFloat dz = cosLat * SimdFloat::Load(&sinPhi[x]);
+				const SimdFloat basis[9] = {
+					SimdFloat(0.282095f), SimdFloat(0.488603f) * dy, SimdFloat(0.488603f) * dz, SimdFloat(0.488603f) * dx,
+					SimdFloat(1.092548f) * dx * dy, SimdFloat(1.092548f) * dy * dz, SimdFloat(0.315392f) * (SimdFloat(3.0f) * dz * dz - SimdFloat(1.0f)),
+					SimdFloat(1.092548f) * dx * dz, SimdFloat(0.546274f) * (dx * dx - dy * dy)
+				};
+				const SimdFloat color[3] = { SimdFloat::Load(&channels[0][x]), SimdFloat::Load(&channels[1][x]), SimdFloat::Load(&channels[2][x]) };
+				for (int i = 0; i < 9; ++i)
+					for (int c = 0; c < 3; ++c)
+						sums[i][c] = sums[i][c] + basis[i] * color[c];
+			}
+			// Solid angle of a texel of this row, and 8-bit to [0, 1].
+			const float weight = (2.0f * pi / width) * (pi / height) * cos(latitude) / 255.0f;
+			for (int i = 0; i < 9; ++i)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					sums[i][c].Store(lanes);
+					float sum = 0.0f;
+					for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+						sum += lanes[lane];
+					rowSums[static_cast<size_t>(y) * 27 + i * 3 + c] = sum * weight;
+				}
+			}
+		}
+	});
+
+	const float bandScale[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	const float basisScale[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+	for (int i = 0; i < 9; ++i)
+	{
+		glm::dvec3 sum(0.0);
+		for (int y = 0; y < height; ++y)
+			for (int c = 0; c < 3; ++c)
+				sum[c] += rowSums[static_cast<size_t>(y) * 27 + i * 3 + c];
+		coeffs[i] = glm::vec3(sum) * bandScale[i] * basisScale[i];
+	}
+}
+
+// Level 0 is the source level of the same size. For the other levels every texel averages
+// ENVIRONMENT_NUM_SAMPLES directions drawn from the Phong lobe around its direction
+// (Hammersley points), each read from the source mip whose texels match the solid angle
+// the sample stands for, so few samples give a smooth result.
+void EnvironmentLighting::PrefilterSpecular(const vector<vector<cv::Mat>>& source, const int size, vector<vector<cv::Mat>>& faces)
+{
+	const int sourceSize = source[0][0].cols;
+	int numLevels = 1;
+	while (size >> numLevels)
+		numLevels++;
+	faces.assign(6, vector<cv::Mat>(numLevels));
+	for (int face = 0; face < 6; ++face)
+		for (const cv::Mat& level : source[face])
+			if (level.cols == size)
+				faces[face][0] = level.clone();
+
+	const float pi = glm::pi<float>();
+	const float texelSolidAngle = 4.0f * pi / (6.0f * sourceSize * sourceSize);
+	const int numSamples = ENVIRONMENT_NUM_SAMPLES;
+	for (int level = 1; level < numLevels; ++level)
+	{
+		const int levelSize = max(1, size >> level);
+		for (int face = 0; face < 6; ++face)
+			faces[face][level].create(levelSize, levelSize, CV_8UC4);
+
+		// Lobe samples in the frame of the lobe axis, and the source mip of each sample.
+		const float exponent = pow(4.0f, static_cast<float>(numLevels - 1 - level));
+		vector<float> lobeX(numSamples), lobeY(numSamples), lobeZ(numSamples), sampleLod(numSamples);
+		for (int k = 0; k < numSamples; ++k)
+		{
+			unsigned int bits = static_cast<unsigned int>(k);
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			const float u = (k + 0.5f) / numSamples;
+			const float v = bits * 2.3283064365386963e-10f;
+			const float cosTheta = pow(u, 1.0f / (exponent + 1.0f));
+			const float sinTheta = sqrt(max(0.0f, 1.0f - cosTheta * cosTheta));
+			lobeX[k] = sinTheta * cos(2.0f * pi * v);
+			lobeY[k] = sinTheta * sin(2.0f * pi * v);
+			lobeZ[k] = cosTheta;
+			const float pdf = (exponent + 1.0f) / (2.0f * pi) * pow(cosTheta, exponent);
+			sampleLod[k] = max(0.0f, 0.5f * log2(1.0f / (numSamples * max(pdf, 1e-6f)) / texelSolidAngle) + 1.0f);
+		}
+
+		ThreadPool::GetGlobal()->ParallelFor(0, 6 * levelSize, 4, [&](int first, int last) {
+			float sampleX[ENVIRONMENT_NUM_SAMPLES], sampleY[ENVIRONMENT_NUM_SAMPLES], sampleZ[ENVIRONMENT_NUM_SAMPLES];
+			for (int row = first; row < last; ++row)
+			{
+				const int face = row / levelSize;
+				const int j = row % levelSize;
+				unsigned char* dst = faces[face][level].ptr<unsigned char>(j);
+				for (int i = 0; i < levelSize; ++i)
+				{
+					const float a = 2.0f * (i + 0.5f) / levelSize - 1.0f;
+					const float b = 2.0f * (j + 0.5f) / levelSize - 1.0f;
+					const glm::vec3 faceDirs[6] = {
+						glm::vec3(1.0f, -b, -a), glm::vec3(-1.0f, -b, a), glm::vec3(a, 1.0f, b),
+						glm::vec3(a, -1.0f, -b), glm::vec3(a, -b, 1.0f), glm::vec3(-a, -b, -1.0f)
+					};
+					const glm::vec3 axis = glm::normalize(faceDirs[face]);
+					const glm::vec3 up = (abs(axis.y) < 0.999f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+					const glm::vec3 tangent = glm::normalize(glm::cross(up, axis));
+					const glm::vec3 bitangent = glm::cross(axis, tangent);
+					// Rotate the lobe samples into place, SIMD_WIDTH at a time.
+					const SimdVec3 t(tangent.x, tangent.y, tangent.z);
+					const SimdVec3 bt(bitangent.x, bitangent.y, bitangent.z);
+					const SimdVec3 n(axis.x, axis.y, axis.z);
+					for (int k = 0; k < numSamples; k += SIMD_WIDTH)
+					{
+						const SimdVec3 dir = t * SimdFloat::Load(&lobeX[k]) + bt * SimdFloat::Load(&lobeY[k]) + n * SimdFloat::Load(&lobeZ[k]);
+						dir.x.Store(&sampleX[k]);
+						dir.y.Store(&sampleY[k]);
+						dir.z.Store(&sampleZ[k]);
+					}
+					float sum[3] = { 0.0f, 0.0f, 0.0f };
+					for (int k = 0; k < numSamples; ++k)
+					{
+						float color[3];
+						SampleCube(source, sampleX[k], sampleY[k], sampleZ[k], sampleLod[k], color);
+						for (int c = 0; c < 3; ++c)
+							sum[c] += color[c];
+					}
+					for (int c = 0; c < 3; ++c)
+						dst[i * 4 + c] = static_cast<unsigned char>(min(255.0f, sum[c] / numSamples + 0.5f));
+					dst[i * 4 + 3] = 255;
+				}
+			}
+		});
+	}
+}
+
+// Trilinear lookup (BGR order, 0-255) like a GL cubemap fetch, without filtering across faces.
+void EnvironmentLighting::SampleCube(const vector<vector<cv::Mat>>& faces, const float x, const float y, const float z,
+	const float lod, float color[3])
+{
+	const float ax = abs(x), ay = abs(y), az = abs(z);
+	int face = 0;
+	float sc = 0.0f, tc = 0.0f, ma = 1.0f;
+	if (ax >= ay && ax >= az)
+	{
+		face = (x > 0.0f) ? 0 : 1;
+		ma = ax;
+		sc = (x > 0.0f) ? -z : z;
+		tc = -y;
+	}
+	else if (ay >= az)
+	{
+		face = (y > 0.0f) ? 2 : 3;
+		ma = ay;
+		sc = x;
+		tc = (y > 0.0f) ? z : -z;
+	}
+	else
+	{
+		face = (z > 0.0f) ? 4 : 5;
+		ma = az;
+		sc = (z > 0.0f) ? x : -x;
+		tc = -y;
+	}
+	const float s = 0.5f * (sc / ma + 1.0f);
+	const float t = 0.5f * (tc / ma + 1.0f);
+
+	const int maxLevel = static_cast<int>(faces[face].size()) - 1;
+	const float clampedLod = min(max(lod, 0.0f), static_cast<float>(maxLevel));
+	const int level0 = static_cast<int>(clampedLod);
+	const int level1 = min(level0 + 1, maxLevel);
+	const float levelWeights[2] = { 1.0f - (clampedLod - level0), clampedLod - level0 };
+	const int levels[2] = { level0, level1 };
+	color[0] = color[1] = color[2] = 0.0f;
+	for (int l = 0; l < 2; ++l)
+	{
+		const cv::Mat& image = faces[face][levels[l]];
+		const int levelSize = image.cols;
+		const float px = min(max(s * levelSize - 0.5f, 0.0f), levelSize - 1.0f);
+		const float py = min(max(t * levelSize - 0.5f, 0.0f), levelSize - 1.0f);
+		const int x0 = static_cast<int>(px), y0 = static_cast<int>(py);
+		const int x1 = min(x0 + 1, levelSize - 1), y1 = min(y0 + 1, levelSize - 1);
+		const float fx = px - x0, fy = py - y0;
+		const unsigned char* row0 = image.ptr<unsigned char>(y0);
+		const unsigned char* row1 = image.ptr<unsigned char>(y1);
+		for (int c = 0; c < 3; ++c)
+		{
+			const float top = row0[x0 * 4 + c] + (row0[x1 * 4 + c] - row0[x0 * 4 + c]) * fx;
+			const float bottom = row1[x0 * 4 + c] + (row1[x1 * 4 + c] - row1[x0 * 4 + c]) * fx;
+			color[c] += levelWeights[l] * (top + (bottom - top) * fy);
+		}
+	}
+}
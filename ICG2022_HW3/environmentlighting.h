@@ -0,0 +1,64 @@
+#ifndef ENVIRONMENT_LIGHTING_H
+#define ENVIRONMENT_LIGHTING_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "simd.h"
+#include "timer.h"
+#include "cubemaptexture.h"
+#include "texturecache.h"
+using namespace std;
+
+// Bump when the precomputation changes so stale cache entries are rebuilt.
+#define ENVIRONMENT_LIGHTING_VERSION 1
+// Face size of the mirror level of the specular cubemap and of the source it is filtered from.
+#define ENVIRONMENT_SPECULAR_SIZE 128
+#define ENVIRONMENT_SOURCE_SIZE 256
+// Lobe samples per texel of the prefiltered levels.
+#define ENVIRONMENT_NUM_SAMPLES 64
+
+
+// EnvironmentLighting Declarations.
+// Image-based lighting from the skybox panorama, treated like the other textures as
+// radiance in [0, 1]:
+// - diffuse: the panorama projected onto 9 spherical harmonics and convolved with the
+//   clamped cosine, stored as the coefficients of the polynomial in phong_shading.fs;
+// - specular: a cubemap whose level L is prefiltered with the Phong lobe of exponent
+//   4^(maxLevel - L) (level 0 is the mirror image), sampled by the reflection vector.
+// The projection runs over panorama rows and the prefilter over texels on the thread
+// pool, both SIMD_WIDTH lanes at a time; the results are cached by panorama hash.
+class EnvironmentLighting
+{
+public:
+	// EnvironmentLighting Public Methods.
+	EnvironmentLighting();
+	~EnvironmentLighting();
+
+	bool GetFromCache() const { return fromCache; }
+	double GetLoadTimeMs() const { return loadTimeMs; }
+	const glm::vec3* GetIrradianceSH() const { return irradianceSH; }
+	float GetSpecularMaxLevel() const { return static_cast<float>(specular.GetNumLevels() - 1); }
+
+	bool Create(const string& panoramaPath);
+	void BindSpecular(GLenum textureUnit) { specular.Bind(textureUnit); }
+	void ShowInfo();
+
+	// The panorama is an 8-bit BGRA image laid out like the sphere skybox.
+	static void ProjectSH9(const cv::Mat& panorama, glm::vec3 coeffs[9]);
+	static void PrefilterSpecular(const vector<vector<cv::Mat>>& source, const int size, vector<vector<cv::Mat>>& faces);
+
+private:
+	// EnvironmentLighting Private Methods.
+	static void SampleCube(const vector<vector<cv::Mat>>& faces, const float x, const float y, const float z,
+		const float lod, float color[3]);
+	// EnvironmentLighting Private Data.
+	glm::vec3 irradianceSH[9];
+	CubemapTexture specular;
+	string filePath;
+	bool fromCache;
+	double loadTimeMs;
+	double projectTimeMs;
+	double prefilterTimeMs;
+};
+
+#endif
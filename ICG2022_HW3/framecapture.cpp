@@ -0,0 +1,84 @@
+#include "framecapture.h"
+using namespace std;
+
+FrameCapture::FrameCapture(const int nReadbackSlots, const unsigned int nEncoderThreads)
+	: readback(nReadbackSlots), encoderPool(nEncoderThreads)
+{
+	// Bound the number of decoded frames waiting for an encoder.
+	maxPendingEncodes = 4 * encoderPool.GetNumThreads();
+	numWritten = 0;
+	numFailed = 0;
+	stats = nullptr;
+}
+
+FrameCapture::~FrameCapture()
+{
+	Flush();
+}
+
+// Queue a readback of the color attachment of fboId (0 is the back buffer, so call
+// this before swapping). Only blocks when every readback slot is still in flight.
+void FrameCapture::CaptureFrame(const GLuint fboId, const int width, const int height, const string& filePath)
+{
+	while (!readback.Request(fboId, width, height, filePath))
+		RetireReadback(true);
+	Update();
+}
+
+// Hand every readback that has already completed to the encoders.
+void FrameCapture::Update()
+{
+	while (RetireReadback(false));
+	RetireEncodes(false);
+}
+
+// Wait until every queued frame has been written.
+void FrameCapture::Flush()
+{
+	while (RetireReadback(true));
+	RetireEncodes(true);
+}
+
+bool FrameCapture::RetireReadback(const bool wait)
+{
+	ReadbackFrame frame;
+	CpuTimer timer;
+	if (!readback.Poll(frame, wait))
+		return false;
+	if (stats != nullptr)
+		stats->Add("readback", timer.GetElapsedMs());
+
+	// Throttle if the encoders fall behind, instead of buffering frames without limit.
+	while (encodeResults.size() >= maxPendingEncodes)
+	{
+		if (encodeResults.front().get())
+			numWritten++;
+		else
+			numFailed++;
+		encodeResults.pop_front();
+	}
+	StageStats* encodeStats = stats;
+	encodeResults.push_back(encoderPool.Submit([frame, encodeStats]()
+	{
+		CpuTimer encodeTimer;
+		bool success = PboReadback::SaveFrame(frame, frame.tag);
+		if (encodeStats != nullptr)
+			encodeStats->Add("encode (worker)", encodeTimer.GetElapsedMs());
+		return success;
+	}));
+	return true;
+}
+
+void FrameCapture::RetireEncodes(const bool wait)
+{
+	while (!encodeResults.empty())
+	{
+		if (!wait && encodeResults.front().wait_for(chrono::seconds(0)) != future_status::ready)
+			break;
+		if (encodeResults.front().get())
+			numWritten++;
+		else
+			numFailed++;
+		encodeResults.pop_front();
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "headers.h"
+#include "pboreadback.h"
+#include "threadpool.h"
+#include "timer.h"
+using namespace std;
+
+
+// FrameCapture Declarations.
+// Saves rendered frames without stalling the render loop: pixels are read back
+// through a fenced PBO ring, mapped a frame or two later by Update(), and encoded
+// to PNG/JPEG by a pool of worker threads.
+class FrameCapture
+{
+public:
+	// FrameCapture Public Methods.
+	FrameCapture(const int nReadbackSlots = 3, const unsigned int nEncoderThreads = 0);
+	~FrameCapture();
+
+	void SetStats(StageStats* stageStats) { stats = stageStats; }
+	unsigned int GetNumWritten() const { return numWritten; }
+	unsigned int GetNumFailed()  const { return numFailed; }
+	bool IsIdle() const { return readback.GetNumPending() == 0 && encodeResults.empty(); }
+
+	void CaptureFrame(const GLuint fboId, const int width, const int height, const string& filePath);
+	void Update();
+	void Flush();
+
+private:
+	// FrameCapture Private Methods.
+	bool RetireReadback(const bool wait);
+	void RetireEncodes(const bool wait);
+	// FrameCapture Private Data.
+	PboReadback readback;
+	ThreadPool encoderPool;
+	deque<future<bool>> encodeResults;
+	size_t maxPendingEncodes;
+	unsigned int numWritten;
+	unsigned int numFailed;
+	StageStats* stats;
+};
+
+#endif
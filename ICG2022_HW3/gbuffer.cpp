@@ -0,0 +1,131 @@
+#include "gbuffer.h"
+using namespace std;
+
+// Internal format and bytes per texel of each map.
+static const GLenum mapFormats[NUM_GBUFFER_MAPS] = { GL_RGBA32F, GL_RGBA16F, GL_RGBA8, GL_RGBA8, GL_RGBA16F, GL_DEPTH_COMPONENT24 };
+static const int mapTexelBytes[NUM_GBUFFER_MAPS] = { 16, 8, 4, 4, 8, 4 };
+
+GBuffer::GBuffer(const int width, const int height)
+{
+	gbWidth = width;
+	gbHeight = height;
+	fboId = 0;
+	for (int map = 0; map < NUM_GBUFFER_MAPS; ++map)
+		mapTexIds[map] = 0;
+	prevFboId = 0;
+	for (int i = 0; i < 4; ++i)
+		prevViewport[i] = 0;
+	complete = false;
+	CreateAttachments();
+
+	const glm::vec2 triangle[3] = { glm::vec2(-1.0f, -1.0f), glm::vec2(3.0f, -1.0f), glm::vec2(-1.0f, 3.0f) };
+	glGenBuffers(1, &triangleVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+}
+
+GBuffer::~GBuffer()
+{
+	DeleteAttachments();
+	glDeleteBuffers(1, &triangleVboId);
+}
+
+size_t GBuffer::GetGpuBytes() const
+{
+	size_t texelBytes = 0;
+	for (int map = 0; map < NUM_GBUFFER_MAPS; ++map)
+		texelBytes += mapTexelBytes[map];
+	return texelBytes * gbWidth * gbHeight;
+}
+
+// Recreate the attachments with a new size.
+void GBuffer::Resize(const int width, const int height)
+{
+	if (width == gbWidth && height == gbHeight)
+		return;
+	DeleteAttachments();
+	gbWidth = width;
+	gbHeight = height;
+	CreateAttachments();
+}
+
+void GBuffer::Bind()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glViewport(0, 0, gbWidth, gbHeight);
+}
+
+void GBuffer::UnBind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void GBuffer::BindMaps(GLenum firstUnit)
+{
+	for (int map = 0; map < NUM_GBUFFER_MAPS; ++map)
+	{
+		glActiveTexture(firstUnit + map);
+		glBindTexture(GL_TEXTURE_2D, mapTexIds[map]);
+	}
+}
+
+// Draw one triangle covering the viewport.
+void GBuffer::DrawFullscreen()
+{
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (const GLvoid*)0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisableVertexAttribArray(0);
+}
+
+void GBuffer::CreateAttachments()
+{
+	glGenTextures(NUM_GBUFFER_MAPS, mapTexIds);
+	for (int map = 0; map < NUM_GBUFFER_MAPS; ++map)
+	{
+		// The lighting pass fetches texels, so there is no filtering.
+		glBindTexture(GL_TEXTURE_2D, mapTexIds[map]);
+		if (GLEW_ARB_texture_storage)
+			glTexStorage2D(GL_TEXTURE_2D, 1, mapFormats[map], gbWidth, gbHeight);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, mapFormats[map], gbWidth, gbHeight, 0,
+				(map == GBUFFER_MAP_DEPTH) ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Resize() may run in the middle of a frame, so the framebuffer of the caller stays bound.
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	glGenFramebuffers(1, &fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	GLenum drawBuffers[GBUFFER_MAP_DEPTH];
+	for (int map = 0; map < GBUFFER_MAP_DEPTH; ++map)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + map, GL_TEXTURE_2D, mapTexIds[map], 0);
+		drawBuffers[map] = GL_COLOR_ATTACHMENT0 + map;
+	}
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mapTexIds[GBUFFER_MAP_DEPTH], 0);
+	glDrawBuffers(GBUFFER_MAP_DEPTH, drawBuffers);
+	complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (!complete)
+		cerr << "[ERROR] Incomplete G-buffer: " << gbWidth << " x " << gbHeight << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+void GBuffer::DeleteAttachments()
+{
+	glDeleteFramebuffers(1, &fboId);
+	glDeleteTextures(NUM_GBUFFER_MAPS, mapTexIds);
+	fboId = 0;
+	for (int map = 0; map < NUM_GBUFFER_MAPS; ++map)
+		mapTexIds[map] = 0;
+	complete = false;
+}
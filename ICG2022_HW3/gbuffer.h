@@ -0,0 +1,61 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "headers.h"
+using namespace std;
+
+// G-buffer maps (the outputs of phong_shading.fs with GBUFFER_PASS, then the depth).
+// BindMaps() binds them to consecutive texture units in this order.
+enum GBufferMap
+{
+	GBUFFER_MAP_POSITION,  // World position and Ns (RGBA32F).
+	GBUFFER_MAP_NORMAL,    // World normal (RGBA16F).
+	GBUFFER_MAP_ALBEDO,    // Kd (RGBA8).
+	GBUFFER_MAP_SPECULAR,  // Ks (RGBA8).
+	GBUFFER_MAP_AMBIENT,   // Ambient or image-based light (RGBA16F).
+	GBUFFER_MAP_DEPTH,     // Depth (DEPTH_COMPONENT24).
+	NUM_GBUFFER_MAPS
+};
+
+
+// GBuffer Declarations.
+// The framebuffer the geometry pass of deferred shading draws the surfaces into, and the
+// fullscreen triangle the lighting pass reads it back with (one texel per pixel, so the
+// G-buffer has the size of the viewport it is lit into and is not multisampled).
+class GBuffer
+{
+public:
+	// GBuffer Public Methods.
+	GBuffer(const int width, const int height);
+	~GBuffer();
+
+	int GetWidth()  const { return gbWidth; }
+	int GetHeight() const { return gbHeight; }
+	GLuint GetFboId() const { return fboId; }
+	GLuint GetMapTex(const GBufferMap map) const { return mapTexIds[map]; }
+	bool GetComplete() const { return complete; }
+	size_t GetGpuBytes() const;
+
+	void Resize(const int width, const int height);
+	// Render into the G-buffer; UnBind() restores the previous framebuffer and viewport.
+	void Bind();
+	void UnBind();
+	void BindMaps(GLenum firstUnit);
+	void DrawFullscreen();
+
+private:
+	// GBuffer Private Methods.
+	void CreateAttachments();
+	void DeleteAttachments();
+	// GBuffer Private Data.
+	int gbWidth;
+	int gbHeight;
+	GLuint fboId;
+	GLuint mapTexIds[NUM_GBUFFER_MAPS];
+	GLuint triangleVboId;
+	GLint prevFboId;
+	GLint prevViewport[4];
+	bool complete;
+};
+
+#endif
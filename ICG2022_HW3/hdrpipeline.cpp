@@ -0,0 +1,259 @@
+#include "hdrpipeline.h"
+using namespace std;
+
+static const char* operatorNames[NUM_TONE_MAP_OPERATORS] = { "Reinhard", "ACES" };
+
+HdrPipeline::HdrPipeline(const int width, const int height)
+{
+	sceneWidth = max(1, width);
+	sceneHeight = max(1, height);
+	sceneFboId = 0;
+	sceneTexId = 0;
+	depthRboId = 0;
+	bloomTexId = 0;
+	for (int i = 0; i < BLOOM_MAX_LEVELS; ++i)
+		bloomFboIds[i] = 0;
+	prevFboId = 0;
+	for (int i = 0; i < 4; ++i)
+		prevViewport[i] = 0;
+	complete = false;
+	CreateAttachments();
+
+	const glm::vec2 triangle[3] = { glm::vec2(-1.0f, -1.0f), glm::vec2(3.0f, -1.0f), glm::vec2(-1.0f, 3.0f) };
+	glGenBuffers(1, &triangleVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+}
+
+HdrPipeline::~HdrPipeline()
+{
+	DeleteAttachments();
+	glDeleteBuffers(1, &triangleVboId);
+}
+
+// RGBA16F color and depth, and 4 bytes per texel of each bloom level.
+size_t HdrPipeline::GetGpuBytes() const
+{
+	size_t bytes = static_cast<size_t>(sceneWidth) * sceneHeight * (8 + 4);
+	for (const glm::ivec2& size : bloomSizes)
+		bytes += static_cast<size_t>(size.x) * size.y * 4;
+	return bytes;
+}
+
+const char* HdrPipeline::GetOperatorName(const ToneMapOperator op)
+{
+	return operatorNames[op];
+}
+
+// Recreate the attachments with a new size.
+void HdrPipeline::Resize(const int width, const int height)
+{
+	if (width == sceneWidth && height == sceneHeight)
+		return;
+	DeleteAttachments();
+	sceneWidth = max(1, width);
+	sceneHeight = max(1, height);
+	CreateAttachments();
+}
+
+void HdrPipeline::BeginScene()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFboId);
+	glViewport(0, 0, sceneWidth, sceneHeight);
+}
+
+void HdrPipeline::EndScene()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void HdrPipeline::Resolve(const ToneMapOperator op, const float exposure, const float bloomStrength,
+	HdrShaderProg* downsampleShader, HdrShaderProg* upsampleShader, HdrShaderProg* toneMapShader)
+{
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	const bool useBloom = bloomStrength > 0.0f && !bloomSizes.empty();
+	if (useBloom)
+		RenderBloom(downsampleShader, upsampleShader);
+
+	// Tone map into the previous framebuffer.
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+	toneMapTimer.Begin();
+	toneMapShader->Bind();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sceneTexId);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, bloomTexId);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glUniform1i(toneMapShader->GetLocSceneMap(), 0);
+	glUniform1i(toneMapShader->GetLocBloomMap(), 1);
+	glUniform1f(toneMapShader->GetLocBloomStrength(), useBloom ? bloomStrength : 0.0f);
+	glUniform1f(toneMapShader->GetLocExposure(), exposure);
+	glUniform1i(toneMapShader->GetLocToneMapOperator(), op);
+	DrawFullscreen();
+	toneMapShader->UnBind();
+	toneMapTimer.End();
+
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void HdrPipeline::RenderBloom(HdrShaderProg* downsampleShader, HdrShaderProg* upsampleShader)
+{
+	// Each pass samples a single level (BASE_LEVEL = MAX_LEVEL), so the level being drawn
+	// into is never read.
+	const int numLevels = GetNumBloomLevels();
+	downsampleTimer.Begin();
+	downsampleShader->Bind();
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(downsampleShader->GetLocSourceMap(), 0);
+	glUniform1f(downsampleShader->GetLocThreshold(), BLOOM_THRESHOLD);
+	glUniform1f(downsampleShader->GetLocKnee(), BLOOM_KNEE);
+	for (int level = 0; level < numLevels; ++level)
+	{
+		if (level == 0)
+			glBindTexture(GL_TEXTURE_2D, sceneTexId);
+		else
+		{
+			glBindTexture(GL_TEXTURE_2D, bloomTexId);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, bloomFboIds[level]);
+		glViewport(0, 0, bloomSizes[level].x, bloomSizes[level].y);
+		glUniform2f(downsampleShader->GetLocTargetTexelSize(), 1.0f / bloomSizes[level].x, 1.0f / bloomSizes[level].y);
+		glUniform1i(downsampleShader->GetLocFirstPass(), level == 0);
+		DrawFullscreen();
+	}
+	downsampleTimer.End();
+
+	upsampleTimer.Begin();
+	upsampleShader->Bind();
+	glUniform1i(upsampleShader->GetLocSourceMap(), 0);
+	glBindTexture(GL_TEXTURE_2D, bloomTexId);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	for (int level = numLevels - 1; level > 0; --level)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+		glBindFramebuffer(GL_FRAMEBUFFER, bloomFboIds[level - 1]);
+		glViewport(0, 0, bloomSizes[level - 1].x, bloomSizes[level - 1].y);
+		glUniform2f(upsampleShader->GetLocTargetTexelSize(), 1.0f / bloomSizes[level - 1].x, 1.0f / bloomSizes[level - 1].y);
+		DrawFullscreen();
+	}
+	glDisable(GL_BLEND);
+	upsampleShader->UnBind();
+	upsampleTimer.End();
+}
+
+void HdrPipeline::ShowInfo()
+{
+	cout << "HDR (" << sceneWidth << " x " << sceneHeight << ", " << GetNumBloomLevels() << " bloom levels), GPU ms per frame:";
+	if (downsampleTimer.GetNumSamples() > 0)
+		cout << " bloom downsample " << downsampleTimer.GetAverageMs() << ", upsample " << upsampleTimer.GetAverageMs() << ",";
+	cout << " tone map " << toneMapTimer.GetAverageMs() << endl;
+	downsampleTimer.Reset();
+	upsampleTimer.Reset();
+	toneMapTimer.Reset();
+}
+
+// Draw one triangle covering the viewport.
+void HdrPipeline::DrawFullscreen()
+{
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (const GLvoid*)0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisableVertexAttribArray(0);
+}
+
+void HdrPipeline::CreateAttachments()
+{
+	// The scene is sampled bilinearly by the first downsample.
+	glGenTextures(1, &sceneTexId);
+	glBindTexture(GL_TEXTURE_2D, sceneTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, sceneWidth, sceneHeight);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, sceneWidth, sceneHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenRenderbuffers(1, &depthRboId);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRboId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, sceneWidth, sceneHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	glGenFramebuffers(1, &sceneFboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFboId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexId, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRboId);
+	complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+	// Bloom levels from half the scene size, down to BLOOM_MIN_SIZE.
+	bloomSizes.clear();
+	glm::ivec2 size = glm::ivec2(sceneWidth / 2, sceneHeight / 2);
+	while (static_cast<int>(bloomSizes.size()) < BLOOM_MAX_LEVELS && min(size.x, size.y) >= BLOOM_MIN_SIZE)
+	{
+		bloomSizes.push_back(size);
+		size = glm::max(size / 2, glm::ivec2(1));
+	}
+	if (!bloomSizes.empty())
+	{
+		glGenTextures(1, &bloomTexId);
+		glBindTexture(GL_TEXTURE_2D, bloomTexId);
+		if (GLEW_ARB_texture_storage)
+			glTexStorage2D(GL_TEXTURE_2D, GetNumBloomLevels(), GL_R11F_G11F_B10F, bloomSizes[0].x, bloomSizes[0].y);
+		else
+		{
+			for (int level = 0; level < GetNumBloomLevels(); ++level)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_R11F_G11F_B10F, bloomSizes[level].x, bloomSizes[level].y, 0,
+					GL_RGB, GL_FLOAT, nullptr);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glGenFramebuffers(GetNumBloomLevels(), bloomFboIds);
+		for (int level = 0; level < GetNumBloomLevels(); ++level)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, bloomFboIds[level]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTexId, level);
+			complete = complete && (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if (!complete)
+		cerr << "[ERROR] Incomplete HDR render target: " << sceneWidth << " x " << sceneHeight << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+void HdrPipeline::DeleteAttachments()
+{
+	glDeleteFramebuffers(1, &sceneFboId);
+	glDeleteRenderbuffers(1, &depthRboId);
+	glDeleteTextures(1, &sceneTexId);
+	if (!bloomSizes.empty())
+	{
+		glDeleteFramebuffers(GetNumBloomLevels(), bloomFboIds);
+		glDeleteTextures(1, &bloomTexId);
+	}
+	sceneFboId = 0;
+	depthRboId = 0;
+	sceneTexId = 0;
+	bloomTexId = 0;
+	for (int i = 0; i < BLOOM_MAX_LEVELS; ++i)
+		bloomFboIds[i] = 0;
+	bloomSizes.clear();
+	complete = false;
+}
@@ -0,0 +1,82 @@
+#ifndef HDR_PIPELINE_H
+#define HDR_PIPELINE_H
+
+#include "headers.h"
+#include "shaderprog.h"
+#include "timer.h"
+using namespace std;
+
+// Most levels of the bloom pyramid (the first is half the size of the scene).
+#define BLOOM_MAX_LEVELS 6
+// Smallest side of a bloom level.
+#define BLOOM_MIN_SIZE 8
+// Luminance above which pixels bloom, and the width of the soft knee below it.
+#define BLOOM_THRESHOLD 1.0f
+#define BLOOM_KNEE 0.5f
+
+// Tone mapping operators of the resolve.
+enum ToneMapOperator
+{
+	TONE_MAP_REINHARD,
+	TONE_MAP_ACES,
+	NUM_TONE_MAP_OPERATORS
+};
+
+
+// HdrPipeline Declarations.
+// The scene is rendered into an RGBA16F target between BeginScene() and EndScene(), so the
+// sum of the lights does not clip, and Resolve() tone maps it into the framebuffer that was
+// bound before. The bloom is a pyramid of mip levels of one R11F_G11F_B10F texture: each
+// level is a 13-tap downsample of the one above (the first one thresholded), and the
+// levels are then added back up with a 3 x 3 tent filter by blending, so every level is
+// written once per direction and read at most twice.
+class HdrPipeline
+{
+public:
+	// HdrPipeline Public Methods.
+	HdrPipeline(const int width, const int height);
+	~HdrPipeline();
+
+	int GetWidth()  const { return sceneWidth; }
+	int GetHeight() const { return sceneHeight; }
+	int GetNumBloomLevels() const { return static_cast<int>(bloomSizes.size()); }
+	bool GetComplete() const { return complete; }
+	size_t GetGpuBytes() const;
+	int GetNumTimingSamples() const { return toneMapTimer.GetNumSamples(); }
+	static const char* GetOperatorName(const ToneMapOperator op);
+
+	void Resize(const int width, const int height);
+	void BeginScene();
+	void EndScene();
+	// Bloom of the scene (skipped when bloomStrength is 0), then tone mapping into the
+	// framebuffer bound before BeginScene().
+	void Resolve(const ToneMapOperator op, const float exposure, const float bloomStrength,
+		HdrShaderProg* downsampleShader, HdrShaderProg* upsampleShader, HdrShaderProg* toneMapShader);
+	// Print the GPU time of each pass, averaged since the last call.
+	void ShowInfo();
+
+private:
+	// HdrPipeline Private Methods.
+	void CreateAttachments();
+	void DeleteAttachments();
+	void RenderBloom(HdrShaderProg* downsampleShader, HdrShaderProg* upsampleShader);
+	void DrawFullscreen();
+	// HdrPipeline Private Data.
+	int sceneWidth;
+	int sceneHeight;
+	GLuint sceneFboId;
+	GLuint sceneTexId;
+	GLuint depthRboId;
+	GLuint bloomTexId;
+	GLuint bloomFboIds[BLOOM_MAX_LEVELS];
+	vector<glm::ivec2> bloomSizes;
+	GLuint triangleVboId;
+	GLint prevFboId;
+	GLint prevViewport[4];
+	bool complete;
+	GpuTimer downsampleTimer;
+	GpuTimer upsampleTimer;
+	GpuTimer toneMapTimer;
+};
+
+#endif
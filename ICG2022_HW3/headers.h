@@ -19,5 +19,16 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <deque>
+#include <random>
 
 #endif
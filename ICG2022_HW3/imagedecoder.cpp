@@ -0,0 +1,57 @@
+#include "imagedecoder.h"
+using namespace std;
+
+bool ImageDecoder::ReadFile(const string& filePath, vector<unsigned char>& bytes)
+{
+	ifstream file(filePath, ios::binary | ios::ate);
+	if (!file)
+		return false;
+	const streamoff size = file.tellg();
+	if (size <= 0)
+		return false;
+	bytes.resize(static_cast<size_t>(size));
+	file.seekg(0, ios::beg);
+	file.read(reinterpret_cast<char*>(bytes.data()), size);
+	return !file.fail();
+}
+
+bool ImageDecoder::Decode(const vector<unsigned char>& bytes, cv::Mat& image, const int reduction, const bool keepFormat)
+{
+	if (bytes.empty())
+		return false;
+	int flags = keepFormat ? cv::IMREAD_UNCHANGED : cv::IMREAD_COLOR;
+	if (!keepFormat && reduction >= 8)
+		flags = cv::IMREAD_REDUCED_COLOR_8;
+	else if (!keepFormat && reduction >= 4)
+		flags = cv::IMREAD_REDUCED_COLOR_4;
+	else if (!keepFormat && reduction >= 2)
+		flags = cv::IMREAD_REDUCED_COLOR_2;
+	image = cv::imdecode(bytes, flags);
+	return !image.empty();
+}
+
+bool ImageDecoder::DecodeFile(const string& filePath, cv::Mat& image, const int reduction)
+{
+	vector<unsigned char> bytes;
+	if (!ReadFile(filePath, bytes))
+		return false;
+	return Decode(bytes, image, reduction);
+}
+
+// Each file is a task, so a few large images do not hold up the small ones.
+void ImageDecoder::DecodeAll(const vector<string>& filePaths, vector<cv::Mat>& images, const int reduction)
+{
+	images.assign(filePaths.size(), cv::Mat());
+	ThreadPool::GetGlobal()->ParallelFor(0, static_cast<int>(filePaths.size()), 1, [&](int first, int last) {
+		for (int i = first; i < last; ++i)
+			DecodeFile(filePaths[i], images[i], reduction);
+	});
+}
+
+int ImageDecoder::GetReduction(const int width, const int height, const int maxSize)
+{
+	int reduction = 1;
+	while (reduction < 8 && max(width, height) > maxSize * reduction)
+		reduction *= 2;
+	return reduction;
+}
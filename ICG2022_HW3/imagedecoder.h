@@ -0,0 +1,29 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include "headers.h"
+#include "threadpool.h"
+using namespace std;
+
+
+// ImageDecoder Declarations.
+// Decodes image files (PNG, JPEG, ...) into 8-bit images that are uploaded as they are:
+// rows stay in file order (top row first) and the meshes flip their texture coordinates
+// once at load time instead, so no pass over the pixels is spent on flipping. A file is
+// read with one call and decoded from memory. A reduction of 2, 4 or 8 decodes a smaller
+// image (JPEG scales in the DCT, other formats are resized after decoding), e.g. for
+// previews. DecodeAll() decodes many files concurrently on the thread pool.
+class ImageDecoder
+{
+public:
+	// ImageDecoder Public Methods.
+	static bool ReadFile(const string& filePath, vector<unsigned char>& bytes);
+	// The image is BGR (or BGRA/gray/16-bit with keepFormat, as stored in the file).
+	static bool Decode(const vector<unsigned char>& bytes, cv::Mat& image, const int reduction = 1, const bool keepFormat = false);
+	static bool DecodeFile(const string& filePath, cv::Mat& image, const int reduction = 1);
+	static void DecodeAll(const vector<string>& filePaths, vector<cv::Mat>& images, const int reduction = 1);
+	// The reduction that brings the larger side down to maxSize or below (1 to 8).
+	static int GetReduction(const int width, const int height, const int maxSize);
+};
+
+#endif
@@ -1,17 +1,61 @@
 #include "imagetexture.h"
+#include "textureresidency.h"
 using namespace std;
 
-ImageTexture::ImageTexture(const string& filePath)
+TextureCompression ImageTexture::compression = TEXTURE_COMPRESSION_NONE;
+bool ImageTexture::cpuMipmaps = false;
+MipFilter ImageTexture::mipFilter = MIP_FILTER_BOX;
+TextureStreamer* ImageTexture::streamer = nullptr;
+TextureResidency* ImageTexture::residency = nullptr;
+VirtualTextureSystem* ImageTexture::virtualTextures = nullptr;
+
+bool ImageTexture::releaseCpuCopies = false;
+
+ImageTexture::ImageTexture(const string& filePath, const bool deferredUpload, const TextureUsage texUsage, const bool allowVirtual)
 	: texFilePath(filePath)
 {
 	successLoaded = false;
 	imageWidth = 0;
 	imageHeight = 0;
 	numChannels = 0;
+	numMipLevels = 1;
 	textureObj = 0;
+	pendingObj = 0;
+	residentLevel = 0;
+	pendingLevel = 0;
+	usage = texUsage;
+	isCompressed = false;
+	fromCache = false;
+	virtualTexture = nullptr;
 
-	texImage = cv::imread(texFilePath);
-	if (texImage.rows == 0 || texImage.cols == 0) 
+	// A map that is too small to page comes back decoded.
+	if (allowVirtual && virtualTextures != nullptr && usage == TEXTURE_USAGE_COLOR)
+	{
+		virtualTexture = new VirtualTexture();
+		if (virtualTexture->Create(texFilePath, VIRTUAL_TEXTURE_MIN_SIZE, mipFilter, texImage))
+		{
+			successLoaded = true;
+			imageWidth = virtualTexture->GetWidth();
+			imageHeight = virtualTexture->GetHeight();
+			numChannels = 3;
+			numMipLevels = virtualTexture->GetNumLevels();
+			fromCache = virtualTexture->GetFromCache();
+			if (!deferredUpload)
+				Upload();
+			return;
+		}
+		delete virtualTexture;
+		virtualTexture = nullptr;
+	}
+
+	if (compression != TEXTURE_COMPRESSION_NONE && LoadCompressed())
+	{
+		if (!deferredUpload)
+			Upload();
+		return;
+	}
+
+	if (texImage.empty() && !ImageDecoder::DecodeFile(texFilePath, texImage))
 	{
 		cerr << "[ERROR] Failed to load image texture: " << filePath << endl;
 		return;
@@ -21,21 +65,138 @@ ImageTexture::ImageTexture(const string& filePath)
 	imageHeight = texImage.rows;
 	numChannels = texImage.channels();
 
-	cv::flip(texImage, texImage, 0);
+	// Streamed textures are sampled from their coarse levels first, so they need the full chain.
+	if (cpuMipmaps || streamer != nullptr)
+	{
+		MipmapBuilder builder(mipFilter, usage == TEXTURE_USAGE_COLOR);
+		builder.Build(texImage, mipLevels);
+		numMipLevels = static_cast<int>(mipLevels.size());
+	}
+
+	if (!deferredUpload)
+		Upload();
+}
+
+// Load the compressed mip chain from the texture cache, or decode, compress and cache it.
+bool ImageTexture::LoadCompressed()
+{
+	vector<unsigned char> bytes;
+	if (!ImageDecoder::ReadFile(texFilePath, bytes))
+		return false;
+	string settings = (usage == TEXTURE_USAGE_NORMAL) ? "normal" : (compression == TEXTURE_COMPRESSION_HIGH ? "high" : "fast");
+	if (usage == TEXTURE_USAGE_DATA)
+		settings += "_linear";
+	settings += "_" + MipmapBuilder::GetFilterName(mipFilter);
+	string cachePath = TextureCache::GetCachePath(TextureCache::HashBytes(bytes), settings);
+	if (TextureCache::Load(cachePath, compressedImage))
+		fromCache = true;
+	else
+	{
+		cv::Mat image;
+		if (!ImageDecoder::Decode(bytes, image, 1, true))
+			return false;
+		if (image.depth() == CV_16U)
+			image.convertTo(image, CV_8U, 1.0 / 257.0);
+		if (image.depth() != CV_8U)
+			return false;
+		// Keep the alpha channel only if it is not fully opaque.
+		bool hasAlpha = false;
+		if (image.channels() == 4)
+		{
+			cv::Mat alpha;
+			double minAlpha = 255.0;
+			cv::extractChannel(image, alpha, 3);
+			cv::minMaxLoc(alpha, &minAlpha);
+			hasAlpha = (usage == TEXTURE_USAGE_COLOR) && minAlpha < 255.0;
+			if (!hasAlpha)
+				cv::cvtColor(image, image, cv::COLOR_BGRA2BGR);
+		}
+		else if (image.channels() == 1)
+			cv::cvtColor(image, image, cv::COLOR_GRAY2BGR);
+		TextureFormat format = TEXTURE_FORMAT_BC5;
+		if (usage != TEXTURE_USAGE_NORMAL)
+			format = (compression == TEXTURE_COMPRESSION_HIGH) ? TEXTURE_FORMAT_BC7 : (hasAlpha ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1);
+
+		vector<cv::Mat> levels;
+		MipmapBuilder builder(mipFilter, usage == TEXTURE_USAGE_COLOR);
+		builder.Build(image, levels);
+		if (!TextureCompressor::Compress(levels, format, compressedImage))
+			return false;
+		TextureCache::Save(cachePath, compressedImage);
+		texImage = image;
+	}
+	successLoaded = true;
+	isCompressed = true;
+	imageWidth = compressedImage.width;
+	imageHeight = compressedImage.height;
+	numChannels = (compressedImage.format == TEXTURE_FORMAT_BC5) ? 2 : (compressedImage.format == TEXTURE_FORMAT_BC1 ? 3 : 4);
+	numMipLevels = static_cast<int>(compressedImage.levels.size());
+	return true;
+}
+
+// Create the GL texture object from the decoded or compressed image.
+void ImageTexture::Upload()
+{
+	if (!successLoaded || textureObj != 0)
+		return;
+	if (virtualTexture != nullptr)
+	{
+		if (virtualTextures != nullptr)
+			virtualTextures->Register(virtualTexture);
+		return;
+	}
+
+	if (streamer != nullptr || residency != nullptr)
+	{
+		// Streamed and managed textures are built from the full CPU mip chain.
+		if (!isCompressed && mipLevels.empty())
+		{
+			MipmapBuilder builder(mipFilter, usage == TEXTURE_USAGE_COLOR);
+			builder.Build(texImage, mipLevels);
+			numMipLevels = static_cast<int>(mipLevels.size());
+		}
+		residentLevel = (residency != nullptr) ? residency->Register(this) : 0;
+		textureObj = CreateTextureObject(residentLevel);
+		ReleaseCpuCopies();
+		return;
+	}
 
 	glGenTextures(1, &textureObj);
     glBindTexture(GL_TEXTURE_2D, textureObj);
-	if(numChannels == 1)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, imageWidth, imageHeight,
-			0, GL_RED, GL_UNSIGNED_BYTE, texImage.ptr());
-	else if(numChannels == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight,
-			0, GL_BGR, GL_UNSIGNED_BYTE, texImage.ptr());
-	else if(numChannels == 4)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight,
-			0, GL_BGRA, GL_UNSIGNED_BYTE, texImage.ptr());
+	if (isCompressed)
+	{
+		// The mip chain is precomputed, so no glGenerateMipmap below.
+		GLenum glFormat = TextureCompressor::GetGLFormat(compressedImage.format);
+		GLint numLevels = static_cast<GLint>(compressedImage.levels.size());
+		for (GLint level = 0; level < numLevels; ++level)
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, glFormat, max(1, imageWidth >> level), max(1, imageHeight >> level),
+				0, static_cast<GLsizei>(compressedImage.levels[level].size()), compressedImage.levels[level].data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	}
 	else
-		cerr << "[ERROR] Unsupport texture format" << endl;
+	{
+		// Level 0 only, unless the mip chain was built on the CPU. Mip rows are tightly packed.
+		GLint numLevels = mipLevels.empty() ? 1 : static_cast<GLint>(mipLevels.size());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (GLint level = 0; level < numLevels; ++level)
+		{
+			const cv::Mat& image = (level == 0) ? texImage : mipLevels[level];
+			if(numChannels == 1)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RED, image.cols, image.rows,
+					0, GL_RED, GL_UNSIGNED_BYTE, image.ptr());
+			else if(numChannels == 3)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, image.cols, image.rows,
+					0, GL_BGR, GL_UNSIGNED_BYTE, image.ptr());
+			else if(numChannels == 4)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, image.cols, image.rows,
+					0, GL_BGRA, GL_UNSIGNED_BYTE, image.ptr());
+			else
+				cerr << "[ERROR] Unsupport texture format" << endl;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (numLevels > 1)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	}
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -43,19 +204,245 @@ ImageTexture::ImageTexture(const string& filePath)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if (!isCompressed && mipLevels.empty())
+		glGenerateMipmap(GL_TEXTURE_2D);
 
 	glBindTexture(GL_TEXTURE_2D, textureObj);
+	ReleaseCpuCopies();
 }
 
-ImageTexture::~ImageTexture()
+// Create a texture object holding the levels from topLevel down. Levels the current object
+// already holds are copied on the GPU when ARB_copy_image is available; the others are
+// queued on the streamer (coarsest first) or uploaded right away without one.
+GLuint ImageTexture::CreateTextureObject(const int topLevel)
+{
+	const GLint numLevels = GetNumLevels() - topLevel;
+	const int width = max(1, imageWidth >> topLevel), height = max(1, imageHeight >> topLevel);
+	GLenum internalFormat = GL_RGB8;
+	GLenum pixelFormat = GL_BGR;
+	if (isCompressed)
+		internalFormat = TextureCompressor::GetGLFormat(compressedImage.format);
+	else if (numChannels == 1)
+	{
+		internalFormat = GL_R8;
+		pixelFormat = GL_RED;
+	}
+	else if (numChannels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		pixelFormat = GL_BGRA;
+	}
+
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, numLevels, internalFormat, width, height);
+	else
+	{
+		// Same layout with mutable storage.
+		for (GLint level = 0; level < numLevels; ++level)
+		{
+			int w = max(1, width >> level), h = max(1, height >> level);
+			if (isCompressed)
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0,
+					static_cast<GLsizei>(GetLevelBytes(topLevel + level)), nullptr);
+			else
+				glTexImage2D(GL_TEXTURE_2D, level, internalFormat, w, h, 0, pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+
+	// GL level i holds level topLevel + i of the image.
+	GLint numUploads = numLevels;
+	if (textureObj != 0 && GLEW_ARB_copy_image)
+	{
+		numUploads = min(numLevels, max(0, residentLevel - topLevel));
+		for (GLint level = numUploads; level < numLevels; ++level)
+			glCopyImageSubData(textureObj, GL_TEXTURE_2D, topLevel + level - residentLevel, 0, 0, 0,
+				texture, GL_TEXTURE_2D, level, 0, 0, 0, max(1, width >> level), max(1, height >> level), 1);
+	}
+	vector<TextureUploadLevel> levels;
+	for (GLint level = numUploads - 1; level >= 0; --level)
+	{
+		TextureUploadLevel upload;
+		upload.textureObj = texture;
+		upload.level = level;
+		upload.width = max(1, width >> level);
+		upload.height = max(1, height >> level);
+		upload.compressed = isCompressed;
+		if (isCompressed)
+		{
+			upload.format = internalFormat;
+			upload.data = compressedImage.levels[topLevel + level].data();
+			upload.rowBytes = static_cast<size_t>((upload.width + 3) / 4) * TextureCompressor::GetBlockBytes(compressedImage.format);
+			upload.rowPitch = upload.rowBytes;
+			upload.numRows = (upload.height + 3) / 4;
+		}
+		else
+		{
+			const cv::Mat& image = (topLevel + level == 0) ? texImage : mipLevels[topLevel + level];
+			upload.format = pixelFormat;
+			upload.data = image.ptr();
+			upload.rowBytes = static_cast<size_t>(image.cols) * numChannels;
+			upload.rowPitch = image.step;
+			upload.numRows = image.rows;
+		}
+		levels.push_back(upload);
+	}
+	// Without copied levels the coarsest one (a few bytes) is uploaded now, so that the texture
+	// is complete from the start; the streamer then brings in the finer levels.
+	size_t numSyncUploads = levels.size();
+	if (streamer != nullptr && !levels.empty())
+		numSyncUploads = (numUploads == numLevels) ? 1 : 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < numSyncUploads; ++i)
+	{
+		const TextureUploadLevel& upload = levels[i];
+		if (upload.compressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, 0, upload.width, upload.height, upload.format,
+				static_cast<GLsizei>(GetLevelBytes(topLevel + upload.level)), upload.data);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, 0, upload.width, upload.height,
+				upload.format, GL_UNSIGNED_BYTE, upload.data);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (numSyncUploads < levels.size())
+	{
+		// Until the finest level arrives the base level points at the finest complete one
+		// (the one uploaded above, or the finest copied one).
+		const GLint completeLevel = (numSyncUploads > 0) ? levels[0].level : numUploads;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, completeLevel);
+		streamer->Enqueue(this, vector<TextureUploadLevel>(levels.begin() + numSyncUploads, levels.end()));
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	return texture;
+}
+
+// Delete the GL texture, e.g. once its pixels were packed into a TextureArray.
+void ImageTexture::ReleaseTextureObject()
+{
+	if (streamer != nullptr)
+		streamer->Cancel(this);
+	if (pendingObj != 0)
+		glDeleteTextures(1, &pendingObj);
+	if (textureObj != 0)
+		glDeleteTextures(1, &textureObj);
+	pendingObj = 0;
+	textureObj = 0;
+	if (releaseCpuCopies)
+	{
+		texImage.release();
+		mipLevels.clear();
+		compressedImage.levels.clear();
+	}
+}
+
+// Keep only the levels from level down on the GPU. The new texture object replaces the
+// current one in Bind() once its levels are uploaded.
+bool ImageTexture::SetResidentLevel(const int level)
+{
+	const int topLevel = glm::clamp(level, 0, GetNumLevels() - 1);
+	if (textureObj == 0 || pendingObj != 0 || topLevel == residentLevel || GetStreaming())
+		return false;
+	pendingObj = CreateTextureObject(topLevel);
+	pendingLevel = topLevel;
+	if (!GetStreaming())
+		SwapPendingObject();
+	return true;
+}
+
+void ImageTexture::SwapPendingObject()
 {
 	glDeleteTextures(1, &textureObj);
+	textureObj = pendingObj;
+	residentLevel = pendingLevel;
+	pendingObj = 0;
+}
+
+// Bytes of one level on the GPU. Uncompressed RGB is assumed to be padded to RGBA by the driver.
+size_t ImageTexture::GetLevelBytes(const int level) const
+{
+	const int w = max(1, imageWidth >> level), h = max(1, imageHeight >> level);
+	if (isCompressed)
+		return static_cast<size_t>((w + 3) / 4) * ((h + 3) / 4) * TextureCompressor::GetBlockBytes(compressedImage.format);
+	size_t bytesPerTexel = (numChannels == 1) ? 1 : 4;
+	return static_cast<size_t>(w) * h * bytesPerTexel;
+}
+
+// Bytes of decoded or compressed pixels held in CPU memory.
+size_t ImageTexture::GetCpuBytes() const
+{
+	size_t numBytes = texImage.total() * texImage.elemSize();
+	// mipLevels[0] shares the pixels of texImage.
+	for (size_t level = 1; level < mipLevels.size(); ++level)
+		numBytes += mipLevels[level].total() * mipLevels[level].elemSize();
+	return numBytes + compressedImage.GetNumBytes();
+}
+
+// Drop the CPU pixels once the GPU holds every level. Textures under a residency manager
+// keep them, since finer levels are uploaded from them later.
+void ImageTexture::ReleaseCpuCopies()
+{
+	if (!releaseCpuCopies || residency != nullptr || textureObj == 0 || pendingObj != 0 || GetStreaming())
+		return;
+	texImage.release();
+	mipLevels.clear();
+	compressedImage.levels.clear();
+}
+
+// Level 0 as an 8-bit image (top row first): the CPU copy if it is kept, otherwise read back from
+// the GPU (must be called on the GL thread), or decoded from the file again.
+bool ImageTexture::FetchImage(cv::Mat& image) const
+{
+	if (!texImage.empty())
+	{
+		image = texImage;
+		return true;
+	}
+	if (textureObj != 0 && residentLevel == 0 && pendingObj == 0 && !GetStreaming())
+	{
+		// The driver decodes compressed formats; BC5 comes back as (x, y, 0, 1).
+		bool hasAlpha = isCompressed || numChannels == 4;
+		image.create(imageHeight, imageWidth, numChannels == 1 ? CV_8UC1 : (hasAlpha ? CV_8UC4 : CV_8UC3));
+		glBindTexture(GL_TEXTURE_2D, textureObj);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, 0, numChannels == 1 ? GL_RED : (hasAlpha ? GL_BGRA : GL_BGR), GL_UNSIGNED_BYTE, image.ptr());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return true;
+	}
+	return ImageDecoder::DecodeFile(texFilePath, image);
+}
+
+ImageTexture::~ImageTexture()
+{
+	if (streamer != nullptr)
+		streamer->Cancel(this);
+	if (residency != nullptr)
+		residency->Unregister(this);
+	if (virtualTexture != nullptr)
+	{
+		if (virtualTextures != nullptr)
+			virtualTextures->Unregister(virtualTexture);
+		delete virtualTexture;
+	}
+	if (pendingObj != 0)
+		glDeleteTextures(1, &pendingObj);
+	if (textureObj != 0)
+		glDeleteTextures(1, &textureObj);
 	texImage.release();
 }
 
 void ImageTexture::Bind(GLenum textureUnit)
 {
+	if (pendingObj != 0 && !GetStreaming())
+		SwapPendingObject();
+	if (releaseCpuCopies && GetCpuBytes() > 0)
+		ReleaseCpuCopies();
 	glActiveTexture(textureUnit);
     glBindTexture(GL_TEXTURE_2D, textureObj);
 }
@@ -63,9 +450,54 @@ void ImageTexture::Bind(GLenum textureUnit)
 void ImageTexture::Preview()
 {
 	string windowText = "[DEBUG] TexturePreview: " + texFilePath;
-	cv::Mat previewImg = cv::Mat(texImage.rows, texImage.cols, texImage.type());
-	cv::cvtColor(texImage, previewImg, cv::COLOR_BGR2RGB);
+	cv::Mat image, previewImg;
+	// Large textures are previewed from a reduced decode of the file.
+	const int reduction = ImageDecoder::GetReduction(imageWidth, imageHeight, 1024);
+	if (reduction > 1 ? !ImageDecoder::DecodeFile(texFilePath, image, reduction) : !FetchImage(image))
+		return;
+	if (image.channels() == 4)
+		cv::cvtColor(image, previewImg, cv::COLOR_BGRA2RGB);
+	else if (image.channels() == 3)
+		cv::cvtColor(image, previewImg, cv::COLOR_BGR2RGB);
+	else
+		previewImg = image;
 	cv::imshow(windowText, previewImg);
 	cv::waitKey(0);
 }
 
+
+// Estimated GPU memory of the levels from topLevel down (-1: the resident ones).
+size_t ImageTexture::GetGpuBytes(const int topLevel) const
+{
+	if (!successLoaded || (topLevel < 0 && textureObj == 0))
+		return 0;
+	if (!isCompressed && numMipLevels == 1)
+		return GetLevelBytes(0) * 4 / 3;
+	size_t numBytes = 0;
+	for (int level = (topLevel < 0) ? residentLevel : topLevel; level < GetNumLevels(); ++level)
+		numBytes += GetLevelBytes(level);
+	return numBytes;
+}
+
+// Show the format, size, GPU memory and compression quality of the texture.
+void ImageTexture::ShowInfo() const
+{
+	if (virtualTexture != nullptr)
+	{
+		cout << texFilePath << ": ";
+		virtualTexture->ShowInfo();
+		cout << endl;
+		return;
+	}
+	cout << texFilePath << ": " << TextureCompressor::GetFormatName(GetFormat()) << ", "
+		<< imageWidth << " x " << imageHeight << ", GPU " << GetGpuBytes() / 1024 << " KB, CPU " << GetCpuBytes() / 1024 << " KB";
+	if (residentLevel > 0)
+		cout << " (resident from level " << residentLevel << ")";
+	if (isCompressed)
+	{
+		stringstream ss;
+		ss << fixed << setprecision(2) << GetPSNR();
+		cout << ", PSNR " << ss.str() << " dB" << (fromCache ? " (cached)" : "");
+	}
+	cout << endl;
+}
@@ -2,32 +2,127 @@
 #define IMAGE_TEXTURE_H
 
 #include "headers.h"
+#include "texturecompressor.h"
+#include "texturecache.h"
+#include "mipmapbuilder.h"
+#include "texturestreamer.h"
+#include "imagedecoder.h"
+#include "virtualtexture.h"
 using namespace std;
 
+class TextureResidency;
+
+// How the texture is sampled (normal maps only need two channels; data maps such as opacity
+// are linear, so their mip levels are not filtered as sRGB).
+enum TextureUsage
+{
+	TEXTURE_USAGE_COLOR,
+	TEXTURE_USAGE_NORMAL,
+	TEXTURE_USAGE_DATA
+};
+
+// Block compression of new textures: FAST uses BC1/BC3, HIGH uses BC7 (normal maps are BC5).
+enum TextureCompression
+{
+	TEXTURE_COMPRESSION_NONE,
+	TEXTURE_COMPRESSION_FAST,
+	TEXTURE_COMPRESSION_HIGH
+};
+
 
 // Texture Declarations.
 class ImageTexture
 {
 public:
 	// Texture Public Methods.
-	ImageTexture(const string& filePath);
+	// With deferredUpload the constructor only decodes the image (safe on any thread)
+	// and Upload() must be called on the GL thread before the texture is bound.
+	// A compressed texture found in the TextureCache is not decoded at all, so its
+	// GetImage() is empty; so is the image of an uploaded texture once its CPU copies
+	// are released (see SetReleaseCpuCopies). FetchImage() works in both cases.
+	// Images keep the row order of the file (see ImageDecoder).
+	// With allowVirtual, a large color map becomes a VirtualTexture when a system is set
+	// (see SetVirtualTextures): it has no texture object and is sampled through the system.
+	ImageTexture(const string& filePath, const bool deferredUpload = false, const TextureUsage texUsage = TEXTURE_USAGE_COLOR,
+		const bool allowVirtual = false);
 	~ImageTexture();
 
 	bool GetSuccessLoaded() const { return successLoaded; }
+	bool GetUploaded() const { return textureObj != 0; }
+	bool GetStreaming() const { return streamer != nullptr && streamer->IsPending(this); }
 	string GetPath() const { return texFilePath; }
+	const cv::Mat& GetImage() const { return texImage; }
+	int GetWidth()  const { return imageWidth; }
+	int GetHeight() const { return imageHeight; }
+	TextureFormat GetFormat() const { return isCompressed ? compressedImage.format : TEXTURE_FORMAT_RGBA8; }
+	bool GetTwoChannel() const { return GetFormat() == TEXTURE_FORMAT_BC5; }
+	bool GetFromCache() const { return fromCache; }
+	float GetPSNR() const { return isCompressed ? compressedImage.psnr : 0.0f; }
+	int GetNumLevels() const { return numMipLevels; }
+	int GetResidentLevel() const { return residentLevel; }
+	bool GetChangingResidency() const { return pendingObj != 0; }
+	VirtualTexture* GetVirtual() const { return virtualTexture; }
+	size_t GetLevelBytes(const int level) const;
+	size_t GetGpuBytes(const int topLevel = -1) const;
+	size_t GetCpuBytes() const;
+	bool FetchImage(cv::Mat& image) const;
+	bool SetResidentLevel(const int level);
+	void Upload();
+	void ReleaseTextureObject();
 	void Bind(GLenum textureUnit);
 	void Preview();
+	void ShowInfo() const;
+
+	static void SetCompression(const TextureCompression mode) { compression = mode; }
+	static TextureCompression GetCompression() { return compression; }
+	// Build mipmaps on the CPU (in linear space) instead of with glGenerateMipmap.
+	// Compressed textures always use the CPU mip chain.
+	static void SetCpuMipmaps(const bool enabled) { cpuMipmaps = enabled; }
+	static void SetMipFilter(const MipFilter filter) { mipFilter = filter; }
+	static MipFilter GetMipFilter() { return mipFilter; }
+	// With a streamer, Upload() allocates immutable storage and queues the levels on it
+	// (coarsest first) instead of uploading them synchronously. Must outlive the textures.
+	static void SetStreamer(TextureStreamer* textureStreamer) { streamer = textureStreamer; }
+	// Release the decoded and compressed pixels once the texture is on the GPU.
+	static void SetReleaseCpuCopies(const bool enabled) { releaseCpuCopies = enabled; }
+	// With a residency manager, Upload() keeps only the coarse levels and the manager
+	// moves the resident level (see SetResidentLevel). Must outlive the textures.
+	static void SetResidency(TextureResidency* textureResidency) { residency = textureResidency; }
+	// Textures at least VIRTUAL_TEXTURE_MIN_SIZE large that allow it are paged by the system.
+	// Must outlive the textures.
+	static void SetVirtualTextures(VirtualTextureSystem* system) { virtualTextures = system; }
 
 private:
+	// Texture Private Methods.
+	bool LoadCompressed();
+	GLuint CreateTextureObject(const int topLevel);
+	void SwapPendingObject();
+	void ReleaseCpuCopies();
 	// Texture Private Data.
 	bool successLoaded;
 	string texFilePath;
 	GLuint textureObj;
+	GLuint pendingObj;
+	int residentLevel;
+	int pendingLevel;
 	int imageWidth;
 	int imageHeight;
 	int numChannels;
+	int numMipLevels;
 	cv::Mat texImage;
+	TextureUsage usage;
+	bool isCompressed;
+	bool fromCache;
+	CompressedImage compressedImage;
+	vector<cv::Mat> mipLevels;
+	VirtualTexture* virtualTexture;
+	static TextureCompression compression;
+	static bool releaseCpuCopies;
+	static bool cpuMipmaps;
+	static MipFilter mipFilter;
+	static TextureStreamer* streamer;
+	static TextureResidency* residency;
+	static VirtualTextureSystem* virtualTextures;
 };
 
 #endif
-
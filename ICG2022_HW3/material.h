@@ -35,6 +35,7 @@ public:
 		Kd = glm::vec3(0.0f, 0.0f, 0.0f);
 		Ks = glm::vec3(0.0f, 0.0f, 0.0f);
 		Ns = 0.0f;
+		opacity = 1.0f;
 
 		hadMapNorm = false;
 		mapNorm = nullptr;
@@ -59,6 +60,10 @@ public:
 		hadMapNs = false;
 		mapNs = nullptr;
 		mapNsPath = "";
+
+		hadMapD = false;
+		mapD = nullptr;
+		mapDPath = "";
 	}
 	~PhongMaterial()
 	{
@@ -87,12 +92,18 @@ public:
 			delete mapNs;
 			mapNs = nullptr;
 		}
+		if (mapD != nullptr)
+		{
+			delete mapD;
+			mapD = nullptr;
+		}
 	}
 
 	void SetKa(const glm::vec3 ka) { Ka = ka; }
 	void SetKd(const glm::vec3 kd) { Kd = kd; }
 	void SetKs(const glm::vec3 ks) { Ks = ks; }
 	void SetNs(const float n)      { Ns = n; }
+	void SetOpacity(const float d) { opacity = d; }
 
 	void SetHadMapNorm(bool hadMpNorm) { hadMapNorm = hadMpNorm; }
 	void SetMapNorm(ImageTexture* tex) { mapNorm = tex; }
@@ -114,10 +125,19 @@ public:
 	void SetMapNs(ImageTexture* tex) { mapNs = tex; }
 	void SetMapNsPath(const string& mpNsPath) { mapNsPath = mpNsPath; }
 
+	void SetHadMapD(bool hadMpD) { hadMapD = hadMpD; }
+	void SetMapD(ImageTexture* tex) { mapD = tex; }
+	void SetMapDPath(const string& mpDPath) { mapDPath = mpDPath; }
+
 	glm::vec3 GetKa() const { return Ka; }
 	glm::vec3 GetKd() const { return Kd; }
 	glm::vec3 GetKs() const { return Ks; }
 	float     GetNs() const { return Ns; }
+	float     GetOpacity() const { return opacity; }
+	// Drawn in the transparent pass (after the opaque surfaces) rather than with them.
+	bool GetTransparent() const { return opacity < 1.0f; }
+	// An opaque surface with an opacity map (a cutout, e.g. foliage) is alpha tested instead.
+	bool GetAlphaTested() const { return opacity >= 1.0f && hadMapD; }
 
 	bool GetHadMapNorm() const { return hadMapNorm; }
 	ImageTexture* GetMapNorm() const { return mapNorm; }
@@ -139,12 +159,17 @@ public:
 	ImageTexture* GetMapNs() const { return mapNs; }
 	string GetMapNsPath() const { return mapNsPath; }
 
+	bool GetHadMapD() const { return hadMapD; }
+	ImageTexture* GetMapD() const { return mapD; }
+	string GetMapDPath() const { return mapDPath; }
+
 private:
 	// PhongMaterial Private Data.
 	glm::vec3 Ka;
 	glm::vec3 Kd;
 	glm::vec3 Ks;
 	float Ns;
+	float opacity;
 
 	bool hadMapNorm;
 	ImageTexture* mapNorm;
@@ -165,6 +190,10 @@ private:
 	bool hadMapNs;
 	ImageTexture* mapNs;
 	string mapNsPath;
+
+	bool hadMapD;
+	ImageTexture* mapD;
+	string mapDPath;
 };
 
 
@@ -0,0 +1,221 @@
+#include "mipmapbuilder.h"
+using namespace std;
+
+#define SRGB_ENCODE_TABLE_SIZE 4096
+#define KAISER_ALPHA 4.0
+#define KAISER_RADIUS 4.0
+
+// SrgbTables Declarations (8-bit sRGB to linear, and quantized linear to 8-bit sRGB).
+struct SrgbTables
+{
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			double c = i / 255.0;
+			toLinear[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+		}
+		for (int i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i)
+		{
+			double c = i / (SRGB_ENCODE_TABLE_SIZE - 1.0);
+			double s = (c <= 0.0031308) ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+			toSrgb[i] = static_cast<unsigned char>(glm::clamp(s * 255.0 + 0.5, 0.0, 255.0));
+		}
+	}
+	float toLinear[256];
+	unsigned char toSrgb[SRGB_ENCODE_TABLE_SIZE];
+};
+
+static const SrgbTables& GetSrgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+// Zeroth-order modified Bessel function of the first kind (series expansion).
+static double BesselI0(const double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+MipmapBuilder::MipmapBuilder(const MipFilter mipFilter, const bool isSrgb)
+{
+	filter = mipFilter;
+	srgb = isSrgb;
+	buildTimeMs = 0.0;
+	// Taps at -3.5 .. 3.5 source texels from the center of the output texel.
+	const double pi = glm::pi<double>();
+	double sum = 0.0;
+	double weights[8];
+	for (int k = 0; k < 8; ++k)
+	{
+		double d = k - 3.5;
+		double x = d / 2.0;
+		double sinc = sin(pi * x) / (pi * x);
+		double r = d / KAISER_RADIUS;
+		weights[k] = sinc * BesselI0(KAISER_ALPHA * sqrt(max(0.0, 1.0 - r * r))) / BesselI0(KAISER_ALPHA);
+		sum += weights[k];
+	}
+	for (int k = 0; k < 8; ++k)
+		kaiserWeights[k] = static_cast<float>(weights[k] / sum);
+}
+
+MipmapBuilder::~MipmapBuilder()
+{}
+
+// Build the mip chain down to 1x1.
+void MipmapBuilder::Build(const cv::Mat& image, vector<cv::Mat>& mipLevels)
+{
+	CpuTimer timer;
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	const SrgbTables& tables = GetSrgbTables();
+	const int numChannels = image.channels();
+	const int floatType = CV_MAKETYPE(CV_32F, numChannels);
+	int numLevels = 1;
+	while (max(image.cols, image.rows) >> numLevels)
+		numLevels++;
+
+	// Decode level 0 to linear float.
+	vector<cv::Mat> floatLevels(numLevels);
+	floatLevels[0] = cv::Mat(image.rows, image.cols, floatType);
+	pool->ParallelFor(0, image.rows, 64, [&](int first, int last) {
+		for (int y = first; y < last; ++y)
+		{
+			const uchar* src = image.ptr<uchar>(y);
+			float* dst = floatLevels[0].ptr<float>(y);
+			for (int i = 0; i < image.cols * numChannels; ++i)
+			{
+				bool isColor = srgb && !(numChannels == 4 && (i & 3) == 3);
+				dst[i] = isColor ? tables.toLinear[src[i]] : src[i] * (1.0f / 255.0f);
+			}
+		}
+	});
+	// Each level is filtered from the previous one.
+	for (int level = 1; level < numLevels; ++level)
+	{
+		if (filter == MIP_FILTER_KAISER)
+			DownsampleKaiser(floatLevels[level - 1], floatLevels[level]);
+		else
+			DownsampleBox(floatLevels[level - 1], floatLevels[level]);
+	}
+
+	// Encode the rows of all levels back to 8-bit at once.
+	mipLevels.assign(numLevels, cv::Mat());
+	mipLevels[0] = image;
+	vector<int> firstRow(numLevels + 1, 0);
+	for (int level = 1; level < numLevels; ++level)
+	{
+		mipLevels[level] = cv::Mat(floatLevels[level].rows, floatLevels[level].cols, image.type());
+		firstRow[level + 1] = firstRow[level] + floatLevels[level].rows;
+	}
+	pool->ParallelFor(0, firstRow[numLevels], 64, [&](int first, int last) {
+		for (int row = first; row < last; ++row)
+		{
+			int level = static_cast<int>(upper_bound(firstRow.begin(), firstRow.end(), row) - firstRow.begin()) - 1;
+			int y = row - firstRow[level];
+			const float* src = floatLevels[level].ptr<float>(y);
+			uchar* dst = mipLevels[level].ptr<uchar>(y);
+			for (int i = 0; i < floatLevels[level].cols * numChannels; ++i)
+			{
+				float v = glm::clamp(src[i], 0.0f, 1.0f);
+				bool isColor = srgb && !(numChannels == 4 && (i & 3) == 3);
+				dst[i] = isColor ? tables.toSrgb[static_cast<int>(v * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)]
+					: static_cast<uchar>(v * 255.0f + 0.5f);
+			}
+		}
+	});
+	buildTimeMs = timer.GetElapsedMs();
+}
+
+// 2x2 average: the vertical sum is done SIMD_WIDTH floats at a time.
+void MipmapBuilder::DownsampleBox(const cv::Mat& src, cv::Mat& dst) const
+{
+	const int numChannels = src.channels();
+	const int dstWidth = max(1, src.cols / 2), dstHeight = max(1, src.rows / 2);
+	const int rowLength = src.cols * numChannels;
+	dst = cv::Mat(dstHeight, dstWidth, src.type());
+	ThreadPool::GetGlobal()->ParallelFor(0, dstHeight, 16, [&](int first, int last) {
+		vector<float> rowSum(rowLength);
+		for (int y = first; y < last; ++y)
+		{
+			const float* row0 = src.ptr<float>(min(2 * y, src.rows - 1));
+			const float* row1 = src.ptr<float>(min(2 * y + 1, src.rows - 1));
+			int i = 0;
+			for (; i + SIMD_WIDTH <= rowLength; i += SIMD_WIDTH)
+				(SimdFloat::Load(row0 + i) + SimdFloat::Load(row1 + i)).Store(&rowSum[i]);
+			for (; i < rowLength; ++i)
+				rowSum[i] = row0[i] + row1[i];
+			float* out = dst.ptr<float>(y);
+			for (int x = 0; x < dstWidth; ++x)
+			{
+				const float* p0 = &rowSum[min(2 * x, src.cols - 1) * numChannels];
+				const float* p1 = &rowSum[min(2 * x + 1, src.cols - 1) * numChannels];
+				for (int c = 0; c < numChannels; ++c)
+					out[x * numChannels + c] = 0.25f * (p0[c] + p1[c]);
+			}
+		}
+	});
+}
+
+// Separable 8-tap Kaiser-windowed sinc with clamp-to-edge: a horizontal pass into
+// a half-width image, then a vertical pass SIMD_WIDTH floats at a time.
+void MipmapBuilder::DownsampleKaiser(const cv::Mat& src, cv::Mat& dst) const
+{
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	const int numChannels = src.channels();
+	const int dstWidth = max(1, src.cols / 2), dstHeight = max(1, src.rows / 2);
+	const int rowLength = dstWidth * numChannels;
+	cv::Mat horizontal(src.rows, dstWidth, src.type());
+	pool->ParallelFor(0, src.rows, 16, [&](int first, int last) {
+		for (int y = first; y < last; ++y)
+		{
+			const float* in = src.ptr<float>(y);
+			float* out = horizontal.ptr<float>(y);
+			for (int x = 0; x < dstWidth; ++x)
+			{
+				// With a single source column the filter degenerates to a copy.
+				for (int c = 0; c < numChannels; ++c)
+				{
+					float sum = 0.0f;
+					for (int k = 0; k < 8; ++k)
+					{
+						int sx = glm::clamp(2 * x - 3 + k, 0, src.cols - 1);
+						sum += kaiserWeights[k] * in[sx * numChannels + c];
+					}
+					out[x * numChannels + c] = sum;
+				}
+			}
+		}
+	});
+	dst = cv::Mat(dstHeight, dstWidth, src.type());
+	pool->ParallelFor(0, dstHeight, 16, [&](int first, int last) {
+		for (int y = first; y < last; ++y)
+		{
+			const float* rows[8];
+			for (int k = 0; k < 8; ++k)
+				rows[k] = horizontal.ptr<float>(glm::clamp(2 * y - 3 + k, 0, src.rows - 1));
+			float* out = dst.ptr<float>(y);
+			int i = 0;
+			for (; i + SIMD_WIDTH <= rowLength; i += SIMD_WIDTH)
+			{
+				SimdFloat sum(0.0f);
+				for (int k = 0; k < 8; ++k)
+					sum = sum + SimdFloat(kaiserWeights[k]) * SimdFloat::Load(rows[k] + i);
+				sum.Store(out + i);
+			}
+			for (; i < rowLength; ++i)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 8; ++k)
+					sum += kaiserWeights[k] * rows[k][i];
+				out[i] = sum;
+			}
+		}
+	});
+}
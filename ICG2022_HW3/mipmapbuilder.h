@@ -0,0 +1,47 @@
+#ifndef MIPMAP_BUILDER_H
+#define MIPMAP_BUILDER_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "simd.h"
+#include "timer.h"
+using namespace std;
+
+enum MipFilter
+{
+	MIP_FILTER_BOX,    // 2x2 average.
+	MIP_FILTER_KAISER  // 8-tap Kaiser-windowed sinc, sharper minification.
+};
+
+
+// MipmapBuilder Declarations.
+// Builds a full mip chain of an 8-bit image (gray, BGR or BGRA) on the CPU. Filtering is
+// done in linear float: color channels are decoded from sRGB first (unless the image holds
+// data such as normals) and alpha is always linear. Rows of a level are filtered in
+// parallel with SIMD, and all levels are converted back to 8-bit in one parallel pass.
+class MipmapBuilder
+{
+public:
+	// MipmapBuilder Public Methods.
+	MipmapBuilder(const MipFilter mipFilter = MIP_FILTER_BOX, const bool isSrgb = true);
+	~MipmapBuilder();
+
+	double GetBuildTimeMs() const { return buildTimeMs; }
+
+	// mipLevels[0] shares the pixels of the input image.
+	void Build(const cv::Mat& image, vector<cv::Mat>& mipLevels);
+
+	static string GetFilterName(const MipFilter mipFilter) { return mipFilter == MIP_FILTER_KAISER ? "kaiser" : "box"; }
+
+private:
+	// MipmapBuilder Private Methods.
+	void DownsampleBox(const cv::Mat& src, cv::Mat& dst) const;
+	void DownsampleKaiser(const cv::Mat& src, cv::Mat& dst) const;
+	// MipmapBuilder Private Data.
+	MipFilter filter;
+	bool srgb;
+	float kaiserWeights[8];
+	double buildTimeMs;
+};
+
+#endif
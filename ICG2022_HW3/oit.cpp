@@ -0,0 +1,169 @@
+#include "oit.h"
+using namespace std;
+
+Oit::Oit(const int width, const int height)
+{
+	oitWidth = max(1, width);
+	oitHeight = max(1, height);
+	fboId = 0;
+	accumTexId = 0;
+	weightTexId = 0;
+	depthTexId = 0;
+	attachedDepthTexId = 0;
+	prevFboId = 0;
+	for (int i = 0; i < 4; ++i)
+		prevViewport[i] = 0;
+	complete = false;
+	CreateAttachments();
+
+	const glm::vec2 triangle[3] = { glm::vec2(-1.0f, -1.0f), glm::vec2(3.0f, -1.0f), glm::vec2(-1.0f, 3.0f) };
+	glGenBuffers(1, &triangleVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+}
+
+Oit::~Oit()
+{
+	DeleteAttachments();
+	glDeleteBuffers(1, &triangleVboId);
+}
+
+// Recreate the attachments with a new size.
+void Oit::Resize(const int width, const int height)
+{
+	if (width == oitWidth && height == oitHeight)
+		return;
+	DeleteAttachments();
+	oitWidth = max(1, width);
+	oitHeight = max(1, height);
+	CreateAttachments();
+}
+
+void Oit::DrawDepth(const function<void()>& drawDepth)
+{
+	// Only the depth attachment is written.
+	GLint callerFboId = 0;
+	GLint callerViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	glGetIntegerv(GL_VIEWPORT, callerViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	if (attachedDepthTexId != depthTexId)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexId, 0);
+		attachedDepthTexId = depthTexId;
+	}
+	glViewport(0, 0, oitWidth, oitHeight);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	drawDepth();
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+	glViewport(callerViewport[0], callerViewport[1], callerViewport[2], callerViewport[3]);
+}
+
+void Oit::BeginAccumulate(GLuint sceneDepthTexId)
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	if (attachedDepthTexId != sceneDepthTexId)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepthTexId, 0);
+		attachedDepthTexId = sceneDepthTexId;
+	}
+	glViewport(0, 0, oitWidth, oitHeight);
+	// Nothing accumulated: no color and full revealage.
+	const GLfloat accumClear[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLfloat weightClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, accumClear);
+	glClearBufferfv(GL_COLOR, 1, weightClear);
+	// The same blending for both targets (GL 3.3 has no per-target functions): colors add
+	// up, alphas multiply by (1 - alpha).
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Oit::EndAccumulate()
+{
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void Oit::Composite(OitCompositeShaderProg* shader)
+{
+	// Average color over the framebuffer: dst * revealage + color * (1 - revealage).
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	shader->Bind();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, accumTexId);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, weightTexId);
+	glUniform1i(shader->GetLocAccumMap(), 0);
+	glUniform1i(shader->GetLocWeightMap(), 1);
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (const GLvoid*)0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisableVertexAttribArray(0);
+	shader->UnBind();
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void Oit::CreateAttachments()
+{
+	// The composite fetches texels, so there is no filtering.
+	const GLenum formats[3] = { GL_RGBA16F, GL_R16F, GL_DEPTH_COMPONENT24 };
+	const GLenum pixelFormats[3] = { GL_RGBA, GL_RED, GL_DEPTH_COMPONENT };
+	GLuint* texIds[3] = { &accumTexId, &weightTexId, &depthTexId };
+	for (int i = 0; i < 3; ++i)
+	{
+		glGenTextures(1, texIds[i]);
+		glBindTexture(GL_TEXTURE_2D, *texIds[i]);
+		if (GLEW_ARB_texture_storage)
+			glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], oitWidth, oitHeight);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, formats[i], oitWidth, oitHeight, 0, pixelFormats[i], GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	glGenFramebuffers(1, &fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexId, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexId, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexId, 0);
+	attachedDepthTexId = depthTexId;
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (!complete)
+		cerr << "[ERROR] Incomplete transparency framebuffer: " << oitWidth << " x " << oitHeight << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+void Oit::DeleteAttachments()
+{
+	glDeleteFramebuffers(1, &fboId);
+	glDeleteTextures(1, &accumTexId);
+	glDeleteTextures(1, &weightTexId);
+	glDeleteTextures(1, &depthTexId);
+	fboId = 0;
+	accumTexId = 0;
+	weightTexId = 0;
+	depthTexId = 0;
+	attachedDepthTexId = 0;
+	complete = false;
+}
@@ -0,0 +1,54 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include "headers.h"
+#include "shaderprog.h"
+using namespace std;
+
+
+// Oit Declarations.
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013). Between
+// BeginAccumulate() and EndAccumulate() the transparent surfaces are drawn in any order,
+// depth tested against the opaque depth without writing it, into two targets: the sum of the
+// weighted premultiplied colors with the product of (1 - alpha) in the alpha channel, and the
+// sum of the weighted alphas. Composite() then blends their average over the framebuffer.
+// The opaque depth is the G-buffer depth or the one drawn by DrawDepth().
+class Oit
+{
+public:
+	// Oit Public Methods.
+	Oit(const int width, const int height);
+	~Oit();
+
+	int GetWidth()  const { return oitWidth; }
+	int GetHeight() const { return oitHeight; }
+	GLuint GetDepthTex() const { return depthTexId; }
+	bool GetComplete() const { return complete; }
+	size_t GetGpuBytes() const { return static_cast<size_t>(oitWidth) * oitHeight * (8 + 2 + 4); }
+
+	void Resize(const int width, const int height);
+	// Fill the depth texture of the pass; drawDepth draws the opaque surfaces.
+	void DrawDepth(const function<void()>& drawDepth);
+	void BeginAccumulate(GLuint sceneDepthTexId);
+	void EndAccumulate();
+	void Composite(OitCompositeShaderProg* shader);
+
+private:
+	// Oit Private Methods.
+	void CreateAttachments();
+	void DeleteAttachments();
+	// Oit Private Data.
+	int oitWidth;
+	int oitHeight;
+	GLuint fboId;
+	GLuint accumTexId;
+	GLuint weightTexId;
+	GLuint depthTexId;
+	GLuint attachedDepthTexId;
+	GLuint triangleVboId;
+	GLint prevFboId;
+	GLint prevViewport[4];
+	bool complete;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "pboreadback.h"
+using namespace std;
+
+PboReadback::PboReadback(const int nSlots)
+{
+	head = 0;
+	numPending = 0;
+	nextFrameId = 0;
+	slots.resize(max(1, nSlots));
+	for (Slot& slot : slots)
+		glGenBuffers(1, &slot.pboId);
+}
+
+PboReadback::~PboReadback()
+{
+	for (Slot& slot : slots)
+	{
+		if (slot.fence != nullptr)
+			glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.pboId);
+	}
+	slots.clear();
+}
+
+// Queue a readback of the color attachment of fboId (0 is the back buffer).
+// Returns false when all slots are in flight; Poll() one first.
+bool PboReadback::Request(const GLuint fboId, const int width, const int height, const string& tag)
+{
+	if (IsFull())
+		return false;
+	Slot& slot = slots[(head + numPending) % slots.size()];
+	size_t bytes = static_cast<size_t>(width) * height * 4;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+	if (bytes > slot.capacity)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+		slot.capacity = bytes;
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fboId);
+	glReadBuffer(fboId == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.frameId = nextFrameId++;
+	slot.tag = tag;
+	numPending++;
+	return true;
+}
+
+// Retrieve the oldest pending readback if its fence has signaled (or wait for it).
+bool PboReadback::Poll(ReadbackFrame& frame, const bool wait)
+{
+	if (numPending == 0)
+		return false;
+	Slot& slot = slots[head];
+	GLuint64 timeout = wait ? 1000000000ull : 0;
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (wait && status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return false;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	frame.frameId = slot.frameId;
+	frame.tag = slot.tag;
+	frame.pixels.create(slot.height, slot.width, CV_8UC4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pboId);
+	void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<size_t>(slot.width) * slot.height * 4, GL_MAP_READ_BIT);
+	if (data != nullptr)
+	{
+		memcpy(frame.pixels.ptr(), data, frame.pixels.total() * frame.pixels.elemSize());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+		cerr << "[ERROR] Failed to map the readback buffer of frame " << slot.frameId << endl;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	head = (head + 1) % slots.size();
+	numPending--;
+	return data != nullptr;
+}
+
+// Encode a finished readback into an image file (thread-safe, no GL calls).
+bool PboReadback::SaveFrame(const ReadbackFrame& frame, const string& filePath)
+{
+	if (frame.pixels.empty())
+		return false;
+	cv::Mat image;
+	cv::flip(frame.pixels, image, 0);
+	string fileType = filePath.substr(filePath.find_last_of('.') + 1);
+	if (fileType != "png" && fileType != "PNG")
+		cv::cvtColor(image, image, cv::COLOR_BGRA2BGR);
+	bool success = false;
+	try
+	{
+		success = cv::imwrite(filePath, image);
+	}
+	catch (const cv::Exception& e)
+	{
+		cerr << "[ERROR] " << e.what() << endl;
+	}
+	if (!success)
+		cerr << "[ERROR] Failed to write image: " << filePath << endl;
+	return success;
+}
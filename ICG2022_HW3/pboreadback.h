@@ -0,0 +1,61 @@
+#ifndef PBO_READBACK_H
+#define PBO_READBACK_H
+
+#include "headers.h"
+using namespace std;
+
+
+// ReadbackFrame Declarations (pixels of a finished readback, bottom-up BGRA).
+struct ReadbackFrame
+{
+	ReadbackFrame()
+	{
+		frameId = 0;
+		tag = "";
+	}
+	unsigned int frameId;
+	string tag;
+	cv::Mat pixels;
+};
+
+
+// PboReadback Declarations.
+// A ring of pixel-pack buffers: Request() starts an asynchronous glReadPixels into
+// the next free buffer and fences it, Poll() maps buffers whose fence has signaled,
+// so the GPU->CPU copy overlaps the following frames instead of stalling the caller.
+class PboReadback
+{
+public:
+	// PboReadback Public Methods.
+	PboReadback(const int nSlots = 3);
+	~PboReadback();
+
+	int GetNumSlots()   const { return static_cast<int>(slots.size()); }
+	int GetNumPending() const { return numPending; }
+	bool IsFull() const { return numPending == static_cast<int>(slots.size()); }
+
+	bool Request(const GLuint fboId, const int width, const int height, const string& tag);
+	bool Poll(ReadbackFrame& frame, const bool wait);
+
+	static bool SaveFrame(const ReadbackFrame& frame, const string& filePath);
+
+private:
+	// PboReadback Private Declarations.
+	struct Slot
+	{
+		GLuint pboId = 0;
+		GLsync fence = nullptr;
+		size_t capacity = 0;
+		int width = 0;
+		int height = 0;
+		unsigned int frameId = 0;
+		string tag;
+	};
+	// PboReadback Private Data.
+	vector<Slot> slots;
+	int head;
+	int numPending;
+	unsigned int nextFrameId;
+};
+
+#endif
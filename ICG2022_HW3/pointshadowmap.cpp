@@ -0,0 +1,160 @@
+#include "pointshadowmap.h"
+using namespace std;
+
+// Axis and up vector of each face, in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + face.
+static const glm::vec3 faceAxes[6] = {
+	glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(-1.0f,  0.0f,  0.0f),
+	glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3( 0.0f, -1.0f,  0.0f),
+	glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3( 0.0f,  0.0f, -1.0f)
+};
+static const glm::vec3 faceUps[6] = {
+	glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3( 0.0f, -1.0f,  0.0f),
+	glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3( 0.0f,  0.0f, -1.0f),
+	glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3( 0.0f, -1.0f,  0.0f)
+};
+static const int allFaces = (1 << 6) - 1;
+
+PointShadowMap::PointShadowMap(const int size)
+{
+	mapSize = size;
+	for (int face = 0; face < 6; ++face)
+		faceMatrices[face] = glm::mat4x4(1.0f);
+	valid = false;
+	lightPos = glm::vec3(0.0f, 0.0f, 0.0f);
+	farPlane = 1.0f;
+	casterId = nullptr;
+	casterWorld = glm::mat4x4(1.0f);
+	casterBoundsCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	casterBoundsRadius = 0.0f;
+	numFrames = 0;
+	numUpdates = 0;
+	numFacesDrawn = 0;
+
+	// Depth comparison in the sampler, bilinear between the four nearest results.
+	glGenTextures(1, &cubeTexId);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_DEPTH_COMPONENT24, mapSize, mapSize);
+	else
+	{
+		for (int face = 0; face < 6; ++face)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, 0,
+				GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	// All faces attached as layers.
+	glGenFramebuffers(1, &fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeTexId, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr << "[ERROR] Incomplete point shadow framebuffer: " << mapSize << " x " << mapSize << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+PointShadowMap::~PointShadowMap()
+{
+	glDeleteFramebuffers(1, &fboId);
+	glDeleteTextures(1, &cubeTexId);
+}
+
+void PointShadowMap::Update(const glm::vec3& position, const float zFar, const void* caster, const glm::mat4x4& casterMatrix,
+	const glm::vec3& casterCenter, const float casterRadius, const function<void(int)>& drawCasters)
+{
+	numFrames++;
+	int faceMask = 0;
+	if (!valid || position != lightPos || zFar != farPlane || caster != casterId)
+		faceMask = allFaces;
+	else if (casterMatrix != casterWorld)
+		faceMask = GetFaceMask(casterBoundsCenter, casterBoundsRadius) | GetFaceMask(casterCenter, casterRadius);
+	valid = true;
+	lightPos = position;
+	farPlane = zFar;
+	casterId = caster;
+	casterWorld = casterMatrix;
+	casterBoundsCenter = casterCenter;
+	casterBoundsRadius = casterRadius;
+	if (faceMask == 0)
+		return;
+
+	const glm::mat4x4 faceProj = glm::perspective(glm::radians(90.0f), 1.0f, 0.01f * farPlane, farPlane);
+	for (int face = 0; face < 6; ++face)
+		faceMatrices[face] = faceProj * glm::lookAt(lightPos, lightPos + faceAxes[face], faceUps[face]);
+
+	GLint prevFboId = 0;
+	GLint prevViewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glViewport(0, 0, mapSize, mapSize);
+	updateTimer.Begin();
+	// A clear covers every layer, so dirty faces are cleared one at a time.
+	if (faceMask == allFaces)
+		glClear(GL_DEPTH_BUFFER_BIT);
+	else
+	{
+		for (int face = 0; face < 6; ++face)
+		{
+			if ((faceMask & (1 << face)) == 0)
+				continue;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubeTexId, 0);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeTexId, 0);
+	}
+	drawCasters(faceMask);
+	updateTimer.End();
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+
+	numUpdates++;
+	for (int face = 0; face < 6; ++face)
+		numFacesDrawn += (faceMask >> face) & 1;
+}
+
+// Faces whose frustum a sphere overlaps: a face sees the directions where its axis is the
+// major one, bounded by four planes at 45 degrees through the light.
+int PointShadowMap::GetFaceMask(const glm::vec3& center, const float radius) const
+{
+	const glm::vec3 p = center - lightPos;
+	const float margin = radius * 1.41421356f;
+	int mask = 0;
+	for (int face = 0; face < 6; ++face)
+	{
+		const int axis = face / 2;
+		const float major = (face % 2 == 0) ? p[axis] : -p[axis];
+		const float minor0 = abs(p[(axis + 1) % 3]);
+		const float minor1 = abs(p[(axis + 2) % 3]);
+		if (major + margin >= minor0 && major + margin >= minor1)
+			mask |= 1 << face;
+	}
+	return mask;
+}
+
+void PointShadowMap::Bind(GLenum unit)
+{
+	glActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTexId);
+}
+
+void PointShadowMap::ShowInfo()
+{
+	cout << "Point shadow cubemap (" << mapSize << " x " << mapSize << "): " << numUpdates << " of " << numFrames
+		<< " frames updated, " << (numUpdates > 0 ? static_cast<double>(numFacesDrawn) / numUpdates : 0.0)
+		<< " faces per update, " << updateTimer.GetAverageMs() << " ms GPU per update" << endl;
+	numFrames = 0;
+	numUpdates = 0;
+	numFacesDrawn = 0;
+	updateTimer.Reset();
+}
@@ -0,0 +1,65 @@
+#ifndef POINT_SHADOW_MAP_H
+#define POINT_SHADOW_MAP_H
+
+#include "headers.h"
+#include "timer.h"
+using namespace std;
+
+
+// PointShadowMap Declarations.
+// Shadow cubemap of a point light: the distance to the light over the far plane in each face.
+// All six faces are rendered in one pass (point_shadow.gs sends every triangle to the faces
+// of faceMask through gl_Layer), and only when something they see has changed: a light that
+// moves redraws every face, a caster that moves redraws the faces its bounding sphere
+// overlaps before or after the move, and otherwise the map is reused as it is.
+class PointShadowMap
+{
+public:
+	// PointShadowMap Public Methods.
+	PointShadowMap(const int size);
+	~PointShadowMap();
+
+	int GetSize() const { return mapSize; }
+	size_t GetGpuBytes() const { return static_cast<size_t>(mapSize) * mapSize * 4 * 6; }
+	// World to clip space of each face (for point_shadow.gs).
+	const glm::mat4x4* GetFaceMatrices() const { return faceMatrices; }
+	glm::vec3 GetLightPos() const { return lightPos; }
+	float GetFarPlane() const { return farPlane; }
+	// World size of a texel at a distance of 1 from the light.
+	float GetTexelSize() const { return 2.0f / mapSize; }
+	int GetNumFrames() const { return numFrames; }
+
+	// Bring the map up to date with the light and the caster (a mesh, its world matrix and
+	// its world bounding sphere). drawCasters draws the caster into the faces of a mask.
+	void Update(const glm::vec3& position, const float zFar, const void* caster, const glm::mat4x4& casterMatrix,
+		const glm::vec3& casterCenter, const float casterRadius, const function<void(int)>& drawCasters);
+	// Redraw every face at the next update.
+	void Invalidate() { valid = false; }
+	void Bind(GLenum unit);
+	// Print the updates and their GPU time since the last call.
+	void ShowInfo();
+
+private:
+	// PointShadowMap Private Methods.
+	int GetFaceMask(const glm::vec3& center, const float radius) const;
+	// PointShadowMap Private Data.
+	int mapSize;
+	GLuint cubeTexId;
+	GLuint fboId;
+	glm::mat4x4 faceMatrices[6];
+	// What the map holds.
+	bool valid;
+	glm::vec3 lightPos;
+	float farPlane;
+	const void* casterId;
+	glm::mat4x4 casterWorld;
+	glm::vec3 casterBoundsCenter;
+	float casterBoundsRadius;
+	// Statistics.
+	GpuTimer updateTimer;
+	int numFrames;
+	int numUpdates;
+	int numFacesDrawn;
+};
+
+#endif
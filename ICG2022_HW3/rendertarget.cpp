@@ -0,0 +1,91 @@
+#include "rendertarget.h"
+using namespace std;
+
+RenderTarget::RenderTarget(const int width, const int height, const GLenum colorFormat)
+{
+	rtWidth = width;
+	rtHeight = height;
+	rtColorFormat = colorFormat;
+	fboId = 0;
+	colorTexId = 0;
+	depthRboId = 0;
+	complete = false;
+	prevFboId = 0;
+	for (int i = 0; i < 4; ++i)
+		prevViewport[i] = 0;
+	CreateAttachments();
+}
+
+RenderTarget::~RenderTarget()
+{
+	DeleteAttachments();
+}
+
+// Recreate the attachments with a new size.
+void RenderTarget::Resize(const int width, const int height)
+{
+	if (width == rtWidth && height == rtHeight)
+		return;
+	DeleteAttachments();
+	rtWidth = width;
+	rtHeight = height;
+	CreateAttachments();
+}
+
+// Render into the target (the viewport is set to the target size).
+void RenderTarget::Bind()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glViewport(0, 0, rtWidth, rtHeight);
+}
+
+// Restore the previous framebuffer and viewport.
+void RenderTarget::UnBind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void RenderTarget::CreateAttachments()
+{
+	glGenTextures(1, &colorTexId);
+	glBindTexture(GL_TEXTURE_2D, colorTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, rtColorFormat, rtWidth, rtHeight);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, rtColorFormat, rtWidth, rtHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &depthRboId);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRboId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, rtWidth, rtHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	glGenFramebuffers(1, &fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexId, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRboId);
+	complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (!complete)
+		cerr << "[ERROR] Incomplete render target: " << rtWidth << " x " << rtHeight << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+void RenderTarget::DeleteAttachments()
+{
+	glDeleteFramebuffers(1, &fboId);
+	glDeleteRenderbuffers(1, &depthRboId);
+	glDeleteTextures(1, &colorTexId);
+	fboId = 0;
+	depthRboId = 0;
+	colorTexId = 0;
+	complete = false;
+}
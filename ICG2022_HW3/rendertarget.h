@@ -0,0 +1,42 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include "headers.h"
+using namespace std;
+
+
+// RenderTarget Declarations (an offscreen framebuffer with a color texture and a depth buffer).
+class RenderTarget
+{
+public:
+	// RenderTarget Public Methods.
+	RenderTarget(const int width, const int height, const GLenum colorFormat = GL_RGBA8);
+	~RenderTarget();
+
+	int GetWidth()  const { return rtWidth; }
+	int GetHeight() const { return rtHeight; }
+	GLuint GetFboId() const { return fboId; }
+	GLuint GetColorTex() const { return colorTexId; }
+	bool GetComplete() const { return complete; }
+
+	void Resize(const int width, const int height);
+	void Bind();
+	void UnBind();
+
+private:
+	// RenderTarget Private Methods.
+	void CreateAttachments();
+	void DeleteAttachments();
+	// RenderTarget Private Data.
+	int rtWidth;
+	int rtHeight;
+	GLenum rtColorFormat;
+	GLuint fboId;
+	GLuint colorTexId;
+	GLuint depthRboId;
+	GLint prevFboId;
+	GLint prevViewport[4];
+	bool complete;
+};
+
+#endif
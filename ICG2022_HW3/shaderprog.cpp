@@ -14,11 +14,12 @@ ShaderProg::ShaderProg()
         exit(1);
     }
     locMVP = -1;
+    gsId = 0;
 }
 
 ShaderProg::~ShaderProg() { glDeleteProgram(shaderProgId); }
 
-bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePath)
+bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePath, const string& defines)
 {
     // Load the vertex shader from a source file and attach it to the shader program.
     string vs = "", fs = "";
@@ -27,6 +28,7 @@ bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePat
         cerr << "[ERROR] Failed to load vertex shader source: " << vsFilePath << endl;
         return false;
     }
+    vs.insert(vs.find('\n') + 1, defines);
     GLuint vsId = AddShader(vs, GL_VERTEX_SHADER);
 
     // Load the fragment shader from a source file and attach it to the shader program.
@@ -35,6 +37,7 @@ bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePat
         cerr << "[ERROR] Failed to load fragment shader source: " << fsFilePath << endl;
         return false;
     };
+    fs.insert(fs.find('\n') + 1, defines);
     GLuint fsId = AddShader(fs, GL_FRAGMENT_SHADER);
 
     // Link and compile shader programs.
@@ -52,6 +55,11 @@ bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePat
     // Now the program already has all stage information, we can delete the shaders now.
     glDeleteShader(vsId);
     glDeleteShader(fsId);
+    if (gsId != 0)
+    {
+        glDeleteShader(gsId);
+        gsId = 0;
+    }
 
     // Validate program.
     glValidateProgram(shaderProgId);
@@ -69,6 +77,18 @@ bool ShaderProg::LoadFromFiles(const string& vsFilePath, const string& fsFilePat
     return true;
 }
 
+bool ShaderProg::AddGeometryShaderFromFile(const string& gsFilePath)
+{
+    string gs = "";
+    if (!LoadShaderTextFromFile(gsFilePath, gs))
+    {
+        cerr << "[ERROR] Failed to load geometry shader source: " << gsFilePath << endl;
+        return false;
+    }
+    gsId = AddShader(gs, GL_GEOMETRY_SHADER);
+    return true;
+}
+
 void ShaderProg::GetUniformVariableLocation()
 {
     locMVP = glGetUniformLocation(shaderProgId, "MVP");
@@ -113,26 +133,32 @@ bool ShaderProg::LoadShaderTextFromFile(const string& filePath, string& sourceTe
         cerr << "[ERROR] Failed to open shader source file: " << filePath << endl;
         return false;
     }
-    sourceText.assign((istreambuf_iterator< char >(sourceFile)), istreambuf_iterator< char >());
+    // Expand #include "file" lines so that shaders can share code.
+    const string directory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+    sourceText.clear();
+    string line;
+    while (getline(sourceFile, line))
+    {
+        if (line.compare(0, 9, "#include ") != 0)
+        {
+            sourceText += line + "\n";
+            continue;
+        }
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        string includedText = "";
+        if (open == string::npos || close <= open
+            || !LoadShaderTextFromFile(directory + line.substr(open + 1, close - open - 1), includedText))
+        {
+            cerr << "[ERROR] Failed to include shader source: " << line << " in " << filePath << endl;
+            return false;
+        }
+        sourceText += includedText;
+    }
     return true;
 }
 
 
-FillColorShaderProg::FillColorShaderProg()
-{
-    locFillColor = -1;
-}
-
-FillColorShaderProg::~FillColorShaderProg()
-{}
-
-void FillColorShaderProg::GetUniformVariableLocation()
-{
-    ShaderProg::GetUniformVariableLocation();
-    locFillColor = glGetUniformLocation(shaderProgId, "fillColor");
-}
-
-
 PhongShadingShaderProg::PhongShadingShaderProg()
 {
     locM = -1;
@@ -143,9 +169,11 @@ PhongShadingShaderProg::PhongShadingShaderProg()
     locKd = -1;
     locKs = -1;
     locNs = -1;
+    locOpacity = -1;
 
     locHadMapNorm = -1;
     locMapNorm = -1;
+    locMapNormTwoChannel = -1;
     locHadMapKa = -1;
     locMapKa = -1;
     locHadMapKd = -1;
@@ -154,19 +182,60 @@ PhongShadingShaderProg::PhongShadingShaderProg()
     locMapKs = -1;
     locHadMapNs = -1;
     locMapNs = -1;
+    locHadMapD = -1;
+    locMapD = -1;
+    locMapNormArray = -1;
+    locMapNormLayer = -1;
+    locMapKaArray = -1;
+    locMapKaLayer = -1;
+    locMapKdArray = -1;
+    locMapKdLayer = -1;
+    locMapKsArray = -1;
+    locMapKsLayer = -1;
+    locMapNsArray = -1;
+    locMapNsLayer = -1;
+    locMapKdVirtual = -1;
+    locVtIndirection = -1;
+    locVtPhysical = -1;
+    locVtSize = -1;
+    locVtMaxLevel = -1;
 
     locAmbientLight = -1;
-    locPointLightPos = -1;
-    locPointLightIntensity = -1;
-
-    locSpotLightPos = -1;
-    locSpotLightIntensity = -1;
-    locSpotLightDir = -1;
-    locCutoffStart = -1;
-    locTotalWidth = -1;
+    locLightData = -1;
+    locNumLights = -1;
+    locClusterData = -1;
+    locUseClusters = -1;
+    locClusterGrid = -1;
+    locClusterTileScale = -1;
+    locClusterDepthScale = -1;
+    locClusterDepthBias = -1;
+    locCameraDir = -1;
 
     locDirLightDir = -1;
     locDirLightRadiance = -1;
+    locUseShadows = -1;
+    locDirShadowMap = -1;
+    locDirShadowMatrices = -1;
+    locCascadeSplits = -1;
+    locCascadeTexelSizes = -1;
+    locSpotShadowMap = -1;
+    locSpotShadowMatrix = -1;
+    locSpotShadowTexelSize = -1;
+    locSpotShadowLight = -1;
+    locUsePointShadow = -1;
+    locPointShadowMap = -1;
+    locPointShadowLight = -1;
+    locPointShadowFar = -1;
+    locPointShadowTexelSize = -1;
+    locUseIbl = -1;
+    locShIrradiance = -1;
+    locEnvSpecular = -1;
+    locEnvSpecularMaxLevel = -1;
+    locEnvRotation = -1;
+    locUseOcclusion = -1;
+    locUseSsao = -1;
+    locAoMap = -1;
+    locInvProjMatrix = -1;
 }
 
 PhongShadingShaderProg::~PhongShadingShaderProg()
@@ -183,9 +252,11 @@ void PhongShadingShaderProg::GetUniformVariableLocation()
     locKd = glGetUniformLocation(shaderProgId, "Kd");
     locKs = glGetUniformLocation(shaderProgId, "Ks");
     locNs = glGetUniformLocation(shaderProgId, "Ns");
+    locOpacity = glGetUniformLocation(shaderProgId, "opacity");
 
     locHadMapNorm = glGetUniformLocation(shaderProgId, "hadMapNorm");
     locMapNorm = glGetUniformLocation(shaderProgId, "mapNorm");
+    locMapNormTwoChannel = glGetUniformLocation(shaderProgId, "mapNormTwoChannel");
     locHadMapKa = glGetUniformLocation(shaderProgId, "hadMapKa");
     locMapKa = glGetUniformLocation(shaderProgId, "mapKa");
     locHadMapKd = glGetUniformLocation(shaderProgId, "hadMapKd");
@@ -194,19 +265,60 @@ void PhongShadingShaderProg::GetUniformVariableLocation()
     locMapKs = glGetUniformLocation(shaderProgId, "mapKs");
     locHadMapNs = glGetUniformLocation(shaderProgId, "hadMapNs");
     locMapNs = glGetUniformLocation(shaderProgId, "mapNs");
+    locHadMapD = glGetUniformLocation(shaderProgId, "hadMapD");
+    locMapD = glGetUniformLocation(shaderProgId, "mapD");
+    locMapNormArray = glGetUniformLocation(shaderProgId, "mapNormArray");
+    locMapNormLayer = glGetUniformLocation(shaderProgId, "mapNormLayer");
+    locMapKaArray = glGetUniformLocation(shaderProgId, "mapKaArray");
+    locMapKaLayer = glGetUniformLocation(shaderProgId, "mapKaLayer");
+    locMapKdArray = glGetUniformLocation(shaderProgId, "mapKdArray");
+    locMapKdLayer = glGetUniformLocation(shaderProgId, "mapKdLayer");
+    locMapKsArray = glGetUniformLocation(shaderProgId, "mapKsArray");
+    locMapKsLayer = glGetUniformLocation(shaderProgId, "mapKsLayer");
+    locMapNsArray = glGetUniformLocation(shaderProgId, "mapNsArray");
+    locMapNsLayer = glGetUniformLocation(shaderProgId, "mapNsLayer");
+    locMapKdVirtual = glGetUniformLocation(shaderProgId, "mapKdVirtual");
+    locVtIndirection = glGetUniformLocation(shaderProgId, "vtIndirection");
+    locVtPhysical = glGetUniformLocation(shaderProgId, "vtPhysical");
+    locVtSize = glGetUniformLocation(shaderProgId, "vtSize");
+    locVtMaxLevel = glGetUniformLocation(shaderProgId, "vtMaxLevel");
 
     locAmbientLight = glGetUniformLocation(shaderProgId, "ambientLight");
-    locPointLightPos = glGetUniformLocation(shaderProgId, "pointLightPos");
-    locPointLightIntensity = glGetUniformLocation(shaderProgId, "pointLightIntensity");
-
-    locSpotLightPos = glGetUniformLocation(shaderProgId, "spotLightPos");
-    locSpotLightIntensity = glGetUniformLocation(shaderProgId, "spotLightIntensity");
-    locSpotLightDir = glGetUniformLocation(shaderProgId, "spotLightDir");
-    locCutoffStart = glGetUniformLocation(shaderProgId, "cutoffStart");
-    locTotalWidth = glGetUniformLocation(shaderProgId, "totalWidth");
+    locLightData = glGetUniformLocation(shaderProgId, "lightData");
+    locNumLights = glGetUniformLocation(shaderProgId, "numLights");
+    locClusterData = glGetUniformLocation(shaderProgId, "clusterData");
+    locUseClusters = glGetUniformLocation(shaderProgId, "useClusters");
+    locClusterGrid = glGetUniformLocation(shaderProgId, "clusterGrid");
+    locClusterTileScale = glGetUniformLocation(shaderProgId, "clusterTileScale");
+    locClusterDepthScale = glGetUniformLocation(shaderProgId, "clusterDepthScale");
+    locClusterDepthBias = glGetUniformLocation(shaderProgId, "clusterDepthBias");
+    locCameraDir = glGetUniformLocation(shaderProgId, "cameraDir");
 
     locDirLightDir = glGetUniformLocation(shaderProgId, "dirLightDir");
     locDirLightRadiance = glGetUniformLocation(shaderProgId, "dirLightRadiance");
+    locUseShadows = glGetUniformLocation(shaderProgId, "useShadows");
+    locDirShadowMap = glGetUniformLocation(shaderProgId, "dirShadowMap");
+    locDirShadowMatrices = glGetUniformLocation(shaderProgId, "dirShadowMatrices");
+    locCascadeSplits = glGetUniformLocation(shaderProgId, "cascadeSplits");
+    locCascadeTexelSizes = glGetUniformLocation(shaderProgId, "cascadeTexelSizes");
+    locSpotShadowMap = glGetUniformLocation(shaderProgId, "spotShadowMap");
+    locSpotShadowMatrix = glGetUniformLocation(shaderProgId, "spotShadowMatrix");
+    locSpotShadowTexelSize = glGetUniformLocation(shaderProgId, "spotShadowTexelSize");
+    locSpotShadowLight = glGetUniformLocation(shaderProgId, "spotShadowLight");
+    locUsePointShadow = glGetUniformLocation(shaderProgId, "usePointShadow");
+    locPointShadowMap = glGetUniformLocation(shaderProgId, "pointShadowMap");
+    locPointShadowLight = glGetUniformLocation(shaderProgId, "pointShadowLight");
+    locPointShadowFar = glGetUniformLocation(shaderProgId, "pointShadowFar");
+    locPointShadowTexelSize = glGetUniformLocation(shaderProgId, "pointShadowTexelSize");
+    locUseIbl = glGetUniformLocation(shaderProgId, "useIbl");
+    locShIrradiance = glGetUniformLocation(shaderProgId, "shIrradiance");
+    locEnvSpecular = glGetUniformLocation(shaderProgId, "envSpecular");
+    locEnvSpecularMaxLevel = glGetUniformLocation(shaderProgId, "envSpecularMaxLevel");
+    locEnvRotation = glGetUniformLocation(shaderProgId, "envRotation");
+    locUseOcclusion = glGetUniformLocation(shaderProgId, "useOcclusion");
+    locUseSsao = glGetUniformLocation(shaderProgId, "useSsao");
+    locAoMap = glGetUniformLocation(shaderProgId, "aoMap");
+    locInvProjMatrix = glGetUniformLocation(shaderProgId, "invProjMatrix");
 }
 
 
@@ -223,3 +335,161 @@ void SkyboxShaderProg::GetUniformVariableLocation()
     ShaderProg::GetUniformVariableLocation();
     locMapKd = glGetUniformLocation(shaderProgId, "mapKd");
 }
+
+SkyboxCubeShaderProg::SkyboxCubeShaderProg()
+{
+    locInvViewProj = -1;
+    locMapCube = -1;
+}
+
+SkyboxCubeShaderProg::~SkyboxCubeShaderProg()
+{}
+
+void SkyboxCubeShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locInvViewProj = glGetUniformLocation(shaderProgId, "invViewProj");
+    locMapCube = glGetUniformLocation(shaderProgId, "mapCube");
+}
+
+VirtualTextureFeedbackShaderProg::VirtualTextureFeedbackShaderProg()
+{
+    locVtId = -1;
+    locVtSize = -1;
+    locVtMaxLevel = -1;
+    locVtLodBias = -1;
+}
+
+VirtualTextureFeedbackShaderProg::~VirtualTextureFeedbackShaderProg()
+{}
+
+void VirtualTextureFeedbackShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locVtId = glGetUniformLocation(shaderProgId, "vtId");
+    locVtSize = glGetUniformLocation(shaderProgId, "vtSize");
+    locVtMaxLevel = glGetUniformLocation(shaderProgId, "vtMaxLevel");
+    locVtLodBias = glGetUniformLocation(shaderProgId, "vtLodBias");
+}
+
+DeferredLightingShaderProg::DeferredLightingShaderProg()
+{
+    locGPosition = -1;
+    locGNormal = -1;
+    locGAlbedo = -1;
+    locGSpecular = -1;
+    locGAmbient = -1;
+    locGDepth = -1;
+}
+
+DeferredLightingShaderProg::~DeferredLightingShaderProg()
+{}
+
+void DeferredLightingShaderProg::GetUniformVariableLocation()
+{
+    PhongShadingShaderProg::GetUniformVariableLocation();
+    locGPosition = glGetUniformLocation(shaderProgId, "gPosition");
+    locGNormal = glGetUniformLocation(shaderProgId, "gNormal");
+    locGAlbedo = glGetUniformLocation(shaderProgId, "gAlbedo");
+    locGSpecular = glGetUniformLocation(shaderProgId, "gSpecular");
+    locGAmbient = glGetUniformLocation(shaderProgId, "gAmbient");
+    locGDepth = glGetUniformLocation(shaderProgId, "gDepth");
+}
+
+PointShadowShaderProg::PointShadowShaderProg()
+{
+    locWorldMatrix = -1;
+    locFaceMatrices = -1;
+    locFaceMask = -1;
+    locLightPos = -1;
+    locFarPlane = -1;
+}
+
+PointShadowShaderProg::~PointShadowShaderProg()
+{}
+
+void PointShadowShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locWorldMatrix = glGetUniformLocation(shaderProgId, "worldMatrix");
+    locFaceMatrices = glGetUniformLocation(shaderProgId, "faceMatrices");
+    locFaceMask = glGetUniformLocation(shaderProgId, "faceMask");
+    locLightPos = glGetUniformLocation(shaderProgId, "lightPos");
+    locFarPlane = glGetUniformLocation(shaderProgId, "farPlane");
+}
+
+SsaoShaderProg::SsaoShaderProg()
+{
+    locDepthMap = -1;
+    locAoMap = -1;
+    locProjMatrix = -1;
+    locInvProjMatrix = -1;
+    locRadius = -1;
+    locNumSamples = -1;
+    locDirection = -1;
+    locBlurRadius = -1;
+}
+
+SsaoShaderProg::~SsaoShaderProg()
+{}
+
+void SsaoShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locDepthMap = glGetUniformLocation(shaderProgId, "depthMap");
+    locAoMap = glGetUniformLocation(shaderProgId, "aoMap");
+    locProjMatrix = glGetUniformLocation(shaderProgId, "projMatrix");
+    locInvProjMatrix = glGetUniformLocation(shaderProgId, "invProjMatrix");
+    locRadius = glGetUniformLocation(shaderProgId, "radius");
+    locNumSamples = glGetUniformLocation(shaderProgId, "numSamples");
+    locDirection = glGetUniformLocation(shaderProgId, "direction");
+    locBlurRadius = glGetUniformLocation(shaderProgId, "blurRadius");
+}
+
+OitCompositeShaderProg::OitCompositeShaderProg()
+{
+    locAccumMap = -1;
+    locWeightMap = -1;
+}
+
+OitCompositeShaderProg::~OitCompositeShaderProg()
+{}
+
+void OitCompositeShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locAccumMap = glGetUniformLocation(shaderProgId, "accumMap");
+    locWeightMap = glGetUniformLocation(shaderProgId, "weightMap");
+}
+
+HdrShaderProg::HdrShaderProg()
+{
+    locSourceMap = -1;
+    locTargetTexelSize = -1;
+    locFirstPass = -1;
+    locThreshold = -1;
+    locKnee = -1;
+    locSceneMap = -1;
+    locBloomMap = -1;
+    locBloomStrength = -1;
+    locExposure = -1;
+    locToneMapOperator = -1;
+}
+
+HdrShaderProg::~HdrShaderProg()
+{}
+
+void HdrShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locSourceMap = glGetUniformLocation(shaderProgId, "sourceMap");
+    locTargetTexelSize = glGetUniformLocation(shaderProgId, "targetTexelSize");
+    locFirstPass = glGetUniformLocation(shaderProgId, "firstPass");
+    locThreshold = glGetUniformLocation(shaderProgId, "threshold");
+    locKnee = glGetUniformLocation(shaderProgId, "knee");
+    locSceneMap = glGetUniformLocation(shaderProgId, "sceneMap");
+    locBloomMap = glGetUniformLocation(shaderProgId, "bloomMap");
+    locBloomStrength = glGetUniformLocation(shaderProgId, "bloomStrength");
+    locExposure = glGetUniformLocation(shaderProgId, "exposure");
+    locToneMapOperator = glGetUniformLocation(shaderProgId, "toneMapOperator");
+}
@@ -13,7 +13,11 @@ public:
 	ShaderProg();
 	~ShaderProg();
 
-	bool LoadFromFiles(const string& vsFilePath, const string& fsFilePath);
+	// Lines of the form #include "file" are replaced by the file (relative to the including
+	// one), and defines (such as "#define X\n") are inserted after the #version line.
+	bool LoadFromFiles(const string& vsFilePath, const string& fsFilePath, const string& defines = "");
+	// Attach a geometry shader to be linked by the next LoadFromFiles().
+	bool AddGeometryShaderFromFile(const string& gsFilePath);
 	void Bind() { glUseProgram(shaderProgId); };
 	void UnBind() { glUseProgram(0); };
 
@@ -31,26 +35,7 @@ private:
 	static bool LoadShaderTextFromFile(const string& filePath, string& sourceText);
 	// ShaderProg Private Data.
 	GLint locMVP;
-};
-
-
-// FillColorShaderProg Declarations.
-class FillColorShaderProg : public ShaderProg
-{
-public:
-	// FillColorShaderProg Public Methods.
-	FillColorShaderProg();
-	~FillColorShaderProg();
-
-	GLint GetLocFillColor() const { return locFillColor; }
-
-protected:
-	// FillColorShaderProg Protected Methods.
-	void GetUniformVariableLocation();
-
-private:
-	// FillColorShaderProg Private Data.
-	GLint locFillColor;
+	GLuint gsId;
 };
 
 
@@ -70,9 +55,11 @@ public:
 	GLint GetLocKd() const { return locKd; }
 	GLint GetLocKs() const { return locKs; }
 	GLint GetLocNs() const { return locNs; }
+	GLint GetLocOpacity() const { return locOpacity; }
 
 	GLint GetLocHadMapNorm() const { return locHadMapNorm; }
 	GLint GetLocMapNorm() const { return locMapNorm; }
+	GLint GetLocMapNormTwoChannel() const { return locMapNormTwoChannel; }
 	GLint GetLocHadMapKa() const { return locHadMapKa; }
 	GLint GetLocMapKa() const { return locMapKa; }
 	GLint GetLocHadMapKd() const { return locHadMapKd; }
@@ -81,20 +68,63 @@ public:
 	GLint GetLocMapKs() const { return locMapKs; }
 	GLint GetLocHadMapNs() const { return locHadMapNs; }
 	GLint GetLocMapNs() const { return locMapNs; }
+	GLint GetLocHadMapD() const { return locHadMapD; }
+	GLint GetLocMapD() const { return locMapD; }
+	GLint GetLocMapNormArray() const { return locMapNormArray; }
+	GLint GetLocMapNormLayer() const { return locMapNormLayer; }
+	GLint GetLocMapKaArray() const { return locMapKaArray; }
+	GLint GetLocMapKaLayer() const { return locMapKaLayer; }
+	GLint GetLocMapKdArray() const { return locMapKdArray; }
+	GLint GetLocMapKdLayer() const { return locMapKdLayer; }
+	GLint GetLocMapKsArray() const { return locMapKsArray; }
+	GLint GetLocMapKsLayer() const { return locMapKsLayer; }
+	GLint GetLocMapNsArray() const { return locMapNsArray; }
+	GLint GetLocMapNsLayer() const { return locMapNsLayer; }
+	GLint GetLocMapKdVirtual() const { return locMapKdVirtual; }
+	GLint GetLocVtIndirection() const { return locVtIndirection; }
+	GLint GetLocVtPhysical() const { return locVtPhysical; }
+	GLint GetLocVtSize() const { return locVtSize; }
+	GLint GetLocVtMaxLevel() const { return locVtMaxLevel; }
 
 	GLint GetLocAmbientLight()  const { return locAmbientLight; }
-	GLint GetLocPointLightPos() const { return locPointLightPos; }
-	GLint GetLocPointLightIntensity() const { return locPointLightIntensity; }
-
-	GLint GetLocSpotLightPos() const { return locSpotLightPos; }
-	GLint GetLocSpotLightDir() const { return locSpotLightDir; }
-	GLint GetLocCutoffStart()  const { return locCutoffStart; }
-	GLint GetLocTotalWidth()   const { return locTotalWidth; }
-	GLint GetLocSpotLightIntensity()  const { return locSpotLightIntensity; }
+	GLint GetLocLightData() const { return locLightData; }
+	GLint GetLocNumLights() const { return locNumLights; }
+	GLint GetLocClusterData() const { return locClusterData; }
+	GLint GetLocUseClusters() const { return locUseClusters; }
+	GLint GetLocClusterGrid() const { return locClusterGrid; }
+	GLint GetLocClusterTileScale() const { return locClusterTileScale; }
+	GLint GetLocClusterDepthScale() const { return locClusterDepthScale; }
+	GLint GetLocClusterDepthBias() const { return locClusterDepthBias; }
+	GLint GetLocCameraDir() const { return locCameraDir; }
 
 	GLint GetLocDirLightDir()      const { return locDirLightDir; }
 	GLint GetLocDirLightRadiance() const { return locDirLightRadiance; }
 
+	GLint GetLocUseShadows() const { return locUseShadows; }
+	GLint GetLocDirShadowMap() const { return locDirShadowMap; }
+	GLint GetLocDirShadowMatrices() const { return locDirShadowMatrices; }
+	GLint GetLocCascadeSplits() const { return locCascadeSplits; }
+	GLint GetLocCascadeTexelSizes() const { return locCascadeTexelSizes; }
+	GLint GetLocSpotShadowMap() const { return locSpotShadowMap; }
+	GLint GetLocSpotShadowMatrix() const { return locSpotShadowMatrix; }
+	GLint GetLocSpotShadowTexelSize() const { return locSpotShadowTexelSize; }
+	GLint GetLocSpotShadowLight() const { return locSpotShadowLight; }
+	GLint GetLocUsePointShadow() const { return locUsePointShadow; }
+	GLint GetLocPointShadowMap() const { return locPointShadowMap; }
+	GLint GetLocPointShadowLight() const { return locPointShadowLight; }
+	GLint GetLocPointShadowFar() const { return locPointShadowFar; }
+	GLint GetLocPointShadowTexelSize() const { return locPointShadowTexelSize; }
+
+	GLint GetLocUseIbl() const { return locUseIbl; }
+	GLint GetLocShIrradiance() const { return locShIrradiance; }
+	GLint GetLocEnvSpecular() const { return locEnvSpecular; }
+	GLint GetLocEnvSpecularMaxLevel() const { return locEnvSpecularMaxLevel; }
+	GLint GetLocEnvRotation() const { return locEnvRotation; }
+	GLint GetLocUseOcclusion() const { return locUseOcclusion; }
+	GLint GetLocUseSsao() const { return locUseSsao; }
+	GLint GetLocAoMap() const { return locAoMap; }
+	GLint GetLocInvProjMatrix() const { return locInvProjMatrix; }
+
 protected:
 	// PhongShadingDemoShaderProg Protected Methods.
 	void GetUniformVariableLocation();
@@ -110,9 +140,11 @@ private:
 	GLint locKd;
 	GLint locKs;
 	GLint locNs;
+	GLint locOpacity;
 	// Texture data.
 	GLint locHadMapNorm;
 	GLint locMapNorm;
+	GLint locMapNormTwoChannel;
 	GLint locHadMapKa;
 	GLint locMapKa;
 	GLint locHadMapKd;
@@ -121,19 +153,66 @@ private:
 	GLint locMapKs;
 	GLint locHadMapNs;
 	GLint locMapNs;
+	GLint locHadMapD;
+	GLint locMapD;
+	// Texture arrays.
+	GLint locMapNormArray;
+	GLint locMapNormLayer;
+	GLint locMapKaArray;
+	GLint locMapKaLayer;
+	GLint locMapKdArray;
+	GLint locMapKdLayer;
+	GLint locMapKsArray;
+	GLint locMapKsLayer;
+	GLint locMapNsArray;
+	GLint locMapNsLayer;
+	// Virtual diffuse map.
+	GLint locMapKdVirtual;
+	GLint locVtIndirection;
+	GLint locVtPhysical;
+	GLint locVtSize;
+	GLint locVtMaxLevel;
 	// Light data.
 	GLint locAmbientLight;
-	GLint locPointLightPos;
-	GLint locPointLightIntensity;
-
-	GLint locSpotLightPos;
-	GLint locSpotLightDir;
-	GLint locCutoffStart;
-	GLint locTotalWidth;
-	GLint locSpotLightIntensity;
+	GLint locLightData;
+	GLint locNumLights;
+	GLint locClusterData;
+	GLint locUseClusters;
+	GLint locClusterGrid;
+	GLint locClusterTileScale;
+	GLint locClusterDepthScale;
+	GLint locClusterDepthBias;
+	GLint locCameraDir;
 
 	GLint locDirLightDir;
 	GLint locDirLightRadiance;
+	// Shadow maps.
+	GLint locUseShadows;
+	GLint locDirShadowMap;
+	GLint locDirShadowMatrices;
+	GLint locCascadeSplits;
+	GLint locCascadeTexelSizes;
+	GLint locSpotShadowMap;
+	GLint locSpotShadowMatrix;
+	GLint locSpotShadowTexelSize;
+	GLint locSpotShadowLight;
+	GLint locUsePointShadow;
+	GLint locPointShadowMap;
+	GLint locPointShadowLight;
+	GLint locPointShadowFar;
+	GLint locPointShadowTexelSize;
+	// Image-based lighting.
+	GLint locUseIbl;
+	GLint locShIrradiance;
+	GLint locEnvSpecular;
+	GLint locEnvSpecularMaxLevel;
+	GLint locEnvRotation;
+	// Baked ambient occlusion.
+	GLint locUseOcclusion;
+	// Screen-space ambient occlusion.
+	GLint locUseSsao;
+	GLint locAoMap;
+	GLint locInvProjMatrix;
 };
 
 
@@ -156,4 +235,206 @@ private:
 	GLint locMapKd;
 };
 
+
+// SkyboxCubeShaderProg Declarations.
+class SkyboxCubeShaderProg : public ShaderProg
+{
+public:
+	// SkyboxCubeShaderProg Public Methods.
+	SkyboxCubeShaderProg();
+	~SkyboxCubeShaderProg();
+
+	GLint GetLocInvViewProj() const { return locInvViewProj; }
+	GLint GetLocMapCube() const { return locMapCube; }
+
+protected:
+	// SkyboxCubeShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// SkyboxCubeShaderProg Private Data.
+	GLint locInvViewProj;
+	GLint locMapCube;
+};
+
+
+// VirtualTextureFeedbackShaderProg Declarations.
+class VirtualTextureFeedbackShaderProg : public ShaderProg
+{
+public:
+	// VirtualTextureFeedbackShaderProg Public Methods.
+	VirtualTextureFeedbackShaderProg();
+	~VirtualTextureFeedbackShaderProg();
+
+	GLint GetLocVtId() const { return locVtId; }
+	GLint GetLocVtSize() const { return locVtSize; }
+	GLint GetLocVtMaxLevel() const { return locVtMaxLevel; }
+	GLint GetLocVtLodBias() const { return locVtLodBias; }
+
+protected:
+	// VirtualTextureFeedbackShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// VirtualTextureFeedbackShaderProg Private Data.
+	GLint locVtId;
+	GLint locVtSize;
+	GLint locVtMaxLevel;
+	GLint locVtLodBias;
+};
+
+
+// DeferredLightingShaderProg Declarations.
+// The lighting pass of deferred shading: the light uniforms of PhongShadingShaderProg and the
+// maps of the G-buffer.
+class DeferredLightingShaderProg : public PhongShadingShaderProg
+{
+public:
+	// DeferredLightingShaderProg Public Methods.
+	DeferredLightingShaderProg();
+	~DeferredLightingShaderProg();
+
+	GLint GetLocGPosition() const { return locGPosition; }
+	GLint GetLocGNormal() const { return locGNormal; }
+	GLint GetLocGAlbedo() const { return locGAlbedo; }
+	GLint GetLocGSpecular() const { return locGSpecular; }
+	GLint GetLocGAmbient() const { return locGAmbient; }
+	GLint GetLocGDepth() const { return locGDepth; }
+
+protected:
+	// DeferredLightingShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// DeferredLightingShaderProg Private Data.
+	GLint locGPosition;
+	GLint locGNormal;
+	GLint locGAlbedo;
+	GLint locGSpecular;
+	GLint locGAmbient;
+	GLint locGDepth;
+};
+
+
+// PointShadowShaderProg Declarations.
+class PointShadowShaderProg : public ShaderProg
+{
+public:
+	// PointShadowShaderProg Public Methods.
+	PointShadowShaderProg();
+	~PointShadowShaderProg();
+
+	GLint GetLocWorldMatrix() const { return locWorldMatrix; }
+	GLint GetLocFaceMatrices() const { return locFaceMatrices; }
+	GLint GetLocFaceMask() const { return locFaceMask; }
+	GLint GetLocLightPos() const { return locLightPos; }
+	GLint GetLocFarPlane() const { return locFarPlane; }
+
+protected:
+	// PointShadowShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// PointShadowShaderProg Private Data.
+	GLint locWorldMatrix;
+	GLint locFaceMatrices;
+	GLint locFaceMask;
+	GLint locLightPos;
+	GLint locFarPlane;
+};
+
+
+// SsaoShaderProg Declarations (the occlusion, blur and upsample passes of Ssao).
+class SsaoShaderProg : public ShaderProg
+{
+public:
+	// SsaoShaderProg Public Methods.
+	SsaoShaderProg();
+	~SsaoShaderProg();
+
+	GLint GetLocDepthMap() const { return locDepthMap; }
+	GLint GetLocAoMap() const { return locAoMap; }
+	GLint GetLocProjMatrix() const { return locProjMatrix; }
+	GLint GetLocInvProjMatrix() const { return locInvProjMatrix; }
+	GLint GetLocRadius() const { return locRadius; }
+	GLint GetLocNumSamples() const { return locNumSamples; }
+	GLint GetLocDirection() const { return locDirection; }
+	GLint GetLocBlurRadius() const { return locBlurRadius; }
+
+protected:
+	// SsaoShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// SsaoShaderProg Private Data.
+	GLint locDepthMap;
+	GLint locAoMap;
+	GLint locProjMatrix;
+	GLint locInvProjMatrix;
+	GLint locRadius;
+	GLint locNumSamples;
+	GLint locDirection;
+	GLint locBlurRadius;
+};
+
+
+// OitCompositeShaderProg Declarations (the resolve of the weighted blended transparency of Oit).
+class OitCompositeShaderProg : public ShaderProg
+{
+public:
+	// OitCompositeShaderProg Public Methods.
+	OitCompositeShaderProg();
+	~OitCompositeShaderProg();
+
+	GLint GetLocAccumMap() const { return locAccumMap; }
+	GLint GetLocWeightMap() const { return locWeightMap; }
+
+protected:
+	// OitCompositeShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// OitCompositeShaderProg Private Data.
+	GLint locAccumMap;
+	GLint locWeightMap;
+};
+
+
+// HdrShaderProg Declarations (the bloom and tone mapping passes of HdrPipeline).
+class HdrShaderProg : public ShaderProg
+{
+public:
+	// HdrShaderProg Public Methods.
+	HdrShaderProg();
+	~HdrShaderProg();
+
+	GLint GetLocSourceMap() const { return locSourceMap; }
+	GLint GetLocTargetTexelSize() const { return locTargetTexelSize; }
+	GLint GetLocFirstPass() const { return locFirstPass; }
+	GLint GetLocThreshold() const { return locThreshold; }
+	GLint GetLocKnee() const { return locKnee; }
+	GLint GetLocSceneMap() const { return locSceneMap; }
+	GLint GetLocBloomMap() const { return locBloomMap; }
+	GLint GetLocBloomStrength() const { return locBloomStrength; }
+	GLint GetLocExposure() const { return locExposure; }
+	GLint GetLocToneMapOperator() const { return locToneMapOperator; }
+
+protected:
+	// HdrShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// HdrShaderProg Private Data.
+	GLint locSourceMap;
+	GLint locTargetTexelSize;
+	GLint locFirstPass;
+	GLint locThreshold;
+	GLint locKnee;
+	GLint locSceneMap;
+	GLint locBloomMap;
+	GLint locBloomStrength;
+	GLint locExposure;
+	GLint locToneMapOperator;
+};
+
 #endif
@@ -0,0 +1,72 @@
+#version 330 core
+
+// The scene, or the bloom level above the one drawn (sampled at level 0 of the texture).
+uniform sampler2D sourceMap;
+uniform vec2 targetTexelSize;
+// The first pass keeps what is brighter than the threshold (with a soft knee) and weights
+// its taps by luminance, so that single bright pixels do not flicker.
+uniform bool firstPass;
+uniform float threshold;
+uniform float knee;
+
+out vec4 FragColor;
+
+float Luminance(vec3 color);
+float KarisWeight(vec3 average);
+
+
+float Luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+float KarisWeight(vec3 average)
+{
+    return 1.0 / (1.0 + Luminance(average));
+}
+
+void main()
+{
+    // 13 bilinear taps (36 texels) centered on the target pixel, grouped into five 2 x 2 boxes.
+    vec2 uv = gl_FragCoord.xy * targetTexelSize;
+    vec2 t = 1.0 / vec2(textureSize(sourceMap, 0));
+    vec3 a = textureLod(sourceMap, uv + t * vec2(-2.0, 2.0), 0.0).rgb;
+    vec3 b = textureLod(sourceMap, uv + t * vec2(0.0, 2.0), 0.0).rgb;
+    vec3 c = textureLod(sourceMap, uv + t * vec2(2.0, 2.0), 0.0).rgb;
+    vec3 d = textureLod(sourceMap, uv + t * vec2(-2.0, 0.0), 0.0).rgb;
+    vec3 e = textureLod(sourceMap, uv, 0.0).rgb;
+    vec3 f = textureLod(sourceMap, uv + t * vec2(2.0, 0.0), 0.0).rgb;
+    vec3 g = textureLod(sourceMap, uv + t * vec2(-2.0, -2.0), 0.0).rgb;
+    vec3 h = textureLod(sourceMap, uv + t * vec2(0.0, -2.0), 0.0).rgb;
+    vec3 i = textureLod(sourceMap, uv + t * vec2(2.0, -2.0), 0.0).rgb;
+    vec3 j = textureLod(sourceMap, uv + t * vec2(-1.0, 1.0), 0.0).rgb;
+    vec3 k = textureLod(sourceMap, uv + t * vec2(1.0, 1.0), 0.0).rgb;
+    vec3 l = textureLod(sourceMap, uv + t * vec2(-1.0, -1.0), 0.0).rgb;
+    vec3 m = textureLod(sourceMap, uv + t * vec2(1.0, -1.0), 0.0).rgb;
+
+    vec3 color;
+    if (firstPass)
+    {
+        vec3 boxes[5] = vec3[5](0.25 * (j + k + l + m), 0.25 * (a + b + d + e), 0.25 * (b + c + e + f),
+                                0.25 * (d + e + g + h), 0.25 * (e + f + h + i));
+        float weightSum = 0.0;
+        color = vec3(0.0);
+        for (int n = 0; n < 5; ++n)
+        {
+            float weight = ((n == 0) ? 0.5 : 0.125) * KarisWeight(boxes[n]);
+            color += boxes[n] * weight;
+            weightSum += weight;
+        }
+        color /= weightSum;
+        // Soft threshold.
+        float brightness = max(color.r, max(color.g, color.b));
+        float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+        soft = soft * soft / (4.0 * knee + 1e-4);
+        color *= max(soft, brightness - threshold) / max(brightness, 1e-4);
+    }
+    else
+    {
+        color = 0.125 * e + 0.03125 * (a + c + g + i) + 0.0625 * (b + d + f + h) + 0.125 * (j + k + l + m);
+    }
+    FragColor = vec4(max(color, vec3(0.0)), 1.0);
+}
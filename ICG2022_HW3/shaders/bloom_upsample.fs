@@ -0,0 +1,21 @@
+#version 330 core
+
+// The smaller bloom level (sampled at level 0 of the texture), added to the target by blending.
+uniform sampler2D sourceMap;
+uniform vec2 targetTexelSize;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    // 3 x 3 tent filter over the texels of the source.
+    vec2 uv = gl_FragCoord.xy * targetTexelSize;
+    vec2 t = 1.0 / vec2(textureSize(sourceMap, 0));
+    vec3 color = 4.0 * textureLod(sourceMap, uv, 0.0).rgb;
+    color += 2.0 * (textureLod(sourceMap, uv + t * vec2(0.0, 1.0), 0.0).rgb + textureLod(sourceMap, uv + t * vec2(0.0, -1.0), 0.0).rgb
+        + textureLod(sourceMap, uv + t * vec2(1.0, 0.0), 0.0).rgb + textureLod(sourceMap, uv + t * vec2(-1.0, 0.0), 0.0).rgb);
+    color += textureLod(sourceMap, uv + t * vec2(1.0, 1.0), 0.0).rgb + textureLod(sourceMap, uv + t * vec2(-1.0, 1.0), 0.0).rgb
+        + textureLod(sourceMap, uv + t * vec2(1.0, -1.0), 0.0).rgb + textureLod(sourceMap, uv + t * vec2(-1.0, -1.0), 0.0).rgb;
+    FragColor = vec4(color / 16.0, 1.0);
+}
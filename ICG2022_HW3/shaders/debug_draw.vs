@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 Position;
+layout (location = 1) in vec3 Color;
+
+uniform mat4 MVP;
+
+out vec3 iColor;
+
+
+void main()
+{
+    iColor = Color;
+    gl_Position = MVP * vec4(Position, 1.0);
+}
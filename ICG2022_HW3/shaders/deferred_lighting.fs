@@ -0,0 +1,41 @@
+#version 330 core
+
+// G-buffer of the geometry pass (see GBuffer), read at the pixel being lit.
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gAmbient;
+uniform sampler2D gDepth;
+// Screen-space ambient occlusion of the G-buffer (see Ssao), applied to the ambient term only.
+uniform bool useSsao;
+
+#include "phong_lighting.glsl"
+#include "ssao_upsample.glsl"
+
+out vec4 FragColor;
+
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // Pixels the geometry pass did not cover keep the background.
+    if (depth >= 1.0)
+        discard;
+    vec4 positionNs = texelFetch(gPosition, pixel, 0);
+    vec3 position = positionNs.xyz;
+    vec3 normal = normalize(texelFetch(gNormal, pixel, 0).xyz);
+    vec3 viewDir = normalize(cameraPos - position);
+    KdColor = texelFetch(gAlbedo, pixel, 0).rgb;
+    KsColor = texelFetch(gSpecular, pixel, 0).rgb;
+    NsVal = positionNs.w;
+
+    vec3 ambient = texelFetch(gAmbient, pixel, 0).rgb;
+    if (useSsao)
+        ambient *= UpsampleAo(pixel, depth);
+    vec3 iColor = ambient + ShadeLights(position, normal, viewDir);
+    FragColor = vec4(iColor, 1.0);
+    // The lights and the skybox drawn afterwards are depth tested against the scene.
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Sums of the transparent pass (see Oit): weighted premultiplied color and revealage, and
+// the weighted alphas.
+uniform sampler2D accumMap;
+uniform sampler2D weightMap;
+
+// Blended over the framebuffer with (alpha, 1 - alpha).
+out vec4 FragColor;
+
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumMap, pixel, 0);
+    float revealage = accum.a;
+    if (revealage >= 1.0)
+        discard;
+    float weight = texelFetch(weightMap, pixel, 0).r;
+    vec3 average = accum.rgb / max(weight, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,203 @@
+// Lights and the Phong BRDF, shared by phong_shading.fs and deferred_lighting.fs
+// (see ShaderProg::LoadFromFiles for #include).
+
+uniform vec3 cameraPos;
+// Point and spot lights (see ClusteredLights), three texels per light:
+// (position, range), (intensity, cos inner), (direction, cos outer < -1 for point lights).
+uniform samplerBuffer lightData;
+uniform int numLights;
+// (offset, count) of each cluster of the view-space grid, then the light indices. A fragment
+// finds its tile from gl_FragCoord and its depth slice from the view depth; without
+// useClusters every light is shaded (for comparison).
+uniform usamplerBuffer clusterData;
+uniform bool useClusters;
+uniform ivec3 clusterGrid;
+uniform vec2 clusterTileScale;
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+uniform vec3 cameraDir;
+
+uniform vec3 dirLightDir;
+uniform vec3 dirLightRadiance;
+
+// Shadow maps (see ShadowMaps): cascades of the directional light, chosen by view depth, and
+// the map of the spot light at index spotShadowLight. Texel sizes scale the normal offset.
+uniform bool useShadows;
+uniform sampler2DArrayShadow dirShadowMap;
+uniform mat4 dirShadowMatrices[4];
+uniform vec4 cascadeSplits;
+uniform vec4 cascadeTexelSizes;
+uniform sampler2DShadow spotShadowMap;
+uniform mat4 spotShadowMatrix;
+uniform float spotShadowTexelSize;
+uniform int spotShadowLight;
+// Shadow cubemap of the point light at index pointShadowLight (see PointShadowMap): the
+// distance to the light over pointShadowFar.
+uniform bool usePointShadow;
+uniform samplerCubeShadow pointShadowMap;
+uniform int pointShadowLight;
+uniform float pointShadowFar;
+uniform float pointShadowTexelSize;
+
+// Image-based lighting from the skybox (replaces the constant ambient light).
+uniform bool useIbl;
+// Irradiance / pi as the coefficients of the SH9 polynomial (see EnvironmentLighting).
+uniform vec3 shIrradiance[9];
+// Level L is prefiltered with the Phong lobe of exponent 4^(envSpecularMaxLevel - L).
+uniform samplerCube envSpecular;
+uniform float envSpecularMaxLevel;
+// World to skybox space (the skybox rotates about y).
+uniform mat3 envRotation;
+
+// Material of the fragment being shaded, set before calling the functions below.
+vec3 KdColor;
+vec3 KsColor;
+float NsVal;
+
+vec3 Diffuse(vec3 KdColor, vec3 I, vec3 N, vec3 lightDir);
+vec3 Specular(vec3 KsColor, vec3 I, vec3 viewDir, vec3 reflectDir, float NsVal);
+float DirShadow(vec3 position, vec3 normal);
+float SpotShadow(vec3 position, vec3 normal, float distance);
+float PointShadow(vec3 position, vec3 normal, vec3 lightPos);
+vec3 LocalLight(int index, vec3 position, vec3 normal, vec3 viewDir);
+vec3 DirLight(vec3 dirLightDir, vec3 normal, vec3 viewDir);
+vec3 EnvironmentLight(vec3 normal, vec3 viewDir);
+vec3 ShadeLights(vec3 position, vec3 normal, vec3 viewDir);
+
+
+vec3 Diffuse(vec3 KdColor, vec3 I, vec3 N, vec3 lightDir)
+{
+    return KdColor * I * max(dot(N, lightDir), 0.0);
+}
+
+vec3 Specular(vec3 KsColor, vec3 I, vec3 viewDir, vec3 reflectDir, float NsVal)
+{
+    return KsColor * I * pow(max(dot(viewDir, reflectDir), 0.0), NsVal);
+}
+
+float DirShadow(vec3 position, vec3 normal)
+{
+    float depth = dot(position - cameraPos, cameraDir);
+    int cascade = int(dot(vec4(greaterThan(vec4(depth), cascadeSplits)), vec4(1.0)));
+    if (cascade > 3)
+        return 1.0;
+    vec4 shadowCoord = dirShadowMatrices[cascade] * vec4(position + normal * (1.5 * cascadeTexelSizes[cascade]), 1.0);
+    // 3 x 3 PCF over bilinear comparisons.
+    vec2 texelSize = 1.0 / vec2(textureSize(dirShadowMap, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+            lit += texture(dirShadowMap, vec4(shadowCoord.xy + vec2(x, y) * texelSize, float(cascade), shadowCoord.z));
+    return lit / 9.0;
+}
+
+float SpotShadow(vec3 position, vec3 normal, float distance)
+{
+    vec4 shadowCoord = spotShadowMatrix * vec4(position + normal * (1.5 * spotShadowTexelSize * distance), 1.0);
+    if (shadowCoord.w <= 0.0)
+        return 1.0;
+    vec3 coord = shadowCoord.xyz / shadowCoord.w;
+    vec2 texelSize = 1.0 / vec2(textureSize(spotShadowMap, 0));
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+            lit += texture(spotShadowMap, vec3(coord.xy + vec2(x, y) * texelSize, coord.z));
+    return lit / 9.0;
+}
+
+float PointShadow(vec3 position, vec3 normal, vec3 lightPos)
+{
+    vec3 fromLight = position - lightPos;
+    float distance = length(fromLight);
+    float texel = pointShadowTexelSize * distance;
+    fromLight += normal * (1.5 * texel);
+    float ref = length(fromLight) / pointShadowFar;
+    // Five taps across the direction to the light, each a bilinear comparison.
+    vec3 tangent = normalize(cross(fromLight, abs(fromLight.y) < 0.99 * length(fromLight) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 bitangent = normalize(cross(fromLight, tangent));
+    float lit = texture(pointShadowMap, vec4(fromLight, ref));
+    lit += texture(pointShadowMap, vec4(fromLight + tangent * texel, ref));
+    lit += texture(pointShadowMap, vec4(fromLight - tangent * texel, ref));
+    lit += texture(pointShadowMap, vec4(fromLight + bitangent * texel, ref));
+    lit += texture(pointShadowMap, vec4(fromLight - bitangent * texel, ref));
+    return lit / 5.0;
+}
+
+vec3 LocalLight(int index, vec3 position, vec3 normal, vec3 viewDir)
+{
+    vec4 positionRange = texelFetch(lightData, 3 * index);
+    vec3 toLight = positionRange.xyz - position;
+    float distance2 = dot(toLight, toLight);
+    float range2 = positionRange.w * positionRange.w;
+    if (distance2 >= range2)
+        return vec3(0.0);
+    vec4 intensityCosInner = texelFetch(lightData, 3 * index + 1);
+    vec4 directionCosOuter = texelFetch(lightData, 3 * index + 2);
+    vec3 lightDir = toLight * inversesqrt(max(distance2, 1e-8));
+    vec3 reflectDir = normalize(reflect(-lightDir, normal));
+
+    // 1 / d^2, faded out towards the range so the light ends at its cluster bounds.
+    float fade = clamp(1.0 - (distance2 * distance2) / (range2 * range2), 0.0, 1.0);
+    float attenuation = fade * fade / max(distance2, 1e-4);
+    if (directionCosOuter.w > -1.5)
+    {
+        float cosTheta = dot(lightDir, -directionCosOuter.xyz);
+        attenuation *= clamp((cosTheta - directionCosOuter.w) / (intensityCosInner.w - directionCosOuter.w), 0.0, 1.0);
+    }
+    if (useShadows && index == spotShadowLight && attenuation > 0.0)
+        attenuation *= SpotShadow(position, normal, sqrt(distance2));
+    if (usePointShadow && index == pointShadowLight && attenuation > 0.0)
+        attenuation *= PointShadow(position, normal, positionRange.xyz);
+    vec3 intensity = intensityCosInner.rgb * attenuation;
+
+    vec3 diffuse = Diffuse(KdColor, intensity, normal, lightDir);
+    vec3 specular = Specular(KsColor, intensity, viewDir, reflectDir, NsVal);
+    return diffuse + specular;
+}
+
+vec3 DirLight(vec3 dirLightDir, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-dirLightDir);
+    vec3 reflectDir = normalize(reflect(-lightDir, normal));
+    
+    vec3 diffuse = Diffuse(KdColor, dirLightRadiance, normal, lightDir);
+    vec3 specular = Specular(KsColor, dirLightRadiance, viewDir, reflectDir, NsVal);
+    return diffuse + specular;
+}
+
+vec3 EnvironmentLight(vec3 normal, vec3 viewDir)
+{
+    vec3 n = envRotation * normal;
+    vec3 irradiance = shIrradiance[0]
+        + shIrradiance[1] * n.y + shIrradiance[2] * n.z + shIrradiance[3] * n.x
+        + shIrradiance[4] * (n.x * n.y) + shIrradiance[5] * (n.y * n.z) + shIrradiance[6] * (3.0 * n.z * n.z - 1.0)
+        + shIrradiance[7] * (n.x * n.z) + shIrradiance[8] * (n.x * n.x - n.y * n.y);
+
+    vec3 reflectDir = envRotation * reflect(-viewDir, normal);
+    float level = clamp(envSpecularMaxLevel - 0.5 * log2(max(NsVal, 1.0)), 0.0, envSpecularMaxLevel);
+    vec3 specular = textureLod(envSpecular, reflectDir, level).rgb;
+    return KdColor * max(irradiance, vec3(0.0)) + KsColor * specular;
+}
+
+vec3 ShadeLights(vec3 position, vec3 normal, vec3 viewDir)
+{
+    vec3 color = vec3(0.0);
+    if (useClusters)
+    {
+        float depth = max(dot(position - cameraPos, cameraDir), 1e-4);
+        ivec3 cell = ivec3(ivec2(gl_FragCoord.xy * clusterTileScale), int(log(depth) * clusterDepthScale + clusterDepthBias));
+        cell = clamp(cell, ivec3(0), clusterGrid - 1);
+        int cluster = (cell.z * clusterGrid.y + cell.y) * clusterGrid.x + cell.x;
+        int first = 2 * clusterGrid.x * clusterGrid.y * clusterGrid.z + int(texelFetch(clusterData, 2 * cluster).r);
+        int count = int(texelFetch(clusterData, 2 * cluster + 1).r);
+        for (int i = 0; i < count; ++i)
+            color += LocalLight(int(texelFetch(clusterData, first + i).r), position, normal, viewDir);
+    }
+    else
+    {
+        for (int i = 0; i < numLights; ++i)
+            color += LocalLight(i, position, normal, viewDir);
+    }
+    color += DirLight(dirLightDir, normal, viewDir) * (useShadows ? DirShadow(position, normal) : 1.0);
+    return color;
+}
@@ -3,13 +3,16 @@
 in vec3 iPosition;
 in vec3 iNormal;
 in vec2 iTexCoord;
-
-uniform vec3 cameraPos;
+in float iOcclusion;
 
 uniform vec3 Ka;
 uniform vec3 Kd;
 uniform vec3 Ks;
 uniform float Ns;
+// Dissolve of the material (MTL d, or 1 - Tr) and the optional opacity map (map_d).
+uniform float opacity;
+uniform bool hadMapD;
+uniform sampler2D mapD;
 
 uniform bool hadMapKa;
 uniform sampler2D mapKa;
@@ -19,99 +22,129 @@ uniform bool hadMapKs;
 uniform sampler2D mapKs;
 uniform bool hadMapNs;
 uniform sampler2D mapNs;
+// Maps packed into texture arrays: the layer of the map, or -1 to sample the 2D texture.
+uniform sampler2DArray mapKaArray;
+uniform sampler2DArray mapKdArray;
+uniform sampler2DArray mapKsArray;
+uniform sampler2DArray mapNsArray;
+uniform int mapKaLayer;
+uniform int mapKdLayer;
+uniform int mapKsLayer;
+uniform int mapNsLayer;
+// Diffuse map paged by the VirtualTextureSystem: the indirection texel of a tile holds the
+// page of the physical cache with the tile, or with its finest resident ancestor, and the
+// level of that tile. Tile and border sizes are those of virtualtexture.h.
+uniform bool mapKdVirtual;
+uniform sampler2D vtIndirection;
+uniform sampler2D vtPhysical;
+uniform ivec2 vtSize;
+uniform int vtMaxLevel;
+const float vtTileSize = 128.0;
+const float vtBorder = 1.0;
 
 uniform vec3 ambientLight;
-uniform vec3 pointLightPos;
-uniform vec3 pointLightIntensity;
-
-uniform vec3 spotLightPos;
-uniform vec3 spotLightIntensity;
-uniform vec3 spotLightDir;
-uniform float cutoffStart;
-uniform float totalWidth;
-
-uniform vec3 dirLightDir;
-uniform vec3 dirLightRadiance;
-
+// Scale the ambient (or environment) light by the baked occlusion of the vertices.
+uniform bool useOcclusion;
+// And by the screen-space occlusion of the opaque scene (see Ssao), in the forward pass only.
+uniform bool useSsao;
+
+#include "phong_lighting.glsl"
+#include "ssao_upsample.glsl"
+
+#ifdef GBUFFER_PASS
+// Geometry pass of deferred shading (compiled with GBUFFER_PASS defined): the surface and
+// its material go to the G-buffer (see GBuffer) and deferred_lighting.fs adds the lights.
+layout (location = 0) out vec4 gPosition;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAlbedo;
+layout (location = 3) out vec4 gSpecular;
+layout (location = 4) out vec4 gAmbient;
+#elif defined(OIT_PASS)
+// Transparent pass (compiled with OIT_PASS defined): weighted premultiplied color with the
+// alpha for the revealage, and the weighted alpha (see Oit and oit_composite.fs).
+layout (location = 0) out vec4 accum;
+layout (location = 1) out vec4 weight;
+#else
 out vec4 FragColor;
+#endif
 
-vec3 Diffuse(vec3 Kd, vec3 I, vec3 N, vec3 lightDir, bool hadMapKd);
-vec3 Specular(vec3 Ks, vec3 I, vec3 viewDir, vec3 reflectDir, float Ns);
-vec3 PointLight(vec3 pointLightPos, vec3 position, vec3 normal, vec3 viewDir);
-vec3 SpotLight(vec3 spotLightPos, vec3 position, vec3 normal, vec3 viewDir);
-vec3 DirLight(vec3 dirLightDir, vec3 normal, vec3 viewDir);
+vec4 SampleMap(sampler2D map, sampler2DArray mapArray, int layer);
+vec4 SampleVirtual(vec2 texCoord);
+vec4 SampleKd();
 
 
-vec3 Diffuse(vec3 Kd, vec3 I, vec3 N, vec3 lightDir, bool hadMapKd)
+vec4 SampleMap(sampler2D map, sampler2DArray mapArray, int layer)
 {
-    vec3 KdColor = Kd;
-    if (hadMapKd)
-        KdColor = vec3(texture2D(mapKd, iTexCoord));
-    return KdColor * I * max(dot(N, lightDir), 0.0);
+    if (layer >= 0)
+        return texture(mapArray, vec3(iTexCoord, float(layer)));
+    return texture2D(map, iTexCoord);
 }
 
-vec3 Specular(vec3 Ks, vec3 I, vec3 viewDir, vec3 reflectDir, float Ns)
+vec4 SampleVirtual(vec2 texCoord)
 {
-    vec3 KsColor = Ks;
-    float NsVal = Ns;
-    if(hadMapKs)
-        KsColor = vec3(texture2D(mapKs, iTexCoord));
-    if(hadMapNs)
-        NsVal = float(texture2D(mapNs, iTexCoord));
-    return KsColor * I * pow(max(dot(viewDir, reflectDir), 0.0), NsVal);
+    // The level the hardware would pick from the texel footprint (bilinear within it).
+    vec2 texel = texCoord * vec2(vtSize);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-6));
+    int level = clamp(int(floor(lod + 0.5)), 0, vtMaxLevel);
+    vec2 uv = fract(texCoord);
+    ivec2 tile = ivec2(uv * vec2(max(vtSize >> level, ivec2(1))) / vtTileSize);
+    vec4 entry = texelFetch(vtIndirection, tile, level) * 255.0;
+    // Position inside the tile of the level that is resident.
+    vec2 residentTexel = uv * vec2(max(vtSize >> int(entry.b + 0.5), ivec2(1)));
+    vec2 inTile = residentTexel - floor(residentTexel / vtTileSize) * vtTileSize;
+    vec2 page = floor(entry.rg + 0.5);
+    vec2 physical = (page * (vtTileSize + 2.0 * vtBorder) + vtBorder + inTile) / vec2(textureSize(vtPhysical, 0));
+    return textureLod(vtPhysical, physical, 0.0);
 }
 
-vec3 PointLight(vec3 pointLightPos, vec3 position, vec3 normal, vec3 viewDir)
+vec4 SampleKd()
 {
-    vec3 lightDir = normalize(pointLightPos - position);
-    vec3 reflectDir = normalize(reflect(-lightDir, normal));
-
-    float distance = length(pointLightPos - position);
-    float attenuation = 1.0 / (distance * distance);
-    vec3 intensity = pointLightIntensity * attenuation;
-    
-    vec3 diffuse = Diffuse(Kd, intensity, normal, lightDir, hadMapKd);
-    vec3 specular = Specular(Ks, intensity, viewDir, reflectDir, Ns);
-    return diffuse + specular;
-}
-
-vec3 SpotLight(vec3 spotLightPos, vec3 position, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(spotLightPos - position);
-    vec3 reflectDir = normalize(reflect(-lightDir, normal));
-
-    float cosTheta = dot(lightDir, normalize(-spotLightDir));
-    float epsilon = cos(radians(cutoffStart)) - cos(radians(totalWidth));
-
-    float distance = length(spotLightPos - position);
-    float attenuation = 1.0 / (distance * distance);
-    vec3 intensity = spotLightIntensity * clamp((cosTheta - cos(radians(totalWidth))) / epsilon, 0.0, 1.0)  * attenuation;
-
-    vec3 diffuse = Diffuse(Kd, intensity, normal, lightDir, hadMapKd);
-    vec3 specular = Specular(Ks, intensity, viewDir, reflectDir, Ns);
-    return diffuse + specular;
-}
-
-vec3 DirLight(vec3 dirLightDir, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-dirLightDir);
-    vec3 reflectDir = normalize(reflect(-lightDir, normal));
-    
-    vec3 diffuse = Diffuse(Kd, dirLightRadiance, normal, lightDir, hadMapKd);
-    vec3 specular = Specular(Ks, dirLightRadiance, viewDir, reflectDir, Ns);
-    return diffuse + specular;
+    if (mapKdVirtual)
+        return SampleVirtual(iTexCoord);
+    return SampleMap(mapKd, mapKdArray, mapKdLayer);
 }
 
 void main()
 {
+    // Cutouts: the opacity map of an opaque material is alpha tested (the transparent pass
+    // blends it instead).
+    if (hadMapD && opacity >= 1.0 && texture(mapD, iTexCoord).r < 0.5)
+        discard;
     vec3 normal = normalize(iNormal);
     vec3 viewDir = normalize(cameraPos - iPosition);
+    KdColor = hadMapKd ? vec3(SampleKd()) : Kd;
+    KsColor = hadMapKs ? vec3(SampleMap(mapKs, mapKsArray, mapKsLayer)) : Ks;
+    NsVal = hadMapNs ? float(SampleMap(mapNs, mapNsArray, mapNsLayer)) : Ns;
     vec3 iColor = Ka * ambientLight;
     if(hadMapKa)
-        iColor = vec3(texture2D(mapKs, iTexCoord)) * ambientLight;
-
-    iColor += PointLight(pointLightPos, iPosition, normal, viewDir);
-    iColor += SpotLight(spotLightPos, iPosition, normal, viewDir);
-    iColor += DirLight(dirLightDir, normal, viewDir);
-    FragColor =  vec4(iColor, 1.0);
+        iColor = vec3(SampleMap(mapKs, mapKsArray, mapKsLayer)) * ambientLight;
+    if (useIbl)
+        iColor = EnvironmentLight(normal, viewDir);
+    if (useOcclusion)
+        iColor *= clamp(iOcclusion, 0.0, 1.0);
+    if (useSsao)
+        iColor *= UpsampleAo(ivec2(gl_FragCoord.xy), gl_FragCoord.z);
+
+#ifdef GBUFFER_PASS
+    gPosition = vec4(iPosition, NsVal);
+    gNormal = vec4(normal, 0.0);
+    gAlbedo = vec4(KdColor, 1.0);
+    gSpecular = vec4(KsColor, 1.0);
+    gAmbient = vec4(iColor, 1.0);
+#else
+    iColor += ShadeLights(iPosition, normal, viewDir);
+    float alpha = opacity;
+    if (hadMapD)
+        alpha *= texture(mapD, iTexCoord).r;
+#ifdef OIT_PASS
+    // Weight of McGuire and Bavoil (equation 10): nearer and more opaque surfaces dominate.
+    float w = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    accum = vec4(iColor * alpha * w, alpha);
+    weight = vec4(alpha * w);
+#else
+    FragColor = vec4(iColor, alpha);
+#endif
+#endif
 }
@@ -3,6 +3,8 @@
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec2 TexCoord;
+// Baked ambient occlusion (1 when the mesh has none).
+layout (location = 3) in float Occlusion;
 
 uniform mat4 worldMatrix;
 uniform mat4 normalMatrix;
@@ -10,10 +12,18 @@ uniform mat4 MVP;
 
 uniform bool hadMapNorm;
 uniform sampler2D mapNorm;
+// Layer of the map in mapNormArray, or -1 to sample mapNorm.
+uniform sampler2DArray mapNormArray;
+uniform int mapNormLayer;
+// Two-channel (BC5) normal maps store x and y only.
+uniform bool mapNormTwoChannel;
 
 out vec3 iPosition;
 out vec3 iNormal;
 out vec2 iTexCoord;
+out float iOcclusion;
+// Bit-identical to shadow_depth.vs, so the depth pre-pass can be tested with GL_EQUAL.
+invariant gl_Position;
 
 
 void main()
@@ -21,7 +31,17 @@ void main()
     iPosition = vec3(worldMatrix * vec4(Position, 1.0));
     iNormal = vec3(normalMatrix * vec4(Normal, 0.0));
     if(hadMapNorm)
-        iNormal = vec3(normalMatrix * vec4(vec3(texture2D(mapNorm, TexCoord)), 0.0));
+    {
+        vec3 texNormal = (mapNormLayer >= 0) ? vec3(texture(mapNormArray, vec3(TexCoord, float(mapNormLayer))))
+                                             : vec3(texture2D(mapNorm, TexCoord));
+        if(mapNormTwoChannel)
+        {
+            vec2 xy = texNormal.xy * 2.0 - 1.0;
+            texNormal.z = sqrt(max(1.0 - dot(xy, xy), 0.0)) * 0.5 + 0.5;
+        }
+        iNormal = vec3(normalMatrix * vec4(texNormal, 0.0));
+    }
     iTexCoord = TexCoord;
+    iOcclusion = Occlusion;
     gl_Position = MVP * vec4(Position, 1.0);
 } 
\ No newline at end of file
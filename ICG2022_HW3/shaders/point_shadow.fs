@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 gPosition;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+
+void main()
+{
+    // The distance to the light, so that one comparison works across the faces.
+    gl_FragDepth = length(gPosition - lightPos) / farPlane;
+}
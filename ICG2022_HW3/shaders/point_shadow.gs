@@ -0,0 +1,28 @@
+#version 330 core
+
+// Every triangle goes to the cubemap faces of faceMask (see PointShadowMap).
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+uniform mat4 faceMatrices[6];
+uniform int faceMask;
+
+out vec3 gPosition;
+
+
+void main()
+{
+    for (int face = 0; face < 6; ++face)
+    {
+        if ((faceMask & (1 << face)) == 0)
+            continue;
+        for (int i = 0; i < 3; ++i)
+        {
+            gl_Layer = face;
+            gPosition = gl_in[i].gl_Position.xyz;
+            gl_Position = faceMatrices[face] * gl_in[i].gl_Position;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
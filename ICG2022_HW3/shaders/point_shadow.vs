@@ -0,0 +1,11 @@
+#version 330 core
+
+layout (location = 0) in vec3 Position;
+
+uniform mat4 worldMatrix;
+
+
+void main()
+{
+    gl_Position = worldMatrix * vec4(Position, 1.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// Depth only (see ShadowMaps).
+
+
+void main()
+{
+}
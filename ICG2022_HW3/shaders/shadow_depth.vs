@@ -4,8 +4,10 @@ layout (location = 0) in vec3 Position;
 
 uniform mat4 MVP;
 
+invariant gl_Position;
+
 
 void main()
 {
     gl_Position = MVP * vec4(Position, 1.0);
-}
\ No newline at end of file
+}
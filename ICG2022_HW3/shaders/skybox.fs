@@ -9,6 +9,6 @@ out vec4 FragColor;
 
 void main()
 {
-    FragColor = texture2D(mapKd, vec2(iTexCoord.x, 1.0 - iTexCoord.y));
+    FragColor = texture2D(mapKd, iTexCoord);
 }
 
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 iNdcPosition;
+
+// Inverse of projection * view (without translation) * skybox rotation.
+uniform mat4 invViewProj;
+uniform samplerCube mapCube;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    vec4 farPoint = invViewProj * vec4(iNdcPosition, 1.0, 1.0);
+    FragColor = texture(mapCube, farPoint.xyz / farPoint.w);
+}
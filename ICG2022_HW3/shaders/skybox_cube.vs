@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (location = 0) in vec2 Position;
+
+out vec2 iNdcPosition;
+
+
+void main()
+{
+    // One triangle covering the screen, on the far plane.
+    iNdcPosition = Position;
+    gl_Position = vec4(Position, 1.0, 1.0);
+}
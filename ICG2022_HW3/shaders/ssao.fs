@@ -0,0 +1,73 @@
+#version 330 core
+
+// Scene depth at full resolution, and the projection it was rendered with.
+uniform sampler2D depthMap;
+uniform mat4 projMatrix;
+uniform mat4 invProjMatrix;
+// Radius of the hemisphere (view space) and samples per pixel.
+uniform float radius;
+uniform int numSamples;
+
+// Occlusion (1 for open) and view depth of the pixel, at half resolution.
+out vec4 FragColor;
+
+vec3 ViewPosition(ivec2 pixel);
+
+
+vec3 ViewPosition(ivec2 pixel)
+{
+    vec2 size = vec2(textureSize(depthMap, 0));
+    pixel = clamp(pixel, ivec2(0), ivec2(size) - 1);
+    float depth = texelFetch(depthMap, pixel, 0).r;
+    vec4 position = invProjMatrix * vec4((vec2(pixel) + 0.5) / size * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+void main()
+{
+    // The half resolution pixel takes the first full resolution pixel it covers.
+    ivec2 pixel = ivec2(gl_FragCoord.xy) * 2;
+    float depth = texelFetch(depthMap, pixel, 0).r;
+    vec3 position = ViewPosition(pixel);
+    if (depth >= 1.0)
+    {
+        FragColor = vec4(1.0, -position.z, 0.0, 1.0);
+        return;
+    }
+    // Normal from the neighbours on the side with the smaller depth step on each axis, so
+    // that it does not bend across silhouettes.
+    vec3 left = position - ViewPosition(pixel - ivec2(1, 0));
+    vec3 right = ViewPosition(pixel + ivec2(1, 0)) - position;
+    vec3 down = position - ViewPosition(pixel - ivec2(0, 1));
+    vec3 up = ViewPosition(pixel + ivec2(0, 1)) - position;
+    vec3 dx = (abs(left.z) < abs(right.z)) ? left : right;
+    vec3 dy = (abs(down.z) < abs(up.z)) ? down : up;
+    vec3 normal = normalize(cross(dx, dy));
+
+    // Hemisphere around the normal, rotated per pixel by interleaved gradient noise.
+    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    vec3 randomDir = vec3(cos(6.2831853 * noise), sin(6.2831853 * noise), 0.0);
+    vec3 tangent = normalize(randomDir - normal * dot(randomDir, normal));
+    vec3 bitangent = cross(normal, tangent);
+    float bias = 0.02 * radius;
+    float occlusion = 0.0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Fibonacci directions over the hemisphere, closer to the center for the first ones.
+        float t = (float(i) + 0.5) / float(numSamples);
+        float cosTheta = 1.0 - t;
+        float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+        float phi = 2.3999632 * float(i);
+        vec3 dir = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+        float scale = mix(0.1, 1.0, t * t);
+        vec3 samplePos = position + (tangent * dir.x + bitangent * dir.y + normal * dir.z) * radius * scale;
+
+        vec4 clip = projMatrix * vec4(samplePos, 1.0);
+        vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+        float sceneZ = ViewPosition(ivec2(uv * vec2(textureSize(depthMap, 0)))).z;
+        // Only occluders within the radius count.
+        float range = smoothstep(0.0, 1.0, radius / max(abs(position.z - sceneZ), 1e-4));
+        occlusion += (sceneZ >= samplePos.z + bias) ? range : 0.0;
+    }
+    FragColor = vec4(1.0 - occlusion / float(numSamples), -position.z, 0.0, 1.0);
+}
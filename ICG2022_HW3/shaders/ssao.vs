@@ -0,0 +1,10 @@
+#version 330 core
+
+layout (location = 0) in vec2 Position;
+
+
+void main()
+{
+    // One triangle covering the screen.
+    gl_Position = vec4(Position, 0.0, 1.0);
+}
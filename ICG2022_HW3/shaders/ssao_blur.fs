@@ -0,0 +1,30 @@
+#version 330 core
+
+// Occlusion and view depth at half resolution.
+uniform sampler2D aoMap;
+// Axis of this pass, (1, 0) or (0, 1), and the radius of the kernel in texels.
+uniform ivec2 direction;
+uniform int blurRadius;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    // Gaussian weights, cut where the depth differs from the center by more than a few percent.
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 maxPixel = textureSize(aoMap, 0) - 1;
+    vec2 center = texelFetch(aoMap, pixel, 0).rg;
+    float sigma = 0.5 * float(blurRadius) + 0.5;
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = -blurRadius; i <= blurRadius; ++i)
+    {
+        vec2 tap = texelFetch(aoMap, clamp(pixel + direction * i, ivec2(0), maxPixel), 0).rg;
+        float depthDelta = (tap.g - center.g) / (0.05 * center.g + 1e-4);
+        float weight = exp(-0.5 * float(i * i) / (sigma * sigma) - depthDelta * depthDelta);
+        sum += tap.r * weight;
+        weightSum += weight;
+    }
+    FragColor = vec4(sum / weightSum, center.g, 0.0, 1.0);
+}
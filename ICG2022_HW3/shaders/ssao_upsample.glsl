@@ -0,0 +1,29 @@
+// Upsampling of the half resolution occlusion of Ssao to a full resolution pixel, shared by
+// phong_shading.fs (forward) and deferred_lighting.fs.
+uniform sampler2D aoMap;
+uniform mat4 invProjMatrix;
+
+float UpsampleAo(ivec2 pixel, float depth)
+{
+    vec4 position = invProjMatrix * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+    float viewDepth = -position.z / position.w;
+
+    // Bilinear weights of the four nearest half resolution texels, scaled down by how far
+    // their depths are from the depth of the pixel.
+    ivec2 maxTexel = textureSize(aoMap, 0) - 1;
+    vec2 halfPos = (vec2(pixel) + 0.5) * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(halfPos));
+    vec2 f = halfPos - vec2(base);
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 tap = texelFetch(aoMap, clamp(base + offset, ivec2(0), maxTexel), 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y / (abs(tap.g - viewDepth) / max(viewDepth, 1e-4) + 1e-3);
+        sum += tap.r * weight;
+        weightSum += weight;
+    }
+    return (weightSum > 0.0) ? sum / weightSum : 1.0;
+}
@@ -0,0 +1,44 @@
+#version 330 core
+
+// HDR scene, and the first level of the bloom pyramid.
+uniform sampler2D sceneMap;
+uniform sampler2D bloomMap;
+uniform float bloomStrength;
+uniform float exposure;
+// 0: Reinhard, 1: ACES (see ToneMapOperator).
+uniform int toneMapOperator;
+
+out vec4 FragColor;
+
+vec3 Reinhard(vec3 color);
+vec3 Aces(vec3 color);
+
+
+vec3 Reinhard(vec3 color)
+{
+    // On luminance, so that bright colors keep their hue.
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return color / (1.0 + luminance);
+}
+
+vec3 Aces(vec3 color)
+{
+    // Narkowicz's fit of the ACES reference rendering transform.
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 color = texelFetch(sceneMap, pixel, 0).rgb;
+    if (bloomStrength > 0.0)
+    {
+        vec2 uv = (gl_FragCoord.xy) / vec2(textureSize(sceneMap, 0));
+        color += bloomStrength * textureLod(bloomMap, uv, 0.0).rgb;
+    }
+    color *= exposure;
+    // The shading writes display values (there is no sRGB encoding anywhere), so the result
+    // is not gamma encoded either.
+    color = (toneMapOperator == 1) ? Aces(color) : Reinhard(color);
+    FragColor = vec4(color, 1.0);
+}
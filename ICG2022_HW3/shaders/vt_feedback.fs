@@ -0,0 +1,31 @@
+#version 330 core
+
+in vec2 iTexCoord;
+
+// Id of the virtual diffuse map of the submesh (0: none) and its size at level 0.
+uniform int vtId;
+uniform ivec2 vtSize;
+uniform int vtMaxLevel;
+// The target is smaller than the screen, so the level is biased by -log2 of the ratio.
+uniform float vtLodBias;
+const float vtTileSize = 128.0;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    if (vtId == 0)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+    // Same level and tile as SampleVirtual() in phong_shading.fs.
+    vec2 texel = iTexCoord * vec2(vtSize);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-6)) + vtLodBias;
+    int level = clamp(int(floor(lod + 0.5)), 0, vtMaxLevel);
+    ivec2 tile = ivec2(fract(iTexCoord) * vec2(max(vtSize >> level, ivec2(1))) / vtTileSize);
+    FragColor = vec4(float(tile.x), float(tile.y), float(level), float(vtId)) / 255.0;
+}
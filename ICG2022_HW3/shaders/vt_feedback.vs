@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 Position;
+layout (location = 2) in vec2 TexCoord;
+
+uniform mat4 MVP;
+
+out vec2 iTexCoord;
+
+
+void main()
+{
+    iTexCoord = TexCoord;
+    gl_Position = MVP * vec4(Position, 1.0);
+}
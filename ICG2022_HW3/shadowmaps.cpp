@@ -0,0 +1,185 @@
+#include "shadowmaps.h"
+using namespace std;
+
+// Depth comparison in the sampler, bilinear between the four nearest results; outside the
+// map everything is lit.
+static void SetShadowParameters(GLenum target)
+{
+	const GLfloat borderColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+// Clip space [-1, 1] to texture space [0, 1].
+static const glm::mat4x4 clipToTexture = glm::translate(glm::mat4x4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f))
+	* glm::scale(glm::mat4x4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f));
+
+ShadowMaps::ShadowMaps(const int size)
+{
+	mapSize = size;
+	for (int c = 0; c < NUM_SHADOW_CASCADES; ++c)
+		cascadeViewProj[c] = cascadeMatrices[c] = glm::mat4x4(1.0f);
+	cascadeSplits = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	cascadeTexelSizes = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	spotViewProj = spotMatrix = glm::mat4x4(1.0f);
+	spotTexelSize = 0.0f;
+
+	glGenTextures(1, &cascadeTexId);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, mapSize, mapSize, NUM_SHADOW_CASCADES);
+	else
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, NUM_SHADOW_CASCADES, 0,
+			GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	SetShadowParameters(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glGenTextures(1, &spotTexId);
+	glBindTexture(GL_TEXTURE_2D, spotTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, mapSize, mapSize);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	SetShadowParameters(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	// A depth-only framebuffer; Render() attaches one map at a time.
+	glGenFramebuffers(1, &fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, spotTexId, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr << "[ERROR] Incomplete shadow map framebuffer: " << mapSize << " x " << mapSize << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+ShadowMaps::~ShadowMaps()
+{
+	glDeleteFramebuffers(1, &fboId);
+	glDeleteTextures(1, &cascadeTexId);
+	glDeleteTextures(1, &spotTexId);
+}
+
+void ShadowMaps::Render(const Camera* cam, const DirectionalLight* dirLight, const SpotLight* spotLight,
+	const glm::vec3& sceneCenter, const float sceneRadius, const function<void(const glm::mat4x4&)>& drawCasters)
+{
+	GLint prevFboId = 0;
+	GLint prevViewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+	glViewport(0, 0, mapSize, mapSize);
+	// Slope-scaled bias against self-shadowing; the shader adds a normal offset.
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.5f, 2.0f);
+
+	if (cam != nullptr && dirLight != nullptr)
+	{
+		FitCascades(cam, glm::normalize(dirLight->GetDirection()), sceneCenter, sceneRadius);
+		for (int c = 0; c < NUM_SHADOW_CASCADES; ++c)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeTexId, 0, c);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			cascadeTimers[c].Begin();
+			drawCasters(cascadeViewProj[c]);
+			cascadeTimers[c].End();
+		}
+	}
+	if (spotLight != nullptr)
+	{
+		FitSpot(spotLight, sceneCenter, sceneRadius);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, spotTexId, 0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		spotTimer.Begin();
+		drawCasters(spotViewProj);
+		spotTimer.End();
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void ShadowMaps::FitCascades(const Camera* cam, const glm::vec3& lightDir, const glm::vec3& sceneCenter, const float sceneRadius)
+{
+	// Frustum of the camera (as built by glm::perspective); the cascades end where the scene does.
+	const glm::mat4x4 projMatrix = cam->GetProjMatrix();
+	const glm::mat4x4 invViewMatrix = glm::inverse(cam->GetViewMatrix());
+	const float tanHalfX = 1.0f / projMatrix[0][0];
+	const float tanHalfY = 1.0f / projMatrix[1][1];
+	const float zNear = projMatrix[3][2] / (projMatrix[2][2] - 1.0f);
+	const float zFar = projMatrix[3][2] / (projMatrix[2][2] + 1.0f);
+	const float sceneFar = glm::clamp(glm::length(sceneCenter - cam->GetCameraPos()) + sceneRadius, 2.0f * zNear, zFar);
+
+	const glm::vec3 up = (abs(lightDir.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	const glm::mat4x4 lightView = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), lightDir, up);
+	const glm::vec3 sceneLight = glm::vec3(lightView * glm::vec4(sceneCenter, 1.0f));
+	const float k2 = tanHalfX * tanHalfX + tanHalfY * tanHalfY;
+	float splitNear = zNear;
+	for (int c = 0; c < NUM_SHADOW_CASCADES; ++c)
+	{
+		const float t = static_cast<float>(c + 1) / NUM_SHADOW_CASCADES;
+		const float splitFar = SHADOW_CASCADE_LOG_WEIGHT * zNear * pow(sceneFar / zNear, t)
+			+ (1.0f - SHADOW_CASCADE_LOG_WEIGHT) * (zNear + (sceneFar - zNear) * t);
+		// The smallest sphere around the slice is centered on the view axis and depends on the
+		// split distances only, so the map does not change size as the camera turns.
+		const float depth = min(0.5f * (splitNear + splitFar) * (1.0f + k2), splitFar);
+		float radius = sqrt((splitFar - depth) * (splitFar - depth) + k2 * splitFar * splitFar);
+		radius = ceil(radius * 16.0f) / 16.0f;
+		const float texelSize = 2.0f * radius / mapSize;
+		glm::vec3 center = glm::vec3(lightView * (invViewMatrix * glm::vec4(0.0f, 0.0f, -depth, 1.0f)));
+		center.x = floor(center.x / texelSize) * texelSize;
+		center.y = floor(center.y / texelSize) * texelSize;
+		// Casters between the light and the slice are inside the scene bounds.
+		const float zMax = max(center.z + radius, sceneLight.z + sceneRadius);
+		const float zMin = min(center.z - radius, sceneLight.z - sceneRadius);
+		const glm::mat4x4 lightProj = glm::ortho(center.x - radius, center.x + radius, center.y - radius, center.y + radius, -zMax, -zMin);
+		cascadeViewProj[c] = lightProj * lightView;
+		cascadeMatrices[c] = clipToTexture * cascadeViewProj[c];
+		cascadeSplits[c] = splitFar;
+		cascadeTexelSizes[c] = texelSize;
+		splitNear = splitFar;
+	}
+}
+
+void ShadowMaps::FitSpot(const SpotLight* spotLight, const glm::vec3& sceneCenter, const float sceneRadius)
+{
+	// The frustum covers the outer cone and the depth range of the scene bounds.
+	const glm::vec3 position = spotLight->GetPosition();
+	const glm::vec3 direction = glm::normalize(spotLight->GetDirection());
+	const float halfAngle = glm::radians(min(spotLight->GetTotalWidthInDegree() + 1.0f, 85.0f));
+	const float distance = glm::length(sceneCenter - position);
+	const float zFar = max(distance + sceneRadius, 0.1f);
+	const float zNear = max(distance - sceneRadius, zFar * 0.005f);
+	const glm::vec3 up = (abs(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	spotViewProj = glm::perspective(2.0f * halfAngle, 1.0f, zNear, zFar) * glm::lookAt(position, position + direction, up);
+	spotMatrix = clipToTexture * spotViewProj;
+	spotTexelSize = 2.0f * tan(halfAngle) / mapSize;
+}
+
+void ShadowMaps::Bind(GLenum cascadeUnit, GLenum spotUnit)
+{
+	glActiveTexture(cascadeUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeTexId);
+	glActiveTexture(spotUnit);
+	glBindTexture(GL_TEXTURE_2D, spotTexId);
+}
+
+void ShadowMaps::ShowInfo()
+{
+	cout << "Shadow maps (" << mapSize << " x " << mapSize << "), GPU ms per frame:";
+	for (int c = 0; c < NUM_SHADOW_CASCADES; ++c)
+	{
+		cout << " cascade " << c << " (to " << cascadeSplits[c] << ") " << cascadeTimers[c].GetAverageMs() << ",";
+		cascadeTimers[c].Reset();
+	}
+	cout << " spot " << spotTimer.GetAverageMs() << endl;
+	spotTimer.Reset();
+}
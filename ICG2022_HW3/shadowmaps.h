@@ -0,0 +1,71 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include "headers.h"
+#include "camera.h"
+#include "light.h"
+#include "timer.h"
+using namespace std;
+
+// Cascades of the directional light (layers of one depth texture array).
+#define NUM_SHADOW_CASCADES 4
+// Weight of the logarithmic split distances against the uniform ones.
+#define SHADOW_CASCADE_LOG_WEIGHT 0.75f
+
+
+// ShadowMaps Declarations.
+// Depth maps of the directional light, cascaded over the view frustum, and of the spot light.
+// Each cascade is an orthographic map of a bounding sphere of its slice of the frustum,
+// snapped to whole texels so that the shadows do not swim as the camera moves, and deep
+// enough to hold every caster of the scene bounds. The spot light map is a perspective one
+// over its cone. The maps compare depths in the sampler (sampler2DArrayShadow and
+// sampler2DShadow), which phong_lighting.glsl filters with a 3 x 3 PCF kernel.
+class ShadowMaps
+{
+public:
+	// ShadowMaps Public Methods.
+	ShadowMaps(const int size);
+	~ShadowMaps();
+
+	int GetSize() const { return mapSize; }
+	size_t GetGpuBytes() const { return static_cast<size_t>(mapSize) * mapSize * 4 * (NUM_SHADOW_CASCADES + 1); }
+	// World to shadow map texture space (xy in [0, 1], depth in z).
+	const glm::mat4x4* GetCascadeMatrices() const { return cascadeMatrices; }
+	// View depth at which each cascade ends.
+	glm::vec4 GetCascadeSplits() const { return cascadeSplits; }
+	// World size of a texel of each cascade.
+	glm::vec4 GetCascadeTexelSizes() const { return cascadeTexelSizes; }
+	glm::mat4x4 GetSpotMatrix() const { return spotMatrix; }
+	// World size of a spot map texel at a distance of 1 from the light.
+	float GetSpotTexelSize() const { return spotTexelSize; }
+	int GetNumTimingSamples() const { return spotTimer.GetNumSamples(); }
+
+	// Render the casters of the scene bounding sphere for both lights. drawCasters draws
+	// the depth of every caster with the given world to clip space matrix.
+	void Render(const Camera* cam, const DirectionalLight* dirLight, const SpotLight* spotLight,
+		const glm::vec3& sceneCenter, const float sceneRadius, const function<void(const glm::mat4x4&)>& drawCasters);
+	void Bind(GLenum cascadeUnit, GLenum spotUnit);
+	// Print the GPU time of each map, averaged since the last call.
+	void ShowInfo();
+
+private:
+	// ShadowMaps Private Methods.
+	void FitCascades(const Camera* cam, const glm::vec3& lightDir, const glm::vec3& sceneCenter, const float sceneRadius);
+	void FitSpot(const SpotLight* spotLight, const glm::vec3& sceneCenter, const float sceneRadius);
+	// ShadowMaps Private Data.
+	int mapSize;
+	GLuint cascadeTexId;
+	GLuint spotTexId;
+	GLuint fboId;
+	glm::mat4x4 cascadeViewProj[NUM_SHADOW_CASCADES];
+	glm::mat4x4 cascadeMatrices[NUM_SHADOW_CASCADES];
+	glm::vec4 cascadeSplits;
+	glm::vec4 cascadeTexelSizes;
+	glm::mat4x4 spotViewProj;
+	glm::mat4x4 spotMatrix;
+	float spotTexelSize;
+	GpuTimer cascadeTimers[NUM_SHADOW_CASCADES];
+	GpuTimer spotTimer;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "headers.h"
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+using namespace std;
+
+// SIMD_WIDTH lanes: 8 with AVX2 (/arch:AVX2, set in every configuration), otherwise 4 with SSE2.
+#if defined(__AVX2__)
+#define SIMD_WIDTH 8
+#else
+#define SIMD_WIDTH 4
+#endif
+
+// Whether this CPU (and OS) runs the instruction set the program was built for.
+// Checked first thing in main(), so an older CPU gets a message instead of an illegal instruction.
+inline bool GetCpuSupportsSimd()
+{
+#if !defined(__AVX2__)
+	return true;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+		return false;
+	__cpuid(regs, 1);
+	const bool hasOsXsave = (regs[2] & (1 << 27)) != 0;
+	if (!hasOsXsave || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+
+// SimdFloat Declarations (SIMD_WIDTH floats; comparisons return all-ones lane masks).
+struct SimdFloat
+{
+#if SIMD_WIDTH == 8
+	__m256 v;
+	SimdFloat() { v = _mm256_setzero_ps(); }
+	SimdFloat(const __m256 x) { v = x; }
+	SimdFloat(const float x) { v = _mm256_set1_ps(x); }
+	static SimdFloat Load(const float* p) { return _mm256_loadu_ps(p); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	static SimdFloat LaneOffsets() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+#else
+	__m128 v;
+	SimdFloat() { v = _mm_setzero_ps(); }
+	SimdFloat(const __m128 x) { v = x; }
+	SimdFloat(const float x) { v = _mm_set1_ps(x); }
+	static SimdFloat Load(const float* p) { return _mm_loadu_ps(p); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+	static SimdFloat LaneOffsets() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+#endif
+};
+
+#if SIMD_WIDTH == 8
+inline SimdFloat operator+(const SimdFloat a, const SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SimdFloat operator-(const SimdFloat a, const SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(const SimdFloat a, const SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(const SimdFloat a, const SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SimdFloat operator&(const SimdFloat a, const SimdFloat b) { return _mm256_and_ps(a.v, b.v); }
+inline SimdFloat operator|(const SimdFloat a, const SimdFloat b) { return _mm256_or_ps(a.v, b.v); }
+inline SimdFloat AndNot(const SimdFloat a, const SimdFloat b) { return _mm256_andnot_ps(a.v, b.v); } // ~a & b
+inline SimdFloat Min(const SimdFloat a, const SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SimdFloat Max(const SimdFloat a, const SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SimdFloat Sqrt(const SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+inline SimdFloat CmpGt(const SimdFloat a, const SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline SimdFloat CmpGe(const SimdFloat a, const SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline SimdFloat CmpLt(const SimdFloat a, const SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline SimdFloat CmpLe(const SimdFloat a, const SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline SimdFloat Select(const SimdFloat mask, const SimdFloat a, const SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline int MoveMask(const SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+#else
+inline SimdFloat operator+(const SimdFloat a, const SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat operator-(const SimdFloat a, const SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(const SimdFloat a, const SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(const SimdFloat a, const SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SimdFloat operator&(const SimdFloat a, const SimdFloat b) { return _mm_and_ps(a.v, b.v); }
+inline SimdFloat operator|(const SimdFloat a, const SimdFloat b) { return _mm_or_ps(a.v, b.v); }
+inline SimdFloat AndNot(const SimdFloat a, const SimdFloat b) { return _mm_andnot_ps(a.v, b.v); } // ~a & b
+inline SimdFloat Min(const SimdFloat a, const SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SimdFloat Max(const SimdFloat a, const SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SimdFloat Sqrt(const SimdFloat a) { return _mm_sqrt_ps(a.v); }
+inline SimdFloat CmpGt(const SimdFloat a, const SimdFloat b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline SimdFloat CmpGe(const SimdFloat a, const SimdFloat b) { return _mm_cmpge_ps(a.v, b.v); }
+inline SimdFloat CmpLt(const SimdFloat a, const SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline SimdFloat CmpLe(const SimdFloat a, const SimdFloat b) { return _mm_cmple_ps(a.v, b.v); }
+inline SimdFloat Select(const SimdFloat mask, const SimdFloat a, const SimdFloat b)
+{
+	return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline int MoveMask(const SimdFloat mask) { return _mm_movemask_ps(mask.v); }
+#endif
+inline SimdFloat operator-(const SimdFloat a) { return SimdFloat(0.0f) - a; }
+inline SimdFloat Clamp(const SimdFloat a, const SimdFloat lo, const SimdFloat hi) { return Min(Max(a, lo), hi); }
+inline SimdFloat Abs(const SimdFloat a) { return AndNot(SimdFloat(-0.0f), a); }
+// atan2 with a degree-11 minimax polynomial on [0, 1]; the error is below 1e-5 radians.
+inline SimdFloat Atan2(const SimdFloat y, const SimdFloat x)
+{
+	const SimdFloat ax = Abs(x), ay = Abs(y);
+	const SimdFloat t = Min(ax, ay) / Max(Max(ax, ay), SimdFloat(1e-30f));
+	const SimdFloat t2 = t * t;
+	SimdFloat r = SimdFloat(-0.01172120f) * t2 + SimdFloat(0.05265332f);
+	r = r * t2 - SimdFloat(0.11643287f);
+	r = r * t2 + SimdFloat(0.19354346f);
+	r = r * t2 - SimdFloat(0.33262347f);
+	r = (r * t2 + SimdFloat(0.99997726f)) * t;
+	r = Select(CmpGt(ay, ax), SimdFloat(1.57079633f) - r, r);
+	r = Select(CmpLt(x, SimdFloat(0.0f)), SimdFloat(3.14159265f) - r, r);
+	return Select(CmpLt(y, SimdFloat(0.0f)), -r, r);
+}
+
+
+// SimdVec3 Declarations (SIMD_WIDTH 3D vectors in SoA form).
+struct SimdVec3
+{
+	SimdVec3() {}
+	SimdVec3(const SimdFloat a, const SimdFloat b, const SimdFloat c) { x = a; y = b; z = c; }
+	SimdVec3(const float a, const float b, const float c) { x = a; y = b; z = c; }
+	SimdFloat x, y, z;
+};
+
+inline SimdVec3 operator+(const SimdVec3& a, const SimdVec3& b) { return SimdVec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline SimdVec3 operator-(const SimdVec3& a, const SimdVec3& b) { return SimdVec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline SimdVec3 operator*(const SimdVec3& a, const SimdVec3& b) { return SimdVec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline SimdVec3 operator*(const SimdVec3& a, const SimdFloat s) { return SimdVec3(a.x * s, a.y * s, a.z * s); }
+inline SimdVec3 operator-(const SimdVec3& a) { return SimdVec3(-a.x, -a.y, -a.z); }
+inline SimdFloat Dot(const SimdVec3& a, const SimdVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline SimdVec3 Cross(const SimdVec3& a, const SimdVec3& b)
+{
+	return SimdVec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline SimdFloat Length(const SimdVec3& a) { return Sqrt(Dot(a, a)); }
+inline SimdVec3 Normalize(const SimdVec3& a) { return a * (SimdFloat(1.0f) / Sqrt(Max(Dot(a, a), SimdFloat(1e-20f)))); }
+inline SimdVec3 Select(const SimdFloat mask, const SimdVec3& a, const SimdVec3& b)
+{
+	return SimdVec3(Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z));
+}
+
+#endif
@@ -1,9 +1,35 @@
 #include "skybox.h"
 using namespace std;
 
+bool Skybox::useCubemap = false;
+int Skybox::cubemapFaceSize = 0;
+
 Skybox::Skybox(const string& texImagePath, const int nSlices, const int nStacks, const float radius)
 {
 	rotationY = 0.0f;
+	material = nullptr;
+	panorama = nullptr;
+	cubemap = nullptr;
+	vboId = 0;
+	iboId = 0;
+	triangleVboId = 0;
+
+	if (useCubemap)
+	{
+		// Convert the panorama and create a fullscreen triangle.
+		cubemap = new CubemapTexture();
+		if (!cubemap->Create(texImagePath, cubemapFaceSize, ImageTexture::GetMipFilter()))
+		{
+			delete cubemap;
+			cubemap = nullptr;
+			return;
+		}
+		const glm::vec2 triangle[3] = { glm::vec2(-1.0f, -1.0f), glm::vec2(3.0f, -1.0f), glm::vec2(-1.0f, 3.0f) };
+		glGenBuffers(1, &triangleVboId);
+		glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+		return;
+	}
 
 	// Load panorama.
 	panorama = new ImageTexture(texImagePath);
@@ -35,15 +61,24 @@ Skybox::Skybox(const string& texImagePath, const int nSlices, const int nStacks,
 Skybox::~Skybox()
 {
 	vertices.clear();
-	glDeleteBuffers(1, &vboId);
+	if (vboId != 0)
+		glDeleteBuffers(1, &vboId);
 	indices.clear();
-	glDeleteBuffers(1, &iboId);
+	if (iboId != 0)
+		glDeleteBuffers(1, &iboId);
+	if (triangleVboId != 0)
+		glDeleteBuffers(1, &triangleVboId);
 
 	if (panorama != nullptr) 
 	{
 		delete panorama;
 		panorama = nullptr;
 	}
+	if (cubemap != nullptr)
+	{
+		delete cubemap;
+		cubemap = nullptr;
+	}
 	if (material != nullptr)
 	{
 		delete material;
@@ -53,6 +88,8 @@ Skybox::~Skybox()
 
 void Skybox::Render(Camera* camera, SkyboxShaderProg* shader, const float curRotationY)
 {
+	if (panorama == nullptr)
+		return;
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 
@@ -83,6 +120,36 @@ void Skybox::Render(Camera* camera, SkyboxShaderProg* shader, const float curRot
     glDisableVertexAttribArray(1);
 }
 
+void Skybox::Render(Camera* camera, SkyboxCubeShaderProg* shader, const float curRotationY)
+{
+	if (cubemap == nullptr)
+		return;
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (const GLvoid*)0);
+
+	shader->Bind();
+
+	// The sky is at infinity, so the view translation is dropped.
+	glm::mat4x4 worldMatrix = glm::rotate(glm::mat4x4(1.0f), glm::radians(curRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4x4 viewRotation = glm::mat4x4(glm::mat3x3(camera->GetViewMatrix()));
+	glm::mat4x4 invViewProj = glm::inverse(camera->GetProjMatrix() * viewRotation * worldMatrix);
+	glUniformMatrix4fv(shader->GetLocInvViewProj(), 1, GL_FALSE, glm::value_ptr(invViewProj));
+	cubemap->Bind(GL_TEXTURE0);
+	glUniform1i(shader->GetLocMapCube(), 0);
+
+	// Only pixels still at the far plane (cleared depth) are covered.
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	shader->UnBind();
+
+	glDisableVertexAttribArray(0);
+}
+
 void Skybox::CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
 							vector<VertexPT>& vertices, vector<unsigned int>& indices)
 {
@@ -3,6 +3,7 @@
 
 #include "headers.h"
 #include "imagetexture.h"
+#include "cubemaptexture.h"
 #include "shaderprog.h"
 #include "material.h"
 #include "camera.h"
@@ -27,6 +28,8 @@ struct VertexPT
 
 
 // Skybox Declarations.
+// Either a textured sphere around the origin, or (SetCubemap) a cubemap converted from the
+// panorama and drawn as one fullscreen triangle that looks the view direction up.
 class Skybox
 {
 public:
@@ -35,11 +38,17 @@ public:
 			const int nStacks, const float radius);
 	~Skybox();
 
+	static void SetCubemap(const bool enable, const int faceSize = 0) { useCubemap = enable; cubemapFaceSize = faceSize; }
+	static bool GetUseCubemap() { return useCubemap; }
+
 	void SetRotation(const float newRotation) { rotationY = newRotation; }
 	ImageTexture* GetTexture() { return panorama; }
+	CubemapTexture* GetCubemap() { return cubemap; }
+	bool GetLoaded() const { return panorama != nullptr || cubemap != nullptr; }
 	float GetRotation() const { return rotationY; }
 
 	void Render(Camera* camera, SkyboxShaderProg* shader, const float curRotationY);
+	void Render(Camera* camera, SkyboxCubeShaderProg* shader, const float curRotationY);
 
 private:
 	// Skybox Private Methods.
@@ -52,10 +61,15 @@ private:
 	
 	SkyboxMaterial* material;
 	ImageTexture* panorama;
+	CubemapTexture* cubemap;
+	GLuint triangleVboId;
 
 	float rotationY;
 	GLuint vboId;
 	GLuint iboId;
+
+	static bool useCubemap;
+	static int cubemapFaceSize;
 };
 
 #endif
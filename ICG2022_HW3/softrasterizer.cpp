@@ -0,0 +1,576 @@
+#include "softrasterizer.h"
+using namespace std;
+
+SoftRasterizer::SoftRasterizer(const int width, const int height)
+{
+	fbWidth = max(1, width);
+	fbHeight = max(1, height);
+	numTilesX = (fbWidth + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	numTilesY = (fbHeight + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	depthBuffer.resize(static_cast<size_t>(fbWidth) * fbHeight, 1.0f);
+	colorBuffer = cv::Mat(fbHeight, fbWidth, CV_8UC3, cv::Scalar(0, 0, 0));
+	tileBins.resize(numTilesX * numTilesY);
+
+	viewProjMatrix = glm::mat4x4(1.0f);
+	eyePos = glm::vec3(0.0f, 0.0f, 0.0f);
+	numPixelsShaded = 0;
+	numTriangles = 0;
+}
+
+SoftRasterizer::~SoftRasterizer()
+{
+	depthBuffer.clear();
+	colorBuffer.release();
+	shadedVertices.clear();
+	triangles.clear();
+	tileBins.clear();
+}
+
+void SoftRasterizer::SetCamera(const glm::mat4x4& viewMatrix, const glm::mat4x4& projMatrix, const glm::vec3& cameraPos)
+{
+	viewProjMatrix = projMatrix * viewMatrix;
+	eyePos = cameraPos;
+}
+
+// Clear color and depth (like glClear) and reset the frame statistics.
+void SoftRasterizer::Clear(const glm::vec3& clearColor)
+{
+	glm::vec3 c = glm::clamp(clearColor, 0.0f, 1.0f) * 255.0f + 0.5f;
+	colorBuffer.setTo(cv::Scalar((int)c.b, (int)c.g, (int)c.r));
+	fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+	numPixelsShaded = 0;
+	numTriangles = 0;
+}
+
+// Render all submeshes of a mesh with Phong shading.
+void SoftRasterizer::DrawMesh(TriangleMesh* mesh, const glm::mat4x4& worldMatrix)
+{
+	if (mesh == nullptr || mesh->GetVertices().empty())
+		return;
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	vector<VertexPTN>& vertices = mesh->GetVertices();
+	vector<SubMesh>& subMeshes = mesh->GetSubMeshes();
+	const int numVertices = static_cast<int>(vertices.size());
+	const int numSubMeshes = static_cast<int>(subMeshes.size());
+	const glm::mat4x4 MVP = viewProjMatrix * worldMatrix;
+	const glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(worldMatrix));
+
+	// Vertex stage (phong_shading.vs).
+	shadedVertices.resize(numVertices);
+	pool->ParallelFor(0, numVertices, 4096, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			ShadedVertex& sv = shadedVertices[i];
+			glm::vec4 p = glm::vec4(vertices[i].position, 1.0f);
+			sv.clipPos = MVP * p;
+			sv.worldPos = glm::vec3(worldMatrix * p);
+			sv.normal = glm::vec3(normalMatrix * glm::vec4(vertices[i].normal, 0.0f));
+			sv.texcoord = vertices[i].texcoord;
+		}
+	});
+	// Normal maps are sampled per vertex, so normal-mapped submeshes get their own copies.
+	vector<vector<int>> subMeshRemap(numSubMeshes);
+	for (int s = 0; s < numSubMeshes; ++s)
+	{
+		PhongMaterial* material = subMeshes[s].material;
+		if (material == nullptr || !material->GetHadMapNorm())
+			continue;
+		const cv::Mat& normImage = material->GetMapNorm()->GetImage();
+		subMeshRemap[s].assign(numVertices, -1);
+		for (unsigned int index : subMeshes[s].vertexIndices)
+		{
+			if (subMeshRemap[s][index] != -1)
+				continue;
+			ShadedVertex sv = shadedVertices[index];
+			glm::vec3 texNormal = glm::vec3(SampleTexture(normImage, sv.texcoord));
+			sv.normal = glm::vec3(normalMatrix * glm::vec4(texNormal, 0.0f));
+			subMeshRemap[s][index] = static_cast<int>(shadedVertices.size());
+			shadedVertices.push_back(sv);
+		}
+	}
+
+	// Primitive stage: cull, clip and set up the edge equations in parallel chunks.
+	vector<int> subMeshTriOffset(numSubMeshes + 1, 0);
+	for (int s = 0; s < numSubMeshes; ++s)
+		subMeshTriOffset[s + 1] = subMeshTriOffset[s] + static_cast<int>(subMeshes[s].vertexIndices.size() / 3);
+	const int totalTriangles = subMeshTriOffset[numSubMeshes];
+	numTriangles += totalTriangles;
+	const int setupGrain = 8192;
+	const int numChunks = (totalTriangles + setupGrain - 1) / setupGrain;
+	vector<vector<SetupTriangle>> chunkTriangles(numChunks);
+	vector<vector<ShadedVertex>> chunkVertices(numChunks);
+	pool->ParallelFor(0, totalTriangles, setupGrain, [&](int begin, int end)
+	{
+		const int chunk = begin / setupGrain;
+		vector<SetupTriangle>& outTriangles = chunkTriangles[chunk];
+		vector<ShadedVertex>& outVertices = chunkVertices[chunk];
+		vector<ShadedVertex> clipped;
+		int s = static_cast<int>(upper_bound(subMeshTriOffset.begin(), subMeshTriOffset.end(), begin) - subMeshTriOffset.begin()) - 1;
+		for (int t = begin; t < end; ++t)
+		{
+			while (t >= subMeshTriOffset[s + 1])
+				s++;
+			const unsigned int* indices = &subMeshes[s].vertexIndices[3 * (t - subMeshTriOffset[s])];
+			int vi[3];
+			for (int k = 0; k < 3; ++k)
+				vi[k] = subMeshRemap[s].empty() ? static_cast<int>(indices[k]) : subMeshRemap[s][indices[k]];
+			const ShadedVertex* v[3] = { &shadedVertices[vi[0]], &shadedVertices[vi[1]], &shadedVertices[vi[2]] };
+
+			// Trivially reject triangles outside one frustum plane (except near, clipped below).
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; ++axis)
+			{
+				bool allBelow = true, allAbove = true;
+				for (int k = 0; k < 3; ++k)
+				{
+					allBelow = allBelow && v[k]->clipPos[axis] < -v[k]->clipPos.w && axis != 2;
+					allAbove = allAbove && v[k]->clipPos[axis] > v[k]->clipPos.w;
+				}
+				outside = allBelow || allAbove;
+			}
+			if (outside)
+				continue;
+
+			SetupTriangle tri;
+			tri.subMesh = s;
+			bool needsClip = false;
+			for (int k = 0; k < 3; ++k)
+				needsClip = needsClip || (v[k]->clipPos.z < -v[k]->clipPos.w);
+			if (!needsClip)
+			{
+				if (SetupTri(v, tri))
+				{
+					int order[3] = { tri.vertex[0], tri.vertex[1], tri.vertex[2] };
+					for (int k = 0; k < 3; ++k)
+						tri.vertex[k] = vi[order[k]];
+					outTriangles.push_back(tri);
+				}
+				continue;
+			}
+			// Near-plane clipping; new vertices are stored per chunk (negative indices).
+			clipped.clear();
+			ShadedVertex input[3] = { *v[0], *v[1], *v[2] };
+			ClipTriangle(input, clipped);
+			for (size_t c = 0; c + 2 < clipped.size(); c += 3)
+			{
+				const ShadedVertex* cv3[3] = { &clipped[c], &clipped[c + 1], &clipped[c + 2] };
+				if (!SetupTri(cv3, tri))
+					continue;
+				int order[3] = { tri.vertex[0], tri.vertex[1], tri.vertex[2] };
+				for (int k = 0; k < 3; ++k)
+				{
+					tri.vertex[k] = -static_cast<int>(outVertices.size()) - 1;
+					outVertices.push_back(clipped[c + order[k]]);
+				}
+				outTriangles.push_back(tri);
+			}
+		}
+	});
+	triangles.clear();
+	for (int c = 0; c < numChunks; ++c)
+	{
+		int vertexBase = static_cast<int>(shadedVertices.size());
+		shadedVertices.insert(shadedVertices.end(), chunkVertices[c].begin(), chunkVertices[c].end());
+		for (SetupTriangle& tri : chunkTriangles[c])
+		{
+			for (int k = 0; k < 3; ++k)
+				if (tri.vertex[k] < 0)
+					tri.vertex[k] = vertexBase - tri.vertex[k] - 1;
+			triangles.push_back(tri);
+		}
+	}
+
+	// Binning: per-chunk bins are concatenated in submission order to keep depth ties stable.
+	const int numTiles = numTilesX * numTilesY;
+	const int numTris = static_cast<int>(triangles.size());
+	const int binGrain = 16384;
+	const int numBinChunks = (numTris + binGrain - 1) / binGrain;
+	vector<vector<vector<int>>> chunkBins(numBinChunks, vector<vector<int>>(numTiles));
+	pool->ParallelFor(0, numTris, binGrain, [&](int begin, int end)
+	{
+		vector<vector<int>>& bins = chunkBins[begin / binGrain];
+		for (int t = begin; t < end; ++t)
+		{
+			const SetupTriangle& tri = triangles[t];
+			for (int ty = tri.minY / SOFT_TILE_SIZE; ty <= tri.maxY / SOFT_TILE_SIZE; ++ty)
+				for (int tx = tri.minX / SOFT_TILE_SIZE; tx <= tri.maxX / SOFT_TILE_SIZE; ++tx)
+					bins[ty * numTilesX + tx].push_back(t);
+		}
+	});
+	pool->ParallelFor(0, numTiles, 8, [&](int begin, int end)
+	{
+		for (int tile = begin; tile < end; ++tile)
+		{
+			tileBins[tile].clear();
+			for (int c = 0; c < numBinChunks; ++c)
+				tileBins[tile].insert(tileBins[tile].end(), chunkBins[c][tile].begin(), chunkBins[c][tile].end());
+		}
+	});
+
+	// Raster and shading stage, one tile per task.
+	pool->ParallelFor(0, numTiles, 1, [&](int begin, int end)
+	{
+		for (int tile = begin; tile < end; ++tile)
+			RasterizeTile(tile, subMeshes);
+	});
+}
+
+// Write the color buffer to an image file.
+bool SoftRasterizer::SaveImage(const string& filePath) const
+{
+	bool success = false;
+	try
+	{
+		success = cv::imwrite(filePath, colorBuffer);
+	}
+	catch (const cv::Exception& e)
+	{
+		cerr << "[ERROR] " << e.what() << endl;
+	}
+	if (!success)
+		cerr << "[ERROR] Failed to write image: " << filePath << endl;
+	return success;
+}
+
+// Bilinear texture lookup with GL_REPEAT wrapping (LOD 0), returned as RGBA in [0, 1].
+// The image rows are stored in the order of the GL texture (see ImageTexture).
+glm::vec4 SoftRasterizer::SampleTexture(const cv::Mat& image, const glm::vec2& uv)
+{
+	if (image.empty())
+		return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	const int w = image.cols, h = image.rows, numChannels = image.channels();
+	float u = uv.x * w - 0.5f, v = uv.y * h - 0.5f;
+	float fu = floor(u), fv = floor(v);
+	float tx = u - fu, ty = v - fv;
+	int x0 = static_cast<int>(fu) % w, y0 = static_cast<int>(fv) % h;
+	if (x0 < 0) x0 += w;
+	if (y0 < 0) y0 += h;
+	int x1 = (x0 + 1) % w, y1 = (y0 + 1) % h;
+
+	const uchar* row0 = image.ptr<uchar>(y0);
+	const uchar* row1 = image.ptr<uchar>(y1);
+	float texel[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+	for (int c = 0; c < numChannels && c < 4; ++c)
+	{
+		float top = row0[x0 * numChannels + c] * (1.0f - tx) + row0[x1 * numChannels + c] * tx;
+		float bottom = row1[x0 * numChannels + c] * (1.0f - tx) + row1[x1 * numChannels + c] * tx;
+		texel[c] = top * (1.0f - ty) + bottom * ty;
+	}
+	const float scale = 1.0f / 255.0f;
+	if (numChannels == 1)
+		return glm::vec4(texel[0] * scale, 0.0f, 0.0f, 1.0f);
+	// OpenCV images are BGR(A).
+	return glm::vec4(texel[2], texel[1], texel[0], texel[3]) * scale;
+}
+
+// Clip a triangle against the near plane (z >= -w) and append the result as a triangle list.
+void SoftRasterizer::ClipTriangle(const ShadedVertex* v, vector<ShadedVertex>& out) const
+{
+	ShadedVertex polygon[4];
+	int numPolygon = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const ShadedVertex& a = v[i];
+		const ShadedVertex& b = v[(i + 1) % 3];
+		float da = a.clipPos.z + a.clipPos.w;
+		float db = b.clipPos.z + b.clipPos.w;
+		if (da >= 0.0f)
+			polygon[numPolygon++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			float t = da / (da - db);
+			ShadedVertex c;
+			c.clipPos = glm::mix(a.clipPos, b.clipPos, t);
+			c.worldPos = glm::mix(a.worldPos, b.worldPos, t);
+			c.normal = glm::mix(a.normal, b.normal, t);
+			c.texcoord = glm::mix(a.texcoord, b.texcoord, t);
+			polygon[numPolygon++] = c;
+		}
+	}
+	for (int i = 1; i + 1 < numPolygon; ++i)
+	{
+		out.push_back(polygon[0]);
+		out.push_back(polygon[i]);
+		out.push_back(polygon[i + 1]);
+	}
+}
+
+// Project a triangle to the screen and compute its edge and depth plane equations.
+bool SoftRasterizer::SetupTri(const ShadedVertex* const* v, SetupTriangle& tri) const
+{
+	float x[3], y[3], z[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		const glm::vec4& clip = v[k]->clipPos;
+		if (clip.w <= 0.0f)
+			return false;
+		tri.invW[k] = 1.0f / clip.w;
+		x[k] = (clip.x * tri.invW[k] * 0.5f + 0.5f) * fbWidth;
+		y[k] = (0.5f - clip.y * tri.invW[k] * 0.5f) * fbHeight;
+		z[k] = clip.z * tri.invW[k] * 0.5f + 0.5f;
+	}
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0.0f || !isfinite(area))
+		return false;
+	// Both windings are drawn (no face culling in the GL path); make the area positive.
+	int order[3] = { 0, 1, 2 };
+	if (area < 0.0f)
+	{
+		swap(order[1], order[2]);
+		area = -area;
+	}
+	float ox[3], oy[3], oz[3], oInvW[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		ox[k] = x[order[k]];
+		oy[k] = y[order[k]];
+		oz[k] = z[order[k]];
+		oInvW[k] = tri.invW[order[k]];
+	}
+	// Edge i is opposite vertex i; its value divided by the area is the weight of vertex i.
+	for (int i = 0; i < 3; ++i)
+	{
+		int a = (i + 1) % 3, b = (i + 2) % 3;
+		tri.edgeA[i] = oy[a] - oy[b];
+		tri.edgeB[i] = ox[b] - ox[a];
+		tri.edgeC[i] = -(tri.edgeA[i] * ox[a] + tri.edgeB[i] * oy[a]);
+		// Fill rule: an edge shared by two triangles is owned by exactly one of them.
+		tri.topLeft[i] = tri.edgeA[i] > 0.0f || (tri.edgeA[i] == 0.0f && tri.edgeB[i] > 0.0f);
+		tri.invW[i] = oInvW[i];
+	}
+	tri.invArea = 1.0f / area;
+	tri.zA = (oz[0] * tri.edgeA[0] + oz[1] * tri.edgeA[1] + oz[2] * tri.edgeA[2]) * tri.invArea;
+	tri.zB = (oz[0] * tri.edgeB[0] + oz[1] * tri.edgeB[1] + oz[2] * tri.edgeB[2]) * tri.invArea;
+	tri.zC = (oz[0] * tri.edgeC[0] + oz[1] * tri.edgeC[1] + oz[2] * tri.edgeC[2]) * tri.invArea;
+
+	// Pixel centers are at +0.5.
+	float minX = min(min(ox[0], ox[1]), ox[2]), maxX = max(max(ox[0], ox[1]), ox[2]);
+	float minY = min(min(oy[0], oy[1]), oy[2]), maxY = max(max(oy[0], oy[1]), oy[2]);
+	tri.minX = max(0, static_cast<int>(ceil(max(minX, -1.0f) - 0.5f)));
+	tri.minY = max(0, static_cast<int>(ceil(max(minY, -1.0f) - 0.5f)));
+	tri.maxX = min(fbWidth - 1, static_cast<int>(floor(min(maxX, (float)fbWidth + 1.0f) - 0.5f)));
+	tri.maxY = min(fbHeight - 1, static_cast<int>(floor(min(maxY, (float)fbHeight + 1.0f) - 0.5f)));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return false;
+	// Return the vertex order (after the winding swap) for the caller to map to indices.
+	tri.vertex[0] = order[0];
+	tri.vertex[1] = order[1];
+	tri.vertex[2] = order[2];
+	return true;
+}
+
+void SoftRasterizer::RasterizeTile(const int tileIndex, const vector<SubMesh>& subMeshes)
+{
+	const vector<int>& bin = tileBins[tileIndex];
+	if (bin.empty())
+		return;
+	const int tileX0 = (tileIndex % numTilesX) * SOFT_TILE_SIZE;
+	const int tileY0 = (tileIndex / numTilesX) * SOFT_TILE_SIZE;
+	const int tileX1 = min(fbWidth, tileX0 + SOFT_TILE_SIZE);
+	const int tileY1 = min(fbHeight, tileY0 + SOFT_TILE_SIZE);
+
+	// Tile-local visibility buffer: depth, triangle id and screen-space barycentrics.
+	alignas(32) float tileDepth[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+	alignas(32) float tileL1[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+	alignas(32) float tileL2[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+	int tileTriIds[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+	fill(tileTriIds, tileTriIds + SOFT_TILE_SIZE * SOFT_TILE_SIZE, -1);
+	for (int y = tileY0; y < tileY1; ++y)
+	{
+		float* dst = &tileDepth[(y - tileY0) * SOFT_TILE_SIZE];
+		memcpy(dst, &depthBuffer[static_cast<size_t>(y) * fbWidth + tileX0], sizeof(float) * (tileX1 - tileX0));
+		fill(dst + (tileX1 - tileX0), dst + SOFT_TILE_SIZE, 0.0f);
+	}
+
+	const SimdFloat laneOffsets = SimdFloat::LaneOffsets();
+	const SimdFloat zero(0.0f), one(1.0f);
+	const SimdFloat tileEnd(static_cast<float>(tileX1));
+	for (int triIndex : bin)
+	{
+		const SetupTriangle& tri = triangles[triIndex];
+		const int bx0 = max(tri.minX, tileX0), bx1 = min(tri.maxX, tileX1 - 1);
+		const int by0 = max(tri.minY, tileY0), by1 = min(tri.maxY, tileY1 - 1);
+		if (bx0 > bx1 || by0 > by1)
+			continue;
+		const int xs = tileX0 + ((bx0 - tileX0) / SIMD_WIDTH) * SIMD_WIDTH;
+		const float px0 = xs + 0.5f;
+		SimdFloat stepE[3], stepZ(tri.zA * SIMD_WIDTH);
+		for (int i = 0; i < 3; ++i)
+			stepE[i] = SimdFloat(tri.edgeA[i] * SIMD_WIDTH);
+		const SimdFloat invArea(tri.invArea);
+		for (int y = by0; y <= by1; ++y)
+		{
+			const float py = y + 0.5f;
+			SimdFloat e[3];
+			for (int i = 0; i < 3; ++i)
+				e[i] = SimdFloat(tri.edgeA[i] * px0 + tri.edgeB[i] * py + tri.edgeC[i]) + SimdFloat(tri.edgeA[i]) * laneOffsets;
+			SimdFloat z = SimdFloat(tri.zA * px0 + tri.zB * py + tri.zC) + SimdFloat(tri.zA) * laneOffsets;
+			SimdFloat px = SimdFloat(static_cast<float>(xs)) + laneOffsets;
+			const int rowOffset = (y - tileY0) * SOFT_TILE_SIZE - tileX0;
+			for (int x = xs; x <= bx1; x += SIMD_WIDTH)
+			{
+				SimdFloat inside = CmpLt(px, tileEnd);
+				for (int i = 0; i < 3; ++i)
+					inside = inside & (tri.topLeft[i] ? CmpGe(e[i], zero) : CmpGt(e[i], zero));
+				if (MoveMask(inside) != 0)
+				{
+					float* depth = &tileDepth[rowOffset + x];
+					SimdFloat oldDepth = SimdFloat::Load(depth);
+					SimdFloat pass = inside & CmpGe(z, zero) & CmpLe(z, one) & CmpLt(z, oldDepth);
+					int passBits = MoveMask(pass);
+					if (passBits != 0)
+					{
+						Select(pass, z, oldDepth).Store(depth);
+						Select(pass, e[1] * invArea, SimdFloat::Load(&tileL1[rowOffset + x])).Store(&tileL1[rowOffset + x]);
+						Select(pass, e[2] * invArea, SimdFloat::Load(&tileL2[rowOffset + x])).Store(&tileL2[rowOffset + x]);
+						for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+							if (passBits & (1 << lane))
+								tileTriIds[rowOffset + x + lane] = triIndex;
+					}
+				}
+				for (int i = 0; i < 3; ++i)
+					e[i] = e[i] + stepE[i];
+				z = z + stepZ;
+				px = px + SimdFloat(static_cast<float>(SIMD_WIDTH));
+			}
+		}
+	}
+
+	for (int y = tileY0; y < tileY1; ++y)
+		memcpy(&depthBuffer[static_cast<size_t>(y) * fbWidth + tileX0], &tileDepth[(y - tileY0) * SOFT_TILE_SIZE], sizeof(float) * (tileX1 - tileX0));
+	ShadeTile(tileX0, tileY0, tileX1, tileY1, tileTriIds, tileL1, tileL2, subMeshes);
+}
+
+// Shade every visible pixel of a tile once (phong_shading.fs), SIMD_WIDTH pixels at a time.
+void SoftRasterizer::ShadeTile(const int tileX0, const int tileY0, const int tileX1, const int tileY1,
+	const int* tileTriIds, const float* tileL1, const float* tileL2, const vector<SubMesh>& subMeshes)
+{
+	alignas(32) float pos[3][SIMD_WIDTH], nrm[3][SIMD_WIDTH];
+	alignas(32) float ka[3][SIMD_WIDTH], kd[3][SIMD_WIDTH], ks[3][SIMD_WIDTH], ns[SIMD_WIDTH];
+	alignas(32) float specBase[SIMD_WIDTH], specPow[SIMD_WIDTH];
+	alignas(32) float out[3][SIMD_WIDTH];
+
+	const SimdVec3 eye(eyePos.x, eyePos.y, eyePos.z);
+	const SimdVec3 ambient(lights.ambientLight.x, lights.ambientLight.y, lights.ambientLight.z);
+	const glm::vec3 spotAxis = glm::normalize(-lights.spotLightDir);
+	const float cosOuter = cos(glm::radians(lights.totalWidth));
+	const float spotEpsilon = cos(glm::radians(lights.cutoffStart)) - cosOuter;
+	const glm::vec3 dirL = glm::normalize(-lights.dirLightDir);
+	unsigned long long numShaded = 0;
+
+	for (int y = tileY0; y < tileY1; ++y)
+	{
+		uchar* colorRow = colorBuffer.ptr<uchar>(y);
+		const int rowOffset = (y - tileY0) * SOFT_TILE_SIZE - tileX0;
+		for (int x = tileX0; x < tileX1; x += SIMD_WIDTH)
+		{
+			int activeBits = 0;
+			for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+			{
+				const int triIndex = (x + lane < tileX1) ? tileTriIds[rowOffset + x + lane] : -1;
+				if (triIndex < 0)
+				{
+					// Inactive lanes get harmless values.
+					for (int c = 0; c < 3; ++c)
+					{
+						pos[c][lane] = 0.0f; nrm[c][lane] = (c == 1) ? 1.0f : 0.0f;
+						ka[c][lane] = kd[c][lane] = ks[c][lane] = 0.0f;
+					}
+					ns[lane] = 1.0f;
+					continue;
+				}
+				activeBits |= 1 << lane;
+				const SetupTriangle& tri = triangles[triIndex];
+				// Perspective-correct barycentrics.
+				float l1 = tileL1[rowOffset + x + lane], l2 = tileL2[rowOffset + x + lane];
+				float b[3] = { (1.0f - l1 - l2) * tri.invW[0], l1 * tri.invW[1], l2 * tri.invW[2] };
+				float invSum = 1.0f / (b[0] + b[1] + b[2]);
+				glm::vec3 p(0.0f), n(0.0f);
+				glm::vec2 uv(0.0f);
+				for (int k = 0; k < 3; ++k)
+				{
+					const ShadedVertex& sv = shadedVertices[tri.vertex[k]];
+					float w = b[k] * invSum;
+					p += sv.worldPos * w;
+					n += sv.normal * w;
+					uv += sv.texcoord * w;
+				}
+				// Material inputs, including texture fetches.
+				const PhongMaterial* material = subMeshes[tri.subMesh].material;
+				glm::vec3 KaColor(0.0f), KdColor(0.0f), KsColor(0.0f);
+				float NsVal = 1.0f;
+				if (material != nullptr)
+				{
+					KaColor = material->GetKa();
+					KdColor = material->GetHadMapKd() ? glm::vec3(SampleTexture(material->GetMapKd()->GetImage(), uv)) : material->GetKd();
+					KsColor = material->GetHadMapKs() ? glm::vec3(SampleTexture(material->GetMapKs()->GetImage(), uv)) : material->GetKs();
+					NsVal = material->GetHadMapNs() ? SampleTexture(material->GetMapNs()->GetImage(), uv).r : material->GetNs();
+					// phong_shading.fs samples mapKs for the ambient term when hadMapKa is set.
+					if (material->GetHadMapKa())
+						KaColor = material->GetHadMapKs() ? KsColor : glm::vec3(SampleTexture(material->GetMapKa()->GetImage(), uv));
+				}
+				for (int c = 0; c < 3; ++c)
+				{
+					pos[c][lane] = p[c];
+					nrm[c][lane] = n[c];
+					ka[c][lane] = KaColor[c];
+					kd[c][lane] = KdColor[c];
+					ks[c][lane] = KsColor[c];
+				}
+				ns[lane] = NsVal;
+			}
+			if (activeBits == 0)
+				continue;
+
+			SimdVec3 P(SimdFloat::Load(pos[0]), SimdFloat::Load(pos[1]), SimdFloat::Load(pos[2]));
+			SimdVec3 N = Normalize(SimdVec3(SimdFloat::Load(nrm[0]), SimdFloat::Load(nrm[1]), SimdFloat::Load(nrm[2])));
+			SimdVec3 V = Normalize(eye - P);
+			SimdVec3 Ka(SimdFloat::Load(ka[0]), SimdFloat::Load(ka[1]), SimdFloat::Load(ka[2]));
+			SimdVec3 Kd(SimdFloat::Load(kd[0]), SimdFloat::Load(kd[1]), SimdFloat::Load(kd[2]));
+			SimdVec3 Ks(SimdFloat::Load(ks[0]), SimdFloat::Load(ks[1]), SimdFloat::Load(ks[2]));
+			SimdVec3 color = Ka * ambient;
+
+			auto addLight = [&](const SimdVec3& L, const SimdVec3& I)
+			{
+				SimdFloat NdotL = Dot(N, L);
+				SimdVec3 R = Normalize(N * (NdotL + NdotL) - L);
+				Max(Dot(V, R), SimdFloat(0.0f)).Store(specBase);
+				for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+					specPow[lane] = pow(specBase[lane], ns[lane]);
+				color = color + Kd * I * Max(NdotL, SimdFloat(0.0f)) + Ks * I * SimdFloat::Load(specPow);
+			};
+			// Point light.
+			SimdVec3 toPoint = SimdVec3(lights.pointLightPos.x, lights.pointLightPos.y, lights.pointLightPos.z) - P;
+			SimdFloat invDist2 = SimdFloat(1.0f) / Max(Dot(toPoint, toPoint), SimdFloat(1e-20f));
+			SimdVec3 pointI = SimdVec3(lights.pointLightIntensity.x, lights.pointLightIntensity.y, lights.pointLightIntensity.z) * invDist2;
+			addLight(Normalize(toPoint), pointI);
+			// Spot light.
+			SimdVec3 toSpot = SimdVec3(lights.spotLightPos.x, lights.spotLightPos.y, lights.spotLightPos.z) - P;
+			invDist2 = SimdFloat(1.0f) / Max(Dot(toSpot, toSpot), SimdFloat(1e-20f));
+			SimdVec3 spotL = Normalize(toSpot);
+			SimdFloat cosTheta = Dot(spotL, SimdVec3(spotAxis.x, spotAxis.y, spotAxis.z));
+			SimdFloat cone = Clamp((cosTheta - SimdFloat(cosOuter)) / SimdFloat(spotEpsilon), SimdFloat(0.0f), SimdFloat(1.0f));
+			SimdVec3 spotI = SimdVec3(lights.spotLightIntensity.x, lights.spotLightIntensity.y, lights.spotLightIntensity.z) * (cone * invDist2);
+			addLight(spotL, spotI);
+			// Directional light.
+			addLight(SimdVec3(dirL.x, dirL.y, dirL.z), SimdVec3(lights.dirLightRadiance.x, lights.dirLightRadiance.y, lights.dirLightRadiance.z));
+
+			const SimdFloat toByte(255.0f);
+			(Clamp(color.x, SimdFloat(0.0f), SimdFloat(1.0f)) * toByte + SimdFloat(0.5f)).Store(out[0]);
+			(Clamp(color.y, SimdFloat(0.0f), SimdFloat(1.0f)) * toByte + SimdFloat(0.5f)).Store(out[1]);
+			(Clamp(color.z, SimdFloat(0.0f), SimdFloat(1.0f)) * toByte + SimdFloat(0.5f)).Store(out[2]);
+			for (int lane = 0; lane < SIMD_WIDTH; ++lane)
+			{
+				if (!(activeBits & (1 << lane)))
+					continue;
+				uchar* pixel = &colorRow[3 * (x + lane)];
+				pixel[0] = static_cast<uchar>(out[2][lane]);
+				pixel[1] = static_cast<uchar>(out[1][lane]);
+				pixel[2] = static_cast<uchar>(out[0][lane]);
+				numShaded++;
+			}
+		}
+	}
+	numPixelsShaded += numShaded;
+}
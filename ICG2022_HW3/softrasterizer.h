@@ -0,0 +1,114 @@
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include "headers.h"
+#include "trianglemesh.h"
+#include "threadpool.h"
+#include "simd.h"
+using namespace std;
+
+#define SOFT_TILE_SIZE 64
+
+
+// SoftLights Declarations (the light uniforms of phong_shading.fs).
+struct SoftLights
+{
+	SoftLights()
+	{
+		ambientLight = glm::vec3(0.0f, 0.0f, 0.0f);
+		pointLightPos = glm::vec3(0.0f, 0.0f, 0.0f);
+		pointLightIntensity = glm::vec3(0.0f, 0.0f, 0.0f);
+		spotLightPos = glm::vec3(0.0f, 0.0f, 0.0f);
+		spotLightIntensity = glm::vec3(0.0f, 0.0f, 0.0f);
+		spotLightDir = glm::vec3(0.0f, -1.0f, 0.0f);
+		cutoffStart = 30.0f;
+		totalWidth = 45.0f;
+		dirLightDir = glm::vec3(0.0f, 0.0f, -1.0f);
+		dirLightRadiance = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+	glm::vec3 ambientLight;
+	glm::vec3 pointLightPos;
+	glm::vec3 pointLightIntensity;
+	glm::vec3 spotLightPos;
+	glm::vec3 spotLightIntensity;
+	glm::vec3 spotLightDir;
+	float cutoffStart; // in degree.
+	float totalWidth;  // in degree.
+	glm::vec3 dirLightDir;
+	glm::vec3 dirLightRadiance;
+};
+
+
+// SoftRasterizer Declarations.
+// A tiled, multi-threaded CPU implementation of the phong_shading.vs/fs pipeline.
+// Vertices are transformed in parallel, triangles are clipped against the near plane
+// and binned into SOFT_TILE_SIZE tiles, and each tile is rasterized by one thread with
+// SIMD edge functions and depth tests. Visible pixels are then shaded once per draw,
+// SIMD_WIDTH pixels at a time.
+class SoftRasterizer
+{
+public:
+	// SoftRasterizer Public Methods.
+	SoftRasterizer(const int width, const int height);
+	~SoftRasterizer();
+
+	int GetWidth()  const { return fbWidth; }
+	int GetHeight() const { return fbHeight; }
+	const cv::Mat& GetColorBuffer() const { return colorBuffer; }
+	unsigned long long GetNumTriangles() const { return numTriangles; }
+	unsigned long long GetNumPixelsShaded() const { return numPixelsShaded; }
+
+	void SetCamera(const glm::mat4x4& viewMatrix, const glm::mat4x4& projMatrix, const glm::vec3& cameraPos);
+	void SetLights(const SoftLights& softLights) { lights = softLights; }
+	void Clear(const glm::vec3& clearColor);
+	void DrawMesh(TriangleMesh* mesh, const glm::mat4x4& worldMatrix);
+	bool SaveImage(const string& filePath) const;
+
+	static glm::vec4 SampleTexture(const cv::Mat& image, const glm::vec2& uv);
+
+private:
+	// SoftRasterizer Private Declarations.
+	struct ShadedVertex
+	{
+		glm::vec4 clipPos;
+		glm::vec3 worldPos;
+		glm::vec3 normal;
+		glm::vec2 texcoord;
+	};
+	struct SetupTriangle
+	{
+		int vertex[3];
+		int subMesh;
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];
+		float zA, zB, zC;
+		float invArea;
+		float invW[3];
+		int minX, minY, maxX, maxY;
+	};
+	// SoftRasterizer Private Methods.
+	void ClipTriangle(const ShadedVertex* v, vector<ShadedVertex>& out) const;
+	bool SetupTri(const ShadedVertex* const* v, SetupTriangle& tri) const;
+	void RasterizeTile(const int tileIndex, const vector<SubMesh>& subMeshes);
+	void ShadeTile(const int tileX0, const int tileY0, const int tileX1, const int tileY1,
+		const int* tileTriIds, const float* tileL1, const float* tileL2, const vector<SubMesh>& subMeshes);
+	// SoftRasterizer Private Data.
+	int fbWidth;
+	int fbHeight;
+	int numTilesX;
+	int numTilesY;
+	vector<float> depthBuffer;
+	cv::Mat colorBuffer;
+
+	glm::mat4x4 viewProjMatrix;
+	glm::vec3 eyePos;
+	SoftLights lights;
+
+	vector<ShadedVertex> shadedVertices;
+	vector<SetupTriangle> triangles;
+	vector<vector<int>> tileBins;
+	atomic<unsigned long long> numPixelsShaded;
+	unsigned long long numTriangles;
+};
+
+#endif
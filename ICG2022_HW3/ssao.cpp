@@ -0,0 +1,222 @@
+#include "ssao.h"
+using namespace std;
+
+// Samples per pixel and blur radius (in half resolution texels) of each quality level.
+static const int qualitySamples[NUM_SSAO_QUALITIES] = { 8, 16, 32 };
+static const int qualityBlurRadii[NUM_SSAO_QUALITIES] = { 2, 4, 6 };
+static const char* qualityNames[NUM_SSAO_QUALITIES] = { "low", "medium", "high" };
+
+Ssao::Ssao(const int width, const int height, const SsaoQuality quality)
+{
+	fullWidth = max(1, width);
+	fullHeight = max(1, height);
+	halfWidth = max(1, fullWidth / 2);
+	halfHeight = max(1, fullHeight / 2);
+	ssaoQuality = quality;
+	depthTexId = 0;
+	depthFboId = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		aoTexIds[i] = 0;
+		aoFboIds[i] = 0;
+	}
+	CreateAttachments();
+
+	const glm::vec2 triangle[3] = { glm::vec2(-1.0f, -1.0f), glm::vec2(3.0f, -1.0f), glm::vec2(-1.0f, 3.0f) };
+	glGenBuffers(1, &triangleVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+}
+
+Ssao::~Ssao()
+{
+	DeleteAttachments();
+	glDeleteBuffers(1, &triangleVboId);
+}
+
+int Ssao::GetNumSamples() const
+{
+	return qualitySamples[ssaoQuality];
+}
+
+int Ssao::GetBlurRadius() const
+{
+	return qualityBlurRadii[ssaoQuality];
+}
+
+// Full resolution depth, and two half resolution RG32F maps.
+size_t Ssao::GetGpuBytes() const
+{
+	return static_cast<size_t>(fullWidth) * fullHeight * 4 + static_cast<size_t>(halfWidth) * halfHeight * 8 * 2;
+}
+
+const char* Ssao::GetQualityName(const SsaoQuality quality)
+{
+	return qualityNames[quality];
+}
+
+void Ssao::SetQuality(const SsaoQuality quality)
+{
+	ssaoQuality = quality;
+	depthTimer.Reset();
+	aoTimer.Reset();
+}
+
+// Recreate the attachments with a new size.
+void Ssao::Resize(const int width, const int height)
+{
+	if (width == fullWidth && height == fullHeight)
+		return;
+	DeleteAttachments();
+	fullWidth = max(1, width);
+	fullHeight = max(1, height);
+	halfWidth = max(1, fullWidth / 2);
+	halfHeight = max(1, fullHeight / 2);
+	CreateAttachments();
+}
+
+void Ssao::DrawDepth(const function<void()>& drawDepth)
+{
+	GLint prevFboId = 0;
+	GLint prevViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthFboId);
+	glViewport(0, 0, fullWidth, fullHeight);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	depthTimer.Begin();
+	drawDepth();
+	depthTimer.End();
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+}
+
+void Ssao::Render(const glm::mat4x4& projMatrix, GLuint sceneDepthTexId, const float radius,
+	SsaoShaderProg* aoShader, SsaoShaderProg* blurShader)
+{
+	GLint prevFboId = 0;
+	GLint prevViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFboId);
+	glGetIntegerv(GL_VIEWPORT, prevViewport);
+	glm::mat4x4 invProjMatrix = glm::inverse(projMatrix);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	aoTimer.Begin();
+
+	// Occlusion at half resolution (into map 0).
+	glBindFramebuffer(GL_FRAMEBUFFER, aoFboIds[0]);
+	glViewport(0, 0, halfWidth, halfHeight);
+	aoShader->Bind();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sceneDepthTexId);
+	glUniform1i(aoShader->GetLocDepthMap(), 0);
+	glUniformMatrix4fv(aoShader->GetLocProjMatrix(), 1, GL_FALSE, glm::value_ptr(projMatrix));
+	glUniformMatrix4fv(aoShader->GetLocInvProjMatrix(), 1, GL_FALSE, glm::value_ptr(invProjMatrix));
+	glUniform1f(aoShader->GetLocRadius(), radius);
+	glUniform1i(aoShader->GetLocNumSamples(), GetNumSamples());
+	DrawFullscreen();
+
+	// Horizontal blur into map 1, vertical blur back into map 0.
+	blurShader->Bind();
+	glUniform1i(blurShader->GetLocAoMap(), 0);
+	glUniform1i(blurShader->GetLocBlurRadius(), GetBlurRadius());
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, aoFboIds[1 - pass]);
+		glBindTexture(GL_TEXTURE_2D, aoTexIds[pass]);
+		glUniform2i(blurShader->GetLocDirection(), 1 - pass, pass);
+		DrawFullscreen();
+	}
+	blurShader->UnBind();
+
+	aoTimer.End();
+	glBindFramebuffer(GL_FRAMEBUFFER, prevFboId);
+	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void Ssao::ShowInfo()
+{
+	cout << "SSAO (" << GetQualityName(ssaoQuality) << ", " << GetNumSamples() << " samples at " << halfWidth << " x "
+		<< halfHeight << ", blur radius " << GetBlurRadius() << "), GPU ms per frame:";
+	if (depthTimer.GetNumSamples() > 0)
+		cout << " depth " << depthTimer.GetAverageMs() << ",";
+	cout << " occlusion and blur " << aoTimer.GetAverageMs() << endl;
+	depthTimer.Reset();
+	aoTimer.Reset();
+}
+
+// Draw one triangle covering the viewport.
+void Ssao::DrawFullscreen()
+{
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleVboId);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (const GLvoid*)0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisableVertexAttribArray(0);
+}
+
+void Ssao::CreateAttachments()
+{
+	// The passes fetch texels, so there is no filtering.
+	glGenTextures(1, &depthTexId);
+	glBindTexture(GL_TEXTURE_2D, depthTexId);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, fullWidth, fullHeight);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, fullWidth, fullHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenTextures(2, aoTexIds);
+	for (int i = 0; i < 2; ++i)
+	{
+		glBindTexture(GL_TEXTURE_2D, aoTexIds[i]);
+		if (GLEW_ARB_texture_storage)
+			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32F, halfWidth, halfHeight);
+		else
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, halfWidth, halfHeight, 0, GL_RG, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint callerFboId = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFboId);
+	bool complete = true;
+	glGenFramebuffers(1, &depthFboId);
+	glBindFramebuffer(GL_FRAMEBUFFER, depthFboId);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexId, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	complete = complete && (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glGenFramebuffers(2, aoFboIds);
+	for (int i = 0; i < 2; ++i)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, aoFboIds[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, aoTexIds[i], 0);
+		complete = complete && (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
+	if (!complete)
+		cerr << "[ERROR] Incomplete SSAO framebuffers: " << fullWidth << " x " << fullHeight << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, callerFboId);
+}
+
+void Ssao::DeleteAttachments()
+{
+	glDeleteFramebuffers(1, &depthFboId);
+	glDeleteFramebuffers(2, aoFboIds);
+	glDeleteTextures(1, &depthTexId);
+	glDeleteTextures(2, aoTexIds);
+	depthTexId = 0;
+	depthFboId = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		aoTexIds[i] = 0;
+		aoFboIds[i] = 0;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef SSAO_H
+#define SSAO_H
+
+#include "headers.h"
+#include "shaderprog.h"
+#include "timer.h"
+using namespace std;
+
+// Quality levels of the SSAO pass (samples per pixel and radius of the blur).
+enum SsaoQuality
+{
+	SSAO_QUALITY_LOW,
+	SSAO_QUALITY_MEDIUM,
+	SSAO_QUALITY_HIGH,
+	NUM_SSAO_QUALITIES
+};
+
+
+// Ssao Declarations.
+// Screen-space ambient occlusion. Render() samples a hemisphere around each pixel at half
+// resolution, with view positions read back from a depth texture and normals reconstructed
+// from the neighbouring depths, and blurs the result with a separable filter that stops at
+// depth edges. The lighting pass (forward or deferred) upsamples the occlusion map, weighted
+// by depth again, into its ambient term (see ssao_upsample.glsl). The depth comes from the
+// G-buffer or from DrawDepth().
+class Ssao
+{
+public:
+	// Ssao Public Methods.
+	Ssao(const int width, const int height, const SsaoQuality quality);
+	~Ssao();
+
+	int GetWidth()  const { return fullWidth; }
+	int GetHeight() const { return fullHeight; }
+	SsaoQuality GetQuality() const { return ssaoQuality; }
+	int GetNumSamples() const;
+	int GetBlurRadius() const;
+	GLuint GetDepthTex() const { return depthTexId; }
+	// Occlusion and view depth of the last Render(), at half resolution.
+	GLuint GetAoTex() const { return aoTexIds[0]; }
+	size_t GetGpuBytes() const;
+	int GetNumTimingSamples() const { return aoTimer.GetNumSamples(); }
+	static const char* GetQualityName(const SsaoQuality quality);
+
+	void SetQuality(const SsaoQuality quality);
+	void Resize(const int width, const int height);
+	// Fill the depth texture of the pass (for a forward frame); drawDepth draws the scene.
+	void DrawDepth(const function<void()>& drawDepth);
+	// Occlusion within radius (view space) of the surfaces in sceneDepthTexId, seen through
+	// projMatrix, into the occlusion map.
+	void Render(const glm::mat4x4& projMatrix, GLuint sceneDepthTexId, const float radius,
+		SsaoShaderProg* aoShader, SsaoShaderProg* blurShader);
+	// Print the GPU time of the passes, averaged since the last call.
+	void ShowInfo();
+
+private:
+	// Ssao Private Methods.
+	void CreateAttachments();
+	void DeleteAttachments();
+	void DrawFullscreen();
+	// Ssao Private Data.
+	int fullWidth;
+	int fullHeight;
+	int halfWidth;
+	int halfHeight;
+	SsaoQuality ssaoQuality;
+	GLuint depthTexId;
+	GLuint depthFboId;
+	// Occlusion and view depth at half resolution, ping-ponged by the blur.
+	GLuint aoTexIds[2];
+	GLuint aoFboIds[2];
+	GLuint triangleVboId;
+	GpuTimer depthTimer;
+	GpuTimer aoTimer;
+};
+
+#endif
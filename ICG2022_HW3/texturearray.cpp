@@ -0,0 +1,90 @@
+#include "texturearray.h"
+using namespace std;
+
+TextureArray::TextureArray()
+{
+	textureObj = 0;
+	width = 0;
+	height = 0;
+	numLayers = 0;
+	numLevels = 0;
+}
+
+TextureArray::~TextureArray()
+{
+	if (textureObj != 0)
+		glDeleteTextures(1, &textureObj);
+}
+
+// Resize and convert the images to BGRA, build their mip chains and upload them as layers.
+bool TextureArray::Create(const vector<cv::Mat>& images, const bool isSrgb, const MipFilter mipFilter)
+{
+	if (images.empty() || textureObj != 0)
+		return false;
+	for (const cv::Mat& image : images)
+	{
+		if (image.empty() || image.depth() != CV_8U)
+		{
+			cerr << "[ERROR] Texture array layers must be 8-bit images" << endl;
+			return false;
+		}
+		width = max(width, image.cols);
+		height = max(height, image.rows);
+	}
+	numLayers = static_cast<int>(images.size());
+	numLevels = 1;
+	while (max(width, height) >> numLevels)
+		numLevels++;
+
+	glGenTextures(1, &textureObj);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, numLevels, GL_RGBA8, width, height, numLayers);
+	else
+	{
+		for (int level = 0; level < numLevels; ++level)
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, max(1, width >> level), max(1, height >> level),
+				numLayers, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	MipmapBuilder builder(mipFilter, isSrgb);
+	vector<cv::Mat> mipLevels;
+	for (int layer = 0; layer < numLayers; ++layer)
+	{
+		cv::Mat image;
+		if (images[layer].channels() == 1)
+			cv::cvtColor(images[layer], image, cv::COLOR_GRAY2BGRA);
+		else if (images[layer].channels() == 3)
+			cv::cvtColor(images[layer], image, cv::COLOR_BGR2BGRA);
+		else
+			image = images[layer];
+		if (image.cols != width || image.rows != height)
+			cv::resize(image, image, cv::Size(width, height), 0.0, 0.0, cv::INTER_LINEAR);
+		builder.Build(image, mipLevels);
+		for (int level = 0; level < numLevels; ++level)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mipLevels[level].cols, mipLevels[level].rows, 1,
+				GL_BGRA, GL_UNSIGNED_BYTE, mipLevels[level].ptr());
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return true;
+}
+
+void TextureArray::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+}
+
+// GPU memory of all layers including their mip chains.
+size_t TextureArray::GetGpuBytes() const
+{
+	size_t numBytes = 0;
+	for (int level = 0; level < numLevels; ++level)
+		numBytes += static_cast<size_t>(max(1, width >> level)) * max(1, height >> level) * 4;
+	return numBytes * numLayers;
+}
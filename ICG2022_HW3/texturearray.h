@@ -0,0 +1,50 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "headers.h"
+#include "mipmapbuilder.h"
+using namespace std;
+
+// Texture maps of a Phong material, in the order of the shader's texture units.
+enum TextureMap
+{
+	TEXTURE_MAP_NORM,
+	TEXTURE_MAP_KA,
+	TEXTURE_MAP_KD,
+	TEXTURE_MAP_KS,
+	TEXTURE_MAP_NS,
+	NUM_TEXTURE_MAPS
+};
+
+
+// TextureArray Declarations.
+// Several images as the layers of one RGBA8 GL_TEXTURE_2D_ARRAY, so that submeshes with
+// different textures can be drawn without rebinding. Layers share one size (the largest
+// of the images); smaller images are resized, which is harmless since they are addressed
+// by normalized texture coordinates. Each layer gets its own CPU-built mip chain.
+class TextureArray
+{
+public:
+	// TextureArray Public Methods.
+	TextureArray();
+	~TextureArray();
+
+	int GetNumLayers() const { return numLayers; }
+	int GetWidth()  const { return width; }
+	int GetHeight() const { return height; }
+	size_t GetGpuBytes() const;
+
+	// Images are 8-bit gray, BGR or BGRA in the row order of the GL textures.
+	bool Create(const vector<cv::Mat>& images, const bool isSrgb, const MipFilter mipFilter = MIP_FILTER_BOX);
+	void Bind(GLenum textureUnit);
+
+private:
+	// TextureArray Private Data.
+	GLuint textureObj;
+	int width;
+	int height;
+	int numLayers;
+	int numLevels;
+};
+
+#endif
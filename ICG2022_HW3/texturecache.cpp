@@ -0,0 +1,244 @@
+#include "texturecache.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+// DDS constants (see the DirectDraw Surface and DXGI_FORMAT documentation).
+#define DDS_MAGIC 0x20534444        // "DDS "
+#define DDS_FOURCC_DX10 0x30315844  // "DX10"
+#define DDS_HEADER_FLAGS 0x000A1007 // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE
+#define DDS_CAPS_MIPMAPS 0x00401008 // COMPLEX | TEXTURE | MIPMAP
+#define DDS_HEADER_FLAGS_PITCH 0x0002100F // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT | MIPMAPCOUNT
+#define DDS_CAPS2_CUBEMAP_ALL 0x0000FE00  // CUBEMAP | all six faces
+#define DDS_PIXELFORMAT_FOURCC 0x4
+#define DDS_RESOURCE_TEXTURE2D 3
+#define DDS_MISC_TEXTURECUBE 0x4
+#define DXGI_FORMAT_B8G8R8A8_UNORM 87
+// Written into the reserved header words so the quality of a cached image is known.
+#define DDS_TAG_ICG 0x54474349      // "ICGT"
+// Tag of the float block that may follow the surfaces of a cached cubemap.
+#define DDS_TAG_METADATA 0x53474349 // "ICGS"
+
+string TextureCache::cacheDirectory = "texture_cache";
+
+static unsigned int GetDxgiFormat(const TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_FORMAT_BC1: return 71;
+	case TEXTURE_FORMAT_BC3: return 77;
+	case TEXTURE_FORMAT_BC5: return 83;
+	case TEXTURE_FORMAT_BC7: return 98;
+	default: return 0;
+	}
+}
+
+// 64-bit FNV-1a.
+unsigned long long TextureCache::HashBytes(const vector<unsigned char>& bytes)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < bytes.size(); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+string TextureCache::GetCachePath(const unsigned long long sourceHash, const string& settings, const string& extension)
+{
+	stringstream ss;
+	ss << cacheDirectory << "/" << hex << setw(16) << setfill('0') << sourceHash << dec
+		<< "_" << settings << "_v" << TEXTURE_COMPRESSOR_VERSION << "." << extension;
+	return ss.str();
+}
+
+// Load a cached image; returns false if it is missing or not written by Save().
+bool TextureCache::Load(const string& filePath, CompressedImage& image)
+{
+	ifstream file(filePath, ios::binary);
+	if (!file)
+		return false;
+	unsigned int header[1 + 31 + 5];
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!file || header[0] != DDS_MAGIC || header[1] != 124 || header[21] != DDS_FOURCC_DX10 || header[8] != DDS_TAG_ICG)
+		return false;
+	image.height = static_cast<int>(header[3]);
+	image.width = static_cast<int>(header[4]);
+	const unsigned int numLevels = header[7];
+	memcpy(&image.psnr, &header[9], sizeof(float));
+	const unsigned int dxgiFormat = header[32];
+	TextureFormat formats[4] = { TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC5, TEXTURE_FORMAT_BC7 };
+	image.format = TEXTURE_FORMAT_RGBA8;
+	for (int i = 0; i < 4; ++i)
+		if (GetDxgiFormat(formats[i]) == dxgiFormat)
+			image.format = formats[i];
+	if (image.format == TEXTURE_FORMAT_RGBA8 || image.width <= 0 || image.height <= 0 || numLevels == 0 || numLevels > 32)
+		return false;
+
+	const int blockBytes = TextureCompressor::GetBlockBytes(image.format);
+	image.levels.assign(numLevels, vector<unsigned char>());
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		int w = max(1, image.width >> level), h = max(1, image.height >> level);
+		image.levels[level].resize(static_cast<size_t>((w + 3) / 4) * ((h + 3) / 4) * blockBytes);
+		file.read(reinterpret_cast<char*>(image.levels[level].data()), image.levels[level].size());
+	}
+	return !file.fail();
+}
+
+// Write the header and data through a temporary file, so concurrent loaders never see a partial file.
+static bool WriteCacheFile(const string& filePath, const unsigned int* header, const size_t headerBytes,
+	const vector<pair<const unsigned char*, size_t>>& blocks)
+{
+	stringstream ss;
+	ss << filePath << "." << this_thread::get_id() << ".tmp";
+	string tmpPath = ss.str();
+	ofstream file(tmpPath, ios::binary);
+	if (!file)
+	{
+		cerr << "[ERROR] Couldn't write the texture cache file: " << tmpPath << endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(header), headerBytes);
+	for (const pair<const unsigned char*, size_t>& block : blocks)
+		file.write(reinterpret_cast<const char*>(block.first), block.second);
+	file.close();
+	if (file.fail() || rename(tmpPath.c_str(), filePath.c_str()) != 0)
+	{
+		// Another loader may have written the same entry first.
+		remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static void CreateCacheDirectory(const string& dirPath)
+{
+#ifdef _WIN32
+	_mkdir(dirPath.c_str());
+#else
+	mkdir(dirPath.c_str(), 0755);
+#endif
+}
+
+void TextureCache::MakeDirectory()
+{
+	CreateCacheDirectory(cacheDirectory);
+}
+
+// Write a compressed mip chain.
+bool TextureCache::Save(const string& filePath, const CompressedImage& image)
+{
+	CreateCacheDirectory(cacheDirectory);
+	unsigned int header[1 + 31 + 5] = { 0 };
+	header[0] = DDS_MAGIC;
+	header[1] = 124;
+	header[2] = DDS_HEADER_FLAGS;
+	header[3] = static_cast<unsigned int>(image.height);
+	header[4] = static_cast<unsigned int>(image.width);
+	header[5] = image.levels.empty() ? 0 : static_cast<unsigned int>(image.levels[0].size());
+	header[7] = static_cast<unsigned int>(image.levels.size());
+	header[8] = DDS_TAG_ICG;
+	memcpy(&header[9], &image.psnr, sizeof(float));
+	header[19] = 32;
+	header[20] = DDS_PIXELFORMAT_FOURCC;
+	header[21] = DDS_FOURCC_DX10;
+	header[27] = DDS_CAPS_MIPMAPS;
+	header[32] = GetDxgiFormat(image.format);
+	header[33] = DDS_RESOURCE_TEXTURE2D;
+	header[35] = 1;
+
+	vector<pair<const unsigned char*, size_t>> blocks;
+	for (unsigned int level = 0; level < image.levels.size(); ++level)
+		blocks.push_back(make_pair(image.levels[level].data(), image.levels[level].size()));
+	return WriteCacheFile(filePath, header, sizeof(header), blocks);
+}
+
+// Load a cached BGRA8 cubemap; faces[face][level] in GL face order.
+bool TextureCache::LoadCubemap(const string& filePath, vector<vector<cv::Mat>>& faces, vector<float>* metadata)
+{
+	ifstream file(filePath, ios::binary);
+	if (!file)
+		return false;
+	unsigned int header[1 + 31 + 5];
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!file || header[0] != DDS_MAGIC || header[1] != 124 || header[21] != DDS_FOURCC_DX10 || header[8] != DDS_TAG_ICG
+		|| header[32] != DXGI_FORMAT_B8G8R8A8_UNORM || (header[34] & DDS_MISC_TEXTURECUBE) == 0)
+		return false;
+	const int faceSize = static_cast<int>(header[4]);
+	const unsigned int numLevels = header[7];
+	if (faceSize <= 0 || static_cast<int>(header[3]) != faceSize || numLevels == 0 || numLevels > 32)
+		return false;
+
+	faces.assign(6, vector<cv::Mat>());
+	for (int face = 0; face < 6; ++face)
+	{
+		for (unsigned int level = 0; level < numLevels; ++level)
+		{
+			const int size = max(1, faceSize >> level);
+			cv::Mat image(size, size, CV_8UC4);
+			file.read(reinterpret_cast<char*>(image.data), image.total() * 4);
+			faces[face].push_back(image);
+		}
+	}
+	if (metadata != nullptr)
+	{
+		// Readers of the DDS format ignore data after the surfaces.
+		unsigned int block[2] = { 0, 0 };
+		file.read(reinterpret_cast<char*>(block), sizeof(block));
+		if (!file || block[0] != DDS_TAG_METADATA || block[1] > 4096)
+			return false;
+		metadata->resize(block[1]);
+		file.read(reinterpret_cast<char*>(metadata->data()), block[1] * sizeof(float));
+	}
+	return !file.fail();
+}
+
+bool TextureCache::SaveCubemap(const string& filePath, const vector<vector<cv::Mat>>& faces, const vector<float>* metadata)
+{
+	if (faces.size() != 6 || faces[0].empty())
+		return false;
+	CreateCacheDirectory(cacheDirectory);
+	const int faceSize = faces[0][0].cols;
+	unsigned int header[1 + 31 + 5] = { 0 };
+	header[0] = DDS_MAGIC;
+	header[1] = 124;
+	header[2] = DDS_HEADER_FLAGS_PITCH;
+	header[3] = static_cast<unsigned int>(faceSize);
+	header[4] = static_cast<unsigned int>(faceSize);
+	header[5] = static_cast<unsigned int>(faceSize * 4);
+	header[7] = static_cast<unsigned int>(faces[0].size());
+	header[8] = DDS_TAG_ICG;
+	header[19] = 32;
+	header[20] = DDS_PIXELFORMAT_FOURCC;
+	header[21] = DDS_FOURCC_DX10;
+	header[27] = DDS_CAPS_MIPMAPS;
+	header[28] = DDS_CAPS2_CUBEMAP_ALL;
+	header[32] = DXGI_FORMAT_B8G8R8A8_UNORM;
+	header[33] = DDS_RESOURCE_TEXTURE2D;
+	header[34] = DDS_MISC_TEXTURECUBE;
+	header[35] = 1;
+
+	vector<pair<const unsigned char*, size_t>> blocks;
+	for (const vector<cv::Mat>& levels : faces)
+	{
+		for (const cv::Mat& level : levels)
+		{
+			if (!level.isContinuous() || level.type() != CV_8UC4)
+				return false;
+			blocks.push_back(make_pair(level.data, level.total() * 4));
+		}
+	}
+	unsigned int metadataBlock[2] = { DDS_TAG_METADATA, 0 };
+	if (metadata != nullptr)
+	{
+		metadataBlock[1] = static_cast<unsigned int>(metadata->size());
+		blocks.push_back(make_pair(reinterpret_cast<const unsigned char*>(metadataBlock), sizeof(metadataBlock)));
+		blocks.push_back(make_pair(reinterpret_cast<const unsigned char*>(metadata->data()), metadata->size() * sizeof(float)));
+	}
+	return WriteCacheFile(filePath, header, sizeof(header), blocks);
+}
@@ -0,0 +1,36 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "headers.h"
+#include "texturecompressor.h"
+using namespace std;
+
+
+// TextureCache Declarations.
+// On-disk cache of compressed mip chains as DDS files (DX10 header), named after a hash
+// of the source file bytes and the encoder settings so edited textures are re-encoded.
+// The levels are stored top row first, as uploaded to GL and as DDS viewers expect.
+// Cubemaps are stored uncompressed (BGRA8, all mips of +X, -X, +Y, -Y, +Z, -Z in turn).
+class TextureCache
+{
+public:
+	// TextureCache Public Methods.
+	static void SetDirectory(const string& dirPath) { cacheDirectory = dirPath; }
+	static string GetDirectory() { return cacheDirectory; }
+
+	static unsigned long long HashBytes(const vector<unsigned char>& bytes);
+	static string GetCachePath(const unsigned long long sourceHash, const string& settings, const string& extension = "dds");
+	// Create the cache directory (for entries written by other classes).
+	static void MakeDirectory();
+	static bool Load(const string& filePath, CompressedImage& image);
+	static bool Save(const string& filePath, const CompressedImage& image);
+	// A cubemap entry can carry a block of floats after the faces (e.g. SH coefficients).
+	static bool LoadCubemap(const string& filePath, vector<vector<cv::Mat>>& faces, vector<float>* metadata = nullptr);
+	static bool SaveCubemap(const string& filePath, const vector<vector<cv::Mat>>& faces, const vector<float>* metadata = nullptr);
+
+private:
+	// TextureCache Private Data.
+	static string cacheDirectory;
+};
+
+#endif
@@ -0,0 +1,626 @@
+#include "texturecompressor.h"
+using namespace std;
+
+// BC7 interpolation weights of 4-bit indices (in 1/64).
+static const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// TexelBlock Declarations (a 4x4 block in [0, 255], stored per channel for SIMD).
+struct TexelBlock
+{
+	float r[16];
+	float g[16];
+	float b[16];
+	float a[16];
+};
+
+// BitWriter/BitReader Declarations (LSB first, as in the BC7 specification).
+struct BitWriter
+{
+	BitWriter(unsigned char* p) { data = p; pos = 0; }
+	void Write(const unsigned int value, const int numBits)
+	{
+		for (int i = 0; i < numBits; ++i, ++pos)
+			if ((value >> i) & 1)
+				data[pos >> 3] |= static_cast<unsigned char>(1 << (pos & 7));
+	}
+	unsigned char* data;
+	int pos;
+};
+
+struct BitReader
+{
+	BitReader(const unsigned char* p) { data = p; pos = 0; }
+	unsigned int Read(const int numBits)
+	{
+		unsigned int value = 0;
+		for (int i = 0; i < numBits; ++i, ++pos)
+			value |= ((data[pos >> 3] >> (pos & 7)) & 1u) << i;
+		return value;
+	}
+	const unsigned char* data;
+	int pos;
+};
+
+// Gather a block from a BGR(A) or gray image, clamping at the image edges.
+static void LoadBlock(const cv::Mat& image, const int bx, const int by, TexelBlock& block)
+{
+	const int numChannels = image.channels();
+	for (int j = 0; j < 4; ++j)
+	{
+		const uchar* row = image.ptr<uchar>(min(by * 4 + j, image.rows - 1));
+		for (int i = 0; i < 4; ++i)
+		{
+			const uchar* p = row + min(bx * 4 + i, image.cols - 1) * numChannels;
+			const int k = j * 4 + i;
+			if (numChannels == 1)
+			{
+				block.r[k] = block.g[k] = block.b[k] = p[0];
+				block.a[k] = 255.0f;
+			}
+			else
+			{
+				block.b[k] = p[0];
+				block.g[k] = p[1];
+				block.r[k] = p[2];
+				block.a[k] = (numChannels == 4) ? p[3] : 255.0f;
+			}
+		}
+	}
+}
+
+// Fit a line through the block (mean and principal axis of the first numDims channels)
+// and return its endpoints where the texels project to the ends of the line.
+static void FitEndpoints(const TexelBlock& block, const int numDims, float e0[4], float e1[4])
+{
+	const float* channels[4] = { block.r, block.g, block.b, block.a };
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float cov[4][4] = { { 0.0f } };
+	for (int d = 0; d < numDims; ++d)
+	{
+		for (int k = 0; k < 16; ++k)
+			mean[d] += channels[d][k];
+		mean[d] /= 16.0f;
+	}
+	for (int d = 0; d < numDims; ++d)
+		for (int e = d; e < numDims; ++e)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 16; ++k)
+				sum += (channels[d][k] - mean[d]) * (channels[e][k] - mean[e]);
+			cov[d][e] = cov[e][d] = sum;
+		}
+	// Power iteration, starting from the row of the widest channel.
+	int widest = 0;
+	for (int d = 1; d < numDims; ++d)
+		if (cov[d][d] > cov[widest][widest])
+			widest = d;
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int d = 0; d < numDims; ++d)
+		axis[d] = cov[widest][d];
+	for (int iter = 0; iter < 8; ++iter)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (int d = 0; d < numDims; ++d)
+		{
+			for (int e = 0; e < numDims; ++e)
+				next[d] += cov[d][e] * axis[e];
+			length += next[d] * next[d];
+		}
+		if (length < 1e-12f)
+			break;
+		length = 1.0f / sqrt(length);
+		for (int d = 0; d < numDims; ++d)
+			axis[d] = next[d] * length;
+	}
+	float tMin = 0.0f, tMax = 0.0f;
+	for (int k = 0; k < 16; ++k)
+	{
+		float t = 0.0f;
+		for (int d = 0; d < numDims; ++d)
+			t += (channels[d][k] - mean[d]) * axis[d];
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+	for (int d = 0; d < 4; ++d)
+	{
+		e0[d] = (d < numDims) ? glm::clamp(mean[d] + axis[d] * tMax, 0.0f, 255.0f) : 255.0f;
+		e1[d] = (d < numDims) ? glm::clamp(mean[d] + axis[d] * tMin, 0.0f, 255.0f) : 255.0f;
+	}
+}
+
+static unsigned short PackRGB565(const float c[3])
+{
+	int r = glm::clamp(static_cast<int>(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+	int g = glm::clamp(static_cast<int>(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+	int b = glm::clamp(static_cast<int>(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+	return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(const unsigned short c, int rgb[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Pick the nearest of four palette colors, SIMD_WIDTH texels at a time. Returns the squared error.
+static float SelectIndicesBC1(const TexelBlock& block, const float palette[4][3], int indices[16])
+{
+	float error = 0.0f;
+	for (int k = 0; k < 16; k += SIMD_WIDTH)
+	{
+		SimdFloat r = SimdFloat::Load(block.r + k);
+		SimdFloat g = SimdFloat::Load(block.g + k);
+		SimdFloat b = SimdFloat::Load(block.b + k);
+		SimdFloat bestDist(FLT_MAX), bestIndex(0.0f);
+		for (int p = 0; p < 4; ++p)
+		{
+			SimdFloat dr = r - SimdFloat(palette[p][0]);
+			SimdFloat dg = g - SimdFloat(palette[p][1]);
+			SimdFloat db = b - SimdFloat(palette[p][2]);
+			SimdFloat dist = dr * dr + dg * dg + db * db;
+			SimdFloat closer = CmpLt(dist, bestDist);
+			bestDist = Select(closer, dist, bestDist);
+			bestIndex = Select(closer, SimdFloat(static_cast<float>(p)), bestIndex);
+		}
+		float dist[SIMD_WIDTH], index[SIMD_WIDTH];
+		bestDist.Store(dist);
+		bestIndex.Store(index);
+		for (int i = 0; i < SIMD_WIDTH; ++i)
+		{
+			indices[k + i] = static_cast<int>(index[i]);
+			error += dist[i];
+		}
+	}
+	return error;
+}
+
+// Encode the color of a block as BC1 (also the color half of BC3), always in
+// four-color mode: a principal-axis fit followed by one least-squares refinement.
+static void EncodeBC1(const TexelBlock& block, unsigned char* out)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	const float* channels[3] = { block.r, block.g, block.b };
+	float e0[4], e1[4];
+	FitEndpoints(block, 3, e0, e1);
+
+	float bestError = FLT_MAX;
+	unsigned short bestC0 = 0, bestC1 = 0;
+	int bestIndices[16] = { 0 };
+	for (int iter = 0; iter < 2; ++iter)
+	{
+		unsigned short c0 = PackRGB565(e0);
+		unsigned short c1 = PackRGB565(e1);
+		if (c0 < c1)
+			swap(c0, c1);
+		int rgb0[3], rgb1[3];
+		UnpackRGB565(c0, rgb0);
+		UnpackRGB565(c1, rgb1);
+		float palette[4][3];
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[0][c] = static_cast<float>(rgb0[c]);
+			palette[1][c] = static_cast<float>(rgb1[c]);
+			palette[2][c] = static_cast<float>((2 * rgb0[c] + rgb1[c]) / 3);
+			palette[3][c] = static_cast<float>((rgb0[c] + 2 * rgb1[c]) / 3);
+		}
+		int indices[16];
+		float error = SelectIndicesBC1(block, palette, indices);
+		// Equal endpoints would select the three-color mode, so use index 0 only.
+		if (c0 == c1)
+		{
+			fill(indices, indices + 16, 0);
+			error = 0.0f;
+			for (int k = 0; k < 16; ++k)
+				for (int c = 0; c < 3; ++c)
+					error += (channels[c][k] - palette[0][c]) * (channels[c][k] - palette[0][c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			bestC0 = c0;
+			bestC1 = c1;
+			copy(indices, indices + 16, bestIndices);
+		}
+		if (c0 == c1)
+			break;
+		// Solve for the endpoints that best reproduce the texels with these indices.
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = { 0.0f }, bx[3] = { 0.0f };
+		for (int k = 0; k < 16; ++k)
+		{
+			float alpha = weights[indices[k]], beta = 1.0f - alpha;
+			aa += alpha * alpha;
+			ab += alpha * beta;
+			bb += beta * beta;
+			for (int c = 0; c < 3; ++c)
+			{
+				ax[c] += alpha * channels[c][k];
+				bx[c] += beta * channels[c][k];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (fabs(det) < 1e-6f)
+			break;
+		for (int c = 0; c < 3; ++c)
+		{
+			e0[c] = glm::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+			e1[c] = glm::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+		}
+	}
+	unsigned int packedIndices = 0;
+	for (int k = 0; k < 16; ++k)
+		packedIndices |= static_cast<unsigned int>(bestIndices[k]) << (2 * k);
+	out[0] = bestC0 & 0xff;
+	out[1] = bestC0 >> 8;
+	out[2] = bestC1 & 0xff;
+	out[3] = bestC1 >> 8;
+	for (int i = 0; i < 4; ++i)
+		out[4 + i] = (packedIndices >> (8 * i)) & 0xff;
+}
+
+// Encode one channel as BC4 in the eight-value mode (alpha of BC3, each half of BC5).
+static void EncodeBC4(const float* values, unsigned char* out)
+{
+	float minValue = 255.0f, maxValue = 0.0f;
+	for (int k = 0; k < 16; ++k)
+	{
+		minValue = min(minValue, values[k]);
+		maxValue = max(maxValue, values[k]);
+	}
+	int a0 = static_cast<int>(maxValue + 0.5f);
+	int a1 = static_cast<int>(minValue + 0.5f);
+	out[0] = static_cast<unsigned char>(a0);
+	out[1] = static_cast<unsigned char>(a1);
+	unsigned long long packedIndices = 0;
+	if (a0 > a1)
+	{
+		// Index 0 is a0, 1 is a1 and 2..7 step from a0 towards a1.
+		float scale = 7.0f / (a0 - a1);
+		for (int k = 0; k < 16; ++k)
+		{
+			int step = glm::clamp(static_cast<int>((values[k] - a1) * scale + 0.5f), 0, 7);
+			unsigned long long index = (step == 7) ? 0 : (step == 0) ? 1 : 8 - step;
+			packedIndices |= index << (3 * k);
+		}
+	}
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (packedIndices >> (8 * i)) & 0xff;
+}
+
+// Encode a block as BC7 mode 6: one RGBA line with 7-bit endpoints, per-endpoint
+// p-bits and 4-bit indices. All four p-bit combinations are tried.
+static void EncodeBC7(const TexelBlock& block, unsigned char* out)
+{
+	const float* channels[4] = { block.r, block.g, block.b, block.a };
+	float e0[4], e1[4];
+	FitEndpoints(block, 4, e0, e1);
+
+	float bestError = FLT_MAX;
+	int bestQ[2][4] = { { 0 } }, bestP[2] = { 0, 0 }, bestIndices[16] = { 0 };
+	for (int pbits = 0; pbits < 4; ++pbits)
+	{
+		int p[2] = { pbits & 1, pbits >> 1 };
+		int q[2][4], v[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q[0][c] = glm::clamp(static_cast<int>((e0[c] - p[0]) * 0.5f + 0.5f), 0, 127);
+			q[1][c] = glm::clamp(static_cast<int>((e1[c] - p[1]) * 0.5f + 0.5f), 0, 127);
+			v[0][c] = (q[0][c] << 1) | p[0];
+			v[1][c] = (q[1][c] << 1) | p[1];
+		}
+		// Project the texels onto the quantized line, SIMD_WIDTH at a time.
+		float dir[4], lengthSq = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			dir[c] = static_cast<float>(v[1][c] - v[0][c]);
+			lengthSq += dir[c] * dir[c];
+		}
+		float invLengthSq = lengthSq > 0.0f ? 15.0f / lengthSq : 0.0f;
+		int indices[16];
+		for (int k = 0; k < 16; k += SIMD_WIDTH)
+		{
+			SimdFloat t(0.0f);
+			for (int c = 0; c < 4; ++c)
+				t = t + (SimdFloat::Load(channels[c] + k) - SimdFloat(static_cast<float>(v[0][c]))) * SimdFloat(dir[c]);
+			t = Clamp(t * SimdFloat(invLengthSq), SimdFloat(0.0f), SimdFloat(15.0f)) + SimdFloat(0.5f);
+			float index[SIMD_WIDTH];
+			t.Store(index);
+			for (int i = 0; i < SIMD_WIDTH; ++i)
+				indices[k + i] = min(15, static_cast<int>(index[i]));
+		}
+		// The weights are not quite uniform, so also try the neighbouring indices.
+		float error = 0.0f;
+		for (int k = 0; k < 16; ++k)
+		{
+			float bestTexelError = FLT_MAX;
+			int bestIndex = indices[k];
+			for (int index = max(0, indices[k] - 1); index <= min(15, indices[k] + 1); ++index)
+			{
+				float texelError = 0.0f;
+				for (int c = 0; c < 4; ++c)
+				{
+					int value = ((64 - bc7Weights4[index]) * v[0][c] + bc7Weights4[index] * v[1][c] + 32) >> 6;
+					texelError += (channels[c][k] - value) * (channels[c][k] - value);
+				}
+				if (texelError < bestTexelError)
+				{
+					bestTexelError = texelError;
+					bestIndex = index;
+				}
+			}
+			indices[k] = bestIndex;
+			error += bestTexelError;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(bestQ, q, sizeof(bestQ));
+			bestP[0] = p[0];
+			bestP[1] = p[1];
+			copy(indices, indices + 16, bestIndices);
+		}
+	}
+	// The anchor (first) index is stored without its top bit.
+	if (bestIndices[0] & 8)
+	{
+		for (int c = 0; c < 4; ++c)
+			swap(bestQ[0][c], bestQ[1][c]);
+		swap(bestP[0], bestP[1]);
+		for (int k = 0; k < 16; ++k)
+			bestIndices[k] = 15 - bestIndices[k];
+	}
+	memset(out, 0, 16);
+	BitWriter writer(out);
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.Write(bestQ[0][c], 7);
+		writer.Write(bestQ[1][c], 7);
+	}
+	writer.Write(bestP[0], 1);
+	writer.Write(bestP[1], 1);
+	writer.Write(bestIndices[0], 3);
+	for (int k = 1; k < 16; ++k)
+		writer.Write(bestIndices[k], 4);
+}
+
+static void DecodeBC1(const unsigned char* in, unsigned char rgba[16][4], const bool forceFourColors)
+{
+	unsigned short c0 = static_cast<unsigned short>(in[0] | (in[1] << 8));
+	unsigned short c1 = static_cast<unsigned short>(in[2] | (in[3] << 8));
+	int palette[4][4];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; ++c)
+	{
+		if (c0 > c1 || forceFourColors)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (c0 <= c1 && !forceFourColors)
+		palette[3][3] = 0;
+	unsigned int indices = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<unsigned int>(in[7]) << 24);
+	for (int k = 0; k < 16; ++k)
+		for (int c = 0; c < 4; ++c)
+			rgba[k][c] = static_cast<unsigned char>(palette[(indices >> (2 * k)) & 3][c]);
+}
+
+static void DecodeBC4(const unsigned char* in, unsigned char values[16])
+{
+	int a0 = in[0], a1 = in[1];
+	int palette[8] = { a0, a1, 0, 0, 0, 0, 0, 255 };
+	if (a0 > a1)
+		for (int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	else
+		for (int i = 2; i < 6; ++i)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+	unsigned long long indices = 0;
+	for (int i = 0; i < 6; ++i)
+		indices |= static_cast<unsigned long long>(in[2 + i]) << (8 * i);
+	for (int k = 0; k < 16; ++k)
+		values[k] = static_cast<unsigned char>(palette[(indices >> (3 * k)) & 7]);
+}
+
+// Decode BC7 mode 6 blocks (the only mode the encoder writes); other modes decode to magenta.
+static void DecodeBC7(const unsigned char* in, unsigned char rgba[16][4])
+{
+	BitReader reader(in);
+	if (reader.Read(7) != (1 << 6))
+	{
+		for (int k = 0; k < 16; ++k)
+		{
+			rgba[k][0] = 255;
+			rgba[k][1] = 0;
+			rgba[k][2] = 255;
+			rgba[k][3] = 255;
+		}
+		return;
+	}
+	int v[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		v[0][c] = reader.Read(7) << 1;
+		v[1][c] = reader.Read(7) << 1;
+	}
+	int p0 = reader.Read(1), p1 = reader.Read(1);
+	for (int c = 0; c < 4; ++c)
+	{
+		v[0][c] |= p0;
+		v[1][c] |= p1;
+	}
+	for (int k = 0; k < 16; ++k)
+	{
+		int index = reader.Read(k == 0 ? 3 : 4);
+		for (int c = 0; c < 4; ++c)
+			rgba[k][c] = static_cast<unsigned char>(((64 - bc7Weights4[index]) * v[0][c] + bc7Weights4[index] * v[1][c] + 32) >> 6);
+	}
+}
+
+// Compress every level of a mip chain (8-bit gray, BGR or BGRA) to the given format.
+bool TextureCompressor::Compress(const vector<cv::Mat>& mipLevels, const TextureFormat format, CompressedImage& image)
+{
+	if (mipLevels.empty() || mipLevels[0].empty() || mipLevels[0].depth() != CV_8U || format == TEXTURE_FORMAT_RGBA8)
+	{
+		cerr << "[ERROR] Unsupported image for texture compression" << endl;
+		return false;
+	}
+	ThreadPool* pool = ThreadPool::GetGlobal();
+	const int blockBytes = GetBlockBytes(format);
+	image.format = format;
+	image.width = mipLevels[0].cols;
+	image.height = mipLevels[0].rows;
+	image.levels.assign(mipLevels.size(), vector<unsigned char>());
+	for (unsigned int level = 0; level < mipLevels.size(); ++level)
+	{
+		const cv::Mat& src = mipLevels[level];
+		const int blocksX = (src.cols + 3) / 4;
+		const int blocksY = (src.rows + 3) / 4;
+		vector<unsigned char>& dst = image.levels[level];
+		dst.assign(static_cast<size_t>(blocksX) * blocksY * blockBytes, 0);
+		pool->ParallelFor(0, blocksY, max(1, 256 / blocksX), [&](int first, int last) {
+			TexelBlock block;
+			for (int by = first; by < last; ++by)
+				for (int bx = 0; bx < blocksX; ++bx)
+				{
+					LoadBlock(src, bx, by, block);
+					unsigned char* out = &dst[(static_cast<size_t>(by) * blocksX + bx) * blockBytes];
+					if (format == TEXTURE_FORMAT_BC1)
+						EncodeBC1(block, out);
+					else if (format == TEXTURE_FORMAT_BC3)
+					{
+						EncodeBC4(block.a, out);
+						EncodeBC1(block, out + 8);
+					}
+					else if (format == TEXTURE_FORMAT_BC5)
+					{
+						EncodeBC4(block.r, out);
+						EncodeBC4(block.g, out + 8);
+					}
+					else
+						EncodeBC7(block, out);
+				}
+		});
+	}
+	cv::Mat decoded;
+	Decompress(image, 0, decoded);
+	image.psnr = static_cast<float>(ComputePSNR(mipLevels[0], decoded, format));
+	return true;
+}
+
+// Decode one level to a BGRA image (BC5 yields red and green only).
+void TextureCompressor::Decompress(const CompressedImage& image, const int level, cv::Mat& decoded)
+{
+	const int width = max(1, image.width >> level);
+	const int height = max(1, image.height >> level);
+	const int blocksX = (width + 3) / 4;
+	const int blockBytes = GetBlockBytes(image.format);
+	decoded = cv::Mat(height, width, CV_8UC4, cv::Scalar(0, 0, 0, 255));
+	const vector<unsigned char>& data = image.levels[level];
+	for (int by = 0; by < (height + 3) / 4; ++by)
+		for (int bx = 0; bx < blocksX; ++bx)
+		{
+			const unsigned char* in = &data[(static_cast<size_t>(by) * blocksX + bx) * blockBytes];
+			unsigned char rgba[16][4];
+			if (image.format == TEXTURE_FORMAT_BC1)
+				DecodeBC1(in, rgba, false);
+			else if (image.format == TEXTURE_FORMAT_BC3)
+			{
+				unsigned char alpha[16];
+				DecodeBC1(in + 8, rgba, true);
+				DecodeBC4(in, alpha);
+				for (int k = 0; k < 16; ++k)
+					rgba[k][3] = alpha[k];
+			}
+			else if (image.format == TEXTURE_FORMAT_BC5)
+			{
+				unsigned char red[16], green[16];
+				DecodeBC4(in, red);
+				DecodeBC4(in + 8, green);
+				for (int k = 0; k < 16; ++k)
+				{
+					rgba[k][0] = red[k];
+					rgba[k][1] = green[k];
+					rgba[k][2] = 0;
+					rgba[k][3] = 255;
+				}
+			}
+			else
+				DecodeBC7(in, rgba);
+			for (int k = 0; k < 16; ++k)
+			{
+				int x = bx * 4 + (k & 3), y = by * 4 + (k >> 2);
+				if (x >= width || y >= height)
+					continue;
+				uchar* p = decoded.ptr<uchar>(y) + 4 * x;
+				p[0] = rgba[k][2];
+				p[1] = rgba[k][1];
+				p[2] = rgba[k][0];
+				p[3] = rgba[k][3];
+			}
+		}
+}
+
+// PSNR over the channels the format stores (RGB, plus alpha for BC3/BC7, RG for BC5).
+double TextureCompressor::ComputePSNR(const cv::Mat& reference, const cv::Mat& decoded, const TextureFormat format)
+{
+	const int numChannels = reference.channels();
+	double sumSq = 0.0;
+	unsigned long long numSamples = 0;
+	for (int y = 0; y < reference.rows; ++y)
+	{
+		const uchar* src = reference.ptr<uchar>(y);
+		const uchar* dst = decoded.ptr<uchar>(y);
+		for (int x = 0; x < reference.cols; ++x)
+		{
+			int bgra[4];
+			for (int c = 0; c < 4; ++c)
+				bgra[c] = (numChannels == 1) ? (c == 3 ? 255 : src[x]) : (c < numChannels ? src[x * numChannels + c] : 255);
+			int firstChannel = (format == TEXTURE_FORMAT_BC5) ? 1 : 0;
+			int lastChannel = ((format == TEXTURE_FORMAT_BC3 || format == TEXTURE_FORMAT_BC7) && numChannels == 4) ? 3 : 2;
+			for (int c = firstChannel; c <= lastChannel; ++c)
+			{
+				double diff = bgra[c] - dst[4 * x + c];
+				sumSq += diff * diff;
+				numSamples++;
+			}
+		}
+	}
+	if (numSamples == 0 || sumSq == 0.0)
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 / (sumSq / numSamples));
+}
+
+GLenum TextureCompressor::GetGLFormat(const TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TEXTURE_FORMAT_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+	case TEXTURE_FORMAT_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default: return GL_RGBA8;
+	}
+}
+
+string TextureCompressor::GetFormatName(const TextureFormat format)
+{
+	switch (format)
+	{
+	case TEXTURE_FORMAT_BC1: return "BC1";
+	case TEXTURE_FORMAT_BC3: return "BC3";
+	case TEXTURE_FORMAT_BC5: return "BC5";
+	case TEXTURE_FORMAT_BC7: return "BC7";
+	default: return "RGBA8";
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "simd.h"
+using namespace std;
+
+// Bump when the encoders change so stale cache entries are rebuilt.
+#define TEXTURE_COMPRESSOR_VERSION 3
+
+enum TextureFormat
+{
+	TEXTURE_FORMAT_RGBA8,
+	TEXTURE_FORMAT_BC1,
+	TEXTURE_FORMAT_BC3,
+	TEXTURE_FORMAT_BC5,
+	TEXTURE_FORMAT_BC7
+};
+
+
+// CompressedImage Declarations.
+// A block-compressed mip chain. Rows are stored top row first, as uploaded.
+struct CompressedImage
+{
+	CompressedImage()
+	{
+		format = TEXTURE_FORMAT_BC1;
+		width = 0;
+		height = 0;
+		psnr = 0.0f;
+	}
+	size_t GetNumBytes() const
+	{
+		size_t numBytes = 0;
+		for (unsigned int i = 0; i < levels.size(); ++i)
+			numBytes += levels[i].size();
+		return numBytes;
+	}
+	TextureFormat format;
+	int width;
+	int height;
+	float psnr; // Level 0 against the source image, in dB.
+	vector<vector<unsigned char>> levels;
+};
+
+
+// TextureCompressor Declarations.
+// CPU encoders for BC1 (RGB), BC3 (RGBA), BC5 (two-channel normal maps) and BC7 (mode 6).
+// Endpoints are fitted along the principal axis of each 4x4 block, indices are chosen
+// SIMD_WIDTH texels at a time, and the blocks of a level are spread over the thread pool.
+class TextureCompressor
+{
+public:
+	// TextureCompressor Public Methods.
+	static bool Compress(const vector<cv::Mat>& mipLevels, const TextureFormat format, CompressedImage& image);
+	static void Decompress(const CompressedImage& image, const int level, cv::Mat& decoded);
+	static double ComputePSNR(const cv::Mat& reference, const cv::Mat& decoded, const TextureFormat format);
+
+	static int GetBlockBytes(const TextureFormat format) { return (format == TEXTURE_FORMAT_BC1) ? 8 : 16; }
+	static GLenum GetGLFormat(const TextureFormat format);
+	static string GetFormatName(const TextureFormat format);
+};
+
+#endif
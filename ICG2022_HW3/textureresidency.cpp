@@ -0,0 +1,147 @@
+#include "textureresidency.h"
+using namespace std;
+
+TextureResidency::TextureResidency(const size_t budgetBytes, const int nUpgradesPerFrame)
+{
+	budget = budgetBytes;
+	residentBytes = 0;
+	maxUpgrades = max(1, nUpgradesPerFrame);
+	frameIndex = 1;
+	numUpgrades = 0;
+	numEvictions = 0;
+}
+
+TextureResidency::~TextureResidency()
+{
+	entries.clear();
+}
+
+// Smallest level index whose larger side is at most TEXTURE_RESIDENCY_COARSE_SIZE.
+int TextureResidency::GetCoarseLevel(const ImageTexture* texture)
+{
+	int level = 0;
+	while (level + 1 < texture->GetNumLevels()
+		&& max(texture->GetWidth() >> level, texture->GetHeight() >> level) > TEXTURE_RESIDENCY_COARSE_SIZE)
+		level++;
+	return level;
+}
+
+// Start managing a texture; returns the level it is first uploaded from.
+int TextureResidency::Register(ImageTexture* texture)
+{
+	Entry entry;
+	entry.wantedLevel = GetCoarseLevel(texture);
+	entries[texture] = entry;
+	residentBytes += texture->GetGpuBytes(entry.wantedLevel);
+	return entry.wantedLevel;
+}
+
+void TextureResidency::Unregister(ImageTexture* texture)
+{
+	if (entries.erase(texture) > 0)
+		residentBytes -= min(residentBytes, texture->GetGpuBytes());
+}
+
+// The texture is sampled at mipLevel in this frame (several requests keep the finest).
+void TextureResidency::Request(ImageTexture* texture, const float mipLevel)
+{
+	auto it = entries.find(texture);
+	if (it == entries.end())
+		return;
+	int level = glm::clamp(static_cast<int>(floor(mipLevel)), 0, texture->GetNumLevels() - 1);
+	Entry& entry = it->second;
+	entry.wantedLevel = (entry.lastUsedFrame == frameIndex) ? min(entry.wantedLevel, level) : level;
+	entry.lastUsedFrame = frameIndex;
+}
+
+// Called once per frame after the requests.
+void TextureResidency::Update()
+{
+	residentBytes = 0;
+	for (auto& entry : entries)
+		residentBytes += entry.first->GetGpuBytes();
+
+	// One finer level for the textures that are the most blurred in this frame.
+	vector<pair<int, ImageTexture*>> upgrades;
+	for (auto& entry : entries)
+	{
+		ImageTexture* texture = entry.first;
+		if (entry.second.lastUsedFrame == frameIndex && entry.second.wantedLevel < texture->GetResidentLevel()
+			&& !texture->GetChangingResidency() && !texture->GetStreaming())
+			upgrades.push_back(make_pair(texture->GetResidentLevel() - entry.second.wantedLevel, texture));
+	}
+	sort(upgrades.begin(), upgrades.end(), [](const pair<int, ImageTexture*>& a, const pair<int, ImageTexture*>& b) {
+		return a.first > b.first;
+	});
+	int numChanges = 0;
+	for (auto& upgrade : upgrades)
+	{
+		if (numChanges >= maxUpgrades)
+			break;
+		ImageTexture* texture = upgrade.second;
+		const int level = texture->GetResidentLevel() - 1;
+		const size_t extraBytes = texture->GetGpuBytes(level) - texture->GetGpuBytes();
+		if (residentBytes + extraBytes > budget && !Evict(residentBytes + extraBytes - budget, texture))
+			continue;
+		if (texture->SetResidentLevel(level))
+		{
+			residentBytes += extraBytes;
+			numUpgrades++;
+			numChanges++;
+		}
+	}
+	// New textures or a smaller budget.
+	if (residentBytes > budget)
+		Evict(residentBytes - budget, nullptr);
+	frameIndex++;
+}
+
+// Drop the finest levels of the least recently used textures until numBytes are freed.
+// Textures used in this frame only give up levels finer than they were requested at.
+bool TextureResidency::Evict(const size_t numBytes, const ImageTexture* keep)
+{
+	vector<pair<unsigned int, ImageTexture*>> victims;
+	for (auto& entry : entries)
+	{
+		ImageTexture* texture = entry.first;
+		int lowestLevel = (entry.second.lastUsedFrame == frameIndex) ? entry.second.wantedLevel : GetCoarseLevel(texture);
+		if (texture != keep && texture->GetResidentLevel() < lowestLevel
+			&& !texture->GetChangingResidency() && !texture->GetStreaming())
+			victims.push_back(make_pair(entry.second.lastUsedFrame, texture));
+	}
+	sort(victims.begin(), victims.end(), [](const pair<unsigned int, ImageTexture*>& a, const pair<unsigned int, ImageTexture*>& b) {
+		return a.first < b.first;
+	});
+	size_t freedBytes = 0;
+	for (auto& victim : victims)
+	{
+		if (freedBytes >= numBytes)
+			break;
+		ImageTexture* texture = victim.second;
+		const Entry& entry = entries[texture];
+		int lowestLevel = (entry.lastUsedFrame == frameIndex) ? entry.wantedLevel : GetCoarseLevel(texture);
+		int level = texture->GetResidentLevel();
+		const size_t residentTextureBytes = texture->GetGpuBytes();
+		while (level < lowestLevel && freedBytes + residentTextureBytes - texture->GetGpuBytes(level) < numBytes)
+			level++;
+		if (texture->SetResidentLevel(level))
+		{
+			freedBytes += residentTextureBytes - texture->GetGpuBytes(level);
+			numEvictions++;
+		}
+	}
+	residentBytes -= min(residentBytes, freedBytes);
+	return freedBytes >= numBytes;
+}
+
+// Show the resident memory against the budget.
+void TextureResidency::ShowInfo() const
+{
+	int numReduced = 0;
+	for (auto& entry : entries)
+		if (entry.first->GetResidentLevel() > 0)
+			numReduced++;
+	cout << "Texture residency: " << residentBytes / 1024 << " KB of " << budget / 1024 << " KB, "
+		<< entries.size() << " textures (" << numReduced << " without their finest level), "
+		<< numUpgrades << " upgrades, " << numEvictions << " evictions" << endl;
+}
@@ -0,0 +1,60 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "headers.h"
+#include "imagetexture.h"
+using namespace std;
+
+// Levels up to this size are always resident (they are loaded first).
+#define TEXTURE_RESIDENCY_COARSE_SIZE 64
+
+
+// TextureResidency Declarations.
+// Keeps the GPU memory of the registered textures within a budget. Textures start with
+// their coarse levels only; each frame the renderer requests the mip level it samples
+// every texture at (from the screen-space texel density), and Update() streams in one
+// finer level for the most blurred textures. When that does not fit, the finest levels
+// of the least recently used textures (and of textures sharper than requested) are evicted.
+class TextureResidency
+{
+public:
+	// TextureResidency Public Methods.
+	TextureResidency(const size_t budgetBytes, const int nUpgradesPerFrame = 2);
+	~TextureResidency();
+
+	size_t GetBudget() const { return budget; }
+	size_t GetResidentBytes() const { return residentBytes; }
+
+	int Register(ImageTexture* texture);
+	void Unregister(ImageTexture* texture);
+	void Request(ImageTexture* texture, const float mipLevel);
+	void Update();
+	void ShowInfo() const;
+
+	static int GetCoarseLevel(const ImageTexture* texture);
+	// Mip level sampled where a world unit covers pixelsPerUnit pixels and texelsPerUnit texels.
+	static float ComputeMipLevel(const float texelsPerUnit, const float pixelsPerUnit)
+	{
+		return (pixelsPerUnit > 0.0f && texelsPerUnit > 0.0f) ? log2(texelsPerUnit / pixelsPerUnit) : 0.0f;
+	}
+
+private:
+	// TextureResidency Private Declarations.
+	struct Entry
+	{
+		int wantedLevel = 0;
+		unsigned int lastUsedFrame = 0;
+	};
+	// TextureResidency Private Methods.
+	bool Evict(const size_t numBytes, const ImageTexture* keep);
+	// TextureResidency Private Data.
+	unordered_map<ImageTexture*, Entry> entries;
+	size_t budget;
+	size_t residentBytes;
+	int maxUpgrades;
+	unsigned int frameIndex;
+	unsigned int numUpgrades;
+	unsigned int numEvictions;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "texturestreamer.h"
+using namespace std;
+
+TextureStreamer::TextureStreamer(const size_t bytesPerFrame, const int nSegments, const size_t segmentBytes)
+{
+	pboId = 0;
+	mappedData = nullptr;
+	// A segment holds at least one row of a 32768 texel wide RGBA8 level.
+	segmentSize = max(segmentBytes, static_cast<size_t>(32768 * 4));
+	frameBudget = bytesPerFrame;
+	numStreamedBytes = 0;
+	maxUpdateMs = 0.0;
+	segments.resize(max(1, nSegments));
+	for (int i = static_cast<int>(segments.size()) - 1; i >= 0; --i)
+		freeSegments.push_back(i);
+
+	const size_t bufferSize = segments.size() * segmentSize;
+	glGenBuffers(1, &pboId);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboId);
+	// Persistent mapping needs GL 4.4 (or ARB_buffer_storage). Without it the workers
+	// fill a CPU staging copy of the ring and Update() copies each segment with glBufferSubData.
+	persistent = (GLEW_ARB_buffer_storage != 0);
+	if (persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, flags);
+		mappedData = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags));
+		persistent = (mappedData != nullptr);
+	}
+	if (!persistent)
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW);
+		staging.resize(bufferSize);
+		mappedData = staging.data();
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Workers may still be writing into the ring.
+	for (int segment : pipeline)
+		if (segments[segment].copyDone.valid())
+			segments[segment].copyDone.wait();
+	for (Segment& segment : segments)
+		if (segment.fence != nullptr)
+			glDeleteSync(segment.fence);
+	if (persistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboId);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &pboId);
+}
+
+// Split the levels into strips that fit a segment and queue them.
+void TextureStreamer::Enqueue(const void* owner, const vector<TextureUploadLevel>& levels)
+{
+	for (const TextureUploadLevel& level : levels)
+	{
+		const int rowsPerChunk = static_cast<int>(segmentSize / level.rowBytes);
+		for (int row = 0; row < level.numRows; row += rowsPerChunk)
+		{
+			Chunk chunk;
+			chunk.owner = owner;
+			chunk.level = level;
+			chunk.firstRow = row;
+			chunk.numRows = min(rowsPerChunk, level.numRows - row);
+			chunk.lastOfLevel = (row + chunk.numRows == level.numRows);
+			pendingChunks.push_back(chunk);
+		}
+	}
+}
+
+// Whether some rows of the owner have not been handed to GL yet.
+bool TextureStreamer::IsPending(const void* owner) const
+{
+	for (const Chunk& chunk : pendingChunks)
+		if (chunk.owner == owner)
+			return true;
+	for (int segment : pipeline)
+		if (segments[segment].chunk.owner == owner)
+			return true;
+	return false;
+}
+
+// Drop the queued strips of the owner and wait until no worker reads its data.
+void TextureStreamer::Cancel(const void* owner)
+{
+	for (auto it = pendingChunks.begin(); it != pendingChunks.end();)
+		it = (it->owner == owner) ? pendingChunks.erase(it) : it + 1;
+	for (auto it = pipeline.begin(); it != pipeline.end();)
+	{
+		Segment& segment = segments[*it];
+		if (segment.chunk.owner != owner)
+		{
+			++it;
+			continue;
+		}
+		if (segment.copyDone.valid())
+			segment.copyDone.wait();
+		freeSegments.push_back(*it);
+		it = pipeline.erase(it);
+	}
+}
+
+// Called once per frame on the GL thread.
+void TextureStreamer::Update()
+{
+	CpuTimer timer;
+	RecycleSegments(false);
+
+	// Issue the filled segments in order, up to the byte budget.
+	size_t numIssuedBytes = 0;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboId);
+	while (!pipeline.empty() && numIssuedBytes < frameBudget)
+	{
+		const int index = pipeline.front();
+		Segment& segment = segments[index];
+		if (segment.copyDone.wait_for(chrono::seconds(0)) != future_status::ready)
+			break;
+		segment.copyDone.get();
+		const size_t offset = index * segmentSize;
+		const size_t numBytes = segment.chunk.level.rowBytes * segment.chunk.numRows;
+		if (!persistent)
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, numBytes, mappedData + offset);
+		Issue(segment.chunk, reinterpret_cast<const unsigned char*>(offset));
+		segment.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		inFlight.push_back(index);
+		pipeline.pop_front();
+		numIssuedBytes += numBytes;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	numStreamedBytes += numIssuedBytes;
+
+	// Hand the next strips to the workers.
+	while (!pendingChunks.empty() && !freeSegments.empty())
+	{
+		const int index = freeSegments.back();
+		freeSegments.pop_back();
+		StartCopy(index);
+	}
+	maxUpdateMs = max(maxUpdateMs, timer.GetElapsedMs());
+}
+
+// Upload everything that is queued before returning.
+void TextureStreamer::Flush()
+{
+	const size_t budget = frameBudget;
+	frameBudget = numeric_limits<size_t>::max();
+	while (GetBusy())
+	{
+		Update();
+		if (freeSegments.empty())
+			RecycleSegments(true);
+		else if (!pipeline.empty())
+			segments[pipeline.front()].copyDone.wait();
+	}
+	frameBudget = budget;
+}
+
+// Copy the next queued strip into the segment on a worker thread.
+void TextureStreamer::StartCopy(const int index)
+{
+	Segment& segment = segments[index];
+	segment.chunk = pendingChunks.front();
+	pendingChunks.pop_front();
+	unsigned char* dst = mappedData + index * segmentSize;
+	const Chunk chunk = segment.chunk;
+	segment.copyDone = ThreadPool::GetGlobal()->Submit([dst, chunk]() {
+		const TextureUploadLevel& level = chunk.level;
+		for (int row = 0; row < chunk.numRows; ++row)
+			memcpy(dst + row * level.rowBytes, level.data + (chunk.firstRow + row) * level.rowPitch, level.rowBytes);
+	});
+	pipeline.push_back(index);
+}
+
+// Upload a strip of tightly packed rows from an offset into the bound unpack buffer.
+void TextureStreamer::Issue(const Chunk& chunk, const unsigned char* pixels)
+{
+	const TextureUploadLevel& level = chunk.level;
+	glBindTexture(GL_TEXTURE_2D, level.textureObj);
+	if (level.compressed)
+	{
+		const int y = chunk.firstRow * 4;
+		const int height = min(chunk.numRows * 4, level.height - y);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, level.level, 0, y, level.width, height, level.format,
+			static_cast<GLsizei>(level.rowBytes * chunk.numRows), pixels);
+	}
+	else
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, level.level, 0, chunk.firstRow, level.width, chunk.numRows,
+			level.format, level.type, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	// Coarser levels were issued before, so the texture is complete from this level down.
+	if (chunk.lastOfLevel)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level.level);
+}
+
+// Return issued segments to the free list once the GPU has consumed them.
+void TextureStreamer::RecycleSegments(const bool wait)
+{
+	while (!inFlight.empty())
+	{
+		Segment& segment = segments[inFlight.front()];
+		GLuint64 timeout = (wait && freeSegments.empty()) ? 1000000000ull : 0;
+		GLenum status = glClientWaitSync(segment.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(segment.fence);
+		segment.fence = nullptr;
+		freeSegments.push_back(inFlight.front());
+		inFlight.pop_front();
+	}
+}
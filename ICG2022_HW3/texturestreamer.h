@@ -0,0 +1,106 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "timer.h"
+using namespace std;
+
+
+// TextureUploadLevel Declarations.
+// One mip level of a texture whose storage is already allocated. Rows are block rows
+// (4 texel rows) for compressed formats.
+struct TextureUploadLevel
+{
+	TextureUploadLevel()
+	{
+		textureObj = 0;
+		level = 0;
+		width = 0;
+		height = 0;
+		format = GL_BGR;
+		type = GL_UNSIGNED_BYTE;
+		compressed = false;
+		data = nullptr;
+		rowPitch = 0;
+		rowBytes = 0;
+		numRows = 0;
+	}
+	GLuint textureObj;
+	GLint level;
+	int width;
+	int height;
+	GLenum format;  // Internal format for compressed levels.
+	GLenum type;
+	bool compressed;
+	const unsigned char* data;
+	size_t rowPitch;
+	size_t rowBytes;
+	int numRows;
+};
+
+
+// TextureStreamer Declarations.
+// Uploads texture levels without stalling the render thread. A persistently mapped
+// pixel-unpack buffer is split into segments; worker threads copy strips of rows into
+// free segments, Update() issues glTexSubImage2D from the filled segments up to a byte
+// budget per frame and fences them, and a segment is reused once its fence signals.
+// Levels are issued in the order given; after the last strip of a level the texture's
+// base level is lowered to it, so enqueueing coarse levels first gives a usable
+// texture after the first frame.
+class TextureStreamer
+{
+public:
+	// TextureStreamer Public Methods.
+	TextureStreamer(const size_t bytesPerFrame = 8 << 20, const int nSegments = 8, const size_t segmentBytes = 4 << 20);
+	~TextureStreamer();
+
+	bool GetPersistent() const { return persistent; }
+	bool GetBusy() const { return !pendingChunks.empty() || !pipeline.empty(); }
+	size_t GetNumStreamedBytes() const { return numStreamedBytes; }
+	double GetMaxUpdateMs() const { return maxUpdateMs; }
+
+	// The level data must stay valid until IsPending(owner) is false or Cancel(owner) returns.
+	void Enqueue(const void* owner, const vector<TextureUploadLevel>& levels);
+	bool IsPending(const void* owner) const;
+	void Cancel(const void* owner);
+	void Update();
+	void Flush();
+
+private:
+	// TextureStreamer Private Declarations.
+	struct Chunk
+	{
+		const void* owner = nullptr;
+		TextureUploadLevel level;
+		int firstRow = 0;
+		int numRows = 0;
+		bool lastOfLevel = false;
+	};
+	struct Segment
+	{
+		GLsync fence = nullptr;
+		future<void> copyDone;
+		Chunk chunk;
+	};
+	// TextureStreamer Private Methods.
+	void StartCopy(const int index);
+	void Issue(const Chunk& chunk, const unsigned char* pixels);
+	void RecycleSegments(const bool wait);
+	// TextureStreamer Private Data.
+	GLuint pboId;
+	unsigned char* mappedData;
+	vector<unsigned char> staging;
+	bool persistent;
+	size_t segmentSize;
+	size_t frameBudget;
+	vector<Segment> segments;
+	vector<int> freeSegments;
+	deque<int> pipeline;      // Segments being filled or ready, in issue order.
+	deque<int> inFlight;      // Issued segments waiting for their fence.
+	deque<Chunk> pendingChunks;
+	size_t numStreamedBytes;
+	double maxUpdateMs;
+};
+
+#endif
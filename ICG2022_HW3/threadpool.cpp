@@ -0,0 +1,101 @@
+#include "threadpool.h"
+using namespace std;
+
+// Create the worker threads (0 means one per hardware thread).
+ThreadPool::ThreadPool(const unsigned int nThreads)
+{
+	stopping = false;
+	unsigned int numThreads = nThreads;
+	if (numThreads == 0)
+		numThreads = max(1u, thread::hardware_concurrency());
+	for (unsigned int i = 0; i < numThreads; ++i)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+// Finish the queued tasks and join the worker threads.
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCond.notify_all();
+	for (thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+// Split [begin, end) into chunks of grainSize and run them on the workers.
+// The calling thread also processes chunks and only waits for chunks that are
+// already running, so it is safe to call from inside another task.
+void ThreadPool::ParallelFor(const int begin, const int end, const int grainSize, const function<void(int, int)>& func)
+{
+	if (end <= begin)
+		return;
+	const int grain = max(1, grainSize);
+	const int numChunks = (end - begin + grain - 1) / grain;
+	if (numChunks == 1 || workers.empty())
+	{
+		func(begin, end);
+		return;
+	}
+	struct ForState
+	{
+		atomic<int> nextChunk;
+		atomic<int> doneChunks;
+		mutex doneMutex;
+		condition_variable doneCond;
+	};
+	shared_ptr<ForState> state = make_shared<ForState>();
+	state->nextChunk = 0;
+	state->doneChunks = 0;
+	const function<void(int, int)>* funcPtr = &func;
+	auto runChunks = [state, funcPtr, begin, end, grain, numChunks]()
+	{
+		int chunk;
+		while ((chunk = state->nextChunk.fetch_add(1)) < numChunks)
+		{
+			int chunkBegin = begin + chunk * grain;
+			(*funcPtr)(chunkBegin, min(end, chunkBegin + grain));
+			if (state->doneChunks.fetch_add(1) + 1 == numChunks)
+			{
+				lock_guard<mutex> lock(state->doneMutex);
+				state->doneCond.notify_all();
+			}
+		}
+	};
+	const int numHelpers = min(numChunks - 1, static_cast<int>(workers.size()));
+	{
+		lock_guard<mutex> lock(queueMutex);
+		for (int i = 0; i < numHelpers; ++i)
+			tasks.push(runChunks);
+	}
+	queueCond.notify_all();
+	runChunks();
+	unique_lock<mutex> lock(state->doneMutex);
+	state->doneCond.wait(lock, [&]() { return state->doneChunks.load() == numChunks; });
+}
+
+// Shared pool for data-parallel work (mesh processing, image filtering, ...).
+ThreadPool* ThreadPool::GetGlobal()
+{
+	static ThreadPool globalPool;
+	return &globalPool;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(queueMutex);
+			queueCond.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
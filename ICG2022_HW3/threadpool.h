@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "headers.h"
+using namespace std;
+
+
+// ThreadPool Declarations.
+class ThreadPool
+{
+public:
+	// ThreadPool Public Methods.
+	ThreadPool(const unsigned int nThreads = 0);
+	~ThreadPool();
+
+	unsigned int GetNumThreads() const { return static_cast<unsigned int>(workers.size()); }
+
+	template<typename Func>
+	future<typename result_of<Func()>::type> Submit(Func func)
+	{
+		using ResultType = typename result_of<Func()>::type;
+		auto task = make_shared<packaged_task<ResultType()>>(func);
+		future<ResultType> result = task->get_future();
+		{
+			lock_guard<mutex> lock(queueMutex);
+			tasks.push([task]() { (*task)(); });
+		}
+		queueCond.notify_one();
+		return result;
+	}
+	void ParallelFor(const int begin, const int end, const int grainSize, const function<void(int, int)>& func);
+
+	static ThreadPool* GetGlobal();
+
+private:
+	// ThreadPool Private Methods.
+	void WorkerLoop();
+	// ThreadPool Private Data.
+	vector<thread> workers;
+	queue<function<void()>> tasks;
+	mutex queueMutex;
+	condition_variable queueCond;
+	bool stopping;
+};
+
+#endif
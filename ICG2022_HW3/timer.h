@@ -0,0 +1,178 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "headers.h"
+using namespace std;
+
+
+// CpuTimer Declarations.
+class CpuTimer
+{
+public:
+	// CpuTimer Public Methods.
+	CpuTimer() { Start(); }
+	~CpuTimer() {}
+
+	void Start() { startTime = chrono::high_resolution_clock::now(); }
+	double GetElapsedMs() const
+	{
+		return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+private:
+	// CpuTimer Private Data.
+	chrono::high_resolution_clock::time_point startTime;
+};
+
+
+// StageStats Declarations (accumulated timings of named stages, thread-safe).
+class StageStats
+{
+public:
+	// StageStats Public Methods.
+	StageStats() {}
+	~StageStats() {}
+
+	void Add(const string& stage, const double ms)
+	{
+		lock_guard<mutex> lock(statsMutex);
+		if (totalMs.find(stage) == totalMs.end())
+			stageOrder.push_back(stage);
+		totalMs[stage] += ms;
+		maxMs[stage] = max(maxMs[stage], ms);
+		counts[stage]++;
+	}
+	void ShowInfo()
+	{
+		lock_guard<mutex> lock(statsMutex);
+		for (const string& stage : stageOrder)
+		{
+			cout << stage << ": total " << totalMs[stage] << " ms, avg "
+				<< totalMs[stage] / counts[stage] << " ms, max " << maxMs[stage]
+				<< " ms (" << counts[stage] << " samples)" << endl;
+		}
+	}
+
+private:
+	// StageStats Private Data.
+	vector<string> stageOrder;
+	unordered_map<string, double> totalMs;
+	unordered_map<string, double> maxMs;
+	unordered_map<string, int> counts;
+	mutex statsMutex;
+};
+
+
+// GpuQuery Declarations (queries of one target that are read back a few frames later, so
+// measuring a pass never stalls the pipeline; Begin() skips a frame if all queries are busy,
+// or if another GpuQuery of the target is running, since GL queries do not nest).
+class GpuQuery
+{
+public:
+	// GpuQuery Public Methods.
+	GpuQuery(const GLenum queryTarget)
+	{
+		target = queryTarget;
+		for (int i = 0; i < NUM_QUERIES; ++i)
+		{
+			queries[i] = 0;
+			issued[i] = false;
+		}
+		next = 0;
+		active = -1;
+		Reset();
+	}
+	~GpuQuery()
+	{
+		if (queries[0] != 0)
+			glDeleteQueries(NUM_QUERIES, queries);
+	}
+
+	void Begin()
+	{
+		if (queries[0] == 0)
+			glGenQueries(NUM_QUERIES, queries);
+		Collect();
+		if (active >= 0 || issued[next] || GetTargetActive(target))
+			return;
+		glBeginQuery(target, queries[next]);
+		active = next;
+		GetTargetActive(target) = true;
+	}
+	void End()
+	{
+		if (active < 0)
+			return;
+		glEndQuery(target);
+		GetTargetActive(target) = false;
+		issued[active] = true;
+		next = (active + 1) % NUM_QUERIES;
+		active = -1;
+	}
+	void Reset()
+	{
+		total = 0.0;
+		numSamples = 0;
+	}
+	int GetNumSamples() const { return numSamples; }
+	double GetAverage() const { return numSamples > 0 ? total / numSamples : 0.0; }
+
+private:
+	// GpuQuery Private Methods.
+	static bool& GetTargetActive(const GLenum queryTarget)
+	{
+		static unordered_map<GLenum, bool> targetActive;
+		return targetActive[queryTarget];
+	}
+	void Collect()
+	{
+		for (int i = 0; i < NUM_QUERIES; ++i)
+		{
+			if (!issued[i])
+				continue;
+			GLint available = 0;
+			glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &result);
+			total += static_cast<double>(result);
+			numSamples++;
+			issued[i] = false;
+		}
+	}
+	// GpuQuery Private Data.
+	static const int NUM_QUERIES = 4;
+	GLenum target;
+	GLuint queries[NUM_QUERIES];
+	bool issued[NUM_QUERIES];
+	int next;
+	int active;
+	double total;
+	int numSamples;
+};
+
+
+// GpuTimer Declarations (GL_TIME_ELAPSED queries).
+class GpuTimer : public GpuQuery
+{
+public:
+	// GpuTimer Public Methods.
+	GpuTimer() : GpuQuery(GL_TIME_ELAPSED) {}
+
+	double GetAverageMs() const { return GetAverage() * 1e-6; }
+};
+
+
+// GpuSampleCounter Declarations (GL_SAMPLES_PASSED queries: the samples that pass the depth
+// test, which are the fragments shaded times the samples per pixel of the target).
+class GpuSampleCounter : public GpuQuery
+{
+public:
+	// GpuSampleCounter Public Methods.
+	GpuSampleCounter() : GpuQuery(GL_SAMPLES_PASSED) {}
+
+	double GetAverageSamples() const { return GetAverage(); }
+};
+
+#endif
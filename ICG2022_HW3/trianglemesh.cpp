@@ -1,10 +1,6 @@
 #include "trianglemesh.h"
-#include "hashfunction.h"
 using namespace std;
 
-unordered_map<string, PhongMaterial> phongMaterials;
-unordered_map<vector<int>, unsigned int, HashFunction> subMeshVertexIndices;
-
 // Constructor of a triangle mesh.
 TriangleMesh::TriangleMesh()
 {
@@ -17,28 +13,45 @@ TriangleMesh::TriangleMesh()
 	objCenter = glm::vec3(0.0f, 0.0f, 0.0f);
 	objExtent = glm::vec3(0.0f, 0.0f, 0.0f);
 	vboId = 0;
+	positionVboId = 0;
+	aoVboId = 0;
+	for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+		textureArrays[map] = nullptr;
 }
 
 // Destructor of a triangle mesh.
 TriangleMesh::~TriangleMesh()
 {
+	DeleteBuffers();
+	for (SubMesh& subMesh : subMeshes)
+	{
+		// The textures are shared with (and deleted by) the parsed materials.
+		(subMesh.material)->SetMapNorm(nullptr);
+		(subMesh.material)->SetMapKa(nullptr);
+		(subMesh.material)->SetMapKd(nullptr);
+		(subMesh.material)->SetMapKs(nullptr);
+		(subMesh.material)->SetMapNs(nullptr);
+		(subMesh.material)->SetMapD(nullptr);
+		delete subMesh.material;
+		subMesh.material = nullptr;
+	}
 	phongMaterials.clear();
 	subMeshVertexIndices.clear();
 	vertices.clear();
 	subMeshes.clear();
-	DeleteBuffers();
 }
 
-// Get the last index of a backslash of the file path.
+// Get the last index of a backslash (or slash) of the file path.
 int TriangleMesh::GetSubFilePathIndex(const string& filePath)
 {
-	int index = static_cast<int>(filePath.rfind("\\"));
+	int index = static_cast<int>(filePath.find_last_of("\\/"));
 	if (index != string::npos)
 		return index;
 	return -1;
 }
 
-// Load the geometry data from an OBJ file.
+// Load the geometry data from an OBJ file (false if it can't be opened or parsed).
+// Only touches CPU memory, textures are uploaded later by CreateBuffers().
 bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 {
 	vector<glm::vec3> positions, normals;
@@ -52,7 +65,7 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 	if (!fileStream)
 	{
 		cerr << "[ERROR] Couldn't open the obj file. Obj file path: " << filePath << endl;
-		exit(1);
+		return false;
 	}
 	while (getline(fileStream, line))
 	{
@@ -64,7 +77,9 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 		{
 			string materialFileName;
 			ss >> materialFileName;
-			hadMaterialFile = LoadMaterialFile(subFilePath, materialFileName);
+			if (!LoadMaterialFile(subFilePath, materialFileName))
+				return false;
+			hadMaterialFile = !phongMaterials.empty();
 		}
 		else if (prefix == "usemtl" || prefix == "f" && lastPrefix == "g")
 		{
@@ -78,6 +93,7 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 				(subMesh.material)->SetKd(phongMaterials[materialName].GetKd());
 				(subMesh.material)->SetKs(phongMaterials[materialName].GetKs());
 				(subMesh.material)->SetNs(phongMaterials[materialName].GetNs());
+				(subMesh.material)->SetOpacity(phongMaterials[materialName].GetOpacity());
 
 				(subMesh.material)->SetHadMapNorm(phongMaterials[materialName].GetHadMapNorm());
 				(subMesh.material)->SetMapNorm(phongMaterials[materialName].GetMapNorm());
@@ -98,6 +114,10 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 				(subMesh.material)->SetHadMapNs(phongMaterials[materialName].GetHadMapNs());
 				(subMesh.material)->SetMapNs(phongMaterials[materialName].GetMapNs());
 				(subMesh.material)->SetMapNsPath(phongMaterials[materialName].GetMapNsPath());
+
+				(subMesh.material)->SetHadMapD(phongMaterials[materialName].GetHadMapD());
+				(subMesh.material)->SetMapD(phongMaterials[materialName].GetMapD());
+				(subMesh.material)->SetMapDPath(phongMaterials[materialName].GetMapDPath());
 			}
 			subMeshes.push_back(subMesh);
 			subMeshesIndices.push_back(vector<vector<int>>(3));
@@ -110,7 +130,7 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the obj file. Lack of the vertex position info" << endl;
-				exit(1);
+				return false;
 			}
 			positions.push_back(vertex);
 			numPositions++;
@@ -122,8 +142,10 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the obj file. Lack of the vertex texcoord info" << endl;
-				exit(1);
+				return false;
 			}
+			// Images are uploaded top row first (see ImageDecoder), so v runs downwards.
+			texcoord.y = 1.0f - texcoord.y;
 			texcoords.push_back(texcoord);
 			numTexcoords++;
 		}
@@ -134,7 +156,7 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the obj file. Lack of the vertex normal info" << endl;
-				exit(1);
+				return false;
 			}
 			normals.push_back(normal);
 			numNormals++;
@@ -149,11 +171,16 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 				ptnString.clear();
 			}
 
+			if (ptnIndices.size() < 3 || subMeshesIndices.empty())
+			{
+				cerr << "[ERROR] Couldn't parse the obj file. Face without three vertices or a group" << endl;
+				return false;
+			}
 			string faceMode = GetFaceMode(ptnIndices[0]);
 			if (faceMode == "NONE")
 			{
 				cerr << "[ERROR] Couldn't parse the obj file. Face mode error" << endl;
-				exit(1);
+				return false;
 			}
 			ProcessSlashes(ptnIndices);
 
@@ -219,6 +246,11 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 	}
 	// ShowVerticesInfo();
 	// ShowSubMeshesInfo();
+	if (vertices.empty())
+	{
+		cerr << "[ERROR] Couldn't parse the obj file. No faces" << endl;
+		return false;
+	}
 
 	glm::vec3 maxPosition = vertices[0].position, minPosition = vertices[0].position;
 	for (VertexPTN& vertex : vertices)
@@ -244,19 +276,22 @@ bool TriangleMesh::LoadObjFile(const string& filePath, const bool normalized)
 		for (VertexPTN& vertex : vertices)
 			vertex.position *= ratio;
 	}
+	ComputeSubMeshBounds();
 	return true;
 }
 
 // Load the material data from a MTL file.
+// Only a parse error returns false, a missing file leaves the default materials.
 bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileName)
 {
 	ifstream fileStream(filePath + fileName);
-	string fileType = fileName.substr(fileName.size() - 4, 4);
+	string fileType = (fileName.size() >= 4) ? fileName.substr(fileName.size() - 4, 4) : "";
 	string line = "", materialName = "";
+	vector<MaterialTextureJob> textureJobs;
 	if (!fileStream || fileType != ".mtl")
 	{
 		cout << "Couldn't find or open the material file. Material file path: " << filePath + fileName << endl;
-		return false;
+		return true;
 	}
 	while (getline(fileStream, line))
 	{
@@ -278,7 +313,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the material file. Lack of the material Ka info" << endl;
-				exit(1);
+				return false;
 			}
 			phongMaterials[materialName].SetKa(ka);
 		}
@@ -289,7 +324,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the material file. Lack of the material Kd info" << endl;
-				exit(1);
+				return false;
 			}
 			phongMaterials[materialName].SetKd(kd);
 		}
@@ -300,7 +335,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the material file. Lack of the material Ks info" << endl;
-				exit(1);
+				return false;
 			}
 			phongMaterials[materialName].SetKs(ks);
 		}
@@ -311,10 +346,28 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (ss.fail())
 			{
 				cerr << "[ERROR] Couldn't parse the material file. Lack of the material Ns info" << endl;
-				exit(1);
+				return false;
 			}
 			phongMaterials[materialName].SetNs(ns);
 		}
+		// Opacity: d, or its complement Tr (d may come after the -halo option).
+		else if (prefix == "d" || prefix == "Tr")
+		{
+			float d;
+			string value;
+			ss >> value;
+			if (value == "-halo")
+				ss >> value;
+			stringstream valueStream(value);
+			valueStream >> d;
+			if (valueStream.fail())
+			{
+				cerr << "[ERROR] Couldn't parse the material file. Lack of the material " << prefix << " info" << endl;
+				return false;
+			}
+			d = (prefix == "Tr") ? 1.0f - d : d;
+			phongMaterials[materialName].SetOpacity(glm::clamp(d, 0.0f, 1.0f));
+		}
 		else if (prefix == "map_Bump")
 		{
 			string mapNormPath;
@@ -322,9 +375,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (mapNormPath.empty())
 				cerr << "Couldn't find the map_Bump file path" << endl;
 
-			ImageTexture* imageTexNorm = new ImageTexture(filePath + mapNormPath);
-			phongMaterials[materialName].SetHadMapNorm(imageTexNorm->GetSuccessLoaded());
-			phongMaterials[materialName].SetMapNorm(imageTexNorm);
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_NORM, mapNormPath));
 			phongMaterials[materialName].SetMapNormPath(mapNormPath);
 		}
 		else if (prefix == "map_Ka")
@@ -334,9 +385,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (mapKaPath.empty())
 				cerr << "Couldn't find the map_Ka file path" << endl;
 
-			ImageTexture* imageTexKa = new ImageTexture(filePath + mapKaPath);
-			phongMaterials[materialName].SetHadMapKa(imageTexKa->GetSuccessLoaded());
-			phongMaterials[materialName].SetMapKa(imageTexKa);
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_KA, mapKaPath));
 			phongMaterials[materialName].SetMapKaPath(mapKaPath);
 		}
 		else if (prefix == "map_Kd")
@@ -346,9 +395,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (mapKdPath.empty())
 				cerr << "Couldn't find the map_Kd file path" << endl;
 
-			ImageTexture* imageTexKd = new ImageTexture(filePath + mapKdPath);
-			phongMaterials[materialName].SetHadMapKd(imageTexKd->GetSuccessLoaded());
-			phongMaterials[materialName].SetMapKd(imageTexKd);
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_KD, mapKdPath));
 			phongMaterials[materialName].SetMapKdPath(mapKdPath);
 		}
 		else if (prefix == "map_Ks")
@@ -358,9 +405,7 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (mapKsPath.empty())
 				cerr << "Couldn't find the map_Ks file path" << endl;
 
-			ImageTexture* imageTexKs = new ImageTexture(filePath + mapKsPath);
-			phongMaterials[materialName].SetHadMapKs(imageTexKs->GetSuccessLoaded());
-			phongMaterials[materialName].SetMapKs(imageTexKs);
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_KS, mapKsPath));
 			phongMaterials[materialName].SetMapKsPath(mapKsPath);
 		}
 		else if (prefix == "map_Ns")
@@ -370,13 +415,69 @@ bool TriangleMesh::LoadMaterialFile(const string& filePath, const string& fileNa
 			if (mapNsPath.empty())
 				cerr << "Couldn't find the map_Ns file path" << endl;
 
-			ImageTexture* imageTexNs = new ImageTexture(filePath + mapNsPath);
-			phongMaterials[materialName].SetHadMapNs(imageTexNs->GetSuccessLoaded());
-			phongMaterials[materialName].SetMapNs(imageTexNs);
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_NS, mapNsPath));
 			phongMaterials[materialName].SetMapNsPath(mapNsPath);
 		}
+		else if (prefix == "map_d")
+		{
+			string mapDPath;
+			ss >> mapDPath;
+			if (mapDPath.empty())
+				cerr << "Couldn't find the map_d file path" << endl;
+
+			textureJobs.push_back(MaterialTextureJob(materialName, MATERIAL_MAP_D, mapDPath));
+			phongMaterials[materialName].SetMapDPath(mapDPath);
+		}
 	}
 	fileStream.close();
+
+	// Decode the textures concurrently (the constructors do not touch GL with deferred upload).
+	vector<ImageTexture*> textures(textureJobs.size(), nullptr);
+	ThreadPool::GetGlobal()->ParallelFor(0, static_cast<int>(textureJobs.size()), 1, [&](int first, int last) {
+		for (int i = first; i < last; ++i)
+		{
+			TextureUsage usage = TEXTURE_USAGE_COLOR;
+			if (textureJobs[i].map == MATERIAL_MAP_NORM)
+				usage = TEXTURE_USAGE_NORMAL;
+			else if (textureJobs[i].map == MATERIAL_MAP_D)
+				usage = TEXTURE_USAGE_DATA;
+			// Large diffuse maps may be paged (see VirtualTextureSystem).
+			const bool allowVirtual = textureJobs[i].map == MATERIAL_MAP_KD;
+			textures[i] = new ImageTexture(filePath + textureJobs[i].path, true, usage, allowVirtual);
+		}
+	});
+	for (size_t i = 0; i < textureJobs.size(); ++i)
+	{
+		PhongMaterial& material = phongMaterials[textureJobs[i].materialName];
+		ImageTexture* texture = textures[i];
+		switch (textureJobs[i].map)
+		{
+		case MATERIAL_MAP_NORM:
+			material.SetHadMapNorm(texture->GetSuccessLoaded());
+			material.SetMapNorm(texture);
+			break;
+		case MATERIAL_MAP_KA:
+			material.SetHadMapKa(texture->GetSuccessLoaded());
+			material.SetMapKa(texture);
+			break;
+		case MATERIAL_MAP_KD:
+			material.SetHadMapKd(texture->GetSuccessLoaded());
+			material.SetMapKd(texture);
+			break;
+		case MATERIAL_MAP_KS:
+			material.SetHadMapKs(texture->GetSuccessLoaded());
+			material.SetMapKs(texture);
+			break;
+		case MATERIAL_MAP_NS:
+			material.SetHadMapNs(texture->GetSuccessLoaded());
+			material.SetMapNs(texture);
+			break;
+		default:
+			material.SetHadMapD(texture->GetSuccessLoaded());
+			material.SetMapD(texture);
+			break;
+		}
+	}
 	return true;
 }
 
@@ -430,26 +531,178 @@ void TriangleMesh::ProcessPTNindex(vector<int>& ptnIndex, const string& faceMode
 	}
 }
 
+// Compute the bounding sphere of each submesh and its UV density, sqrt(UV area / surface area).
+void TriangleMesh::ComputeSubMeshBounds()
+{
+	for (SubMesh& subMesh : subMeshes)
+	{
+		if (subMesh.vertexIndices.empty())
+			continue;
+		glm::vec3 maxPosition = vertices[subMesh.vertexIndices[0]].position, minPosition = maxPosition;
+		double uvArea = 0.0, area = 0.0;
+		for (size_t i = 0; i + 2 < subMesh.vertexIndices.size(); i += 3)
+		{
+			const VertexPTN& v0 = vertices[subMesh.vertexIndices[i]];
+			const VertexPTN& v1 = vertices[subMesh.vertexIndices[i + 1]];
+			const VertexPTN& v2 = vertices[subMesh.vertexIndices[i + 2]];
+			maxPosition = glm::max(maxPosition, glm::max(v0.position, glm::max(v1.position, v2.position)));
+			minPosition = glm::min(minPosition, glm::min(v0.position, glm::min(v1.position, v2.position)));
+			area += 0.5 * glm::length(glm::cross(v1.position - v0.position, v2.position - v0.position));
+			glm::vec2 e1 = v1.texcoord - v0.texcoord, e2 = v2.texcoord - v0.texcoord;
+			uvArea += 0.5 * fabs(e1.x * e2.y - e1.y * e2.x);
+		}
+		subMesh.boundsCenter = (maxPosition + minPosition) / 2.0f;
+		subMesh.boundsRadius = glm::length(maxPosition - minPosition) / 2.0f;
+		subMesh.uvDensity = (area > 0.0) ? static_cast<float>(sqrt(uvArea / area)) : 0.0f;
+	}
+}
+
+// Upload the decoded material textures to the GPU.
+void TriangleMesh::UploadTextures()
+{
+	for (auto& material : phongMaterials)
+	{
+		ImageTexture* textures[] = {
+			material.second.GetMapNorm(), material.second.GetMapKa(), material.second.GetMapKd(),
+			material.second.GetMapKs(), material.second.GetMapNs(), material.second.GetMapD()
+		};
+		for (ImageTexture* texture : textures)
+			if (texture != nullptr)
+				texture->Upload();
+	}
+}
+
 // Create vertex and index buffers.
 void TriangleMesh::CreateBuffers()
 {
+	UploadTextures();
 	glGenBuffers(1, &vboId);
 	glBindBuffer(GL_ARRAY_BUFFER, vboId);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPTN) * vertices.size(), &(vertices[0]), GL_STATIC_DRAW);
+	// Tightly packed positions for the depth-only passes (a third of the vertex bytes).
+	vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		positions[i] = vertices[i].position;
+	glGenBuffers(1, &positionVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), &(positions[0]), GL_STATIC_DRAW);
 	for (SubMesh& subMesh : subMeshes)
 	{
 		glGenBuffers(1, &subMesh.iboId);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, subMesh.iboId);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * subMesh.vertexIndices.size(), &(subMesh.vertexIndices[0]), GL_STATIC_DRAW);
 	}
+	if (!vertexOcclusion.empty())
+		SetVertexOcclusion(vertexOcclusion);
+}
+
+// Kept on the CPU and uploaded now if the buffers exist (or by CreateBuffers otherwise).
+void TriangleMesh::SetVertexOcclusion(const vector<float>& occlusion)
+{
+	if (&occlusion != &vertexOcclusion)
+		vertexOcclusion = occlusion;
+	if (vboId == 0 || vertexOcclusion.size() != vertices.size())
+		return;
+	if (aoVboId == 0)
+		glGenBuffers(1, &aoVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, aoVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertexOcclusion.size(), &(vertexOcclusion[0]), GL_STATIC_DRAW);
 }
 
 // Delete vertex and index buffers.
 void TriangleMesh::DeleteBuffers()
 {
+	// Meshes that were never uploaded (e.g. discarded by a loader thread) own no GL objects.
+	if (vboId == 0)
+		return;
 	glDeleteBuffers(1, &vboId);
+	glDeleteBuffers(1, &positionVboId);
 	for (SubMesh& subMesh : subMeshes)
 		glDeleteBuffers(1, &subMesh.iboId);
+	vboId = 0;
+	positionVboId = 0;
+	if (aoVboId != 0)
+		glDeleteBuffers(1, &aoVboId);
+	aoVboId = 0;
+	for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+	{
+		delete textureArrays[map];
+		textureArrays[map] = nullptr;
+		textureLayers[map].clear();
+	}
+}
+
+// Pack the uploaded uncompressed textures of each map (at least two per map) into a
+// texture array, so that all submeshes are drawn with one bind per map.
+void TriangleMesh::PackTextureArrays()
+{
+	int numBindsBefore = 0, numBindsAfter = 0;
+	for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+	{
+		vector<ImageTexture*> textures;
+		for (SubMesh& subMesh : subMeshes)
+		{
+			PhongMaterial* material = subMesh.material;
+			if (material == nullptr)
+				continue;
+			ImageTexture* mapTextures[] = {
+				material->GetMapNorm(), material->GetMapKa(), material->GetMapKd(), material->GetMapKs(), material->GetMapNs()
+			};
+			ImageTexture* texture = mapTextures[map];
+			if (texture == nullptr || !texture->GetUploaded())
+				continue;
+			numBindsBefore++;
+			if (texture->GetFormat() == TEXTURE_FORMAT_RGBA8 && textureLayers[map].count(texture) == 0)
+			{
+				textureLayers[map][texture] = static_cast<int>(textures.size());
+				textures.push_back(texture);
+			}
+		}
+		vector<cv::Mat> images(textures.size());
+		bool success = textures.size() >= 2;
+		for (size_t i = 0; success && i < textures.size(); ++i)
+			success = textures[i]->FetchImage(images[i]);
+		if (success)
+		{
+			textureArrays[map] = new TextureArray();
+			success = textureArrays[map]->Create(images, map != TEXTURE_MAP_NORM);
+		}
+		if (!success)
+		{
+			delete textureArrays[map];
+			textureArrays[map] = nullptr;
+			textureLayers[map].clear();
+			continue;
+		}
+		for (ImageTexture* texture : textures)
+			texture->ReleaseTextureObject();
+		cout << "Texture array " << map << ": " << textures.size() << " layers of " << textureArrays[map]->GetWidth()
+			<< " x " << textureArrays[map]->GetHeight() << ", " << textureArrays[map]->GetGpuBytes() / 1024 << " KB" << endl;
+	}
+	// Count the binds of one draw of the mesh, as done by the renderer.
+	for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+		if (textureArrays[map] != nullptr)
+			numBindsAfter++;
+	for (SubMesh& subMesh : subMeshes)
+	{
+		PhongMaterial* material = subMesh.material;
+		if (material == nullptr)
+			continue;
+		ImageTexture* mapTextures[] = {
+			material->GetMapNorm(), material->GetMapKa(), material->GetMapKd(), material->GetMapKs(), material->GetMapNs()
+		};
+		for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+			if (mapTextures[map] != nullptr && mapTextures[map]->GetUploaded())
+				numBindsAfter++;
+	}
+	cout << "Texture binds per draw: " << numBindsBefore << " without texture arrays, " << numBindsAfter << " with" << endl << endl;
+}
+
+// Layer of the texture in the array of the map, or -1 if it is not packed.
+int TriangleMesh::GetTextureLayer(const TextureMap map, const ImageTexture* texture) const
+{
+	auto it = textureLayers[map].find(texture);
+	return (it != textureLayers[map].end()) ? it->second : -1;
 }
 
 // Draw the model.
@@ -462,6 +715,15 @@ void TriangleMesh::Draw(const unsigned int index)
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)offsetof(VertexPTN, normal));
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)offsetof(VertexPTN, texcoord));
+	// Without baked occlusion every vertex is fully open.
+	if (aoVboId != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, aoVboId);
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const GLvoid*)0);
+	}
+	else
+		glVertexAttrib1f(3, 1.0f);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, subMeshes[index].iboId);
 	glDrawElements(GL_TRIANGLES, (GLsizei)(subMeshes[index].vertexIndices.size()), GL_UNSIGNED_INT, 0);
@@ -469,6 +731,44 @@ void TriangleMesh::Draw(const unsigned int index)
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
 	glDisableVertexAttribArray(2);
+	if (aoVboId != 0)
+		glDisableVertexAttribArray(3);
+}
+
+// Draw every submesh (or the opaque ones) with positions only (for depth passes, which need no material).
+void TriangleMesh::DrawDepth(const bool opaqueOnly, const bool skipAlphaTested)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, positionVboId);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (const GLvoid*)0);
+	for (SubMesh& subMesh : subMeshes)
+	{
+		if (opaqueOnly && subMesh.material != nullptr && (subMesh.material)->GetTransparent())
+			continue;
+		if (skipAlphaTested && subMesh.material != nullptr && (subMesh.material)->GetAlphaTested())
+			continue;
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, subMesh.iboId);
+		glDrawElements(GL_TRIANGLES, (GLsizei)(subMesh.vertexIndices.size()), GL_UNSIGNED_INT, 0);
+	}
+	glDisableVertexAttribArray(0);
+}
+
+unsigned int TriangleMesh::GetNumTransparentSubMeshes() const
+{
+	unsigned int count = 0;
+	for (const SubMesh& subMesh : subMeshes)
+		if (subMesh.material != nullptr && (subMesh.material)->GetTransparent())
+			count++;
+	return count;
+}
+
+unsigned int TriangleMesh::GetNumAlphaTestedSubMeshes() const
+{
+	unsigned int count = 0;
+	for (const SubMesh& subMesh : subMeshes)
+		if (subMesh.material != nullptr && (subMesh.material)->GetAlphaTested())
+			count++;
+	return count;
 }
 
 // Show model information.
@@ -493,6 +793,38 @@ void TriangleMesh::ShowInfo()
 	cout << "Model Extent: " << objExtent.x << " x " << objExtent.y << " x " << objExtent.z << endl << endl;
 }
 
+// Show the textures of each material with their format, GPU memory and quality.
+void TriangleMesh::ShowTexturesInfo()
+{
+	size_t totalBytes = 0, uncompressedBytes = 0, cpuBytes = 0;
+	const char* mapNames[] = { "map_Bump", "map_Ka", "map_Kd", "map_Ks", "map_Ns", "map_d" };
+	for (auto& material : phongMaterials)
+	{
+		ImageTexture* textures[] = {
+			material.second.GetMapNorm(), material.second.GetMapKa(), material.second.GetMapKd(),
+			material.second.GetMapKs(), material.second.GetMapNs(), material.second.GetMapD()
+		};
+		cout << "Material: " << material.first << endl;
+		if (material.second.GetTransparent())
+			cout << "  d " << material.second.GetOpacity() << endl;
+		for (int i = 0; i < 6; ++i)
+		{
+			if (textures[i] == nullptr || !textures[i]->GetSuccessLoaded())
+				continue;
+			cout << "  " << mapNames[i] << " ";
+			textures[i]->ShowInfo();
+			totalBytes += textures[i]->GetGpuBytes();
+			cpuBytes += textures[i]->GetCpuBytes();
+			uncompressedBytes += static_cast<size_t>(textures[i]->GetWidth()) * textures[i]->GetHeight() * 4 * 4 / 3;
+		}
+	}
+	for (int map = 0; map < NUM_TEXTURE_MAPS; ++map)
+		if (textureArrays[map] != nullptr)
+			totalBytes += textureArrays[map]->GetGpuBytes();
+	cout << "Texture GPU memory: " << totalBytes / 1024 << " KB (RGBA8 with mipmaps: " << uncompressedBytes / 1024 << " KB)" << endl;
+	cout << "Texture CPU memory: " << cpuBytes / 1024 << " KB" << endl << endl;
+}
+
 // Show vertices information.
 void TriangleMesh::ShowVerticesInfo()
 {
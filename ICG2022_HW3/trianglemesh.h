@@ -3,6 +3,9 @@
 
 #include "headers.h"
 #include "material.h"
+#include "hashfunction.h"
+#include "texturearray.h"
+#include "threadpool.h"
 using namespace std;
 
 // VertexPTN Declarations.
@@ -32,10 +35,45 @@ struct SubMesh
 	{
 		material = nullptr;
 		iboId = 1;
+		boundsCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+		boundsRadius = 0.0f;
+		uvDensity = 0.0f;
 	}
 	PhongMaterial* material = nullptr;
 	vector<unsigned int> vertexIndices;
 	GLuint iboId;
+	// Bounding sphere and UV units per object-space unit (for texture residency).
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+	float uvDensity;
+};
+
+
+// Texture maps of a MTL material. The opacity map (map_d) is not one of the TextureMap maps,
+// so it is never packed.
+enum MaterialMap
+{
+	MATERIAL_MAP_NORM,
+	MATERIAL_MAP_KA,
+	MATERIAL_MAP_KD,
+	MATERIAL_MAP_KS,
+	MATERIAL_MAP_NS,
+	MATERIAL_MAP_D
+};
+
+
+// MaterialTextureJob Declarations (a texture map of a material, decoded after parsing).
+struct MaterialTextureJob
+{
+	MaterialTextureJob(const string& name, const MaterialMap materialMap, const string& filePath)
+	{
+		materialName = name;
+		map = materialMap;
+		path = filePath;
+	}
+	string materialName;
+	MaterialMap map;
+	string path;
 };
 
 
@@ -57,6 +95,9 @@ public:
 	unsigned int GetNumSubMeshes() const { return numSubMeshes; }
 	glm::vec3 GetObjCenter() const { return objCenter; }
 	glm::vec3 GetObjExtent() const { return objExtent; }
+	TextureArray* GetTextureArray(const TextureMap map) const { return textureArrays[map]; }
+	int GetTextureLayer(const TextureMap map, const ImageTexture* texture) const;
+	bool GetHadOcclusion() const { return !vertexOcclusion.empty(); }
 
 	int GetSubFilePathIndex(const string& filePath);
 	bool LoadObjFile(const string& filePath, const bool normalized = true);
@@ -64,10 +105,18 @@ public:
 	string GetFaceMode(const string& ptnIndex);
 	void ProcessSlashes(vector<string>& ptnIndices);
 	void ProcessPTNindex(vector<int>& ptnIndex, const string& faceMode);
+	void ComputeSubMeshBounds();
+	void SetVertexOcclusion(const vector<float>& occlusion);
+	void UploadTextures();
 	void CreateBuffers();
 	void DeleteBuffers();
+	void PackTextureArrays();
 	void Draw(const unsigned int index);
+	void DrawDepth(const bool opaqueOnly = false, const bool skipAlphaTested = false);
+	unsigned int GetNumTransparentSubMeshes() const;
+	unsigned int GetNumAlphaTestedSubMeshes() const;
 	void ShowInfo();
+	void ShowTexturesInfo();
 	void ShowVerticesInfo();
 	void ShowSubMeshesInfo();
 
@@ -75,6 +124,9 @@ private:
 	// TriangleMesh Private Data.
 	vector<VertexPTN> vertices;
 	vector<SubMesh> subMeshes;
+	// Per-mesh parsing state, so several meshes can be loaded concurrently.
+	unordered_map<string, PhongMaterial> phongMaterials;
+	unordered_map<vector<int>, unsigned int, HashFunction> subMeshVertexIndices;
 
 	unsigned int numPositions;
 	unsigned int numNormals;
@@ -85,6 +137,14 @@ private:
 	glm::vec3 objCenter;
 	glm::vec3 objExtent;
 	GLuint vboId;
+	// Positions only, for DrawDepth().
+	GLuint positionVboId;
+	// Baked ambient occlusion per vertex (vertex attribute 3, empty when not baked).
+	vector<float> vertexOcclusion;
+	GLuint aoVboId;
+	// Texture maps packed into arrays (per map, the layer of each packed texture).
+	TextureArray* textureArrays[NUM_TEXTURE_MAPS];
+	unordered_map<const ImageTexture*, int> textureLayers[NUM_TEXTURE_MAPS];
 };
 
 #endif
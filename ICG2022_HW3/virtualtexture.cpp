@@ -0,0 +1,625 @@
+#include "virtualtexture.h"
+using namespace std;
+
+// Page file header: magic, version, width, height, levels, tile size, border, channels.
+#define VIRTUAL_TEXTURE_MAGIC 0x54564349  // "ICVT"
+#define VIRTUAL_TEXTURE_HEADER_WORDS 8
+#define VIRTUAL_TEXTURE_PAGE_BYTES (VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE * 3)
+
+VirtualTexture::VirtualTexture()
+{
+	width = 0;
+	height = 0;
+	numLevels = 0;
+	fromCache = false;
+	loadTimeMs = 0.0;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	pageFile.close();
+}
+
+bool VirtualTexture::Create(const string& filePath, const int minSize, const MipFilter mipFilter, cv::Mat& image)
+{
+	CpuTimer loadTimer;
+	texFilePath = filePath;
+	vector<unsigned char> bytes;
+	if (!ImageDecoder::ReadFile(texFilePath, bytes))
+		return false;
+	stringstream settings;
+	settings << "vt" << VIRTUAL_TEXTURE_TILE_SIZE << "b" << VIRTUAL_TEXTURE_BORDER << "_" << MipmapBuilder::GetFilterName(mipFilter)
+		<< "_p" << VIRTUAL_TEXTURE_VERSION;
+	pageFilePath = TextureCache::GetCachePath(TextureCache::HashBytes(bytes), settings.str(), "vtp");
+	fromCache = OpenPageFile();
+	if (!fromCache)
+	{
+		if (!ImageDecoder::Decode(bytes, image))
+			return false;
+		if (max(image.cols, image.rows) < minSize || max(image.cols, image.rows) > VIRTUAL_TEXTURE_MAX_SIZE)
+			return false;
+		// Keep the decoded image for the caller until the page file is in place.
+		if (!WritePageFile(image, mipFilter) || !OpenPageFile())
+			return false;
+		image.release();
+	}
+	loadTimeMs = loadTimer.GetElapsedMs();
+	return true;
+}
+
+// Level offsets of the tiles; the last level is the first whose sides fit into one tile.
+void VirtualTexture::ComputeLayout()
+{
+	numLevels = 1;
+	while ((width >> (numLevels - 1)) > VIRTUAL_TEXTURE_TILE_SIZE || (height >> (numLevels - 1)) > VIRTUAL_TEXTURE_TILE_SIZE)
+		numLevels++;
+	levelOffsets.assign(numLevels + 1, 0);
+	for (int level = 0; level < numLevels; ++level)
+		levelOffsets[level + 1] = levelOffsets[level] + GetTilesX(level) * GetTilesY(level);
+}
+
+bool VirtualTexture::OpenPageFile()
+{
+	lock_guard<mutex> lock(fileMutex);
+	pageFile.close();
+	pageFile.clear();
+	pageFile.open(pageFilePath, ios::binary);
+	if (!pageFile)
+		return false;
+	unsigned int header[VIRTUAL_TEXTURE_HEADER_WORDS] = { 0 };
+	pageFile.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (pageFile.fail() || header[0] != VIRTUAL_TEXTURE_MAGIC || header[1] != VIRTUAL_TEXTURE_VERSION
+		|| header[5] != VIRTUAL_TEXTURE_TILE_SIZE || header[6] != VIRTUAL_TEXTURE_BORDER || header[7] != 3
+		|| header[2] == 0 || header[3] == 0 || header[2] > VIRTUAL_TEXTURE_MAX_SIZE || header[3] > VIRTUAL_TEXTURE_MAX_SIZE)
+	{
+		pageFile.close();
+		return false;
+	}
+	width = static_cast<int>(header[2]);
+	height = static_cast<int>(header[3]);
+	ComputeLayout();
+	// A truncated file (e.g. an interrupted write) is rebuilt.
+	pageFile.seekg(0, ios::end);
+	if (numLevels != static_cast<int>(header[4]) || static_cast<size_t>(pageFile.tellg()) != GetPageFileBytes())
+	{
+		pageFile.close();
+		return false;
+	}
+	return true;
+}
+
+// Copy the page of tile (x, y): the tile and its border, wrapping around the level.
+static void CopyPage(const cv::Mat& level, const int x, const int y, unsigned char* page)
+{
+	const int left = x * VIRTUAL_TEXTURE_TILE_SIZE - VIRTUAL_TEXTURE_BORDER;
+	const int top = y * VIRTUAL_TEXTURE_TILE_SIZE - VIRTUAL_TEXTURE_BORDER;
+	const bool inside = left >= 0 && left + VIRTUAL_TEXTURE_PAGE_SIZE <= level.cols;
+	for (int r = 0; r < VIRTUAL_TEXTURE_PAGE_SIZE; ++r)
+	{
+		const unsigned char* src = level.ptr<unsigned char>(((top + r) % level.rows + level.rows) % level.rows);
+		unsigned char* dst = page + static_cast<size_t>(r) * VIRTUAL_TEXTURE_PAGE_SIZE * 3;
+		if (inside)
+		{
+			memcpy(dst, src + left * 3, VIRTUAL_TEXTURE_PAGE_SIZE * 3);
+			continue;
+		}
+		for (int c = 0; c < VIRTUAL_TEXTURE_PAGE_SIZE; ++c)
+		{
+			const int col = ((left + c) % level.cols + level.cols) % level.cols;
+			dst[c * 3 + 0] = src[col * 3 + 0];
+			dst[c * 3 + 1] = src[col * 3 + 1];
+			dst[c * 3 + 2] = src[col * 3 + 2];
+		}
+	}
+}
+
+// Build the mip chain and write the pages level by level, one row of tiles at a time.
+bool VirtualTexture::WritePageFile(const cv::Mat& image, const MipFilter mipFilter)
+{
+	int w = 1, h = 1;
+	while (w < image.cols)
+		w *= 2;
+	while (h < image.rows)
+		h *= 2;
+	cv::Mat source = image;
+	if (w != image.cols || h != image.rows)
+		cv::resize(image, source, cv::Size(w, h), 0.0, 0.0, cv::INTER_CUBIC);
+	width = w;
+	height = h;
+	ComputeLayout();
+	vector<cv::Mat> levels;
+	MipmapBuilder builder(mipFilter, true);
+	builder.Build(source, levels);
+
+	TextureCache::MakeDirectory();
+	stringstream ss;
+	ss << pageFilePath << "." << this_thread::get_id() << ".tmp";
+	string tmpPath = ss.str();
+	ofstream file(tmpPath, ios::binary);
+	if (!file)
+	{
+		cerr << "[ERROR] Couldn't write the page file: " << tmpPath << endl;
+		return false;
+	}
+	unsigned int header[VIRTUAL_TEXTURE_HEADER_WORDS] = {
+		VIRTUAL_TEXTURE_MAGIC, VIRTUAL_TEXTURE_VERSION, static_cast<unsigned int>(width), static_cast<unsigned int>(height),
+		static_cast<unsigned int>(numLevels), VIRTUAL_TEXTURE_TILE_SIZE, VIRTUAL_TEXTURE_BORDER, 3
+	};
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	vector<unsigned char> rowPages;
+	for (int level = 0; level < numLevels; ++level)
+	{
+		const int tilesX = GetTilesX(level);
+		rowPages.resize(static_cast<size_t>(tilesX) * VIRTUAL_TEXTURE_PAGE_BYTES);
+		for (int y = 0; y < GetTilesY(level); ++y)
+		{
+			ThreadPool::GetGlobal()->ParallelFor(0, tilesX, 1, [&](int first, int last) {
+				for (int x = first; x < last; ++x)
+					CopyPage(levels[level], x, y, &rowPages[static_cast<size_t>(x) * VIRTUAL_TEXTURE_PAGE_BYTES]);
+			});
+			file.write(reinterpret_cast<const char*>(rowPages.data()), rowPages.size());
+		}
+	}
+	file.close();
+	if (file.fail() || rename(tmpPath.c_str(), pageFilePath.c_str()) != 0)
+	{
+		// Another loader may have written the same page file first.
+		remove(tmpPath.c_str());
+		ifstream existing(pageFilePath, ios::binary);
+		return existing.good();
+	}
+	return true;
+}
+
+// Read the page of a tile (VIRTUAL_TEXTURE_PAGE_SIZE squared BGR texels, top row first).
+bool VirtualTexture::ReadTile(const int level, const int x, const int y, vector<unsigned char>& pixels)
+{
+	lock_guard<mutex> lock(fileMutex);
+	pixels.resize(VIRTUAL_TEXTURE_PAGE_BYTES);
+	const size_t offset = VIRTUAL_TEXTURE_HEADER_WORDS * sizeof(unsigned int)
+		+ static_cast<size_t>(GetTileIndex(level, x, y)) * VIRTUAL_TEXTURE_PAGE_BYTES;
+	pageFile.clear();
+	pageFile.seekg(offset, ios::beg);
+	pageFile.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+	if (pageFile.fail())
+	{
+		cerr << "[ERROR] Failed to read tile (" << x << ", " << y << ") of level " << level << ": " << pageFilePath << endl;
+		return false;
+	}
+	return true;
+}
+
+size_t VirtualTexture::GetPageFileBytes() const
+{
+	return VIRTUAL_TEXTURE_HEADER_WORDS * sizeof(unsigned int) + static_cast<size_t>(GetNumTiles()) * VIRTUAL_TEXTURE_PAGE_BYTES;
+}
+
+void VirtualTexture::ShowInfo() const
+{
+	stringstream ss;
+	ss << fixed << setprecision(1);
+	ss << "virtual " << width << " x " << height << ", " << numLevels << " levels, " << GetNumTiles() << " tiles, page file "
+		<< GetPageFileBytes() / 1024.0 / 1024.0 << " MB (" << (fromCache ? "cached" : "built") << " in " << loadTimeMs << " ms)";
+	cout << ss.str();
+}
+
+
+VirtualTextureSystem::VirtualTextureSystem(const int nPagesPerSide, const int nUploadsPerFrame, const int nFeedbackScale)
+{
+	pagesPerSide = glm::clamp(nPagesPerSide, 2, 256);
+	maxUploads = max(1, nUploadsPerFrame);
+	feedbackScale = max(1, nFeedbackScale);
+	pages.resize(static_cast<size_t>(pagesPerSide) * pagesPerSide);
+	frameIndex = 1;
+	loadingTexture = nullptr;
+	stopping = false;
+	numUploads = 0;
+	numEvictions = 0;
+	numRequested = 0;
+	for (int i = 0; i < 4; ++i)
+		prevClearColor[i] = 0.0f;
+	feedbackTarget = nullptr;
+	feedbackReadback = new PboReadback(3);
+
+	const int size = pagesPerSide * VIRTUAL_TEXTURE_PAGE_SIZE;
+	glGenTextures(1, &physicalObj);
+	glBindTexture(GL_TEXTURE_2D, physicalObj);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, size, size);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	loader = thread(&VirtualTextureSystem::LoaderLoop, this);
+}
+
+VirtualTextureSystem::~VirtualTextureSystem()
+{
+	{
+		lock_guard<mutex> lock(loaderMutex);
+		stopping = true;
+	}
+	loaderCond.notify_all();
+	loader.join();
+	for (auto& entry : entries)
+		glDeleteTextures(1, &entry.second.indirectionObj);
+	entries.clear();
+	glDeleteTextures(1, &physicalObj);
+	delete feedbackReadback;
+	delete feedbackTarget;
+}
+
+void VirtualTextureSystem::LoaderLoop()
+{
+	while (true)
+	{
+		TileRequest request;
+		{
+			unique_lock<mutex> lock(loaderMutex);
+			loaderCond.wait(lock, [this]() { return stopping || !queuedTiles.empty(); });
+			if (stopping)
+				return;
+			request = move(queuedTiles.front());
+			queuedTiles.pop_front();
+			loadingTexture = request.texture;
+		}
+		// A failed read comes back without pixels, so the tile can be requested again.
+		if (!request.texture->ReadTile(request.level, request.x, request.y, request.pixels))
+			request.pixels.clear();
+		{
+			lock_guard<mutex> lock(loaderMutex);
+			loadingTexture = nullptr;
+			loadedTiles.push_back(move(request));
+		}
+		idleCond.notify_all();
+	}
+}
+
+// Make the coarsest tile resident and create the indirection texture.
+bool VirtualTextureSystem::Register(VirtualTexture* texture)
+{
+	if (entries.count(texture) > 0)
+		return true;
+	int id = 0;
+	while (id < static_cast<int>(textureIds.size()) && textureIds[id] != nullptr)
+		id++;
+	if (id >= VIRTUAL_TEXTURE_MAX_TEXTURES)
+	{
+		cerr << "[ERROR] Too many virtual textures (" << VIRTUAL_TEXTURE_MAX_TEXTURES << ")" << endl;
+		return false;
+	}
+	const int rootLevel = texture->GetNumLevels() - 1;
+	vector<unsigned char> pixels;
+	int rootPage = AllocatePage(true);
+	if (rootPage < 0 || !texture->ReadTile(rootLevel, 0, 0, pixels))
+	{
+		cerr << "[ERROR] Couldn't make the virtual texture resident: " << texture->GetPageFilePath() << endl;
+		return false;
+	}
+	if (id == static_cast<int>(textureIds.size()))
+		textureIds.push_back(nullptr);
+	textureIds[id] = texture;
+
+	Entry& entry = entries[texture];
+	entry.id = id + 1;
+	entry.tilePages.assign(texture->GetNumTiles(), TILE_NOT_RESIDENT);
+	const int rootTile = texture->GetTileIndex(rootLevel, 0, 0);
+	entry.tilePages[rootTile] = rootPage;
+	Page& page = pages[rootPage];
+	page.owner = texture;
+	page.tileIndex = rootTile;
+	page.lastUsedFrame = frameIndex;
+	page.pinned = true;
+	UploadPage(rootPage, pixels);
+
+	// One texel per tile; the tile grids of the levels halve like a mip chain.
+	const int levels = texture->GetNumLevels();
+	glGenTextures(1, &entry.indirectionObj);
+	glBindTexture(GL_TEXTURE_2D, entry.indirectionObj);
+	if (GLEW_ARB_texture_storage)
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, texture->GetTilesX(0), texture->GetTilesY(0));
+	else
+	{
+		for (int level = 0; level < levels; ++level)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, texture->GetTilesX(level), texture->GetTilesY(level), 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	UpdateIndirection(texture, entry);
+	return true;
+}
+
+// Drop the tiles of a texture (waiting for the loader if it is reading one of them).
+void VirtualTextureSystem::Unregister(VirtualTexture* texture)
+{
+	auto it = entries.find(texture);
+	if (it == entries.end())
+		return;
+	{
+		unique_lock<mutex> lock(loaderMutex);
+		auto ofTexture = [texture](const TileRequest& request) { return request.texture == texture; };
+		queuedTiles.erase(remove_if(queuedTiles.begin(), queuedTiles.end(), ofTexture), queuedTiles.end());
+		idleCond.wait(lock, [this, texture]() { return loadingTexture != texture; });
+		loadedTiles.erase(remove_if(loadedTiles.begin(), loadedTiles.end(), ofTexture), loadedTiles.end());
+	}
+	for (Page& page : pages)
+	{
+		if (page.owner == texture)
+			page = Page();
+	}
+	textureIds[it->second.id - 1] = nullptr;
+	glDeleteTextures(1, &it->second.indirectionObj);
+	entries.erase(it);
+}
+
+int VirtualTextureSystem::GetId(const VirtualTexture* texture) const
+{
+	auto it = entries.find(const_cast<VirtualTexture*>(texture));
+	return (it != entries.end()) ? it->second.id : 0;
+}
+
+void VirtualTextureSystem::BindPhysical(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, physicalObj);
+}
+
+void VirtualTextureSystem::BindIndirection(const VirtualTexture* texture, GLenum textureUnit)
+{
+	auto it = entries.find(const_cast<VirtualTexture*>(texture));
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, (it != entries.end()) ? it->second.indirectionObj : 0);
+}
+
+// Render into the feedback target, cleared to id 0 (no virtual texture).
+void VirtualTextureSystem::BeginFeedback(const int screenWidth, const int screenHeight)
+{
+	const int width = max(1, screenWidth / feedbackScale), height = max(1, screenHeight / feedbackScale);
+	if (feedbackTarget == nullptr)
+		feedbackTarget = new RenderTarget(width, height);
+	else
+		feedbackTarget->Resize(width, height);
+	feedbackTarget->Bind();
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, prevClearColor);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Start reading the feedback back (skipped while the previous readbacks are in flight).
+void VirtualTextureSystem::EndFeedback()
+{
+	feedbackTarget->UnBind();
+	glClearColor(prevClearColor[0], prevClearColor[1], prevClearColor[2], prevClearColor[3]);
+	if (feedbackTarget->GetComplete() && !feedbackReadback->IsFull())
+		feedbackReadback->Request(feedbackTarget->GetFboId(), feedbackTarget->GetWidth(), feedbackTarget->GetHeight(), "");
+}
+
+void VirtualTextureSystem::Update(const bool wait)
+{
+	frameIndex++;
+	// Only the newest finished feedback matters.
+	ReadbackFrame frame;
+	bool hasFeedback = false;
+	while (feedbackReadback->GetNumPending() > 0 && feedbackReadback->Poll(frame, wait))
+		hasFeedback = true;
+	if (hasFeedback)
+		ProcessFeedback(frame.pixels);
+	if (wait)
+	{
+		unique_lock<mutex> lock(loaderMutex);
+		idleCond.wait(lock, [this]() { return queuedTiles.empty() && loadingTexture == nullptr; });
+	}
+	UploadTiles(wait);
+	for (auto& entry : entries)
+	{
+		if (entry.second.dirty)
+			UpdateIndirection(entry.first, entry.second);
+	}
+}
+
+// Mark the resident tiles of the feedback as used and queue the missing ones. The queue is
+// rebuilt every time, so tiles that went out of view before the loader got to them are dropped.
+void VirtualTextureSystem::ProcessFeedback(const cv::Mat& feedback)
+{
+	// Distinct (id, x, y, level) values; neighbouring pixels mostly repeat.
+	vector<unsigned int> keys;
+	unsigned int prevKey = 0;
+	for (int row = 0; row < feedback.rows; ++row)
+	{
+		const unsigned char* pixel = feedback.ptr<unsigned char>(row);
+		for (int col = 0; col < feedback.cols; ++col, pixel += 4)
+		{
+			// BGRA: level, tile y, tile x, id.
+			const unsigned int key = (static_cast<unsigned int>(pixel[3]) << 24) | (pixel[2] << 16) | (pixel[1] << 8) | pixel[0];
+			if (pixel[3] == 0 || key == prevKey)
+				continue;
+			keys.push_back(key);
+			prevKey = key;
+		}
+	}
+	sort(keys.begin(), keys.end());
+	keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+	vector<TileRequest> requests;
+	unique_lock<mutex> lock(loaderMutex);
+	for (TileRequest& queued : queuedTiles)
+		entries[queued.texture].tilePages[queued.tileIndex] = TILE_NOT_RESIDENT;
+	queuedTiles.clear();
+	for (unsigned int key : keys)
+	{
+		const int id = key >> 24;
+		VirtualTexture* texture = (id <= static_cast<int>(textureIds.size())) ? textureIds[id - 1] : nullptr;
+		if (texture == nullptr)
+			continue;
+		Entry& entry = entries[texture];
+		int level = min(static_cast<int>(key & 0xFF), texture->GetNumLevels() - 1);
+		int x = min(static_cast<int>((key >> 16) & 0xFF), texture->GetTilesX(level) - 1);
+		int y = min(static_cast<int>((key >> 8) & 0xFF), texture->GetTilesY(level) - 1);
+		// The tile and its ancestors, so coarser tiles fill in while the finer ones load.
+		for (; level < texture->GetNumLevels(); ++level, x /= 2, y /= 2)
+		{
+			const int tileIndex = texture->GetTileIndex(level, x, y);
+			int& state = entry.tilePages[tileIndex];
+			if (state >= 0)
+				pages[state].lastUsedFrame = frameIndex;
+			else if (state == TILE_NOT_RESIDENT)
+			{
+				state = TILE_LOADING;
+				TileRequest request;
+				request.texture = texture;
+				request.level = level;
+				request.x = x;
+				request.y = y;
+				request.tileIndex = tileIndex;
+				requests.push_back(move(request));
+			}
+		}
+	}
+	stable_sort(requests.begin(), requests.end(), [](const TileRequest& a, const TileRequest& b) { return a.level > b.level; });
+	numRequested = requests.size();
+	for (TileRequest& request : requests)
+		queuedTiles.push_back(move(request));
+	lock.unlock();
+	loaderCond.notify_all();
+}
+
+// Move the read tiles into pages, up to maxUploads unless all is set.
+void VirtualTextureSystem::UploadTiles(const bool all)
+{
+	vector<TileRequest> tiles;
+	{
+		lock_guard<mutex> lock(loaderMutex);
+		const size_t count = all ? loadedTiles.size() : min(loadedTiles.size(), static_cast<size_t>(maxUploads));
+		tiles.assign(make_move_iterator(loadedTiles.begin()), make_move_iterator(loadedTiles.begin() + count));
+		loadedTiles.erase(loadedTiles.begin(), loadedTiles.begin() + count);
+	}
+	for (TileRequest& tile : tiles)
+	{
+		Entry& entry = entries[tile.texture];
+		const int page = tile.pixels.empty() ? -1 : AllocatePage(false);
+		if (page < 0)
+		{
+			// The cache is full of tiles in view; the tile is requested again later.
+			entry.tilePages[tile.tileIndex] = TILE_NOT_RESIDENT;
+			continue;
+		}
+		UploadPage(page, tile.pixels);
+		pages[page].owner = tile.texture;
+		pages[page].tileIndex = tile.tileIndex;
+		pages[page].lastUsedFrame = frameIndex;
+		entry.tilePages[tile.tileIndex] = page;
+		entry.dirty = true;
+		numUploads++;
+	}
+}
+
+// A free page, or the least recently used one (only among those not used in this frame
+// unless evictUsed is set). The coarsest tiles are never evicted.
+int VirtualTextureSystem::AllocatePage(const bool evictUsed)
+{
+	int victim = -1;
+	for (int i = 0; i < static_cast<int>(pages.size()); ++i)
+	{
+		const Page& page = pages[i];
+		if (page.owner == nullptr)
+			return i;
+		if (page.pinned || (!evictUsed && page.lastUsedFrame >= frameIndex))
+			continue;
+		if (victim < 0 || page.lastUsedFrame < pages[victim].lastUsedFrame)
+			victim = i;
+	}
+	if (victim < 0)
+		return -1;
+	Entry& owner = entries[pages[victim].owner];
+	owner.tilePages[pages[victim].tileIndex] = TILE_NOT_RESIDENT;
+	owner.dirty = true;
+	pages[victim] = Page();
+	numEvictions++;
+	return victim;
+}
+
+void VirtualTextureSystem::UploadPage(const int page, const vector<unsigned char>& pixels)
+{
+	glBindTexture(GL_TEXTURE_2D, physicalObj);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (page % pagesPerSide) * VIRTUAL_TEXTURE_PAGE_SIZE, (page / pagesPerSide) * VIRTUAL_TEXTURE_PAGE_SIZE,
+		VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_PAGE_SIZE, GL_BGR, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Rewrite the indirection texture from the coarsest level down: a tile that is not resident
+// inherits the texel of its parent. Texels are (page x, page y, level of the page, 255).
+void VirtualTextureSystem::UpdateIndirection(const VirtualTexture* texture, Entry& entry)
+{
+	vector<unsigned char> parent, current;
+	glBindTexture(GL_TEXTURE_2D, entry.indirectionObj);
+	for (int level = texture->GetNumLevels() - 1; level >= 0; --level)
+	{
+		const int tilesX = texture->GetTilesX(level), tilesY = texture->GetTilesY(level);
+		const int parentTilesX = texture->GetTilesX(min(level + 1, texture->GetNumLevels() - 1));
+		current.resize(static_cast<size_t>(tilesX) * tilesY * 4);
+		for (int y = 0; y < tilesY; ++y)
+		{
+			for (int x = 0; x < tilesX; ++x)
+			{
+				unsigned char* texel = &current[(static_cast<size_t>(y) * tilesX + x) * 4];
+				const int page = entry.tilePages[texture->GetTileIndex(level, x, y)];
+				if (page >= 0)
+				{
+					texel[0] = static_cast<unsigned char>(page % pagesPerSide);
+					texel[1] = static_cast<unsigned char>(page / pagesPerSide);
+					texel[2] = static_cast<unsigned char>(level);
+					texel[3] = 255;
+				}
+				else
+					memcpy(texel, &parent[(static_cast<size_t>(y / 2) * parentTilesX + x / 2) * 4], 4);
+			}
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, tilesX, tilesY, GL_RGBA, GL_UNSIGNED_BYTE, current.data());
+		swap(parent, current);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	entry.dirty = false;
+}
+
+int VirtualTextureSystem::GetNumResidentPages() const
+{
+	int numResident = 0;
+	for (const Page& page : pages)
+		numResident += (page.owner != nullptr) ? 1 : 0;
+	return numResident;
+}
+
+// The physical cache and the indirection textures.
+size_t VirtualTextureSystem::GetGpuBytes() const
+{
+	size_t numBytes = pages.size() * VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE * 4;
+	for (const auto& entry : entries)
+		numBytes += entry.second.tilePages.size() * 4;
+	return numBytes;
+}
+
+void VirtualTextureSystem::ShowInfo() const
+{
+	size_t numQueued = 0;
+	{
+		lock_guard<mutex> lock(loaderMutex);
+		numQueued = queuedTiles.size() + loadedTiles.size();
+	}
+	stringstream ss;
+	ss << fixed << setprecision(1);
+	ss << "Virtual textures: " << entries.size() << " textures, " << GetNumResidentPages() << " / " << pages.size()
+		<< " pages resident (" << GetGpuBytes() / 1024.0 / 1024.0 << " MB GPU), " << numRequested << " tiles requested by the last feedback, "
+		<< numQueued << " loading" << endl;
+	ss << "  " << numUploads << " tiles uploaded, " << numEvictions << " evicted" << endl;
+	cout << ss.str();
+}
@@ -0,0 +1,182 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "headers.h"
+#include "threadpool.h"
+#include "timer.h"
+#include "mipmapbuilder.h"
+#include "texturecache.h"
+#include "imagedecoder.h"
+#include "rendertarget.h"
+#include "pboreadback.h"
+using namespace std;
+
+// Bump when the page file layout changes so stale page files are rebuilt.
+#define VIRTUAL_TEXTURE_VERSION 1
+// Texels of a tile, and of the border copied from its neighbours for bilinear filtering.
+// The shaders (phong_shading.fs, vt_feedback.fs) use the same values.
+#define VIRTUAL_TEXTURE_TILE_SIZE 128
+#define VIRTUAL_TEXTURE_BORDER 1
+#define VIRTUAL_TEXTURE_PAGE_SIZE (VIRTUAL_TEXTURE_TILE_SIZE + 2 * VIRTUAL_TEXTURE_BORDER)
+// Color maps at least this large (either side) are virtualized.
+#define VIRTUAL_TEXTURE_MIN_SIZE 1024
+// Tile coordinates and texture ids are written to the 8-bit feedback target.
+#define VIRTUAL_TEXTURE_MAX_SIZE (256 * VIRTUAL_TEXTURE_TILE_SIZE)
+#define VIRTUAL_TEXTURE_MAX_TEXTURES 255
+
+
+// VirtualTexture Declarations.
+// A large color map kept in a page file instead of GPU memory. The image is resized to
+// powers of two, so the tiles of all levels nest, and every mip level down to the one that
+// fits into a single tile is cut into TILE_SIZE tiles stored with a repeat-wrapped border
+// (BGR, one page per tile). The page file lives in the texture cache, named after the hash
+// of the source file, so later loads do not decode the image at all. ReadTile() may be
+// called from any thread; the VirtualTextureSystem decides which tiles are on the GPU.
+class VirtualTexture
+{
+public:
+	// VirtualTexture Public Methods.
+	VirtualTexture();
+	~VirtualTexture();
+
+	string GetPageFilePath() const { return pageFilePath; }
+	int GetWidth()  const { return width; }
+	int GetHeight() const { return height; }
+	int GetNumLevels() const { return numLevels; }
+	int GetTilesX(const int level) const { return max(1, (width >> level) / VIRTUAL_TEXTURE_TILE_SIZE); }
+	int GetTilesY(const int level) const { return max(1, (height >> level) / VIRTUAL_TEXTURE_TILE_SIZE); }
+	int GetNumTiles() const { return levelOffsets.empty() ? 0 : levelOffsets.back(); }
+	int GetTileIndex(const int level, const int x, const int y) const { return levelOffsets[level] + y * GetTilesX(level) + x; }
+	bool GetFromCache() const { return fromCache; }
+	double GetLoadTimeMs() const { return loadTimeMs; }
+	size_t GetPageFileBytes() const;
+
+	// Open the page file of an image, building it first if it is not cached (no GL calls).
+	// Returns false if the image is smaller than minSize on both sides (or cannot be paged);
+	// the decoded image is then returned in image so the caller can use it as it is.
+	bool Create(const string& filePath, const int minSize, const MipFilter mipFilter, cv::Mat& image);
+	bool ReadTile(const int level, const int x, const int y, vector<unsigned char>& pixels);
+	void ShowInfo() const;
+
+private:
+	// VirtualTexture Private Methods.
+	void ComputeLayout();
+	bool OpenPageFile();
+	bool WritePageFile(const cv::Mat& image, const MipFilter mipFilter);
+	// VirtualTexture Private Data.
+	string texFilePath;
+	string pageFilePath;
+	ifstream pageFile;
+	mutex fileMutex;
+	int width;
+	int height;
+	int numLevels;
+	vector<int> levelOffsets;  // Index of the first tile of each level (and the tile count).
+	bool fromCache;
+	double loadTimeMs;
+};
+
+
+// VirtualTextureSystem Declarations.
+// Keeps the tiles of the registered virtual textures that the camera needs in one physical
+// page cache texture. Each frame the scene is drawn into a small feedback target that holds
+// (tile x, tile y, level, texture id) per pixel; it is read back asynchronously and Update()
+// queues the missing tiles (and their ancestors, coarsest first) for a loader thread that
+// reads them from the page files. Read tiles are uploaded up to a number per frame into free
+// or least recently used pages. The indirection texture of a texture has one texel per tile
+// and level holding the page of the tile, or of its finest resident ancestor (the single tile
+// of the coarsest level is always resident), so sampling never misses.
+class VirtualTextureSystem
+{
+public:
+	// VirtualTextureSystem Public Methods.
+	VirtualTextureSystem(const int nPagesPerSide = 16, const int nUploadsPerFrame = 16, const int nFeedbackScale = 8);
+	~VirtualTextureSystem();
+
+	int GetNumPages() const { return static_cast<int>(pages.size()); }
+	int GetNumResidentPages() const;
+	size_t GetGpuBytes() const;
+	// The feedback target is feedbackScale times smaller than the screen, so its texel
+	// footprints are larger by that factor: the feedback shader subtracts log2(feedbackScale).
+	float GetFeedbackLodBias() const { return -log2(static_cast<float>(feedbackScale)); }
+	// 1-based id written by the feedback shader, 0 if the texture is not registered.
+	int GetId(const VirtualTexture* texture) const;
+
+	bool Register(VirtualTexture* texture);
+	void Unregister(VirtualTexture* texture);
+	void BindPhysical(GLenum textureUnit);
+	void BindIndirection(const VirtualTexture* texture, GLenum textureUnit);
+	// The feedback pass is drawn between these two calls.
+	void BeginFeedback(const int screenWidth, const int screenHeight);
+	void EndFeedback();
+	// Called once per frame. With wait, the last feedback is used right away and every tile
+	// it needs is loaded and uploaded before returning (for offline rendering).
+	void Update(const bool wait = false);
+	void ShowInfo() const;
+
+private:
+	// VirtualTextureSystem Private Declarations.
+	// Tile states besides the index of the page holding the tile.
+	enum TileState
+	{
+		TILE_NOT_RESIDENT = -1,
+		TILE_LOADING = -2
+	};
+	struct Entry
+	{
+		int id = 0;
+		vector<int> tilePages;
+		GLuint indirectionObj = 0;
+		bool dirty = false;
+	};
+	struct Page
+	{
+		VirtualTexture* owner = nullptr;
+		int tileIndex = 0;
+		unsigned int lastUsedFrame = 0;
+		bool pinned = false;
+	};
+	struct TileRequest
+	{
+		VirtualTexture* texture = nullptr;
+		int level = 0;
+		int x = 0;
+		int y = 0;
+		int tileIndex = 0;
+		vector<unsigned char> pixels;
+	};
+	// VirtualTextureSystem Private Methods.
+	void LoaderLoop();
+	void ProcessFeedback(const cv::Mat& feedback);
+	void UploadTiles(const bool all);
+	int AllocatePage(const bool evictUsed);
+	void UploadPage(const int page, const vector<unsigned char>& pixels);
+	void UpdateIndirection(const VirtualTexture* texture, Entry& entry);
+	// VirtualTextureSystem Private Data.
+	unordered_map<VirtualTexture*, Entry> entries;
+	vector<VirtualTexture*> textureIds;  // Registered texture of each id - 1.
+	vector<Page> pages;
+	int pagesPerSide;
+	int maxUploads;
+	int feedbackScale;
+	GLuint physicalObj;
+	RenderTarget* feedbackTarget;
+	PboReadback* feedbackReadback;
+	GLfloat prevClearColor[4];
+	unsigned int frameIndex;
+	// Loader thread.
+	thread loader;
+	mutable mutex loaderMutex;
+	condition_variable loaderCond;
+	condition_variable idleCond;
+	deque<TileRequest> queuedTiles;   // Waiting for the loader, coarsest first.
+	vector<TileRequest> loadedTiles;  // Read, waiting for a page.
+	const VirtualTexture* loadingTexture;
+	bool stopping;
+	// Statistics.
+	unsigned long long numUploads;
+	unsigned long long numEvictions;
+	size_t numRequested;
+};
+
+#endif